@@ -0,0 +1,281 @@
+#include "backup.h"
+#include "busy_retry.h"
+#include "../utils/utc_time.h"
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    int64_t readInt(const json& section, const char* key, int64_t fallback) {
+        if (section.contains(key) && section[key].is_number_integer())
+            return section[key].get<int64_t>();
+        return fallback;
+    }
+
+    std::string utcTimestamp() {
+        std::tm tm = utcTime(std::time(nullptr));
+        char buf[32];
+        std::strftime(buf, sizeof(buf), "%Y%m%dT%H%M%SZ", &tm);
+        return buf;
+    }
+
+    uint64_t micros(Clock::duration d) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    }
+}
+
+BackupManager::Options BackupManager::Options::fromConfig(const json& section) {
+    Options o;
+    if (!section.is_object()) return o;
+    if (section.contains("directory") && section["directory"].is_string())
+        o.directory = section["directory"].get<std::string>();
+    o.pagesPerStep = static_cast<int>(readInt(section, "pages_per_step", o.pagesPerStep));
+    o.stepSleep = std::chrono::milliseconds(readInt(section, "step_sleep_ms", o.stepSleep.count()));
+    o.interval = std::chrono::minutes(readInt(section, "interval_minutes", o.interval.count()));
+    o.keep = static_cast<size_t>(std::max<int64_t>(readInt(section, "keep", static_cast<int64_t>(o.keep)), 1));
+    o.maxRestarts = static_cast<int>(readInt(section, "max_restarts", o.maxRestarts));
+    if (o.pagesPerStep <= 0)
+        o.pagesPerStep = 256;
+    return o;
+}
+
+BackupManager::BackupManager(std::vector<Source> sources, Options options)
+    : sources(std::move(sources)), options(options), stopping(false), requested(false), running(false),
+      current(json::object()), completed(0), failed(0), steps(0), lockMicros(0), maxStepMicros(0), busySteps(0) {
+    worker = std::thread([this] { loop(); });
+}
+
+BackupManager::~BackupManager() {
+    stop();
+}
+
+void BackupManager::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+bool BackupManager::start() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping || requested || running)
+            return false;
+        requested = true;
+    }
+    wake.notify_one();
+    return true;
+}
+
+void BackupManager::loop() {
+    auto nextScheduled = Clock::now() + options.interval;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        auto ready = [this] { return stopping || requested; };
+        if (options.interval.count() > 0) {
+            if (!wake.wait_until(lock, nextScheduled, ready))
+                requested = true;  // scheduled run
+        } else {
+            wake.wait(lock, ready);
+        }
+        if (stopping)
+            break;
+        requested = false;
+        running = true;
+        lock.unlock();
+        runBackup();
+        lock.lock();
+        running = false;
+        nextScheduled = Clock::now() + options.interval;
+    }
+}
+
+std::string BackupManager::targetDirectory() const {
+    fs::path dir(options.directory);
+    if (dir.is_relative())
+        dir = fs::path(sources.front().path).parent_path() / dir;
+    return dir.string();
+}
+
+void BackupManager::runBackup() {
+    auto started = Clock::now();
+    std::string dir = targetDirectory();
+    std::string stamp = utcTimestamp();
+    std::vector<std::string> targets;
+    for (const auto& source : sources)
+        targets.push_back((fs::path(dir) / (fs::path(source.path).stem().string() + "-" + stamp + ".db")).string());
+    steps = lockMicros = maxStepMicros = busySteps = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = json::object();
+        current["state"] = "running";
+        current["file"] = targets.front();
+        current["files"] = targets;
+        current["started_at"] = stamp;
+    }
+
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    std::string error;
+    size_t written = 0;
+    for (; written < sources.size() && error.empty(); written++) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current["copying"] = targets[written];
+        }
+        error = copyFile(sources[written], targets[written]);
+    }
+    if (!error.empty()) {
+        // A partial set cannot be restored consistently, so none of it is kept
+        for (size_t i = 0; i + 1 < written; i++)
+            fs::remove(targets[i], ec);
+    } else {
+        for (const auto& source : sources)
+            prune(dir, fs::path(source.path).stem().string());
+    }
+
+    uint64_t elapsed = micros(Clock::now() - started);
+    std::lock_guard<std::mutex> lock(mutex);
+    current.erase("copying");
+    current["state"] = error.empty() ? "completed" : "failed";
+    current["duration_us"] = elapsed;
+    current["busy_steps"] = busySteps;
+    if (error.empty()) {
+        completed++;
+        uint64_t bytes = 0;
+        for (const auto& target : targets) {
+            std::error_code sizeEc;
+            auto size = fs::file_size(target, sizeEc);
+            bytes += sizeEc ? 0 : static_cast<uint64_t>(size);
+        }
+        current["bytes"] = bytes;
+        std::cout << "Backup written to " << targets.front();
+        if (targets.size() > 1)
+            std::cout << " and " << targets.size() - 1 << " more file(s)";
+        std::cout << " in " << elapsed / 1000 << " ms (" << steps << " steps, source locked " << lockMicros / 1000
+                  << " ms, max step " << maxStepMicros / 1000.0 << " ms)" << std::endl;
+    } else {
+        failed++;
+        current["error"] = error;
+        std::cerr << "Backup to " << targets[written - 1] << " failed: " << error << std::endl;
+    }
+}
+
+std::string BackupManager::copyFile(const Source& source, const std::string& target) {
+    std::string partial = target + ".part";
+    sqlite3* src = source.opener();
+    sqlite3* dest = nullptr;
+    sqlite3_backup* backup = nullptr;
+    std::string error;
+    if (!src) {
+        error = "could not open source database " + source.path;
+    } else if (sqlite3_open_v2(partial.c_str(), &dest, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+        error = std::string("could not create ") + partial + ": " + (dest ? sqlite3_errmsg(dest) : "out of memory");
+    } else if (!(backup = sqlite3_backup_init(dest, "main", src, "main"))) {
+        error = sqlite3_errmsg(dest);
+    }
+
+    int rc = SQLITE_OK;
+    int restarts = 0;
+    int previousRemaining = -1;
+    if (backup) {
+        int pages = options.pagesPerStep;
+        for (;;) {
+            // Each step holds the source read lock only while it copies its pages
+            auto stepStart = Clock::now();
+            rc = sqlite3_backup_step(backup, pages);
+            uint64_t stepMicros = micros(Clock::now() - stepStart);
+            steps++;
+            lockMicros += stepMicros;
+            maxStepMicros = std::max(maxStepMicros, stepMicros);
+            int remaining = sqlite3_backup_remaining(backup);
+            int total = sqlite3_backup_pagecount(backup);
+            // No progress: another connection wrote to the source and the copy started over
+            if (rc == SQLITE_OK && previousRemaining >= 0 && remaining >= previousRemaining && ++restarts >= options.maxRestarts)
+                pages = -1;
+            previousRemaining = remaining;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                current["pages_total"] = total;
+                current["pages_remaining"] = remaining;
+                current["progress"] = total > 0 ? static_cast<double>(total - remaining) / total : 0.0;
+                current["steps"] = steps;
+                current["restarts"] = restarts;
+                current["lock_held_us"] = lockMicros;
+                current["max_step_us"] = maxStepMicros;
+                if (stopping) break;
+            }
+            if (rc == SQLITE_DONE)
+                break;
+            if (BusyRetry::isBusy(rc)) {
+                busySteps++;
+            } else if (rc != SQLITE_OK) {
+                break;
+            }
+            std::this_thread::sleep_for(options.stepSleep);
+        }
+        if (rc != SQLITE_DONE && error.empty())
+            error = rc == SQLITE_OK ? "stopped" : sqlite3_errstr(rc);
+        sqlite3_backup_finish(backup);
+    }
+    if (dest) sqlite3_close(dest);
+    if (src) sqlite3_close_v2(src);
+
+    std::error_code ec;
+    if (error.empty()) {
+        fs::rename(partial, target, ec);
+        if (ec) error = "could not rename backup: " + ec.message();
+    }
+    if (!error.empty())
+        fs::remove(partial, ec);
+    return error;
+}
+
+void BackupManager::prune(const std::string& dir, const std::string& stem) const {
+    // Exactly <stem>-YYYYMMDDTHHMMSSZ.db, so lala-store does not also match
+    // lala-store-archive or lala-store-shard-0 backups
+    const size_t stampLength = 16;
+    std::string prefix = stem + "-";
+    std::vector<fs::path> backups;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        std::string name = entry.path().filename().string();
+        if (entry.is_regular_file() && name.rfind(prefix, 0) == 0 && entry.path().extension() == ".db" &&
+            name.size() == prefix.size() + stampLength + 3 && name[prefix.size() + 8] == 'T' &&
+            std::isdigit(static_cast<unsigned char>(name[prefix.size()])))
+            backups.push_back(entry.path());
+    }
+    if (backups.size() <= options.keep)
+        return;
+    // Timestamps sort lexicographically, oldest first
+    std::sort(backups.begin(), backups.end());
+    for (size_t i = 0; i + options.keep < backups.size(); i++)
+        fs::remove(backups[i], ec);
+}
+
+json BackupManager::status() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    json j;
+    j["running"] = running;
+    j["queued"] = requested;
+    j["completed"] = completed;
+    j["failed"] = failed;
+    j["directory"] = targetDirectory();
+    j["pages_per_step"] = options.pagesPerStep;
+    j["step_sleep_ms"] = options.stepSleep.count();
+    j["interval_minutes"] = options.interval.count();
+    j["keep"] = options.keep;
+    j["last"] = current;
+    return j;
+}
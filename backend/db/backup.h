@@ -0,0 +1,85 @@
+#ifndef BACKUP_H
+#define BACKUP_H
+
+#include <sqlite3.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Online backups through the sqlite3_backup API. Pages are copied a few
+// hundred per step with a pause between steps, so the source read lock is only
+// ever held for one short step. Backups land in a timestamped file next to the
+// database and run on a schedule or on demand. One backup covers every file
+// it was given (the main file, then shard and archive files), all stamped
+// with the same timestamp; if any file fails the whole set is discarded.
+class BackupManager {
+public:
+    using Opener = std::function<sqlite3*()>;
+
+    struct Source {
+        std::string path;   // the file being copied; its stem names the backup
+        Opener opener;
+    };
+
+    struct Options {
+        std::string directory = "backups";   // relative to the database file's directory
+        int pagesPerStep = 256;
+        std::chrono::milliseconds stepSleep{10};
+        std::chrono::minutes interval{0};     // 0 disables scheduled backups
+        size_t keep = 7;                      // older backups beyond this are deleted
+        // When writers keep invalidating the copy, finish the remaining pages in
+        // one step after this many restarts instead of chasing them forever
+        int maxRestarts = 3;
+
+        // Reads db_config.json's "backup" section
+        static Options fromConfig(const nlohmann::json& section);
+    };
+
+    // sources.front() is the main database; the backup directory is relative to it
+    BackupManager(std::vector<Source> sources, Options options);
+    ~BackupManager();
+    BackupManager(const BackupManager&) = delete;
+    BackupManager& operator=(const BackupManager&) = delete;
+
+    // Queues a backup; false if one is already queued or running
+    bool start();
+    // Progress of the running backup, or the result of the last one
+    nlohmann::json status() const;
+    void stop();
+
+private:
+    void loop();
+    void runBackup();
+    // Copies one source into target through a .part file; empty on success
+    std::string copyFile(const Source& source, const std::string& target);
+    std::string targetDirectory() const;
+    void prune(const std::string& dir, const std::string& stem) const;
+
+    std::vector<Source> sources;
+    Options options;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+    bool requested;
+    bool running;
+    std::thread worker;
+
+    // Progress of the current or last backup, guarded by the mutex
+    nlohmann::json current;
+    uint64_t completed;
+    uint64_t failed;
+    // Step counters of the current backup summed over its files; worker thread only
+    uint64_t steps;
+    uint64_t lockMicros;
+    uint64_t maxStepMicros;
+    uint64_t busySteps;
+};
+
+#endif // BACKUP_H
@@ -0,0 +1,182 @@
+#include "busy_retry.h"
+#include "../utils/latency_histogram.h"
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+
+using json = nlohmann::json;
+
+namespace {
+    struct SiteStats {
+        std::atomic<uint64_t> busyEvents{0};     // busy handler invoked for a fresh lock wait
+        std::atomic<uint64_t> handlerTimeouts{0};
+        std::atomic<uint64_t> retries{0};        // extra attempts made by BusyRetry::retry
+        std::atomic<uint64_t> recovered{0};      // retried calls that eventually succeeded
+        std::atomic<uint64_t> exhausted{0};      // retried calls still BUSY after the last attempt
+        LatencyHistogram wait;                   // total wait per contended call
+    };
+
+    std::mutex registryMutex;
+    std::map<std::string, std::unique_ptr<SiteStats>> sites;
+    std::mutex policyMutex;
+    BusyPolicy currentPolicy;
+
+    thread_local const char* currentSite = nullptr;
+    // Busy-handler sleep accumulated for the current site, flushed when the site scope ends
+    thread_local uint64_t pendingWaitMicros = 0;
+    thread_local SiteStats* pendingSite = nullptr;
+    // Set while BusyRetry::retry runs: the handler and the retry loop share one
+    // timeout budget, and retry() records the whole wait itself
+    thread_local bool inRetry = false;
+    thread_local std::chrono::steady_clock::time_point retryDeadline;
+
+    SiteStats& site(const std::string& name) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        auto& entry = sites[name];
+        if (!entry) entry = std::make_unique<SiteStats>();
+        return *entry;
+    }
+
+    void flushPending() {
+        if (pendingSite && pendingWaitMicros > 0)
+            pendingSite->wait.record(pendingWaitMicros);
+        pendingSite = nullptr;
+        pendingWaitMicros = 0;
+    }
+
+    uint64_t jitteredBackoffMicros(int attempt, const BusyPolicy& p) {
+        thread_local std::mt19937 rng(std::random_device{}());
+        int64_t ceiling = std::min<int64_t>(int64_t(p.retryBaseMs) << std::min(attempt, 20), p.retryMaxMs) * 1000;
+        std::uniform_int_distribution<int64_t> dist(0, ceiling);
+        return static_cast<uint64_t>(dist(rng));
+    }
+
+    // Same delay schedule as SQLite's default busy handler
+    const int kDelaysMs[] = {1, 2, 5, 10, 15, 20, 25, 25, 25, 50, 50, 100};
+    const int kDelayCount = sizeof(kDelaysMs) / sizeof(kDelaysMs[0]);
+
+    int onBusy(void* arg, int count) {
+        const char* name = currentSite ? currentSite : static_cast<const char*>(arg);
+        SiteStats& stats = site(name);
+        if (count == 0) {
+            stats.busyEvents.fetch_add(1, std::memory_order_relaxed);
+            if (pendingSite != &stats) flushPending();
+            pendingSite = inRetry ? nullptr : &stats;
+        }
+        int delay = count < kDelayCount ? kDelaysMs[count] : kDelaysMs[kDelayCount - 1];
+        auto now = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::time_point deadline = retryDeadline;
+        if (!inRetry) {
+            // Reconstruct how long this lock wait has slept so far from the schedule
+            int slept = 0;
+            for (int i = 0; i < count; i++)
+                slept += i < kDelayCount ? kDelaysMs[i] : kDelaysMs[kDelayCount - 1];
+            deadline = now + std::chrono::milliseconds(BusyRetry::policy().timeoutMs - slept);
+        }
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now).count();
+        if (remaining <= 0) {
+            stats.handlerTimeouts.fetch_add(1, std::memory_order_relaxed);
+            if (!currentSite) flushPending();
+            return 0;
+        }
+        delay = static_cast<int>(std::min<int64_t>(delay, remaining));
+        std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+        if (pendingSite)
+            pendingWaitMicros += static_cast<uint64_t>(delay) * 1000;
+        return 1;
+    }
+}
+
+namespace BusyRetry {
+
+void configure(const BusyPolicy& policy) {
+    std::lock_guard<std::mutex> lock(policyMutex);
+    currentPolicy = policy;
+}
+
+BusyPolicy policy() {
+    std::lock_guard<std::mutex> lock(policyMutex);
+    return currentPolicy;
+}
+
+void install(sqlite3* db, const char* defaultSite) {
+    sqlite3_busy_handler(db, onBusy, const_cast<char*>(defaultSite));
+}
+
+bool isBusy(int rc) {
+    int primary = rc & 0xff;
+    return primary == SQLITE_BUSY || primary == SQLITE_LOCKED;
+}
+
+int retry(const char* name, const std::function<int()>& fn) {
+    BusyPolicy p = policy();
+    auto start = std::chrono::steady_clock::now();
+    BusySite scope(name);
+    inRetry = true;
+    retryDeadline = start + std::chrono::milliseconds(p.timeoutMs);
+    int rc = fn();
+    if (!isBusy(rc)) {
+        inRetry = false;
+        return rc;
+    }
+    SiteStats& stats = site(name);
+    for (int attempt = 0; attempt < p.retryAttempts && isBusy(rc); attempt++) {
+        auto pause = std::chrono::microseconds(jitteredBackoffMicros(attempt, p));
+        if (std::chrono::steady_clock::now() + pause > retryDeadline)
+            break;
+        std::this_thread::sleep_for(pause);
+        stats.retries.fetch_add(1, std::memory_order_relaxed);
+        rc = fn();
+    }
+    inRetry = false;
+    (isBusy(rc) ? stats.exhausted : stats.recovered).fetch_add(1, std::memory_order_relaxed);
+    stats.wait.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count()));
+    return rc;
+}
+
+json stats() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    json j = json::object();
+    for (const auto& entry : sites) {
+        const SiteStats& s = *entry.second;
+        json site;
+        site["busy_events"] = s.busyEvents.load(std::memory_order_relaxed);
+        site["handler_timeouts"] = s.handlerTimeouts.load(std::memory_order_relaxed);
+        site["retries"] = s.retries.load(std::memory_order_relaxed);
+        site["recovered"] = s.recovered.load(std::memory_order_relaxed);
+        site["exhausted"] = s.exhausted.load(std::memory_order_relaxed);
+        site["wait"] = s.wait.toJson();
+        j[entry.first] = site;
+    }
+    return j;
+}
+
+void resetStats() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto& entry : sites) {
+        SiteStats& s = *entry.second;
+        s.busyEvents = 0;
+        s.handlerTimeouts = 0;
+        s.retries = 0;
+        s.recovered = 0;
+        s.exhausted = 0;
+        s.wait.reset();
+    }
+}
+
+}
+
+BusySite::BusySite(const char* name) : previous(currentSite) {
+    flushPending();
+    currentSite = name;
+}
+
+BusySite::~BusySite() {
+    flushPending();
+    currentSite = previous;
+}
@@ -0,0 +1,50 @@
+#ifndef BUSY_RETRY_H
+#define BUSY_RETRY_H
+
+#include <sqlite3.h>
+#include <functional>
+#include <string>
+#include <nlohmann/json.hpp>
+
+struct BusyPolicy {
+    int timeoutMs = 5000;   // busy handler gives up after this much sleeping
+    int retryAttempts = 5;  // extra attempts made by BusyRetry::retry
+    int retryBaseMs = 2;    // first backoff; doubles per attempt, full jitter
+    int retryMaxMs = 100;
+};
+
+// SQLITE_BUSY / SQLITE_LOCKED handling with per-call-site contention metrics.
+namespace BusyRetry {
+    void configure(const BusyPolicy& policy);
+    BusyPolicy policy();
+
+    // Installs a busy handler that backs off up to policy().timeoutMs and records
+    // the time spent waiting. Waits count against the thread's current BusySite,
+    // or against defaultSite (e.g. the pool name) when there is none.
+    void install(sqlite3* db, const char* defaultSite);
+
+    // BUSY or LOCKED, including extended result codes
+    bool isBusy(int rc);
+
+    // Re-runs fn while it returns BUSY/LOCKED, sleeping with jittered exponential
+    // backoff between attempts. Busy-handler waits inside fn share the same
+    // timeoutMs budget, so the total wait stays bounded. Returns the last result code.
+    int retry(const char* site, const std::function<int()>& fn);
+
+    nlohmann::json stats();
+    void resetStats();
+}
+
+// Attributes busy-handler waits on this thread to a named call site while in scope.
+class BusySite {
+public:
+    explicit BusySite(const char* name);
+    ~BusySite();
+    BusySite(const BusySite&) = delete;
+    BusySite& operator=(const BusySite&) = delete;
+
+private:
+    const char* previous;
+};
+
+#endif // BUSY_RETRY_H
@@ -0,0 +1,709 @@
+#include "catalog_importer.h"
+#include "query_registry.h"
+#include "../models/Money.h"
+#include "../models/Timestamp.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    constexpr size_t kMaxReportedErrors = 20;
+
+    // Unchanged rows are left alone (no page write) so re-importing a catalog
+    // only costs the rows that moved. RETURNING tells inserts and updates apart.
+    const char* const kUpsertSql = QueryRegistry::add("import.upsert-product",
+        "INSERT INTO products (sku, name, description, price_cents, image_url, category_id, gender, "
+        "stock_quantity, sizes, size_chart, created_at_ms) "
+        "VALUES (?1, ?2, ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10, ?11) "
+        "ON CONFLICT(sku) WHERE sku IS NOT NULL DO UPDATE SET "
+        "name = excluded.name, description = excluded.description, price_cents = excluded.price_cents, "
+        "image_url = excluded.image_url, category_id = excluded.category_id, gender = excluded.gender, "
+        "stock_quantity = excluded.stock_quantity, sizes = excluded.sizes, size_chart = excluded.size_chart "
+        "WHERE products.name IS NOT excluded.name OR products.description IS NOT excluded.description "
+        "OR products.price_cents IS NOT excluded.price_cents OR products.image_url IS NOT excluded.image_url "
+        "OR products.category_id IS NOT excluded.category_id OR products.gender IS NOT excluded.gender "
+        "OR products.stock_quantity IS NOT excluded.stock_quantity OR products.sizes IS NOT excluded.sizes "
+        "OR products.size_chart IS NOT excluded.size_chart "
+        "RETURNING id",
+        QueryRegistry::Scope::Catalog);
+    const char* const kCategoryIdSql = QueryRegistry::add("import.category-id",
+        "SELECT id FROM categories WHERE name = ?1", QueryRegistry::Scope::Catalog);
+    const char* const kInsertCategorySql = QueryRegistry::add("import.insert-category",
+        "INSERT INTO categories (name) VALUES (?1) RETURNING id", QueryRegistry::Scope::Catalog);
+    const char* const kNextIdSql = QueryRegistry::add("import.next-product-id",
+        "SELECT COALESCE(MAX(id), 0) + 1 FROM products", QueryRegistry::Scope::Catalog);
+
+    struct Row {
+        int64_t line = 0;
+        std::string sku;
+        std::string name;
+        std::optional<std::string> description;
+        std::optional<std::string> imageUrl;
+        std::optional<std::string> sizes;
+        std::optional<std::string> sizeChart;
+        std::string category;
+        int64_t categoryId = 0;
+        std::string gender;
+        Money price;
+        int64_t stock = 0;
+    };
+
+    struct Batch {
+        std::vector<Row> rows;
+        size_t read = 0;
+        size_t rejected = 0;
+        std::vector<std::string> errors;
+    };
+
+    // Parsed batches handed from the parser thread to the importing thread
+    class BatchQueue {
+    public:
+        explicit BatchQueue(size_t capacity) : capacity(std::max<size_t>(capacity, 1)), done(false), cancelled(false) {}
+
+        // Blocks while the queue is full; false once the consumer has cancelled
+        bool push(Batch batch) {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return cancelled || batches.size() < capacity; });
+            if (cancelled)
+                return false;
+            batches.push_back(std::move(batch));
+            changed.notify_all();
+            return true;
+        }
+
+        // Empty once the parser has finished and everything was taken
+        std::optional<Batch> pop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return done || !batches.empty(); });
+            if (batches.empty())
+                return std::nullopt;
+            Batch b = std::move(batches.front());
+            batches.pop_front();
+            changed.notify_all();
+            return b;
+        }
+
+        void finish() {
+            std::lock_guard<std::mutex> lock(mutex);
+            done = true;
+            changed.notify_all();
+        }
+
+        void cancel() {
+            std::lock_guard<std::mutex> lock(mutex);
+            cancelled = true;
+            changed.notify_all();
+        }
+
+    private:
+        size_t capacity;
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<Batch> batches;
+        bool done;
+        bool cancelled;
+    };
+
+    // RFC 4180 records: quoted fields may hold commas, doubled quotes and newlines
+    class CsvReader {
+    public:
+        explicit CsvReader(std::istream& in) : in(in), buffer(1 << 20), pos(0), len(0), lineNo(1) {}
+
+        // Next record and the line it starts on; false at end of input
+        bool next(std::vector<std::string>& fields, int64_t& line) {
+            fields.clear();
+            int c = get();
+            if (c == EOF)
+                return false;
+            line = lineNo;
+            std::string field;
+            bool quoted = false;
+            bool wasQuoted = false;
+            for (;; c = get()) {
+                if (quoted) {
+                    if (c == EOF) {
+                        break;  // unterminated quote: keep what was read
+                    } else if (c == '"') {
+                        if (peek() == '"') {
+                            get();
+                            field += '"';
+                        } else {
+                            quoted = false;
+                        }
+                    } else {
+                        if (c == '\n') lineNo++;
+                        field += static_cast<char>(c);
+                    }
+                } else if (c == '"' && field.empty() && !wasQuoted) {
+                    quoted = wasQuoted = true;
+                } else if (c == ',') {
+                    fields.push_back(std::move(field));
+                    field.clear();
+                    wasQuoted = false;
+                } else if (c == '\n' || c == EOF) {
+                    if (c == '\n') lineNo++;
+                    break;
+                } else if (c != '\r') {
+                    field += static_cast<char>(c);
+                }
+            }
+            fields.push_back(std::move(field));
+            return true;
+        }
+
+    private:
+        bool fill() {
+            if (pos < len)
+                return true;
+            in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            len = static_cast<size_t>(in.gcount());
+            pos = 0;
+            return len > 0;
+        }
+        int get() { return fill() ? static_cast<unsigned char>(buffer[pos++]) : EOF; }
+        int peek() { return fill() ? static_cast<unsigned char>(buffer[pos]) : EOF; }
+
+        std::istream& in;
+        std::vector<char> buffer;
+        size_t pos;
+        size_t len;
+        int64_t lineNo;
+    };
+
+    std::string lower(std::string s) {
+        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return s;
+    }
+
+    std::string trim(const std::string& s) {
+        size_t b = s.find_first_not_of(" \t\r\n");
+        if (b == std::string::npos) return "";
+        size_t e = s.find_last_not_of(" \t\r\n");
+        return s.substr(b, e - b + 1);
+    }
+
+    bool parseInt(const std::string& s, int64_t& out) {
+        std::string t = trim(s);
+        if (t.empty()) return false;
+        char* end = nullptr;
+        long long v = std::strtoll(t.c_str(), &end, 10);
+        if (*end != '\0') return false;
+        out = v;
+        return true;
+    }
+
+    bool parseDecimal(const std::string& s, double& out) {
+        std::string t = trim(s);
+        if (t.empty()) return false;
+        char* end = nullptr;
+        double v = std::strtod(t.c_str(), &end);
+        if (*end != '\0') return false;
+        out = v;
+        return true;
+    }
+
+    // Fills in what only depends on the row itself; error names the first problem
+    bool validate(Row& row, bool hasPrice, std::string& error) {
+        if (row.sku.empty()) { error = "missing sku"; return false; }
+        if (row.name.empty()) { error = "missing name"; return false; }
+        row.gender = lower(row.gender);
+        if (row.gender != "men" && row.gender != "women" && row.gender != "unisex") {
+            error = "gender must be men, women or unisex";
+            return false;
+        }
+        if (!hasPrice) { error = "missing or invalid price"; return false; }
+        if (row.price.cents < 0) { error = "negative price"; return false; }
+        if (row.stock < 0) { error = "negative stock"; return false; }
+        return true;
+    }
+
+    struct CsvColumns {
+        int sku = -1, name = -1, description = -1, price = -1, priceCents = -1, imageUrl = -1;
+        int category = -1, categoryId = -1, gender = -1, stock = -1, sizes = -1, sizeChart = -1;
+
+        explicit CsvColumns(const std::vector<std::string>& header) {
+            for (size_t i = 0; i < header.size(); i++) {
+                std::string h = lower(trim(header[i]));
+                int idx = static_cast<int>(i);
+                if (h == "sku") sku = idx;
+                else if (h == "name") name = idx;
+                else if (h == "description") description = idx;
+                else if (h == "price") price = idx;
+                else if (h == "price_cents") priceCents = idx;
+                else if (h == "image_url") imageUrl = idx;
+                else if (h == "category") category = idx;
+                else if (h == "category_id") categoryId = idx;
+                else if (h == "gender") gender = idx;
+                else if (h == "stock_quantity" || h == "stock") stock = idx;
+                else if (h == "sizes") sizes = idx;
+                else if (h == "size_chart") sizeChart = idx;
+            }
+        }
+    };
+
+    bool rowFromCsv(const CsvColumns& cols, const std::vector<std::string>& f, Row& row, std::string& error) {
+        auto field = [&f](int idx) -> const std::string* {
+            return idx >= 0 && static_cast<size_t>(idx) < f.size() ? &f[idx] : nullptr;
+        };
+        auto optional = [&field](int idx) -> std::optional<std::string> {
+            const std::string* v = field(idx);
+            if (!v || v->empty()) return std::nullopt;
+            return *v;
+        };
+        if (const std::string* v = field(cols.sku)) row.sku = trim(*v);
+        if (const std::string* v = field(cols.name)) row.name = trim(*v);
+        if (const std::string* v = field(cols.gender)) row.gender = trim(*v);
+        if (const std::string* v = field(cols.category)) row.category = trim(*v);
+        row.description = optional(cols.description);
+        row.imageUrl = optional(cols.imageUrl);
+        row.sizes = optional(cols.sizes);
+        row.sizeChart = optional(cols.sizeChart);
+        bool hasPrice = false;
+        int64_t n = 0;
+        double d = 0;
+        if (const std::string* v = field(cols.priceCents); v && parseInt(*v, n)) {
+            row.price = Money::fromCents(n);
+            hasPrice = true;
+        } else if (const std::string* v = field(cols.price); v && parseDecimal(*v, d)) {
+            row.price = Money::fromDecimal(d);
+            hasPrice = true;
+        }
+        if (const std::string* v = field(cols.stock); v && !trim(*v).empty() && !parseInt(*v, row.stock)) {
+            error = "invalid stock_quantity";
+            return false;
+        }
+        if (const std::string* v = field(cols.categoryId); v && !trim(*v).empty() && !parseInt(*v, row.categoryId)) {
+            error = "invalid category_id";
+            return false;
+        }
+        return validate(row, hasPrice, error);
+    }
+
+    bool rowFromJson(const json& obj, Row& row, std::string& error) {
+        if (!obj.is_object()) { error = "not a JSON object"; return false; }
+        auto text = [&obj](const char* key) -> std::optional<std::string> {
+            auto it = obj.find(key);
+            if (it == obj.end() || it->is_null()) return std::nullopt;
+            if (it->is_string()) return it->get<std::string>();
+            return it->dump();
+        };
+        row.sku = trim(text("sku").value_or(""));
+        row.name = trim(text("name").value_or(""));
+        row.gender = trim(text("gender").value_or(""));
+        row.category = trim(text("category").value_or(""));
+        row.description = text("description");
+        row.imageUrl = text("image_url");
+        row.sizes = text("sizes");
+        row.sizeChart = text("size_chart");
+        bool hasPrice = false;
+        if (obj.contains("price_cents") && obj["price_cents"].is_number_integer()) {
+            row.price = Money::fromCents(obj["price_cents"].get<int64_t>());
+            hasPrice = true;
+        } else if (obj.contains("price") && obj["price"].is_number()) {
+            row.price = Money::fromDecimal(obj["price"].get<double>());
+            hasPrice = true;
+        } else if (obj.contains("price") && obj["price"].is_string()) {
+            double d = 0;
+            hasPrice = parseDecimal(obj["price"].get<std::string>(), d);
+            row.price = Money::fromDecimal(d);
+        }
+        for (const char* key : {"stock_quantity", "stock"}) {
+            if (!obj.contains(key) || obj[key].is_null()) continue;
+            if (!obj[key].is_number_integer()) { error = "invalid stock_quantity"; return false; }
+            row.stock = obj[key].get<int64_t>();
+            break;
+        }
+        if (obj.contains("category_id") && !obj["category_id"].is_null()) {
+            if (!obj["category_id"].is_number_integer()) { error = "invalid category_id"; return false; }
+            row.categoryId = obj["category_id"].get<int64_t>();
+        }
+        return validate(row, hasPrice, error);
+    }
+
+    void reject(Batch& batch, int64_t line, const std::string& error) {
+        batch.rejected++;
+        if (batch.errors.size() < kMaxReportedErrors)
+            batch.errors.push_back("line " + std::to_string(line) + ": " + error);
+    }
+
+    // Parser thread body: reads the whole input into the queue, batchSize rows at a time
+    void parse(std::istream& in, CatalogImporter::Format format, size_t batchSize,
+               const std::atomic<bool>& cancelled, BatchQueue& queue) {
+        batchSize = std::max<size_t>(batchSize, 1);
+        Batch batch;
+        auto flush = [&]() {
+            bool ok = queue.push(std::move(batch));
+            batch = Batch();
+            return ok && !cancelled;
+        };
+        if (format == CatalogImporter::Format::Csv) {
+            CsvReader reader(in);
+            std::vector<std::string> fields;
+            int64_t line = 0;
+            std::optional<CsvColumns> cols;
+            while (reader.next(fields, line)) {
+                if (fields.size() == 1 && trim(fields[0]).empty())
+                    continue;  // blank line
+                if (!cols) {
+                    cols.emplace(fields);
+                    continue;
+                }
+                batch.read++;
+                Row row;
+                row.line = line;
+                std::string error;
+                if (rowFromCsv(*cols, fields, row, error))
+                    batch.rows.push_back(std::move(row));
+                else
+                    reject(batch, line, error);
+                if (batch.rows.size() >= batchSize && !flush())
+                    break;
+            }
+        } else {
+            std::string text;
+            int64_t line = 0;
+            while (std::getline(in, text)) {
+                line++;
+                if (trim(text).empty())
+                    continue;
+                batch.read++;
+                Row row;
+                row.line = line;
+                std::string error;
+                json obj = json::parse(text, nullptr, false);
+                if (obj.is_discarded())
+                    reject(batch, line, "invalid JSON");
+                else if (rowFromJson(obj, row, error))
+                    batch.rows.push_back(std::move(row));
+                else
+                    reject(batch, line, error);
+                if (batch.rows.size() >= batchSize && !flush())
+                    break;
+            }
+        }
+        if (batch.read > 0)
+            queue.push(std::move(batch));
+        queue.finish();
+    }
+
+    struct BatchResult {
+        size_t inserted = 0;
+        size_t updated = 0;
+        size_t unchanged = 0;
+        size_t rejected = 0;
+        std::vector<std::string> errors;
+    };
+
+    // Lives on the importing thread; only touched by batch jobs, which the
+    // writer runs one at a time
+    struct ImportState {
+        std::unordered_map<std::string, int64_t> categories;
+        int64_t firstNewId = -1;  // ids from here on were inserted by this import
+    };
+
+    int64_t categoryFor(WriteContext& tx, ImportState& state, const std::string& name) {
+        auto it = state.categories.find(name);
+        if (it != state.categories.end())
+            return it->second;
+        int64_t id = 0;
+        auto find = tx.prepare(kCategoryIdSql);
+        if (find) {
+            sqlite3_bind_text(find, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+            if (sqlite3_step(find) == SQLITE_ROW)
+                id = sqlite3_column_int64(find, 0);
+        }
+        find.release();
+        if (id == 0) {
+            auto insert = tx.prepare(kInsertCategorySql);
+            if (insert) {
+                sqlite3_bind_text(insert, 1, name.c_str(), -1, SQLITE_TRANSIENT);
+                if (sqlite3_step(insert) == SQLITE_ROW)
+                    id = sqlite3_column_int64(insert, 0);
+                sqlite3_step(insert);
+            }
+            insert.release();
+        }
+        if (id != 0)
+            state.categories.emplace(name, id);
+        return id;
+    }
+
+    void bindOptional(sqlite3_stmt* stmt, int idx, const std::optional<std::string>& v) {
+        if (v)
+            sqlite3_bind_text(stmt, idx, v->c_str(), static_cast<int>(v->size()), SQLITE_STATIC);
+        else
+            sqlite3_bind_null(stmt, idx);
+    }
+
+    BatchResult upsertBatch(WriteContext& tx, ImportState& state, const std::vector<Row>& rows) {
+        BatchResult r;
+        if (state.firstNewId < 0) {
+            auto next = tx.prepare(kNextIdSql);
+            state.firstNewId = next && sqlite3_step(next) == SQLITE_ROW ? sqlite3_column_int64(next, 0) : 1;
+        }
+        int64_t createdAt = Timestamp::now().ms;
+        // One statement for the whole batch; the writer's cache keeps it prepared across batches
+        auto stmt = tx.prepare(kUpsertSql);
+        if (!stmt) {
+            r.rejected = rows.size();
+            r.errors.push_back(std::string("could not prepare upsert: ") + sqlite3_errmsg(tx));
+            return r;
+        }
+        for (const Row& row : rows) {
+            int64_t categoryId = row.categoryId;
+            if (categoryId == 0 && !row.category.empty())
+                categoryId = categoryFor(tx, state, row.category);
+            sqlite3_bind_text(stmt, 1, row.sku.c_str(), static_cast<int>(row.sku.size()), SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 2, row.name.c_str(), static_cast<int>(row.name.size()), SQLITE_STATIC);
+            bindOptional(stmt, 3, row.description);
+            sqlite3_bind_int64(stmt, 4, row.price.cents);
+            bindOptional(stmt, 5, row.imageUrl);
+            if (categoryId > 0)
+                sqlite3_bind_int64(stmt, 6, categoryId);
+            else
+                sqlite3_bind_null(stmt, 6);
+            sqlite3_bind_text(stmt, 7, row.gender.c_str(), static_cast<int>(row.gender.size()), SQLITE_STATIC);
+            sqlite3_bind_int64(stmt, 8, row.stock);
+            bindOptional(stmt, 9, row.sizes);
+            bindOptional(stmt, 10, row.sizeChart);
+            sqlite3_bind_int64(stmt, 11, createdAt);
+            int rc = sqlite3_step(stmt);
+            if (rc == SQLITE_ROW) {
+                if (sqlite3_column_int64(stmt, 0) >= state.firstNewId)
+                    r.inserted++;
+                else
+                    r.updated++;
+                rc = sqlite3_step(stmt);
+            } else if (rc == SQLITE_DONE) {
+                r.unchanged++;
+            }
+            if (rc != SQLITE_DONE) {
+                // A failed statement only undoes its own row; the batch goes on
+                r.rejected++;
+                if (r.errors.size() < kMaxReportedErrors)
+                    r.errors.push_back("line " + std::to_string(row.line) + ": " + sqlite3_errmsg(tx));
+            }
+            sqlite3_reset(stmt);
+        }
+        return r;
+    }
+
+    void addErrors(json& report, const std::vector<std::string>& errors) {
+        for (const std::string& e : errors) {
+            if (report["errors"].size() >= kMaxReportedErrors)
+                return;
+            report["errors"].push_back(e);
+        }
+    }
+}
+
+CatalogImporter::Options CatalogImporter::Options::fromConfig(const json& section) {
+    Options o;
+    if (!section.is_object()) return o;
+    if (section.contains("batch_size") && section["batch_size"].is_number_unsigned())
+        o.batchSize = std::max<size_t>(section["batch_size"].get<size_t>(), 1);
+    if (section.contains("buffered_batches") && section["buffered_batches"].is_number_unsigned())
+        o.bufferedBatches = std::max<size_t>(section["buffered_batches"].get<size_t>(), 1);
+    if (section.contains("directory") && section["directory"].is_string())
+        o.directory = section["directory"].get<std::string>();
+    return o;
+}
+
+std::string CatalogImporter::Options::directoryFor(const std::string& databasePath) const {
+    if (directory.empty())
+        return "";
+    fs::path dir(directory);
+    if (dir.is_relative())
+        dir = fs::path(databasePath).parent_path() / dir;
+    return dir.string();
+}
+
+CatalogImporter::CatalogImporter(WriteQueue* writer, Options options)
+    : writer(writer), options(options), running(false), cancelled(false), current(json::object()) {}
+
+CatalogImporter::~CatalogImporter() {
+    stop();
+}
+
+bool CatalogImporter::resolveRequestPath(const std::string& requested, std::string& path, std::string& error) const {
+    if (options.directory.empty()) {
+        error = "Imports over HTTP are disabled; set import.directory in db_config.json";
+        return false;
+    }
+    fs::path name(requested);
+    if (requested.empty() || name.has_root_name() || name.has_root_directory()) {
+        error = "Path must be relative to the import directory";
+        return false;
+    }
+    for (const auto& part : name) {
+        if (part == "..") {
+            error = "Path must not contain '..'";
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::path base = fs::weakly_canonical(options.directory, ec);
+    fs::path full = ec ? fs::path() : fs::weakly_canonical(base / name, ec);
+    // A symlink inside the directory may still point out of it
+    auto rest = std::mismatch(base.begin(), base.end(), full.begin(), full.end());
+    if (ec || rest.first != base.end()) {
+        error = "Path is outside the import directory";
+        return false;
+    }
+    path = full.string();
+    return true;
+}
+
+bool CatalogImporter::formatFor(const std::string& path, Format& format) {
+    std::string p = lower(path);
+    auto endsWith = [&p](const std::string& suffix) {
+        return p.size() >= suffix.size() && p.compare(p.size() - suffix.size(), suffix.size(), suffix) == 0;
+    };
+    if (endsWith(".csv")) {
+        format = Format::Csv;
+        return true;
+    }
+    if (endsWith(".jsonl") || endsWith(".ndjson")) {
+        format = Format::Jsonl;
+        return true;
+    }
+    return false;
+}
+
+const char* CatalogImporter::formatName(Format format) {
+    return format == Format::Csv ? "csv" : "jsonl";
+}
+
+json CatalogImporter::run(const std::string& path, Format format, Progress progress) {
+    auto started = Clock::now();
+    json report;
+    report["state"] = "running";
+    report["path"] = path;
+    report["format"] = formatName(format);
+    report["batch_size"] = options.batchSize;
+    report["rows_read"] = 0;
+    report["inserted"] = 0;
+    report["updated"] = 0;
+    report["unchanged"] = 0;
+    report["rejected"] = 0;
+    report["batches"] = 0;
+    report["elapsed_s"] = 0.0;
+    report["rows_per_sec"] = 0.0;
+    report["errors"] = json::array();
+    auto publish = [this, &report]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        current = report;
+    };
+    auto finish = [&](const char* state, const std::string& error) {
+        report["state"] = state;
+        if (!error.empty()) {
+            report["error"] = error;
+            std::cerr << "Catalog import of " << path << " " << state << ": " << error << std::endl;
+        }
+        publish();
+        return report;
+    };
+    publish();
+
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return finish("failed", "could not open file");
+    if (!writer)
+        return finish("failed", "database not connected");
+
+    BatchQueue queue(options.bufferedBatches);
+    std::thread parser([&] { parse(in, format, options.batchSize, cancelled, queue); });
+    ImportState state;
+    uint64_t rowsRead = 0, inserted = 0, updated = 0, unchanged = 0, rejected = 0, batches = 0;
+    std::string error;
+    while (std::optional<Batch> batch = queue.pop()) {
+        rowsRead += batch->read;
+        rejected += batch->rejected;
+        addErrors(report, batch->errors);
+        if (!batch->rows.empty() && error.empty() && !cancelled) {
+            const std::vector<Row>& rows = batch->rows;
+            auto result = writer->submit([&state, &rows](WriteContext& tx) {
+                return upsertBatch(tx, state, rows);
+            }, "import.batch").get();
+            if (!result) {
+                error = result.busy() ? "database busy, batch not committed" : "batch commit failed";
+                queue.cancel();
+            } else {
+                batches++;
+                inserted += result->inserted;
+                updated += result->updated;
+                unchanged += result->unchanged;
+                rejected += result->rejected;
+                addErrors(report, result->errors);
+            }
+        }
+        double elapsed = std::chrono::duration<double>(Clock::now() - started).count();
+        report["rows_read"] = rowsRead;
+        report["inserted"] = inserted;
+        report["updated"] = updated;
+        report["unchanged"] = unchanged;
+        report["rejected"] = rejected;
+        report["batches"] = batches;
+        report["elapsed_s"] = elapsed;
+        report["rows_per_sec"] = elapsed > 0 ? static_cast<double>(rowsRead) / elapsed : 0.0;
+        publish();
+        if (progress)
+            progress(report);
+        if (cancelled)
+            queue.cancel();
+    }
+    parser.join();
+    if (!error.empty())
+        return finish("failed", error);
+    if (in.bad())
+        return finish("failed", "read error");
+    return finish(cancelled ? "cancelled" : "completed", "");
+}
+
+bool CatalogImporter::start(const std::string& path, Format format) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running)
+        return false;
+    if (worker.joinable())
+        worker.join();  // the last import has already finished
+    running = true;
+    cancelled = false;
+    current = {{"state", "queued"}, {"path", path}, {"format", formatName(format)}};
+    worker = std::thread([this, path, format] {
+        run(path, format);
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    });
+    return true;
+}
+
+json CatalogImporter::status() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return current;
+}
+
+void CatalogImporter::stop() {
+    cancelled = true;
+    std::thread finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = std::move(worker);
+    }
+    if (finished.joinable())
+        finished.join();
+}
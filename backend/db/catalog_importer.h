@@ -0,0 +1,80 @@
+#ifndef CATALOG_IMPORTER_H
+#define CATALOG_IMPORTER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <nlohmann/json.hpp>
+#include "write_queue.h"
+
+// Bulk product import from a supplier CSV or JSONL file. A parser thread
+// streams the file into batches of a few thousand rows, and each batch is
+// upserted on the sku column as one writer job, so one transaction and one
+// commit, with the writer's cached INSERT ... ON CONFLICT statement. Parsing
+// the next batch overlaps with committing the last. Rows that fail validation
+// or a constraint are counted and skipped, and the first few are reported with
+// their line numbers.
+//
+// Columns / keys: sku, name, description, price (decimal) or price_cents,
+// image_url, category (name, created if missing) or category_id, gender,
+// stock_quantity (or stock), sizes, size_chart. sku, name, gender and a
+// price are required; CSV files need a header row.
+class CatalogImporter {
+public:
+    enum class Format { Csv, Jsonl };
+
+    struct Options {
+        size_t batchSize = 5000;
+        size_t bufferedBatches = 4;  // parsed batches waiting for the writer
+        // The only directory POST /api/admin/import may read from, relative to
+        // the database's directory; empty (the default) disables that endpoint
+        std::string directory;
+
+        std::string directoryFor(const std::string& databasePath) const;
+
+        // Reads db_config.json's "import" section
+        static Options fromConfig(const nlohmann::json& section);
+    };
+
+    // Called after each committed batch with the running report
+    using Progress = std::function<void(const nlohmann::json& report)>;
+
+    CatalogImporter(WriteQueue* writer, Options options);
+    ~CatalogImporter();
+    CatalogImporter(const CatalogImporter&) = delete;
+    CatalogImporter& operator=(const CatalogImporter&) = delete;
+
+    // Picks the format from the extension: .csv, .jsonl or .ndjson
+    static bool formatFor(const std::string& path, Format& format);
+    static const char* formatName(Format format);
+
+    // Maps a file name from an HTTP request into options.directory. False,
+    // with the reason, when the endpoint is disabled or the name is absolute,
+    // contains "..", or resolves (through symlinks) outside the directory.
+    bool resolveRequestPath(const std::string& requested, std::string& path, std::string& error) const;
+    bool acceptsRequestPaths() const { return !options.directory.empty(); }
+
+    // Imports on the calling thread and returns the final report
+    nlohmann::json run(const std::string& path, Format format, Progress progress = nullptr);
+    // Imports on a background thread; false if an import is already running
+    bool start(const std::string& path, Format format);
+    // Report of the running import, or of the last one
+    nlohmann::json status() const;
+    // Cancels a running import after its current batch
+    void stop();
+
+private:
+    WriteQueue* writer;
+    Options options;
+
+    mutable std::mutex mutex;
+    bool running;
+    std::atomic<bool> cancelled;
+    std::thread worker;
+    nlohmann::json current;  // guarded by mutex
+};
+
+#endif // CATALOG_IMPORTER_H
@@ -0,0 +1,289 @@
+#include "change_feed.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <iostream>
+
+using json = nlohmann::json;
+
+namespace {
+    int64_t nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    // "orders" for the main schema, "archive.orders" otherwise
+    std::string tableKey(const std::string& database, const std::string& table) {
+        return database == "main" ? table : database + "." + table;
+    }
+}
+
+const char* RowChange::opName(Op op) {
+    switch (op) {
+        case Op::Insert: return "insert";
+        case Op::Update: return "update";
+        case Op::Delete: return "delete";
+    }
+    return "unknown";
+}
+
+ChangeCapture::ChangeCapture(ChangeFeed& feed, std::string source)
+    : feed(feed), source(std::move(source)), db(nullptr), maxRows(std::max<size_t>(feed.maxRowsPerBatch(), 1)),
+      committedRows(0), committedOverflow(0) {}
+
+void ChangeCapture::install(sqlite3* connection) {
+    db = connection;
+    sqlite3_update_hook(db, &ChangeCapture::onUpdate, this);
+    sqlite3_commit_hook(db, &ChangeCapture::onCommit, this);
+    sqlite3_rollback_hook(db, &ChangeCapture::onRollback, this);
+}
+
+void ChangeCapture::onUpdate(void* self, int op, const char* database, const char* table, sqlite3_int64 rowid) {
+    auto* c = static_cast<ChangeCapture*>(self);
+    if (std::strcmp(database, "temp") == 0)
+        return;
+    if (c->rows.size() < c->maxRows) {
+        RowChange::Op kind = op == SQLITE_INSERT ? RowChange::Op::Insert
+                           : op == SQLITE_DELETE ? RowChange::Op::Delete : RowChange::Op::Update;
+        c->rows.push_back({database, table, kind, rowid});
+        return;
+    }
+    for (const ChangedTable& t : c->overflow)
+        if (t.table == table && t.database == database)
+            return;
+    c->overflow.push_back({database, table});
+}
+
+int ChangeCapture::onCommit(void* self) {
+    auto* c = static_cast<ChangeCapture*>(self);
+    c->committedRows = c->rows.size();
+    c->committedOverflow = c->overflow.size();
+    return 0;  // let the commit proceed
+}
+
+void ChangeCapture::onRollback(void* self) {
+    auto* c = static_cast<ChangeCapture*>(self);
+    c->rows.erase(c->rows.begin() + c->committedRows, c->rows.end());
+    c->overflow.erase(c->overflow.begin() + c->committedOverflow, c->overflow.end());
+}
+
+void ChangeCapture::rollbackTo(size_t mark) {
+    mark = std::max(mark, committedRows);
+    if (mark < rows.size())
+        rows.erase(rows.begin() + mark, rows.end());
+}
+
+void ChangeCapture::flush() {
+    if (!db || (committedRows == 0 && committedOverflow == 0))
+        return;
+    // Still inside a transaction: the last commit hook may belong to a COMMIT
+    // that has not finished (or will be retried)
+    if (!sqlite3_get_autocommit(db))
+        return;
+    ChangeBatch batch;
+    batch.source = source;
+    batch.committedAtMs = nowMs();
+    if (committedRows == rows.size()) {
+        batch.changes.swap(rows);
+    } else {
+        batch.changes.assign(rows.begin(), rows.begin() + committedRows);
+        rows.erase(rows.begin(), rows.begin() + committedRows);
+    }
+    batch.overflow.assign(overflow.begin(), overflow.begin() + committedOverflow);
+    overflow.erase(overflow.begin(), overflow.begin() + committedOverflow);
+    committedRows = 0;
+    committedOverflow = 0;
+    feed.publish(std::move(batch));
+}
+
+void ChangeCapture::discard() {
+    rows.clear();
+    overflow.clear();
+    committedRows = 0;
+    committedOverflow = 0;
+}
+
+ChangeFeed::Options ChangeFeed::Options::fromConfig(const json& section) {
+    Options o;
+    if (!section.is_object()) return o;
+    if (section.contains("enabled") && section["enabled"].is_boolean())
+        o.enabled = section["enabled"].get<bool>();
+    if (section.contains("max_pending_batches") && section["max_pending_batches"].is_number_unsigned())
+        o.maxPendingBatches = section["max_pending_batches"].get<size_t>();
+    if (section.contains("max_rows_per_batch") && section["max_rows_per_batch"].is_number_unsigned())
+        o.maxRowsPerBatch = section["max_rows_per_batch"].get<size_t>();
+    return o;
+}
+
+ChangeFeed::ChangeFeed(Options options)
+    : options(options), tail(new Node()), pending(0), sleeping(false), published(0), dropped(0), gapPending(false),
+      stopping(false), subscribers(std::make_shared<SubscriptionList>()), nextSubscriberId(1), delivered(0), rows(0) {
+    head.store(tail);
+    dispatcher = std::thread([this] { loop(); });
+}
+
+ChangeFeed::~ChangeFeed() {
+    stop();
+    // Batches published after stop() were never delivered
+    while (tail) {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        delete tail;
+        tail = next;
+    }
+}
+
+uint64_t ChangeFeed::subscribe(std::string name, Subscriber subscriber) {
+    auto s = std::make_shared<Subscription>();
+    s->name = std::move(name);
+    s->deliver = std::move(subscriber);
+    std::lock_guard<std::mutex> lock(mutex);
+    s->id = nextSubscriberId++;
+    auto list = std::make_shared<SubscriptionList>(*subscribers);
+    list->push_back(s);
+    subscribers = std::move(list);
+    return s->id;
+}
+
+void ChangeFeed::unsubscribe(uint64_t id) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto list = std::make_shared<SubscriptionList>(*subscribers);
+    list->erase(std::remove_if(list->begin(), list->end(),
+                               [id](const std::shared_ptr<Subscription>& s) { return s->id == id; }),
+                list->end());
+    subscribers = std::move(list);
+    lock.unlock();
+    // A delivery may still hold the old list; once it is done the subscriber is never called again
+    std::lock_guard<std::mutex> wait(deliveryMutex);
+}
+
+void ChangeFeed::publish(ChangeBatch batch) {
+    if (pending.load(std::memory_order_relaxed) >= options.maxPendingBatches) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        gapPending.store(true);
+    } else {
+        Node* node = new Node();
+        node->batch = std::move(batch);
+        pending.fetch_add(1);
+        Node* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+        published.fetch_add(1, std::memory_order_relaxed);
+    }
+    // Only take the lock when the dispatcher is parked on the condition variable
+    if (sleeping.load()) {
+        std::lock_guard<std::mutex> lock(mutex);
+        wake.notify_one();
+    }
+}
+
+bool ChangeFeed::pop(ChangeBatch& batch) {
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (!next)
+        return false;
+    batch = std::move(next->batch);
+    delete tail;
+    tail = next;
+    pending.fetch_sub(1);
+    return true;
+}
+
+void ChangeFeed::loop() {
+    for (;;) {
+        ChangeBatch batch;
+        while (pop(batch)) {
+            if (gapPending.load(std::memory_order_relaxed))
+                batch.gap = gapPending.exchange(false);
+            deliver(batch);
+            batch = ChangeBatch();
+        }
+        if (gapPending.exchange(false)) {
+            // Dropped batches and nothing after them yet: announce the gap alone
+            ChangeBatch gap;
+            gap.source = "change-feed";
+            gap.committedAtMs = nowMs();
+            gap.gap = true;
+            deliver(gap);
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stopping && pending.load() == 0)
+            break;
+        sleeping.store(true);
+        // A producer sees sleeping before or after this check, so either the
+        // predicate catches its batch or its notify wakes the wait; the timeout
+        // only covers a producer that is between publishing and linking
+        wake.wait_for(lock, std::chrono::milliseconds(100),
+                      [this] { return stopping || pending.load() > 0 || gapPending.load(); });
+        sleeping.store(false);
+    }
+}
+
+void ChangeFeed::deliver(ChangeBatch& batch) {
+    std::shared_ptr<const SubscriptionList> targets;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch.sequence = ++delivered;
+        rows += batch.changes.size();
+        TableCounts* counts = nullptr;
+        const RowChange* last = nullptr;
+        for (const RowChange& c : batch.changes) {
+            if (!last || c.table != last->table || c.database != last->database)
+                counts = &tables[tableKey(c.database, c.table)];
+            last = &c;
+            if (c.op == RowChange::Op::Insert) counts->inserts++;
+            else if (c.op == RowChange::Op::Update) counts->updates++;
+            else counts->deletes++;
+        }
+        for (const ChangedTable& t : batch.overflow)
+            tables[tableKey(t.database, t.table)].overflows++;
+        targets = subscribers;
+    }
+    std::lock_guard<std::mutex> delivering(deliveryMutex);
+    for (const auto& s : *targets) {
+        auto start = std::chrono::steady_clock::now();
+        try {
+            s->deliver(batch);
+            s->delivered.fetch_add(1, std::memory_order_relaxed);
+        } catch (const std::exception& e) {
+            std::cerr << "Change feed: subscriber " << s->name << " threw: " << e.what() << std::endl;
+            s->failed.fetch_add(1, std::memory_order_relaxed);
+        } catch (...) {
+            std::cerr << "Change feed: subscriber " << s->name << " threw" << std::endl;
+            s->failed.fetch_add(1, std::memory_order_relaxed);
+        }
+        s->latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count()));
+    }
+}
+
+void ChangeFeed::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (dispatcher.joinable())
+        dispatcher.join();
+}
+
+json ChangeFeed::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    json j;
+    j["pending"] = pending.load();
+    j["max_pending_batches"] = options.maxPendingBatches;
+    j["max_rows_per_batch"] = options.maxRowsPerBatch;
+    j["published"] = published.load();
+    j["delivered"] = delivered;
+    j["dropped"] = dropped.load();
+    j["rows"] = rows;
+    json t = json::object();
+    for (const auto& entry : tables)
+        t[entry.first] = {{"inserts", entry.second.inserts}, {"updates", entry.second.updates},
+                          {"deletes", entry.second.deletes}, {"overflows", entry.second.overflows}};
+    j["tables"] = t;
+    json subs = json::array();
+    for (const auto& s : *subscribers)
+        subs.push_back({{"id", s->id}, {"name", s->name}, {"delivered", s->delivered.load()},
+                        {"failed", s->failed.load()}, {"latency", s->latency.toJson()}});
+    j["subscribers"] = subs;
+    return j;
+}
@@ -0,0 +1,185 @@
+#ifndef CHANGE_FEED_H
+#define CHANGE_FEED_H
+
+#include <sqlite3.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../utils/latency_histogram.h"
+
+// One row written by a committed transaction, as sqlite3_update_hook reports
+// it. database is the schema name ("main", "archive", ...).
+struct RowChange {
+    enum class Op : uint8_t { Insert, Update, Delete };
+
+    std::string database;
+    std::string table;
+    Op op;
+    int64_t rowid;
+
+    static const char* opName(Op op);
+};
+
+struct ChangedTable {
+    std::string database;
+    std::string table;
+};
+
+// Everything one connection committed since its last publish, in write order.
+// A transaction that wrote more than max_rows_per_batch rows lists the rest
+// only by table in overflow; subscribers drop whatever they hold for those
+// tables. gap is set on the first batch after the feed had to drop batches
+// (queue full): subscribers should then drop everything.
+struct ChangeBatch {
+    uint64_t sequence = 0;       // delivery order, from 1
+    std::string source;          // "writer", "shard-3", "read-write"
+    int64_t committedAtMs = 0;
+    std::vector<RowChange> changes;
+    std::vector<ChangedTable> overflow;
+    bool gap = false;
+};
+
+class ChangeFeed;
+
+// Collects one writer connection's row changes through the update, commit and
+// rollback hooks, and hands committed ones to the feed. Used only by the thread
+// that holds the connection, so it needs no locking. Changes after the last
+// commit hook are kept until flush() finds the connection back in autocommit;
+// a rollback drops them, but not rows whose commit hook already fired, so a
+// commit that fails after the hook can only over-report.
+class ChangeCapture {
+public:
+    // Destroy only after the connection it was installed on has closed
+    ChangeCapture(ChangeFeed& feed, std::string source);
+    ChangeCapture(const ChangeCapture&) = delete;
+    ChangeCapture& operator=(const ChangeCapture&) = delete;
+
+    // Registers the hooks on db; call right after opening it
+    void install(sqlite3* db);
+    // Position to come back to when a savepoint is rolled back (the hooks do
+    // not see ROLLBACK TO)
+    size_t mark() const { return rows.size(); }
+    void rollbackTo(size_t mark);
+    // Publishes committed changes; does nothing while a transaction is open
+    void flush();
+    // Drops everything, e.g. after a failed COMMIT was rolled back
+    void discard();
+
+private:
+    static void onUpdate(void* self, int op, const char* database, const char* table, sqlite3_int64 rowid);
+    static int onCommit(void* self);
+    static void onRollback(void* self);
+
+    ChangeFeed& feed;
+    std::string source;
+    sqlite3* db;
+    size_t maxRows;
+    std::vector<RowChange> rows;
+    std::vector<ChangedTable> overflow;
+    size_t committedRows;
+    size_t committedOverflow;
+};
+
+// Publishes committed row changes to in-process subscribers (caches, search
+// indexes) so they can drop exactly the keys a write touched, and only once it
+// has committed. Writer threads push batches onto a lock-free MPSC queue and
+// never block on subscribers; one dispatcher thread delivers batches to every
+// subscriber in order. When the queue is full, batches are dropped and the
+// next delivered batch carries gap = true.
+class ChangeFeed {
+public:
+    struct Options {
+        bool enabled = true;
+        size_t maxPendingBatches = 4096;  // queued for the dispatcher
+        size_t maxRowsPerBatch = 50000;   // beyond this, changes are reported by table
+
+        // Reads db_config.json's "change_feed" section
+        static Options fromConfig(const nlohmann::json& section);
+    };
+
+    // Runs on the dispatcher thread; keep it short and never call back into
+    // subscribe() / unsubscribe() from it
+    using Subscriber = std::function<void(const ChangeBatch& batch)>;
+
+    explicit ChangeFeed(Options options);
+    ~ChangeFeed();
+    ChangeFeed(const ChangeFeed&) = delete;
+    ChangeFeed& operator=(const ChangeFeed&) = delete;
+
+    // Subscribe before writes start: a subscriber only sees batches published
+    // after it joined
+    uint64_t subscribe(std::string name, Subscriber subscriber);
+    // Returns once the subscriber is no longer running, so whatever it
+    // captured can be destroyed right after
+    void unsubscribe(uint64_t id);
+    // Called by ChangeCapture from writer threads; lock-free unless the
+    // dispatcher is asleep and needs waking
+    void publish(ChangeBatch batch);
+    size_t maxRowsPerBatch() const { return options.maxRowsPerBatch; }
+    // Delivers what is queued, then joins the dispatcher
+    void stop();
+    nlohmann::json stats() const;
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        ChangeBatch batch;
+    };
+
+    struct Subscription {
+        uint64_t id;
+        std::string name;
+        Subscriber deliver;
+        // Written by the dispatcher only
+        std::atomic<uint64_t> delivered{0};
+        std::atomic<uint64_t> failed{0};
+        LatencyHistogram latency;
+    };
+    using SubscriptionList = std::vector<std::shared_ptr<Subscription>>;
+
+    struct TableCounts {
+        uint64_t inserts = 0;
+        uint64_t updates = 0;
+        uint64_t deletes = 0;
+        uint64_t overflows = 0;
+    };
+
+    // Single consumer: only the dispatcher thread calls pop()
+    bool pop(ChangeBatch& batch);
+    void loop();
+    void deliver(ChangeBatch& batch);
+
+    Options options;
+
+    // Vyukov MPSC queue: producers swap themselves in at head, the dispatcher
+    // walks from tail, which always points at an already consumed node
+    std::atomic<Node*> head;
+    Node* tail;
+    std::atomic<size_t> pending;
+    std::atomic<bool> sleeping;
+    std::atomic<uint64_t> published;
+    std::atomic<uint64_t> dropped;
+    std::atomic<bool> gapPending;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+    std::shared_ptr<const SubscriptionList> subscribers;  // guarded by mutex; replaced, never edited
+    uint64_t nextSubscriberId;
+    // Dispatcher-side totals, guarded by mutex
+    uint64_t delivered;
+    uint64_t rows;
+    std::map<std::string, TableCounts> tables;
+    std::mutex deliveryMutex;  // held by the dispatcher while calling subscribers
+    std::thread dispatcher;
+};
+
+#endif // CHANGE_FEED_H
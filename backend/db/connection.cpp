@@ -1,18 +1,36 @@
 #include "connection.h"
+#include "busy_retry.h"
+#include "migrations.h"
+#include "sql_profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <sstream>
+#include <thread>
 #include <vector>
 #include <nlohmann/json.hpp>
 
+namespace fs = std::filesystem;
 using json = nlohmann::json;
 
+bool DatabaseConnection::replicaMode = false;
+
 DatabaseConnection& DatabaseConnection::getInstance() {
     static DatabaseConnection instance;
     return instance;
 }
 
-DatabaseConnection::DatabaseConnection() : conn(nullptr) {
+void DatabaseConnection::runAsReplica() {
+    replicaMode = true;
+}
+
+bool DatabaseConnection::isReplica() {
+    return replicaMode;
+}
+
+DatabaseConnection::DatabaseConnection()
+    : poolSize(0), readPoolSize(0), acquireTimeoutMs(5000), statementCacheSize(64), storage(StorageProfile::preset("durable")) {
     loadConfig();
     connect();
 }
@@ -38,15 +56,139 @@ void DatabaseConnection::loadConfig() {
         configFile >> config;
         if (config.contains("database_path") && config["database_path"].is_string())
             databasePath = config["database_path"].get<std::string>();
+        if (config.contains("pool_size") && config["pool_size"].is_number_unsigned())
+            poolSize = config["pool_size"].get<size_t>();
+        if (config.contains("read_pool_size") && config["read_pool_size"].is_number_unsigned())
+            readPoolSize = config["read_pool_size"].get<size_t>();
+        if (config.contains("pool_acquire_timeout_ms") && config["pool_acquire_timeout_ms"].is_number_integer())
+            acquireTimeoutMs = config["pool_acquire_timeout_ms"].get<int>();
+        if (config.contains("statement_cache_size") && config["statement_cache_size"].is_number_unsigned())
+            statementCacheSize = config["statement_cache_size"].get<size_t>();
+        if (config.contains("writer") && config["writer"].is_object()) {
+            const json& w = config["writer"];
+            if (w.contains("batch_window_us") && w["batch_window_us"].is_number_unsigned())
+                writerOptions.batchWindow = std::chrono::microseconds(w["batch_window_us"].get<int64_t>());
+            if (w.contains("max_batch") && w["max_batch"].is_number_unsigned())
+                writerOptions.maxBatch = w["max_batch"].get<size_t>();
+        }
+        if (config.contains("busy") && config["busy"].is_object()) {
+            const json& b = config["busy"];
+            BusyPolicy busy = BusyRetry::policy();
+            if (b.contains("timeout_ms") && b["timeout_ms"].is_number_integer())
+                busy.timeoutMs = b["timeout_ms"].get<int>();
+            if (b.contains("retry_attempts") && b["retry_attempts"].is_number_integer())
+                busy.retryAttempts = b["retry_attempts"].get<int>();
+            if (b.contains("retry_base_ms") && b["retry_base_ms"].is_number_integer())
+                busy.retryBaseMs = b["retry_base_ms"].get<int>();
+            if (b.contains("retry_max_ms") && b["retry_max_ms"].is_number_integer())
+                busy.retryMaxMs = b["retry_max_ms"].get<int>();
+            BusyRetry::configure(busy);
+        }
+        if (config.contains("change_feed"))
+            changeFeedOptions = ChangeFeed::Options::fromConfig(config["change_feed"]);
+        if (config.contains("executor"))
+            executorOptions = DbExecutor::Options::fromConfig(config["executor"]);
+        if (config.contains("maintenance"))
+            maintenanceOptions = MaintenanceScheduler::Options::fromConfig(config["maintenance"]);
+        if (config.contains("backup"))
+            backupOptions = BackupManager::Options::fromConfig(config["backup"]);
+        if (config.contains("import"))
+            importOptions = CatalogImporter::Options::fromConfig(config["import"]);
+        if (config.contains("sharding"))
+            shardOptions = ShardSet::Options::fromConfig(config["sharding"]);
+        if (config.contains("archive"))
+            archiveOptions = OrderArchiver::Options::fromConfig(config["archive"]);
+        if (config.contains("profiling") && config["profiling"].is_object()) {
+            const json& p = config["profiling"];
+            if (p.contains("enabled") && p["enabled"].is_boolean())
+                SqlProfiler::configure(p["enabled"].get<bool>());
+            SlowQueryPolicy slow = SqlProfiler::slowLogPolicy();
+            if (p.contains("slow_query_ms") && p["slow_query_ms"].is_number_integer())
+                slow.thresholdMs = p["slow_query_ms"].get<int>();
+            if (p.contains("slow_log") && p["slow_log"].is_string())
+                slow.logPath = p["slow_log"].get<std::string>();
+            if (p.contains("slow_log_keep") && p["slow_log_keep"].is_number_unsigned())
+                slow.keep = p["slow_log_keep"].get<size_t>();
+            SqlProfiler::configureSlowLog(slow);
+        }
+        if (config.contains("memory"))
+            memoryOptions = MemoryImage::Options::fromConfig(config["memory"]);
+        if (config.contains("connection_memory"))
+            connectionMemory = SqliteMemory::Options::fromConfig(config["connection_memory"]);
+        if (config.contains("advisor"))
+            advisorOptions = IndexAdvisor::Options::fromConfig(config["advisor"]);
+        if (config.contains("storage"))
+            storage = StorageProfile::fromConfig(config["storage"]);
+        if (config.contains("replication"))
+            replicationOptions = Replication::Options::fromConfig(config["replication"]);
         configFile.close();
     }
+    if (replicaMode) {
+        // A replica copies the main file only and never writes on its own
+        memoryOptions.enabled = false;
+        shardOptions.shards = 0;
+        archiveOptions.enabled = false;
+        changeFeedOptions.enabled = false;
+        replicationOptions.publish = false;
+    }
     if (databasePath.empty()) {
         databasePath = "database/lala-store.db";
     }
+    if (poolSize == 0) {
+        // One connection per Crow worker (multithreaded() defaults to hardware concurrency)
+        poolSize = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (readPoolSize == 0) {
+        readPoolSize = std::max(1u, std::thread::hardware_concurrency());
+    }
+}
+
+namespace {
+    // file: URI for a filesystem path, escaping the characters URIs reserve
+    std::string sqliteUri(const std::string& path, const std::string& query) {
+        std::string uri = "file:";
+        for (char c : path) {
+            if (c == '%' || c == '?' || c == '#' || c == ' ') {
+                char buf[4];
+                std::snprintf(buf, sizeof(buf), "%%%02X", static_cast<unsigned char>(c));
+                uri += buf;
+            } else {
+                uri += c;
+            }
+        }
+        return uri + "?" + query;
+    }
+
+    // lala-store.db -> lala-store-archive.db, next to it
+    std::string archivePathFor(const std::string& path) {
+        fs::path p(path);
+        return (p.parent_path() / (p.stem().string() + "-archive" + p.extension().string())).string();
+    }
+
+    std::string sqlQuote(const std::string& s) {
+        std::string out = "'";
+        for (char c : s) {
+            out += c;
+            if (c == '\'') out += '\'';
+        }
+        return out + "'";
+    }
+}
+
+// Plain read-only connection to a shard or archive file, for backups
+static sqlite3* openFileReadOnly(const std::string& path) {
+    sqlite3* db = nullptr;
+    if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        std::cerr << "SQLite read-only open failed for " << path << ": " << (db ? sqlite3_errmsg(db) : "out of memory") << std::endl;
+        if (db) sqlite3_close(db);
+        return nullptr;
+    }
+    BusyRetry::install(db, "backup");
+    return db;
 }
 
 static int tryOpenDb(const std::string& path, sqlite3** out) {
-    return sqlite3_open(path.c_str(), out);
+    return sqlite3_open_v2(path.c_str(), out, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_URI, nullptr);
 }
 
 bool DatabaseConnection::connect() {
@@ -58,74 +200,544 @@ bool DatabaseConnection::connect() {
         "../../../" + databasePath,
         "backend/" + databasePath,
     };
+    sqlite3* probe = nullptr;
     int rc = SQLITE_OK;
     for (const auto& path : tryPaths) {
-        rc = tryOpenDb(path, &conn);
-        if (rc == SQLITE_OK && conn != nullptr) {
+        rc = tryOpenDb(path, &probe);
+        if (rc == SQLITE_OK && probe != nullptr) {
             databasePath = path;
             break;
         }
-        if (conn) {
-            sqlite3_close(conn);
-            conn = nullptr;
+        if (probe) {
+            sqlite3_close(probe);
+            probe = nullptr;
+        }
+    }
+    if (rc != SQLITE_OK || probe == nullptr) {
+        std::cerr << "SQLite open failed: " << (probe ? sqlite3_errmsg(probe) : "out of memory") << std::endl;
+        if (probe) {
+            sqlite3_close(probe);
+        }
+        return false;
+    }
+    sqlite3_close(probe);
+    if (replicaMode) {
+        std::string directory = replicationOptions.directoryFor(databasePath);
+        databasePath = replicationOptions.replicaPathFor(databasePath);
+        applier = std::make_unique<Replication::Applier>(directory, replicationOptions, [this] {
+            sqlite3* db = openConnection(connectionMemory.writer);
+            if (db) BusyRetry::install(db, "replica");
+            return db;
+        });
+        if (!applier->bootstrap())
+            std::cerr << "Replica " << databasePath << " has no data yet; it fills in once the primary publishes a snapshot to "
+                      << directory << std::endl;
+        applier->start();
+    }
+    if (memoryOptions.enabled) {
+        memory = std::make_unique<MemoryImage>(databasePath, memoryOptions);
+        if (!memory->load()) {
+            std::cerr << "Serving " << databasePath << " from disk instead" << std::endl;
+            memory.reset();
+        }
+    }
+    // Created before anything that writes, so no commit goes unreported
+    if (changeFeedOptions.enabled)
+        changes = std::make_unique<ChangeFeed>(changeFeedOptions);
+    if (!replicaMode)
+        pool = std::make_unique<ConnectionPool>("read-write", poolSize, std::chrono::milliseconds(acquireTimeoutMs),
+                                                statementCacheSize, [this] { return openConnection(connectionMemory.readWrite); },
+                                                changes.get());
+    readPool = std::make_unique<ConnectionPool>("read-only", readPoolSize, std::chrono::milliseconds(acquireTimeoutMs),
+                                                statementCacheSize, [this] { return openReadConnection(); });
+    writerOptions.statementCacheSize = statementCacheSize;
+    writerOptions.changes = changes.get();
+    if (!replicaMode) {
+        writeQueue = std::make_unique<WriteQueue>([this] {
+            sqlite3* db = openConnection(connectionMemory.writer);
+            if (db) BusyRetry::install(db, "writer");
+            return db;
+        }, writerOptions);
+    }
+    DbExecutor::Options executorConfig = executorOptions;
+    if (executorConfig.threads == 0)
+        executorConfig.threads = poolSize + readPoolSize;
+    dbExecutor = std::make_unique<DbExecutor>(executorConfig);
+    maintenance = std::make_unique<MaintenanceScheduler>(databasePath, [this] { return openConnection(connectionMemory.readWrite); }, maintenanceOptions);
+    if (!replicaMode) {
+        CatalogImporter::Options importConfig = importOptions;
+        importConfig.directory = importOptions.directoryFor(databasePath);
+        catalogImporter = std::make_unique<CatalogImporter>(writeQueue.get(), importConfig);
+    }
+    if (shardOptions.shards > 1 && !replicaMode && mainHasUserRows()) {
+        // The shards would start empty and hide every cart and order already in the main file
+        std::cerr << "sharding.shards is " << shardOptions.shards << " but " << databasePath
+                  << " already holds carts or orders; keeping them in the main file. Empty cart_items, orders and"
+                  << " order_items (or start from a fresh database) to enable sharding" << std::endl;
+    } else if (shardOptions.shards > 1) {
+        shards = std::make_unique<ShardSet>(databasePath, shardOptions, readPoolSize, std::chrono::milliseconds(acquireTimeoutMs),
+                                            statementCacheSize, writerOptions,
+                                            [this](const std::string& path, bool readOnly) { return openShardConnection(path, readOnly); });
+        // Each shard file (and its attached archive) is checkpointed, optimized and vacuumed on its own
+        for (size_t i = 0; i < shards->size(); i++) {
+            std::string path = shards->path(i);
+            shardMaintenance.push_back(std::make_unique<MaintenanceScheduler>(
+                path, [this, path] { return openShardConnection(path, false); }, maintenanceOptions));
         }
     }
-    if (rc != SQLITE_OK || conn == nullptr) {
-        std::cerr << "SQLite open failed: " << (conn ? sqlite3_errmsg(conn) : "out of memory") << std::endl;
-        if (conn) {
-            sqlite3_close(conn);
-            conn = nullptr;
+    if (!replicaMode) {
+        // One backup set covers the main file, every shard and their archives
+        std::vector<BackupManager::Source> backupSources;
+        backupSources.push_back({databasePath, [this] { return openReadConnection(); }});
+        std::vector<std::string> files;
+        if (shards)
+            for (size_t i = 0; i < shards->size(); i++)
+                files.push_back(shards->path(i));
+        if (archiveOptions.enabled) {
+            files.push_back(archivePathFor(databasePath));
+            if (shards)
+                for (size_t i = 0; i < shards->size(); i++)
+                    files.push_back(archivePathFor(shards->path(i)));
         }
+        for (const auto& path : files)
+            backupSources.push_back({path, [path] { return openFileReadOnly(path); }});
+        backupManager = std::make_unique<BackupManager>(std::move(backupSources), backupOptions);
+    }
+    WriteQueue* mainWriter = writeQueue.get();
+    ShardSet* shardSet = shards.get();
+    orderArchiver = std::make_unique<OrderArchiver>(archiveOptions, shards ? shards->size() : 1,
+                                                    [mainWriter, shardSet](size_t shard) {
+        return shardSet ? shardSet->writer(shard) : mainWriter;
+    });
+    std::cout << "Connected to SQLite database: " << databasePath << (memory ? " (in memory)" : "")
+              << (replicaMode ? " (read replica)" : "")
+              << " (" << (pool ? poolSize : 0) << " read-write + " << readPoolSize << " read-only connections, " << storage.name << " storage profile)" << std::endl;
+    if (shards)
+        std::cout << "Carts and orders sharded by user across " << shards->size() << " files in "
+                  << fs::path(shards->path(0)).parent_path().string() << std::endl;
+    return true;
+}
+
+sqlite3* DatabaseConnection::openConnection(const SqliteMemory::Budget& budget) {
+    sqlite3* db = nullptr;
+    if (tryOpenDb(mainPath(), &db) != SQLITE_OK) {
+        std::cerr << "SQLite open failed: " << (db ? sqlite3_errmsg(db) : "out of memory") << std::endl;
+        if (db) sqlite3_close(db);
+        return nullptr;
+    }
+    budget.applyLookaside(db);
+    // Pooled connections write concurrently, so wait for the lock instead of failing fast
+    BusyRetry::install(db, "read-write");
+    SqlProfiler::install(db);
+    storage.apply(db);
+    sqlite3_exec(db, "PRAGMA foreign_keys = ON;", nullptr, nullptr, nullptr);
+    if (archiveOptions.enabled)
+        attachArchive(db, databasePath, false);
+    budget.applyCache(db);
+    return db;
+}
+
+sqlite3* DatabaseConnection::openReadConnection() {
+    sqlite3* db = nullptr;
+    if (sqlite3_open_v2(mainPath().c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_URI, nullptr) != SQLITE_OK) {
+        std::cerr << "SQLite read-only open failed: " << (db ? sqlite3_errmsg(db) : "out of memory") << std::endl;
+        if (db) sqlite3_close(db);
+        return nullptr;
+    }
+    connectionMemory.readOnly.applyLookaside(db);
+    BusyRetry::install(db, "read-only");
+    SqlProfiler::install(db);
+    storage.apply(db, true);
+    sqlite3_exec(db, "PRAGMA query_only = ON;", nullptr, nullptr, nullptr);
+    if (archiveOptions.enabled)
+        attachArchive(db, databasePath, true);
+    connectionMemory.readOnly.applyCache(db);
+    return db;
+}
+
+sqlite3* DatabaseConnection::openShardConnection(const std::string& path, bool readOnly) {
+    sqlite3* db = nullptr;
+    int flags = (readOnly ? SQLITE_OPEN_READONLY : SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE) | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_URI;
+    if (sqlite3_open_v2(path.c_str(), &db, flags, nullptr) != SQLITE_OK) {
+        std::cerr << "SQLite shard open failed: " << (db ? sqlite3_errmsg(db) : "out of memory") << std::endl;
+        if (db) sqlite3_close(db);
+        return nullptr;
+    }
+    // Shard read-write connections only ever serve the shard's writer thread
+    const SqliteMemory::Budget& budget = readOnly ? connectionMemory.readOnly : connectionMemory.writer;
+    budget.applyLookaside(db);
+    BusyRetry::install(db, readOnly ? "shard-read-only" : "shard-read-write");
+    SqlProfiler::install(db);
+    storage.apply(db, readOnly);
+    // The catalog is attached read-only, so a shard write transaction never
+    // takes the main file's write lock and shards commit independently
+    std::string catalog = memory ? memory->uri() + "&mode=ro" : sqliteUri(databasePath, "mode=ro");
+    std::string attach = "ATTACH DATABASE " + sqlQuote(catalog) + " AS catalog;";
+    if (sqlite3_exec(db, attach.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+        std::cerr << "Shard " << path << ": could not attach catalog: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return nullptr;
+    }
+    sqlite3_exec(db, readOnly ? "PRAGMA query_only = ON;" : "PRAGMA foreign_keys = ON;", nullptr, nullptr, nullptr);
+    if (archiveOptions.enabled)
+        attachArchive(db, path, readOnly);
+    budget.applyCache(db);
+    return db;
+}
+
+bool DatabaseConnection::attachArchive(sqlite3* db, const std::string& path, bool readOnly) {
+    std::string archive = archivePathFor(path);
+    std::string attach = "ATTACH DATABASE " + sqlQuote(readOnly ? sqliteUri(archive, "mode=ro") : archive) + " AS archive;";
+    if (sqlite3_exec(db, attach.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+        // Read-only connections can open before the first writer has created the file
+        std::cerr << "Could not attach order archive " << archive << ": " << sqlite3_errmsg(db) << std::endl;
         return false;
     }
-    sqlite3_exec(conn, "PRAGMA foreign_keys = ON;", nullptr, nullptr, nullptr);
-    std::cout << "Connected to SQLite database: " << databasePath << std::endl;
+    if (!readOnly) {
+        std::string pragmas = "PRAGMA archive.journal_mode = " + storage.journalMode +
+                              "; PRAGMA archive.synchronous = " + storage.synchronous + ";";
+        sqlite3_exec(db, pragmas.c_str(), nullptr, nullptr, nullptr);
+    }
     return true;
 }
 
-bool DatabaseConnection::ensureSchema() {
-    const std::vector<std::string> schemaPaths = {
-        "database/schema_sqlite.sql",
-        "../database/schema_sqlite.sql",
-        "../../database/schema_sqlite.sql",
-        "../../../database/schema_sqlite.sql",
-        "backend/../database/schema_sqlite.sql",
+bool DatabaseConnection::mainHasUserRows() {
+    sqlite3* db = openReadConnection();
+    if (!db) return false;
+    static const char* const probes[] = {
+        "SELECT 1 FROM main.cart_items LIMIT 1",
+        "SELECT 1 FROM main.orders LIMIT 1",
+        "SELECT 1 FROM main.order_items LIMIT 1",
+        "SELECT 1 FROM archive.orders LIMIT 1",
     };
-    std::ifstream schemaFile;
-    for (const auto& path : schemaPaths) {
-        schemaFile.open(path);
-        if (schemaFile.is_open())
-            break;
+    bool found = false;
+    for (const char* sql : probes) {
+        // A table that does not exist yet (fresh database, no archive) holds nothing
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+            found = true;
+        sqlite3_finalize(stmt);
+        if (found) break;
     }
-    if (!schemaFile.is_open())
+    sqlite3_close_v2(db);
+    return found;
+}
+
+bool DatabaseConnection::ensureSchema() {
+    // The primary migrates; its schema arrives with the next snapshot
+    if (replicaMode)
+        return isConnected();
+    std::string databaseDir = MigrationRunner::findDatabaseDir();
+    if (databaseDir.empty())
         return true;
-    std::stringstream buf;
-    buf << schemaFile.rdbuf();
-    schemaFile.close();
-    std::string sql = buf.str();
-    char* errMsg = nullptr;
-    int rc = sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, &errMsg);
-    if (rc != SQLITE_OK && errMsg) {
-        std::cerr << "Schema exec error: " << errMsg << std::endl;
-        sqlite3_free(errMsg);
+    MigrationRunner runner(MigrationRunner::load(databaseDir));
+    auto conn = getConnection();
+    if (!conn)
+        return false;
+    if (!runner.run(conn))
+        return false;
+    conn.release();
+    ShardSet* s;
+    {
+        std::lock_guard<std::mutex> lock(connectMutex);
+        s = shards.get();
+    }
+    if (s && !s->ensureSchema(MigrationRunner::load(databaseDir, "shard_schema_sqlite.sql", "migrations/shard")))
+        return false;
+    OrderArchiver* a = archiveOptions.enabled ? archiver() : nullptr;
+    if (a && !a->prepare()) {
+        std::cerr << "Order archive tables could not be prepared" << std::endl;
         return false;
     }
-    if (errMsg) sqlite3_free(errMsg);
+    if (advisorOptions.onStartup)
+        IndexAdvisor::report(adviseIndexes(), std::cerr);
     return true;
 }
 
+json DatabaseConnection::adviseIndexes() {
+    bool sharded;
+    {
+        std::lock_guard<std::mutex> lock(connectMutex);
+        sharded = shards != nullptr;
+    }
+    auto catalog = getReadConnection();
+    // Unsharded, the user tables are in the catalog file; don't hold two leases on the read pool
+    PooledConnection user = sharded ? getUserReadConnection(0) : PooledConnection();
+    IndexAdvisor::Targets targets;
+    targets.catalog = catalog.get();
+    targets.user = sharded ? user.get() : catalog.get();
+    targets.archive = archiveOptions.enabled;
+    return IndexAdvisor::analyze(targets);
+}
+
 bool DatabaseConnection::isConnected() {
-    return conn != nullptr;
+    std::lock_guard<std::mutex> lock(connectMutex);
+    return readPool != nullptr;
 }
 
-sqlite3* DatabaseConnection::getConnection() {
-    if (!conn && !connect()) return nullptr;
-    return conn;
+PooledConnection DatabaseConnection::getConnection() {
+    if (replicaMode)
+        return {};
+    ConnectionPool* p;
+    {
+        std::lock_guard<std::mutex> lock(connectMutex);
+        if (!pool && !connect()) return {};
+        p = pool.get();
+    }
+    return p->acquire();
+}
+
+WriteQueue* DatabaseConnection::writer() {
+    if (replicaMode)
+        return nullptr;
+    std::lock_guard<std::mutex> lock(connectMutex);
+    if (!writeQueue && !connect()) return nullptr;
+    return writeQueue.get();
+}
+
+DbExecutor* DatabaseConnection::executor() {
+    std::lock_guard<std::mutex> lock(connectMutex);
+    if (!dbExecutor && !connect()) return nullptr;
+    return dbExecutor.get();
+}
+
+CatalogImporter* DatabaseConnection::importer() {
+    if (replicaMode)
+        return nullptr;
+    std::lock_guard<std::mutex> lock(connectMutex);
+    if (!catalogImporter && !connect()) return nullptr;
+    return catalogImporter.get();
+}
+
+ChangeFeed* DatabaseConnection::changeFeed() {
+    std::lock_guard<std::mutex> lock(connectMutex);
+    if (!readPool && !connect()) return nullptr;
+    return changes.get();
+}
+
+BackupManager* DatabaseConnection::backups() {
+    if (replicaMode)
+        return nullptr;
+    std::lock_guard<std::mutex> lock(connectMutex);
+    if (!backupManager && !connect()) return nullptr;
+    return backupManager.get();
+}
+
+size_t DatabaseConnection::userShardCount() {
+    std::lock_guard<std::mutex> lock(connectMutex);
+    return shards ? shards->size() : 1;
+}
+
+size_t DatabaseConnection::userShardFor(int64_t userId) {
+    std::lock_guard<std::mutex> lock(connectMutex);
+    return shards ? shards->shardForUser(userId) : 0;
+}
+
+size_t DatabaseConnection::userShardForId(int64_t rowId) {
+    std::lock_guard<std::mutex> lock(connectMutex);
+    return shards ? shards->shardForId(rowId) : 0;
+}
+
+PooledConnection DatabaseConnection::getUserReadConnection(size_t shard) {
+    ShardSet* s;
+    {
+        std::lock_guard<std::mutex> lock(connectMutex);
+        if (!readPool && !connect()) return {};
+        s = shards.get();
+    }
+    if (!s)
+        return getReadConnection();
+    return shard < s->size() ? s->read(shard) : PooledConnection();
+}
+
+WriteQueue* DatabaseConnection::userWriter(size_t shard) {
+    if (replicaMode)
+        return nullptr;
+    std::lock_guard<std::mutex> lock(connectMutex);
+    if (!writeQueue && !connect()) return nullptr;
+    if (!shards)
+        return writeQueue.get();
+    return shard < shards->size() ? shards->writer(shard) : nullptr;
+}
+
+bool DatabaseConnection::archiveEnabled() {
+    return archiveOptions.enabled;
+}
+
+OrderArchiver* DatabaseConnection::archiver() {
+    std::lock_guard<std::mutex> lock(connectMutex);
+    if (!orderArchiver && !connect()) return nullptr;
+    return orderArchiver.get();
+}
+
+MemoryImage* DatabaseConnection::memoryImage() {
+    std::lock_guard<std::mutex> lock(connectMutex);
+    return memory.get();
+}
+
+bool DatabaseConnection::startReplication() {
+    std::lock_guard<std::mutex> lock(connectMutex);
+    if (!replicationOptions.publish || publisher)
+        return true;
+    if (!readPool && !connect())
+        return false;
+    if (!changes) {
+        std::cerr << "Replication needs the change feed; set \"change_feed\": {\"enabled\": true}" << std::endl;
+        return false;
+    }
+    ConnectionPool* reads = readPool.get();
+    publisher = std::make_unique<Replication::Publisher>(replicationOptions.directoryFor(databasePath), replicationOptions,
+                                                         *changes, [reads] { return reads->acquire(); });
+    return true;
+}
+
+json DatabaseConnection::replicationStats() {
+    std::lock_guard<std::mutex> lock(connectMutex);
+    if (publisher)
+        return publisher->stats();
+    if (applier)
+        return applier->stats();
+    return nullptr;
+}
+
+PooledConnection DatabaseConnection::getReadConnection() {
+    ConnectionPool* p;
+    {
+        std::lock_guard<std::mutex> lock(connectMutex);
+        if (!readPool && !connect()) return {};
+        p = readPool.get();
+    }
+    return p->acquire();
+}
+
+json DatabaseConnection::poolStats() {
+    std::lock_guard<std::mutex> lock(connectMutex);
+    json j;
+    j["database_path"] = databasePath;
+    j["storage"] = storage.toJson();
+    j["pools"] = json::array();
+    if (pool)
+        j["pools"].push_back(pool->stats());
+    if (readPool)
+        j["pools"].push_back(readPool->stats());
+    if (writeQueue)
+        j["writer"] = writeQueue->stats();
+    if (dbExecutor)
+        j["executor"] = dbExecutor->stats();
+    if (changes)
+        j["change_feed"] = changes->stats();
+    if (maintenance)
+        j["maintenance"] = maintenance->stats();
+    if (shards) {
+        j["shards"] = shards->stats();
+        for (size_t i = 0; i < shardMaintenance.size(); i++)
+            j["shards"][i]["maintenance"] = shardMaintenance[i]->stats();
+    }
+    if (orderArchiver)
+        j["archive"] = orderArchiver->stats();
+    if (memory)
+        j["memory"] = memory->stats();
+    if (publisher)
+        j["replication"] = publisher->stats();
+    else if (applier)
+        j["replication"] = applier->stats();
+    return j;
+}
+
+json DatabaseConnection::memoryStats(bool reset) {
+    std::lock_guard<std::mutex> lock(connectMutex);
+    json j;
+    j["process"] = SqliteMemory::processStats(reset);
+    j["budgets"] = connectionMemory.toJson();
+    SqliteMemory::Counters readWrite;
+    SqliteMemory::Counters readOnly;
+    SqliteMemory::Counters writers;
+    if (pool)
+        readWrite += pool->memory(reset);
+    if (readPool)
+        readOnly += readPool->memory(reset);
+    if (writeQueue)
+        writers += writeQueue->memory(reset);
+    if (shards) {
+        readOnly += shards->readMemory(reset);
+        writers += shards->writerMemory(reset);
+    }
+    SqliteMemory::Counters total = readWrite;
+    total += readOnly;
+    total += writers;
+    j["connections"] = {{"read_write", readWrite.toJson()}, {"read_only", readOnly.toJson()},
+                        {"writer", writers.toJson()}, {"total", total.toJson()}};
+    return j;
 }
 
 void DatabaseConnection::closeConnection() {
-    if (conn != nullptr) {
-        sqlite3_close(conn);
-        conn = nullptr;
+    // Queued handlers lease connections through this class, so they finish
+    // before the lock is taken and everything below closes
+    std::unique_ptr<DbExecutor> executor;
+    {
+        std::lock_guard<std::mutex> lock(connectMutex);
+        executor = std::move(dbExecutor);
+    }
+    if (executor)
+        executor->stop();
+    std::lock_guard<std::mutex> lock(connectMutex);
+    // The archiver and the importer submit to the writers, so they stop first
+    if (orderArchiver) {
+        orderArchiver->stop();
+        orderArchiver.reset();
+    }
+    if (catalogImporter) {
+        catalogImporter->stop();
+        catalogImporter.reset();
+    }
+    if (shards) {
+        shards->close();
+        shards.reset();
+    }
+    if (backupManager) {
+        backupManager->stop();
+        backupManager.reset();
+    }
+    if (maintenance) {
+        maintenance->stop();
+        maintenance.reset();
+    }
+    for (auto& scheduler : shardMaintenance)
+        scheduler->stop();
+    shardMaintenance.clear();
+    if (writeQueue) {
+        writeQueue->stop();
+        writeQueue.reset();
+    }
+    // After the writers, so the last segment carries what they committed
+    if (publisher) {
+        publisher->stop();
+        publisher.reset();
     }
+    if (applier) {
+        applier->stop();
+        applier.reset();
+    }
+    if (readPool) {
+        readPool->close();
+        readPool.reset();
+    }
+    if (pool) {
+        pool->close();
+        pool.reset();
+    }
+    // After every connection that reports to it has closed; delivers what is still queued
+    if (changes) {
+        changes->stop();
+        changes.reset();
+    }
+    // Last, so the final write-back sees every commit and no other handle is left on the image
+    if (memory) {
+        memory->stop();
+        memory.reset();
+    }
+}
+
+const std::string& DatabaseConnection::mainPath() const {
+    return memory ? memory->uri() : databasePath;
 }
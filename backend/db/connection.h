@@ -2,15 +2,80 @@
 #define CONNECTION_H
 
 #include <sqlite3.h>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "backup.h"
+#include "catalog_importer.h"
+#include "change_feed.h"
+#include "connection_pool.h"
+#include "db_executor.h"
+#include "index_advisor.h"
+#include "maintenance.h"
+#include "memory_image.h"
+#include "order_archiver.h"
+#include "replication.h"
+#include "shard_set.h"
+#include "sqlite_memory.h"
+#include "storage_profile.h"
+#include "write_queue.h"
 
 class DatabaseConnection {
 public:
     static DatabaseConnection& getInstance();
-    sqlite3* getConnection();
+    // Call before the first getInstance(): serve a read replica of the main
+    // database (see Replication::Applier) instead of the database itself. A
+    // replica has no read-write connections, writers or importer.
+    static void runAsReplica();
+    static bool isReplica();
+    // Leases a connection from the pool; empty (null) if the database is unavailable
+    PooledConnection getConnection();
+    // Leases a SQLITE_OPEN_READONLY, query_only connection for GET routes
+    PooledConnection getReadConnection();
+    // Single writer thread for cart/order mutations; null if the database is unavailable
+    WriteQueue* writer();
+    // Thread pool route handlers run their queries on (see DbAsync::respond);
+    // null if the database is unavailable
+    DbExecutor* executor();
+    // Online backups of the database file; null if the database is unavailable
+    BackupManager* backups();
+    // Bulk CSV / JSONL product imports through the main writer; null if the database is unavailable
+    CatalogImporter* importer();
+    // Committed row changes from every writer and read-write connection, for
+    // cache invalidation; null if "change_feed" is disabled or the database is unavailable
+    ChangeFeed* changeFeed();
+
+    // cart_items, orders and order_items are user-scoped. With sharding enabled
+    // they live in per-user shard files; otherwise every "shard" below is the
+    // main database, so callers can use these unconditionally.
+    size_t userShardCount();
+    size_t userShardFor(int64_t userId);
+    // Shard that owns a cart item or order id; userShardCount() if none does
+    size_t userShardForId(int64_t rowId);
+    PooledConnection getUserReadConnection(size_t shard);
+    WriteQueue* userWriter(size_t shard);
+    // Old finished orders move to an "archive" database attached to every
+    // connection of the file they came from; read it only past the hot rows
+    bool archiveEnabled();
+    OrderArchiver* archiver();
+    // Set when "memory": {"enabled": true} serves the main database from RAM
+    MemoryImage* memoryImage();
+    // On the primary, starts writing segments for replicas when
+    // "replication": {"publish": true}; call after ensureSchema()
+    bool startReplication();
+    // The publisher's or the replica's figures; null when neither runs
+    nlohmann::json replicationStats();
     void closeConnection();
     bool isConnected();
     bool ensureSchema();
+    // Explains every registered query against the live schema (see IndexAdvisor)
+    nlohmann::json adviseIndexes();
+    nlohmann::json poolStats();
+    // SQLite heap use plus page cache and lookaside figures per kind of
+    // connection; reset clears event counts and high-water marks after reading
+    nlohmann::json memoryStats(bool reset = false);
 
 private:
     DatabaseConnection();
@@ -18,11 +83,51 @@ private:
     DatabaseConnection(const DatabaseConnection&) = delete;
     DatabaseConnection& operator=(const DatabaseConnection&) = delete;
 
-    sqlite3* conn;
+    std::unique_ptr<ChangeFeed> changes;
+    std::unique_ptr<ConnectionPool> pool;
+    std::unique_ptr<ConnectionPool> readPool;
+    std::unique_ptr<WriteQueue> writeQueue;
+    std::unique_ptr<DbExecutor> dbExecutor;
+    std::unique_ptr<MaintenanceScheduler> maintenance;
+    std::unique_ptr<BackupManager> backupManager;
+    std::unique_ptr<CatalogImporter> catalogImporter;
+    std::unique_ptr<ShardSet> shards;
+    std::vector<std::unique_ptr<MaintenanceScheduler>> shardMaintenance;
+    std::unique_ptr<OrderArchiver> orderArchiver;
+    std::unique_ptr<MemoryImage> memory;
+    std::unique_ptr<Replication::Publisher> publisher;
+    std::unique_ptr<Replication::Applier> applier;
+    std::mutex connectMutex;
     std::string databasePath;
+    size_t poolSize;
+    size_t readPoolSize;
+    int acquireTimeoutMs;
+    size_t statementCacheSize;
+    StorageProfile storage;
+    WriteQueue::Options writerOptions;
+    ChangeFeed::Options changeFeedOptions;
+    DbExecutor::Options executorOptions;
+    MaintenanceScheduler::Options maintenanceOptions;
+    BackupManager::Options backupOptions;
+    CatalogImporter::Options importOptions;
+    ShardSet::Options shardOptions;
+    OrderArchiver::Options archiveOptions;
+    IndexAdvisor::Options advisorOptions;
+    MemoryImage::Options memoryOptions;
+    Replication::Options replicationOptions;
+    SqliteMemory::Options connectionMemory;
+    static bool replicaMode;
 
     void loadConfig();
     bool connect();
+    // What pooled connections open: the memdb URI in memory mode, else the file
+    const std::string& mainPath() const;
+    sqlite3* openConnection(const SqliteMemory::Budget& budget);
+    sqlite3* openReadConnection();
+    sqlite3* openShardConnection(const std::string& path, bool readOnly);
+    bool attachArchive(sqlite3* db, const std::string& path, bool readOnly);
+    // Whether the main file (or its archive) already holds carts or orders
+    bool mainHasUserRows();
 };
 
 #endif // CONNECTION_H
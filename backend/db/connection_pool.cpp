@@ -0,0 +1,191 @@
+#include "connection_pool.h"
+#include <algorithm>
+#include <iostream>
+
+using json = nlohmann::json;
+
+PooledConnection::PooledConnection(ConnectionPool* pool, size_t slot) : pool(pool), slot(slot) {}
+
+PooledConnection::PooledConnection(PooledConnection&& other) noexcept : pool(other.pool), slot(other.slot) {
+    other.pool = nullptr;
+}
+
+PooledConnection& PooledConnection::operator=(PooledConnection&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool = other.pool;
+        slot = other.slot;
+        other.pool = nullptr;
+    }
+    return *this;
+}
+
+PooledConnection::~PooledConnection() {
+    release();
+}
+
+sqlite3* PooledConnection::get() const {
+    return pool ? pool->handle(slot) : nullptr;
+}
+
+CachedStatement PooledConnection::prepare(const char* sql) const {
+    return pool ? pool->statements(slot)->prepare(sql) : CachedStatement();
+}
+
+void PooledConnection::release() {
+    if (pool) {
+        pool->giveBack(slot);
+        pool = nullptr;
+    }
+}
+
+ConnectionPool::ConnectionPool(std::string name, size_t size, std::chrono::milliseconds acquireTimeout,
+                               size_t statementCacheSize, Opener opener, ChangeFeed* changes)
+    : name(std::move(name)), acquireTimeout(acquireTimeout), statementCacheSize(statementCacheSize),
+      opener(std::move(opener)), changes(changes),
+      slots(std::max<size_t>(size, 1)), waiting(0), timeouts(0), closed(false) {
+    // Hand out low slots first so a lightly loaded server keeps few connections open
+    for (size_t i = slots.size(); i > 0; i--)
+        idle.push_back(i - 1);
+}
+
+ConnectionPool::~ConnectionPool() {
+    close();
+}
+
+PooledConnection ConnectionPool::acquire() {
+    auto start = std::chrono::steady_clock::now();
+    size_t slot;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        waiting++;
+        bool ready = available.wait_for(lock, acquireTimeout, [this] { return closed || !idle.empty(); });
+        waiting--;
+        if (closed)
+            return {};
+        if (!ready) {
+            timeouts++;
+            std::cerr << "SQLite pool '" << name << "': no connection free after "
+                      << acquireTimeout.count() << " ms" << std::endl;
+            return {};
+        }
+        slot = idle.back();
+        idle.pop_back();
+        auto waited = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        Slot& s = slots[slot];
+        s.checkouts++;
+        s.totalWaitMicros += waited;
+        s.maxWaitMicros = std::max(s.maxWaitMicros, waited);
+    }
+    // Open lazily outside the lock; only the lease holder uses this slot's handle
+    if (!slots[slot].db) {
+        sqlite3* db = opener();
+        if (!db) {
+            giveBack(slot);
+            return {};
+        }
+        auto statements = std::make_unique<StatementCache>(db, statementCacheSize);
+        std::unique_ptr<ChangeCapture> capture;
+        if (changes) {
+            capture = std::make_unique<ChangeCapture>(*changes, name);
+            capture->install(db);
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        slots[slot].db = db;
+        slots[slot].statements = std::move(statements);
+        slots[slot].capture = std::move(capture);
+    }
+    return PooledConnection(this, slot);
+}
+
+sqlite3* ConnectionPool::handle(size_t slot) const {
+    return slots[slot].db;
+}
+
+StatementCache* ConnectionPool::statements(size_t slot) const {
+    return slots[slot].statements.get();
+}
+
+void ConnectionPool::closeSlot(Slot& s) {
+    if (s.db) {
+        s.statements.reset();
+        sqlite3_close_v2(s.db);
+        s.db = nullptr;
+        s.capture.reset();
+        s.memory = SqliteMemory::Counters();
+    }
+}
+
+void ConnectionPool::giveBack(size_t slot) {
+    // The releasing thread still owns the handle, so this is the safe moment to
+    // read its status counters and publish what it committed
+    SqliteMemory::Counters sample = SqliteMemory::Counters::sample(slots[slot].db);
+    if (slots[slot].capture)
+        slots[slot].capture->flush();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        slots[slot].memory.merge(sample);
+        if (closed)
+            closeSlot(slots[slot]);
+        idle.push_back(slot);
+    }
+    available.notify_one();
+}
+
+size_t ConnectionPool::size() const {
+    return slots.size();
+}
+
+json ConnectionPool::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    json j;
+    j["name"] = name;
+    j["size"] = slots.size();
+    j["idle"] = idle.size();
+    j["in_use"] = slots.size() - idle.size();
+    j["waiting"] = waiting;
+    j["acquire_timeouts"] = timeouts;
+    json conns = json::array();
+    for (size_t i = 0; i < slots.size(); i++) {
+        const Slot& s = slots[i];
+        json c;
+        c["slot"] = i;
+        c["open"] = s.db != nullptr;
+        c["checkouts"] = s.checkouts;
+        c["total_wait_us"] = s.totalWaitMicros;
+        c["avg_wait_us"] = s.checkouts ? s.totalWaitMicros / s.checkouts : 0;
+        c["max_wait_us"] = s.maxWaitMicros;
+        if (s.statements)
+            c["statement_cache"] = s.statements->stats();
+        if (s.db)
+            c["memory"] = s.memory.toJson();
+        conns.push_back(c);
+    }
+    j["connections"] = conns;
+    return j;
+}
+
+SqliteMemory::Counters ConnectionPool::memory(bool reset) {
+    std::lock_guard<std::mutex> lock(mutex);
+    SqliteMemory::Counters total;
+    for (Slot& s : slots) {
+        if (!s.db)
+            continue;
+        total += s.memory;
+        if (reset)
+            s.memory.clearEvents();
+    }
+    return total;
+}
+
+void ConnectionPool::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        // Idle connections close now; leased ones close when they come back
+        for (size_t slot : idle)
+            closeSlot(slots[slot]);
+    }
+    available.notify_all();
+}
@@ -0,0 +1,103 @@
+#ifndef CONNECTION_POOL_H
+#define CONNECTION_POOL_H
+
+#include <sqlite3.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "change_feed.h"
+#include "sqlite_memory.h"
+#include "statement_cache.h"
+
+class ConnectionPool;
+
+// RAII lease on one pooled connection. The connection goes back to the pool
+// when the lease is destroyed, so keep it in a named local for the whole handler.
+class PooledConnection {
+public:
+    PooledConnection() = default;
+    PooledConnection(PooledConnection&& other) noexcept;
+    PooledConnection& operator=(PooledConnection&& other) noexcept;
+    PooledConnection(const PooledConnection&) = delete;
+    PooledConnection& operator=(const PooledConnection&) = delete;
+    ~PooledConnection();
+
+    sqlite3* get() const;
+    // Prepared statement from this connection's cache; release it before the lease
+    CachedStatement prepare(const char* sql) const;
+    // Lets a named lease be passed straight to sqlite3_* calls; converting a
+    // temporary lease would hand out a connection that is already back in the pool.
+    operator sqlite3*() const& { return get(); }
+    operator sqlite3*() const&& = delete;
+    void release();
+
+private:
+    friend class ConnectionPool;
+    PooledConnection(ConnectionPool* pool, size_t slot);
+
+    ConnectionPool* pool = nullptr;
+    size_t slot = 0;
+};
+
+// Bounded checkout pool of SQLite connections. Each connection is used by one
+// thread at a time, so connections are opened without SQLite's per-connection mutex.
+class ConnectionPool {
+public:
+    using Opener = std::function<sqlite3*()>;
+
+    // With changes set, each connection reports its committed row changes
+    // there when its lease is released (pools whose connections write)
+    ConnectionPool(std::string name, size_t size, std::chrono::milliseconds acquireTimeout,
+                   size_t statementCacheSize, Opener opener, ChangeFeed* changes = nullptr);
+    ~ConnectionPool();
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    // Blocks until a connection is free. Returns an empty lease on timeout or open failure.
+    PooledConnection acquire();
+    size_t size() const;
+    nlohmann::json stats() const;
+    // sqlite3_db_status figures summed over the open connections, as of each
+    // one's last release; reset zeroes the event counts after reading
+    SqliteMemory::Counters memory(bool reset = false);
+    void close();
+
+private:
+    friend class PooledConnection;
+
+    struct Slot {
+        sqlite3* db = nullptr;
+        std::unique_ptr<StatementCache> statements;
+        uint64_t checkouts = 0;
+        uint64_t totalWaitMicros = 0;
+        uint64_t maxWaitMicros = 0;
+        SqliteMemory::Counters memory;  // sampled by the lease holder on release
+        std::unique_ptr<ChangeCapture> capture;
+    };
+
+    sqlite3* handle(size_t slot) const;
+    StatementCache* statements(size_t slot) const;
+    void closeSlot(Slot& s);
+    void giveBack(size_t slot);
+
+    std::string name;
+    std::chrono::milliseconds acquireTimeout;
+    size_t statementCacheSize;
+    Opener opener;
+    ChangeFeed* changes;
+    mutable std::mutex mutex;
+    std::condition_variable available;
+    std::vector<Slot> slots;
+    std::vector<size_t> idle;
+    size_t waiting;
+    uint64_t timeouts;
+    bool closed;
+};
+
+#endif // CONNECTION_POOL_H
@@ -0,0 +1,112 @@
+#include "db_executor.h"
+#include "sql_profiler.h"
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+using json = nlohmann::json;
+
+namespace {
+    uint64_t micros(std::chrono::steady_clock::duration d) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    }
+}
+
+DbExecutor::Options DbExecutor::Options::fromConfig(const json& section) {
+    Options o;
+    if (!section.is_object()) return o;
+    if (section.contains("threads") && section["threads"].is_number_unsigned())
+        o.threads = section["threads"].get<size_t>();
+    if (section.contains("max_queue") && section["max_queue"].is_number_unsigned())
+        o.maxQueue = section["max_queue"].get<size_t>();
+    return o;
+}
+
+DbExecutor::DbExecutor(Options options)
+    : options(options), stopping(false), running(0), maxDepth(0), submitted(0), rejected(0), failed(0) {
+    size_t threads = std::max<size_t>(this->options.threads, 1);
+    this->options.threads = threads;
+    for (size_t i = 0; i < threads; i++)
+        workers.emplace_back([this] { loop(); });
+}
+
+DbExecutor::~DbExecutor() {
+    stop();
+}
+
+bool DbExecutor::submit(std::function<void()> job, const char* site) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping || (options.maxQueue > 0 && queue.size() >= options.maxQueue)) {
+            rejected++;
+            return false;
+        }
+        queue.push_back({std::move(job), site, Clock::now()});
+        submitted++;
+        maxDepth = std::max(maxDepth, queue.size());
+    }
+    wake.notify_one();
+    return true;
+}
+
+void DbExecutor::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (queue.empty())
+            break;  // stopping and drained
+        Job job = std::move(queue.front());
+        queue.pop_front();
+        running++;
+        lock.unlock();
+
+        auto started = Clock::now();
+        bool ok = true;
+        try {
+            SqlSite site(job.site);
+            job.run();
+        } catch (const std::exception& e) {
+            std::cerr << "DB executor: " << job.site << " threw: " << e.what() << std::endl;
+            ok = false;
+        } catch (...) {
+            std::cerr << "DB executor: " << job.site << " threw" << std::endl;
+            ok = false;
+        }
+        wait.record(micros(started - job.queued));
+        run.record(micros(Clock::now() - started));
+
+        lock.lock();
+        running--;
+        if (!ok) failed++;
+    }
+}
+
+void DbExecutor::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping && workers.empty())
+            return;
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& t : workers)
+        if (t.joinable())
+            t.join();
+    workers.clear();
+}
+
+json DbExecutor::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    json j;
+    j["threads"] = options.threads;
+    j["running"] = running;
+    j["queue_depth"] = queue.size();
+    j["max_queue_depth"] = maxDepth;
+    j["max_queue"] = options.maxQueue;
+    j["submitted"] = submitted;
+    j["rejected"] = rejected;
+    j["failed"] = failed;
+    j["wait"] = wait.toJson();
+    j["run"] = run.toJson();
+    return j;
+}
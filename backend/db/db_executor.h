@@ -0,0 +1,70 @@
+#ifndef DB_EXECUTOR_H
+#define DB_EXECUTOR_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../utils/latency_histogram.h"
+
+// Bounded thread pool that route handlers hand their SQLite work to, so a slow
+// scan holds one of these threads instead of one of Crow's I/O threads. Jobs
+// run in arrival order; when the queue is full submit() refuses the job at
+// once rather than blocking the I/O thread, and the caller answers 503.
+class DbExecutor {
+public:
+    struct Options {
+        size_t threads = 0;     // 0: one per pooled connection (read-write + read-only)
+        size_t maxQueue = 256;  // jobs waiting for a thread; 0 means unbounded
+
+        // Reads db_config.json's "executor" section
+        static Options fromConfig(const nlohmann::json& section);
+    };
+
+    explicit DbExecutor(Options options);
+    ~DbExecutor();
+    DbExecutor(const DbExecutor&) = delete;
+    DbExecutor& operator=(const DbExecutor&) = delete;
+
+    // Queues job; false when the queue is full or the executor has stopped.
+    // site labels the job's statements in SqlProfiler stats (see SqlSite).
+    bool submit(std::function<void()> job, const char* site = "executor.job");
+    // Runs every job already queued, then joins the threads
+    void stop();
+    nlohmann::json stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+        std::function<void()> run;
+        const char* site;
+        Clock::time_point queued;
+    };
+
+    void loop();
+
+    Options options;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Job> queue;
+    bool stopping;
+    std::vector<std::thread> workers;
+
+    // Guarded by mutex
+    size_t running;
+    size_t maxDepth;
+    uint64_t submitted;
+    uint64_t rejected;
+    uint64_t failed;
+    // Lock-free: time queued before a thread picked the job up, and time it then ran
+    LatencyHistogram wait;
+    LatencyHistogram run;
+};
+
+#endif // DB_EXECUTOR_H
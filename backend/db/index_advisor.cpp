@@ -0,0 +1,526 @@
+#include "index_advisor.h"
+#include "query_registry.h"
+#include "sql_profiler.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <map>
+#include <regex>
+#include <set>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+    std::string upper(std::string s) {
+        for (char& c : s) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+        return s;
+    }
+
+    std::string trim(const std::string& s) {
+        size_t b = s.find_first_not_of(" \t\n");
+        size_t e = s.find_last_not_of(" \t\n");
+        return b == std::string::npos ? "" : s.substr(b, e - b + 1);
+    }
+
+    bool isKeyword(const std::string& word) {
+        static const std::set<std::string> keywords = {
+            "WHERE", "ON", "JOIN", "LEFT", "INNER", "CROSS", "ORDER", "GROUP", "LIMIT", "SET", "USING", "NATURAL",
+        };
+        return keywords.count(upper(word)) > 0;
+    }
+
+    // Replaces every "(SELECT ...)" group with "()", so a correlated subquery's
+    // predicates are not read as the outer query's
+    std::string stripSubqueries(const std::string& sql) {
+        std::string u = upper(sql);
+        std::string out;
+        size_t i = 0;
+        while (i < sql.size()) {
+            size_t next = sql[i] == '(' ? u.find_first_not_of(" \n\t", i + 1) : std::string::npos;
+            if (next != std::string::npos && u.compare(next, 6, "SELECT") == 0) {
+                int depth = 0;
+                size_t j = i;
+                for (; j < sql.size(); j++) {
+                    if (sql[j] == '(') depth++;
+                    else if (sql[j] == ')' && --depth == 0) break;
+                }
+                out += "()";
+                i = j + 1;
+            } else {
+                out += sql[i++];
+            }
+        }
+        return out;
+    }
+
+    // Text after keyword up to the first of the terminators (or the end); empty if keyword is absent
+    std::string clause(const std::string& sql, const char* keyword, std::initializer_list<const char*> terminators) {
+        std::string u = upper(sql);
+        size_t at = u.find(keyword);
+        if (at == std::string::npos) return "";
+        size_t begin = at + std::strlen(keyword);
+        size_t end = sql.size();
+        for (const char* t : terminators)
+            end = std::min(end, u.find(t, begin));
+        return sql.substr(begin, end - begin);
+    }
+
+    // Splits on top-level AND
+    std::vector<std::string> conjuncts(const std::string& where) {
+        std::vector<std::string> parts;
+        std::string u = upper(where);
+        int depth = 0;
+        size_t start = 0;
+        for (size_t i = 0; i < where.size(); i++) {
+            if (where[i] == '(') depth++;
+            else if (where[i] == ')') depth--;
+            else if (depth == 0 && u.compare(i, 5, " AND ") == 0) {
+                parts.push_back(trim(where.substr(start, i - start)));
+                start = i + 5;
+                i += 4;
+            }
+        }
+        std::string last = trim(where.substr(start));
+        if (!last.empty()) parts.push_back(last);
+        return parts;
+    }
+
+    struct TableRef {
+        std::string schema;  // "" when unqualified
+        std::string table;
+        std::string alias;   // what EXPLAIN QUERY PLAN calls it
+    };
+
+    std::vector<TableRef> tableRefs(const std::string& sql) {
+        static const std::regex fromJoin(R"(\b(FROM|JOIN|UPDATE)\s+([A-Za-z_][\w.]*)(?:\s+(?:AS\s+)?([A-Za-z_]\w*))?)",
+                                         std::regex::icase);
+        std::vector<TableRef> refs;
+        for (auto it = std::sregex_iterator(sql.begin(), sql.end(), fromJoin); it != std::sregex_iterator(); ++it) {
+            const auto& m = *it;
+            TableRef ref;
+            std::string name = m[2];
+            size_t dot = name.find('.');
+            if (dot != std::string::npos) {
+                ref.schema = name.substr(0, dot);
+                name = name.substr(dot + 1);
+            }
+            ref.table = name;
+            std::string alias = m[3];
+            ref.alias = !alias.empty() && !isKeyword(alias) ? alias : name;
+            refs.push_back(ref);
+        }
+        return refs;
+    }
+
+    const std::regex kEqualsParam(R"(^(?:(\w+)\.)?(\w+)\s*=\s*\?\d*$)");
+    const std::regex kLikeParam(R"(^(?:(\w+)\.)?(\w+)\s+(?:LIKE|GLOB)\s+\?\d*$)", std::regex::icase);
+    const std::regex kRangeParam(R"(^(?:(\w+)\.)?(\w+)\s*(?:<|>|<=|>=|BETWEEN)\s*\?)", std::regex::icase);
+    const std::regex kJoinEquals(R"(^(\w+)\.(\w+)\s*=\s*(\w+)\.(\w+)$)");
+    const std::regex kQualified(R"(\b([A-Za-z_]\w*)\.[A-Za-z_]\w*)");
+
+    // What the outer query asks of one table, gathered from its WHERE, ON and ORDER BY clauses
+    struct Demand {
+        std::vector<std::string> equals;   // col = ?, or the join column when the other side is filtered
+        std::string range;                 // col < ? etc.
+        std::vector<std::string> order;    // ORDER BY columns, when they all belong to this table
+        std::vector<std::string> partial;  // parameterless predicates, usable as a partial-index WHERE
+        std::string like;                  // col LIKE ?
+        bool filtered = false;             // any predicate at all
+    };
+
+    struct QueryShape {
+        std::vector<TableRef> tables;
+        std::map<std::string, Demand> demands;  // by alias
+    };
+
+    QueryShape parseShape(const std::string& sql) {
+        QueryShape q;
+        std::string outer = stripSubqueries(sql);
+        q.tables = tableRefs(outer);
+        for (const auto& t : q.tables)
+            q.demands[t.alias];
+        auto owner = [&q](const std::string& qualifier) -> std::string {
+            if (!qualifier.empty()) return q.demands.count(qualifier) ? qualifier : "";
+            return q.tables.size() == 1 ? q.tables[0].alias : "";
+        };
+        auto addUnique = [](std::vector<std::string>& v, const std::string& c) {
+            if (std::find(v.begin(), v.end(), c) == v.end()) v.push_back(c);
+        };
+
+        std::set<std::string> filteredByParam;
+        std::string where = clause(outer, " WHERE ", {" ORDER BY ", " GROUP BY ", " LIMIT "});
+        for (const std::string& p : conjuncts(where)) {
+            std::smatch m;
+            if (std::regex_match(p, m, kEqualsParam)) {
+                std::string o = owner(m[1]);
+                if (o.empty()) continue;
+                addUnique(q.demands[o].equals, m[2]);
+                q.demands[o].filtered = true;
+                filteredByParam.insert(o);
+            } else if (std::regex_match(p, m, kLikeParam)) {
+                std::string o = owner(m[1]);
+                if (o.empty()) continue;
+                q.demands[o].like = m[2];
+                q.demands[o].filtered = true;
+            } else if (std::regex_search(p, m, kRangeParam)) {
+                std::string o = owner(m[1]);
+                if (o.empty()) continue;
+                if (q.demands[o].range.empty()) q.demands[o].range = m[2];
+                q.demands[o].filtered = true;
+            } else if (p.find('?') == std::string::npos) {
+                // Parameterless: a partial-index candidate when it only touches one table
+                std::set<std::string> owners;
+                for (auto it = std::sregex_iterator(p.begin(), p.end(), kQualified); it != std::sregex_iterator(); ++it)
+                    owners.insert((*it)[1]);
+                std::string o = owners.size() == 1 ? owner(*owners.begin()) : owners.empty() ? owner("") : "";
+                if (o.empty()) continue;
+                q.demands[o].partial.push_back(std::regex_replace(p, std::regex("\\b" + o + "\\."), ""));
+                q.demands[o].filtered = true;
+            }
+        }
+
+        // A joined table is looked up by its join column once the other side is narrowed by a parameter
+        std::string u = upper(outer);
+        for (size_t at = u.find(" ON "); at != std::string::npos; at = u.find(" ON ", at + 4)) {
+            std::string on = clause(outer.substr(at), " ON ", {" LEFT ", " JOIN ", " INNER ", " WHERE ", " ORDER BY ", " LIMIT "});
+            for (const std::string& p : conjuncts(on)) {
+                std::smatch m;
+                if (!std::regex_match(p, m, kJoinEquals)) continue;
+                for (int side = 0; side < 2; side++) {
+                    std::string self = m[side ? 3 : 1], col = m[side ? 4 : 2], other = m[side ? 1 : 3];
+                    auto ref = std::find_if(q.tables.begin(), q.tables.end(),
+                                            [&](const TableRef& t) { return t.alias == self; });
+                    if (ref == q.tables.end() || !filteredByParam.count(other)) continue;
+                    auto& d = q.demands[self];
+                    d.equals.insert(d.equals.begin(), col);
+                    d.filtered = true;
+                }
+            }
+        }
+
+        std::string orderBy = clause(outer, " ORDER BY ", {" LIMIT "});
+        std::vector<std::pair<std::string, std::string>> terms;
+        for (size_t start = 0; start < orderBy.size();) {
+            size_t comma = orderBy.find(',', start);
+            std::string term = trim(orderBy.substr(start, comma == std::string::npos ? std::string::npos : comma - start));
+            std::smatch m;
+            static const std::regex orderTerm(R"(^(?:(\w+)\.)?(\w+)(?:\s+(?:ASC|DESC))?$)", std::regex::icase);
+            if (!std::regex_match(term, m, orderTerm)) { terms.clear(); break; }
+            terms.emplace_back(owner(m[1]), m[2]);
+            if (comma == std::string::npos) break;
+            start = comma + 1;
+        }
+        if (!terms.empty() && std::all_of(terms.begin(), terms.end(),
+                                          [&](const auto& t) { return !t.first.empty() && t.first == terms[0].first; })) {
+            auto& d = q.demands[terms[0].first];
+            for (const auto& t : terms)
+                if (std::find(d.equals.begin(), d.equals.end(), t.second) == d.equals.end())
+                    addUnique(d.order, t.second);
+        }
+        return q;
+    }
+
+    struct IndexInfo {
+        sqlite3* db;
+        const char* database;  // label the advisor reports it under
+        std::string schema;
+        std::string table;
+        std::string name;
+        std::vector<std::string> columns;
+        bool unique = false;
+        bool partial = false;
+        std::string origin;  // c = CREATE INDEX, u = UNIQUE constraint, pk = PRIMARY KEY
+    };
+
+    std::vector<IndexInfo> loadIndexes(sqlite3* db, const char* database, const std::string& schema) {
+        std::vector<IndexInfo> out;
+        std::string sql = "SELECT m.name, il.name, il.\"unique\", il.origin, il.partial "
+                          "FROM \"" + schema + "\".sqlite_master m, pragma_index_list(m.name, ?1) il "
+                          "WHERE m.type = 'table' ORDER BY m.name, il.seq DESC";
+        sqlite3_stmt* list = nullptr;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &list, nullptr) != SQLITE_OK) {
+            sqlite3_finalize(list);
+            return out;
+        }
+        sqlite3_bind_text(list, 1, schema.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_stmt* info = nullptr;
+        sqlite3_prepare_v2(db, "SELECT name FROM pragma_index_info(?1, ?2) ORDER BY seqno", -1, &info, nullptr);
+        while (sqlite3_step(list) == SQLITE_ROW) {
+            IndexInfo idx;
+            idx.db = db;
+            idx.database = database;
+            idx.schema = schema;
+            idx.table = reinterpret_cast<const char*>(sqlite3_column_text(list, 0));
+            idx.name = reinterpret_cast<const char*>(sqlite3_column_text(list, 1));
+            idx.unique = sqlite3_column_int(list, 2) != 0;
+            idx.origin = reinterpret_cast<const char*>(sqlite3_column_text(list, 3));
+            idx.partial = sqlite3_column_int(list, 4) != 0;
+            if (info) {
+                sqlite3_bind_text(info, 1, idx.name.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_text(info, 2, schema.c_str(), -1, SQLITE_TRANSIENT);
+                while (sqlite3_step(info) == SQLITE_ROW) {
+                    const char* col = reinterpret_cast<const char*>(sqlite3_column_text(info, 0));
+                    idx.columns.push_back(col ? col : "<expr>");
+                }
+                sqlite3_reset(info);
+            }
+            out.push_back(std::move(idx));
+        }
+        sqlite3_finalize(info);
+        sqlite3_finalize(list);
+        return out;
+    }
+
+    // Leading columns of the table's foreign keys; an index there serves the
+    // parent-side ON DELETE / ON UPDATE checks even when no query names it
+    std::set<std::string> foreignKeyColumns(sqlite3* db, const std::string& schema, const std::string& table) {
+        std::set<std::string> cols;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT \"from\" FROM pragma_foreign_key_list(?1, ?2) WHERE seq = 0",
+                               -1, &stmt, nullptr) == SQLITE_OK) {
+            sqlite3_bind_text(stmt, 1, table.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, schema.c_str(), -1, SQLITE_TRANSIENT);
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+                cols.insert(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+        }
+        sqlite3_finalize(stmt);
+        return cols;
+    }
+
+    bool isPrefix(const std::vector<std::string>& a, const std::vector<std::string>& b) {
+        return a.size() <= b.size() && std::equal(a.begin(), a.end(), b.begin());
+    }
+
+    std::string joined(const std::vector<std::string>& v, const char* sep) {
+        std::string s;
+        for (size_t i = 0; i < v.size(); i++) {
+            if (i > 0) s += sep;
+            s += v[i];
+        }
+        return s;
+    }
+
+    // CREATE INDEX for what the query asks of one table, or "" when it asks for nothing indexable
+    // or an identical index already exists
+    std::string suggestIndex(const TableRef& ref, const Demand& d, const std::vector<IndexInfo>& existing) {
+        std::vector<std::string> cols = d.equals;
+        cols.insert(cols.end(), d.order.begin(), d.order.end());
+        if (d.order.empty() && !d.range.empty()) cols.push_back(d.range);
+        if (cols.empty()) return "";
+        bool partial = !d.partial.empty();
+        std::string schema = ref.schema == "archive" ? "archive" : "main";
+        for (const auto& idx : existing)
+            if (idx.schema == schema && idx.table == ref.table && idx.columns == cols && idx.partial == partial)
+                return "";
+        std::string name = "idx_" + ref.table + "_" + joined(cols, "_") + (partial ? "_partial" : "");
+        std::string ddl = "CREATE INDEX " + (schema == "main" ? "" : schema + ".") + name +
+                          " ON " + ref.table + "(" + joined(cols, ", ") + ")";
+        if (partial) ddl += " WHERE " + joined(d.partial, " AND ");
+        return ddl;
+    }
+
+    struct Database {
+        const char* label;
+        sqlite3* db;
+        std::string schema;
+    };
+}
+
+namespace IndexAdvisor {
+    Options Options::fromConfig(const json& section) {
+        Options o;
+        if (!section.is_object()) return o;
+        if (section.contains("on_startup") && section["on_startup"].is_boolean())
+            o.onStartup = section["on_startup"].get<bool>();
+        return o;
+    }
+
+    json analyze(const Targets& targets) {
+        SqlSite site("index-advisor");
+        json result;
+        result["queries"] = json::array();
+        result["redundant_indexes"] = json::array();
+        result["unused_indexes"] = json::array();
+
+        // The schemas behind the targets, each audited once even when two handles share a file
+        std::vector<Database> databases;
+        if (targets.catalog)
+            databases.push_back({"main", targets.catalog, "main"});
+        if (targets.user && targets.user != targets.catalog) {
+            const char* a = targets.catalog ? sqlite3_db_filename(targets.catalog, "main") : nullptr;
+            const char* b = sqlite3_db_filename(targets.user, "main");
+            if (!a || !b || std::strcmp(a, b) != 0) {
+                if (!databases.empty()) databases.back().label = "catalog";
+                databases.push_back({"shard 0", targets.user, "main"});
+            }
+        }
+        if (targets.archive && targets.user)
+            databases.push_back({"archive", targets.user, "archive"});
+        std::vector<IndexInfo> indexes;
+        for (const auto& d : databases) {
+            auto found = loadIndexes(d.db, d.label, d.schema);
+            indexes.insert(indexes.end(), found.begin(), found.end());
+        }
+
+        std::set<std::string> usedIndexes;
+        size_t flagged = 0, suggestions = 0, skipped = 0, errors = 0;
+        bool complete = true;  // every query that can run here was explained
+        static const std::regex usesIndex(R"(USING (?:COVERING )?INDEX (\w+))");
+        for (const auto& q : QueryRegistry::all()) {
+            json entry;
+            entry["name"] = q.name;
+            entry["scope"] = QueryRegistry::scopeName(q.scope);
+            sqlite3* db = q.scope == QueryRegistry::Scope::Catalog ? targets.catalog : targets.user;
+            if (q.scope == QueryRegistry::Scope::Archive && !targets.archive) db = nullptr;
+            if (!db) {
+                bool archiveOff = q.scope == QueryRegistry::Scope::Archive && !targets.archive;
+                entry["skipped"] = archiveOff ? "order archive is not attached" : "no connection";
+                complete &= archiveOff;
+                skipped++;
+                result["queries"].push_back(entry);
+                continue;
+            }
+            std::string error;
+            json plan = SqlProfiler::explain(db, q.sql.c_str(), &error);
+            if (!error.empty()) {
+                // A statement that no longer prepares is the worst regression of all
+                entry["error"] = error;
+                errors++;
+                result["queries"].push_back(entry);
+                continue;
+            }
+            entry["plan"] = plan;
+
+            QueryShape shape = parseShape(q.sql);
+            json issues = json::array();
+            std::set<std::string> advise;  // aliases that need an index
+            for (const auto& line : plan) {
+                std::string detail = trim(line.get<std::string>());
+                std::smatch m;
+                if (std::regex_search(detail, m, usesIndex))
+                    usedIndexes.insert(m[1]);
+                if (detail.rfind("SCAN ", 0) == 0 && detail != "SCAN CONSTANT ROW") {
+                    std::string alias = detail.substr(5, detail.find(' ', 5) - 5);
+                    bool viaIndex = detail.find(" USING ") != std::string::npos;
+                    auto it = shape.demands.find(alias);
+                    // An ordered walk of an index with nothing left to filter is just a listing:
+                    // either the query has no predicate on the table, or a partial index already applies it
+                    if (viaIndex && (it == shape.demands.end() || !it->second.filtered))
+                        continue;
+                    if (viaIndex && std::regex_search(detail, m, usesIndex) && it->second.equals.empty() &&
+                        it->second.range.empty() && it->second.like.empty() &&
+                        std::any_of(indexes.begin(), indexes.end(),
+                                    [&](const IndexInfo& idx) { return idx.name == m[1] && idx.partial; }))
+                        continue;
+                    issues.push_back({{"kind", viaIndex ? "index_scan" : "full_scan"}, {"detail", detail}});
+                    advise.insert(alias);
+                } else if (detail.rfind("USE TEMP B-TREE", 0) == 0) {
+                    issues.push_back({{"kind", "temp_btree"}, {"detail", detail}});
+                    for (const auto& [alias, d] : shape.demands)
+                        if (!d.order.empty()) advise.insert(alias);
+                }
+            }
+            entry["issues"] = issues;
+
+            json advice = json::array();
+            json notes = json::array();
+            for (const std::string& alias : advise) {
+                auto ref = std::find_if(shape.tables.begin(), shape.tables.end(),
+                                        [&](const TableRef& t) { return t.alias == alias; });
+                if (ref == shape.tables.end()) continue;  // a subquery's table
+                const Demand& d = shape.demands[alias];
+                if (!d.like.empty())
+                    notes.push_back(ref->table + "." + d.like + " LIKE '%...%' cannot use an index; "
+                                    "an FTS5 table would serve the text search");
+                std::string ddl = suggestIndex(*ref, d, indexes);
+                if (!ddl.empty() && std::find(advice.begin(), advice.end(), ddl) == advice.end())
+                    advice.push_back(ddl);
+            }
+            entry["suggestions"] = advice;
+            if (!notes.empty()) entry["notes"] = notes;
+            if (!issues.empty()) flagged++;
+            suggestions += advice.size();
+            result["queries"].push_back(entry);
+        }
+
+        // Redundant: a plain index whose columns lead another index on the same table
+        for (const auto& a : indexes) {
+            if (a.origin != "c" || a.partial) continue;
+            for (const auto& b : indexes) {
+                if (&a == &b || a.database != b.database || a.table != b.table || b.partial) continue;
+                if (!isPrefix(a.columns, b.columns)) continue;
+                // Of two identical plain indexes keep the first; a UNIQUE one is only covered by an equal UNIQUE one
+                if (a.columns.size() == b.columns.size() && b.origin == "c" && !b.unique && !a.unique && &b > &a) continue;
+                if (a.unique && !(b.unique && a.columns.size() == b.columns.size())) continue;
+                result["redundant_indexes"].push_back({
+                    {"database", a.database}, {"table", a.table}, {"index", a.name}, {"columns", a.columns},
+                    {"covered_by", b.name},
+                    {"reason", b.origin == "c" ? "leading columns of another index"
+                                               : b.origin == "u" ? "duplicates the UNIQUE constraint's index"
+                                                                 : "duplicates the PRIMARY KEY index"}});
+                break;
+            }
+        }
+
+        // Unused: created indexes no registered plan touches and no foreign key needs.
+        // Only meaningful when every query was explained.
+        if (complete && errors == 0) {
+            for (const auto& idx : indexes) {
+                if (idx.origin != "c" || usedIndexes.count(idx.name) || idx.columns.empty()) continue;
+                if (foreignKeyColumns(idx.db, idx.schema, idx.table).count(idx.columns[0]))
+                    continue;
+                bool redundant = false;
+                for (const auto& r : result["redundant_indexes"])
+                    redundant |= r["index"] == idx.name;
+                if (redundant) continue;
+                result["unused_indexes"].push_back({{"database", idx.database}, {"table", idx.table}, {"index", idx.name}, {"columns", idx.columns}});
+            }
+        }
+
+        result["summary"] = {
+            {"queries", result["queries"].size()},
+            {"flagged", flagged},
+            {"suggestions", suggestions},
+            {"errors", errors},
+            {"skipped", skipped},
+            {"redundant_indexes", result["redundant_indexes"].size()},
+            {"unused_indexes", result["unused_indexes"].size()},
+        };
+        return result;
+    }
+
+    size_t report(const json& analysis, std::ostream& out) {
+        size_t lines = 0;
+        for (const auto& q : analysis["queries"]) {
+            std::string name = q["name"].get<std::string>();
+            if (q.contains("error")) {
+                out << "Index advisor: " << name << " does not prepare: " << q["error"].get<std::string>() << '\n';
+                lines++;
+                continue;
+            }
+            if (!q.contains("issues")) continue;
+            for (const auto& issue : q["issues"]) {
+                out << "Index advisor: " << name << ": " << issue["detail"].get<std::string>() << '\n';
+                lines++;
+            }
+            for (const auto& s : q["suggestions"]) {
+                out << "Index advisor: " << name << ": consider " << s.get<std::string>() << '\n';
+                lines++;
+            }
+            for (const auto& n : q.value("notes", json::array())) {
+                out << "Index advisor: " << name << ": " << n.get<std::string>() << '\n';
+                lines++;
+            }
+        }
+        for (const auto& r : analysis["redundant_indexes"]) {
+            out << "Index advisor: " << r["index"].get<std::string>() << " on " << r["table"].get<std::string>()
+                << " is redundant with " << r["covered_by"].get<std::string>() << " ("
+                << r["reason"].get<std::string>() << ")\n";
+            lines++;
+        }
+        out << std::flush;
+        return lines;
+    }
+}
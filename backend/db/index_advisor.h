@@ -0,0 +1,39 @@
+#ifndef INDEX_ADVISOR_H
+#define INDEX_ADVISOR_H
+
+#include <sqlite3.h>
+#include <cstddef>
+#include <ostream>
+#include <nlohmann/json.hpp>
+
+// Checks every statement in the QueryRegistry against the live schema: runs
+// EXPLAIN QUERY PLAN on the connection the statement would use and flags full
+// scans (SCAN) and sorts (USE TEMP B-TREE), with a suggested covering or
+// partial index for each, then audits the schema for indexes that duplicate
+// a prefix of another (e.g. a plain index on a UNIQUE column). Meant to run at
+// startup, right after migrations, so a dropped or mis-ordered index shows up
+// in the log before it shows up as latency.
+namespace IndexAdvisor {
+    struct Options {
+        bool onStartup = true;
+
+        // Reads db_config.json's "advisor" section
+        static Options fromConfig(const nlohmann::json& section);
+    };
+
+    // Connections to EXPLAIN on. user may be the same handle as catalog when the
+    // orders tables are not sharded; archive says whether user has it attached.
+    struct Targets {
+        sqlite3* catalog = nullptr;
+        sqlite3* user = nullptr;
+        bool archive = false;
+    };
+
+    // {"queries":[...],"redundant_indexes":[...],"unused_indexes":[...],"summary":{...}}
+    nlohmann::json analyze(const Targets& targets);
+
+    // One line per finding; returns how many were written
+    size_t report(const nlohmann::json& analysis, std::ostream& out);
+}
+
+#endif // INDEX_ADVISOR_H
@@ -0,0 +1,236 @@
+#include "maintenance.h"
+#include "busy_retry.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <iostream>
+
+using json = nlohmann::json;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    int64_t queryInt(sqlite3* db, const char* sql) {
+        sqlite3_stmt* stmt = nullptr;
+        int64_t value = -1;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+            value = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+        return value;
+    }
+
+    int checkpointMode(const std::string& mode) {
+        if (mode == "TRUNCATE") return SQLITE_CHECKPOINT_TRUNCATE;
+        if (mode == "RESTART") return SQLITE_CHECKPOINT_RESTART;
+        if (mode == "FULL") return SQLITE_CHECKPOINT_FULL;
+        return SQLITE_CHECKPOINT_PASSIVE;
+    }
+
+    int64_t readInt(const json& section, const char* key, int64_t fallback) {
+        if (section.contains(key) && section[key].is_number_integer())
+            return section[key].get<int64_t>();
+        return fallback;
+    }
+}
+
+MaintenanceScheduler::Options MaintenanceScheduler::Options::fromConfig(const json& section) {
+    Options o;
+    if (!section.is_object()) return o;
+    if (section.contains("enabled") && section["enabled"].is_boolean())
+        o.enabled = section["enabled"].get<bool>();
+    o.pollInterval = std::chrono::milliseconds(readInt(section, "poll_interval_ms", o.pollInterval.count()));
+    if (section.contains("checkpoint_mode") && section["checkpoint_mode"].is_string()) {
+        std::string mode = section["checkpoint_mode"].get<std::string>();
+        std::transform(mode.begin(), mode.end(), mode.begin(), [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+        if (mode == "PASSIVE" || mode == "TRUNCATE")
+            o.checkpointMode = mode;
+        else
+            std::cerr << "maintenance.checkpoint_mode: unsupported value '" << mode << "', keeping " << o.checkpointMode << std::endl;
+    }
+    o.walCheckpointBytes = readInt(section, "wal_checkpoint_bytes", o.walCheckpointBytes);
+    o.walTruncateBytes = readInt(section, "wal_truncate_bytes", o.walTruncateBytes);
+    o.optimizeInterval = std::chrono::seconds(readInt(section, "optimize_interval_s", o.optimizeInterval.count()));
+    o.analysisLimit = static_cast<int>(readInt(section, "analysis_limit", o.analysisLimit));
+    o.vacuumInterval = std::chrono::seconds(readInt(section, "vacuum_interval_s", o.vacuumInterval.count()));
+    o.vacuumPages = static_cast<int>(readInt(section, "vacuum_pages", o.vacuumPages));
+    o.vacuumMinFreePages = readInt(section, "vacuum_min_free_pages", o.vacuumMinFreePages);
+    o.slowTask = std::chrono::milliseconds(readInt(section, "slow_task_ms", o.slowTask.count()));
+    return o;
+}
+
+MaintenanceScheduler::MaintenanceScheduler(std::string databasePath, Opener opener, Options options)
+    : databasePath(std::move(databasePath)), opener(std::move(opener)), options(options), db(nullptr),
+      stopping(false), vacuumUnavailable(false) {
+    if (options.enabled)
+        worker = std::thread([this] { loop(); });
+}
+
+MaintenanceScheduler::~MaintenanceScheduler() {
+    stop();
+}
+
+void MaintenanceScheduler::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+void MaintenanceScheduler::loop() {
+    auto nextOptimize = Clock::now() + options.optimizeInterval;
+    auto nextVacuum = Clock::now() + options.vacuumInterval;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (wake.wait_for(lock, options.pollInterval, [this] { return stopping; }))
+                break;
+        }
+        if (!db) {
+            db = opener();
+            if (!db) continue;
+            BusyRetry::install(db, "maintenance");
+        }
+        checkpointIfNeeded();
+        auto now = Clock::now();
+        if (now >= nextOptimize) {
+            optimize();
+            nextOptimize = Clock::now() + options.optimizeInterval;
+        }
+        if (now >= nextVacuum && !vacuumUnavailable) {
+            incrementalVacuum();
+            // Keep stepping on the next poll while the freelist is still above the threshold
+            bool more = queryInt(db, "PRAGMA freelist_count") >= options.vacuumMinFreePages;
+            nextVacuum = Clock::now() + (more ? std::chrono::duration_cast<Clock::duration>(options.pollInterval)
+                                             : std::chrono::duration_cast<Clock::duration>(options.vacuumInterval));
+        }
+    }
+    if (db) {
+        sqlite3_close_v2(db);
+        db = nullptr;
+    }
+}
+
+int64_t MaintenanceScheduler::walSize() const {
+    std::error_code ec;
+    auto size = std::filesystem::file_size(databasePath + "-wal", ec);
+    return ec ? 0 : static_cast<int64_t>(size);
+}
+
+void MaintenanceScheduler::checkpointIfNeeded() {
+    int64_t before = walSize();
+    if (before < options.walCheckpointBytes)
+        return;
+    // A passive checkpoint leaves the file at its high-water mark, so only a
+    // WAL past the truncate threshold is worth truncating
+    std::string mode = before >= options.walTruncateBytes ? "TRUNCATE" : options.checkpointMode;
+    auto start = Clock::now();
+    int logFrames = 0, checkpointed = 0;
+    int rc;
+    bool fellBack = false;
+    if (mode == "TRUNCATE") {
+        // TRUNCATE holds off writers while it waits for readers, so it must not
+        // sit in the busy handler: try once, and if anyone is in the way settle
+        // for a passive pass and try again on a later poll
+        sqlite3_busy_handler(db, nullptr, nullptr);
+        rc = sqlite3_wal_checkpoint_v2(db, nullptr, SQLITE_CHECKPOINT_TRUNCATE, &logFrames, &checkpointed);
+        BusyRetry::install(db, "maintenance");
+        if (BusyRetry::isBusy(rc)) {
+            fellBack = true;
+            rc = sqlite3_wal_checkpoint_v2(db, nullptr, SQLITE_CHECKPOINT_PASSIVE, &logFrames, &checkpointed);
+        }
+    } else {
+        rc = sqlite3_wal_checkpoint_v2(db, nullptr, checkpointMode(mode), &logFrames, &checkpointed);
+    }
+    // Nothing new since the last passive run: the WAL is waiting to be reused from the start
+    if (rc == SQLITE_OK && mode == "PASSIVE" && checkpoints.last.is_object() && logFrames == checkpoints.last.value("wal_frames", -1)
+        && checkpointed == checkpoints.last.value("checkpointed_frames", -1))
+        return;
+    json detail;
+    detail["mode"] = fellBack ? "PASSIVE" : mode;
+    if (fellBack) detail["truncate_busy"] = true;
+    detail["wal_bytes_before"] = before;
+    detail["wal_bytes_after"] = walSize();
+    detail["wal_frames"] = logFrames;
+    detail["checkpointed_frames"] = checkpointed;
+    if (rc != SQLITE_OK)
+        detail["error"] = BusyRetry::isBusy(rc) ? "busy" : sqlite3_errmsg(db);
+    record(checkpoints, "checkpoint", start, rc == SQLITE_OK, detail);
+}
+
+void MaintenanceScheduler::optimize() {
+    auto start = Clock::now();
+    // analysis_limit bounds the rows ANALYZE reads per index; 0x10002 checks every
+    // table rather than only those this (query-less) connection has touched
+    std::string sql = "PRAGMA analysis_limit = " + std::to_string(options.analysisLimit) + "; PRAGMA optimize = 0x10002;";
+    char* errMsg = nullptr;
+    int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg);
+    json detail;
+    detail["analysis_limit"] = options.analysisLimit;
+    if (rc != SQLITE_OK)
+        detail["error"] = errMsg ? errMsg : sqlite3_errstr(rc);
+    if (errMsg) sqlite3_free(errMsg);
+    record(optimizes, "optimize", start, rc == SQLITE_OK, detail);
+}
+
+void MaintenanceScheduler::incrementalVacuum() {
+    if (queryInt(db, "PRAGMA auto_vacuum") != 2) {
+        // auto_vacuum can only be switched on with a full VACUUM, which is not a background job
+        std::cerr << "Maintenance: auto_vacuum is not INCREMENTAL on " << databasePath
+                  << "; run PRAGMA auto_vacuum = INCREMENTAL; VACUUM; offline to enable freelist reclaim" << std::endl;
+        std::lock_guard<std::mutex> lock(mutex);
+        vacuumUnavailable = true;
+        return;
+    }
+    int64_t freeBefore = queryInt(db, "PRAGMA freelist_count");
+    if (freeBefore < options.vacuumMinFreePages)
+        return;
+    auto start = Clock::now();
+    std::string sql = "PRAGMA incremental_vacuum(" + std::to_string(options.vacuumPages) + ")";
+    int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr);
+    json detail;
+    detail["free_pages_before"] = freeBefore;
+    detail["free_pages_after"] = queryInt(db, "PRAGMA freelist_count");
+    if (rc != SQLITE_OK)
+        detail["error"] = BusyRetry::isBusy(rc) ? "busy" : sqlite3_errmsg(db);
+    record(vacuums, "incremental_vacuum", start, rc == SQLITE_OK, detail);
+}
+
+void MaintenanceScheduler::record(TaskStats& task, const char* name, Clock::time_point start, bool ok, json detail) {
+    auto micros = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+    detail["duration_us"] = micros;
+    bool slow = micros >= static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(options.slowTask).count());
+    (slow || !ok ? std::cerr : std::cout) << "Maintenance: " << name << " on " << std::filesystem::path(databasePath).filename().string()
+                                         << (ok ? "" : " failed") << " in "
+                                         << micros / 1000.0 << " ms" << (slow ? " (slow)" : "") << " " << detail.dump() << std::endl;
+    std::lock_guard<std::mutex> lock(mutex);
+    task.runs++;
+    if (!ok) task.failures++;
+    task.totalMicros += micros;
+    task.maxMicros = std::max(task.maxMicros, micros);
+    task.last = std::move(detail);
+}
+
+json MaintenanceScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto task = [](const TaskStats& t) {
+        json j;
+        j["runs"] = t.runs;
+        j["failures"] = t.failures;
+        j["avg_us"] = t.runs ? t.totalMicros / t.runs : 0;
+        j["max_us"] = t.maxMicros;
+        j["last"] = t.last.is_null() ? json::object() : t.last;
+        return j;
+    };
+    json j;
+    j["enabled"] = options.enabled;
+    j["file"] = databasePath;
+    j["wal_bytes"] = walSize();
+    j["checkpoint"] = task(checkpoints);
+    j["optimize"] = task(optimizes);
+    j["incremental_vacuum"] = task(vacuums);
+    j["incremental_vacuum"]["available"] = !vacuumUnavailable;
+    return j;
+}
@@ -0,0 +1,84 @@
+#ifndef MAINTENANCE_H
+#define MAINTENANCE_H
+
+#include <sqlite3.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+// Background thread that keeps the database file in shape: checkpoints the
+// WAL once it passes a size threshold, runs PRAGMA optimize periodically and
+// reclaims freelist pages a few at a time. Every task is timed and logged so
+// a maintenance step that stalls foreground queries shows up in the log.
+class MaintenanceScheduler {
+public:
+    using Opener = std::function<sqlite3*()>;
+
+    struct Options {
+        bool enabled = true;
+        std::chrono::milliseconds pollInterval{1000};
+        // PASSIVE never blocks writers; TRUNCATE also resets the WAL file to zero
+        // bytes but briefly waits for readers and writers to finish
+        std::string checkpointMode = "PASSIVE";
+        int64_t walCheckpointBytes = 16ll * 1024 * 1024;
+        // Escalate to TRUNCATE when the WAL is still this large after a passive checkpoint
+        int64_t walTruncateBytes = 64ll * 1024 * 1024;
+        std::chrono::seconds optimizeInterval{3600};
+        int analysisLimit = 400;
+        std::chrono::seconds vacuumInterval{300};
+        int vacuumPages = 256;        // pages reclaimed per incremental_vacuum step
+        int64_t vacuumMinFreePages = 1024;
+        std::chrono::milliseconds slowTask{50};  // log at warning level above this
+
+        // Reads db_config.json's "maintenance" section
+        static Options fromConfig(const nlohmann::json& section);
+    };
+
+    MaintenanceScheduler(std::string databasePath, Opener opener, Options options);
+    ~MaintenanceScheduler();
+    MaintenanceScheduler(const MaintenanceScheduler&) = delete;
+    MaintenanceScheduler& operator=(const MaintenanceScheduler&) = delete;
+
+    void stop();
+    nlohmann::json stats() const;
+
+private:
+    struct TaskStats {
+        uint64_t runs = 0;
+        uint64_t failures = 0;
+        uint64_t totalMicros = 0;
+        uint64_t maxMicros = 0;
+        nlohmann::json last;
+    };
+
+    void loop();
+    void checkpointIfNeeded();
+    void optimize();
+    void incrementalVacuum();
+    int64_t walSize() const;
+    void record(TaskStats& task, const char* name, std::chrono::steady_clock::time_point start,
+                bool ok, nlohmann::json detail);
+
+    std::string databasePath;
+    Opener opener;
+    Options options;
+    sqlite3* db;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+    std::thread worker;
+
+    // Written by the maintenance thread, read under the mutex
+    TaskStats checkpoints;
+    TaskStats optimizes;
+    TaskStats vacuums;
+    bool vacuumUnavailable;
+};
+
+#endif // MAINTENANCE_H
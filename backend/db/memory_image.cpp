@@ -0,0 +1,226 @@
+#include "memory_image.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    uint64_t micros(Clock::duration d) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    }
+
+    std::string sqlQuote(const std::string& s) {
+        std::string out = "'";
+        for (char c : s) {
+            out += c;
+            if (c == '\'') out += '\'';
+        }
+        return out + "'";
+    }
+
+    int64_t pragmaInt(sqlite3* db, const char* sql) {
+        sqlite3_stmt* stmt = nullptr;
+        int64_t v = -1;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+            v = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+        return v;
+    }
+
+    // Copies every page of src into dest in one step
+    std::string copyDatabase(sqlite3* dest, sqlite3* src) {
+        sqlite3_backup* backup = sqlite3_backup_init(dest, "main", src, "main");
+        if (!backup)
+            return sqlite3_errmsg(dest);
+        int rc = sqlite3_backup_step(backup, -1);
+        sqlite3_backup_finish(backup);
+        return rc == SQLITE_DONE ? "" : sqlite3_errstr(rc);
+    }
+}
+
+MemoryImage::Options MemoryImage::Options::fromConfig(const json& section) {
+    Options o;
+    if (!section.is_object()) return o;
+    if (section.contains("enabled") && section["enabled"].is_boolean())
+        o.enabled = section["enabled"].get<bool>();
+    if (section.contains("persist_interval_s") && section["persist_interval_s"].is_number_integer())
+        o.persistInterval = std::chrono::seconds(std::max<int64_t>(section["persist_interval_s"].get<int64_t>(), 0));
+    if (section.contains("persist_on_shutdown") && section["persist_on_shutdown"].is_boolean())
+        o.persistOnShutdown = section["persist_on_shutdown"].get<bool>();
+    return o;
+}
+
+MemoryImage::MemoryImage(std::string databasePath, Options options)
+    : databasePath(std::move(databasePath)), options(options), anchor(nullptr), persistedVersion(-1),
+      stopping(false), stopped(false), loadBytes(0), loadMicros(0), persists(0), skipped(0), failed(0),
+      last(json::object()) {
+    // A memdb name starting with '/' is shared by every connection in the process
+    memoryUri = "file:/" + fs::path(this->databasePath).filename().string() + "?vfs=memdb";
+}
+
+MemoryImage::~MemoryImage() {
+    stop();
+}
+
+bool MemoryImage::load() {
+    auto started = Clock::now();
+    if (sqlite3_open_v2(memoryUri.c_str(), &anchor,
+                        SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        std::cerr << "In-memory database: could not open " << memoryUri << ": "
+                  << (anchor ? sqlite3_errmsg(anchor) : "out of memory") << std::endl;
+        sqlite3_close(anchor);
+        anchor = nullptr;
+        return false;
+    }
+    sqlite3* disk = nullptr;
+    std::string error;
+    if (sqlite3_open_v2(databasePath.c_str(), &disk,
+                        SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        error = disk ? sqlite3_errmsg(disk) : "out of memory";
+    } else {
+        sqlite3_busy_timeout(disk, 5000);
+        // Not sqlite3_backup: it copies the WAL flag in the file header along with
+        // page 1, and memdb cannot open a WAL-mode image. VACUUM INTO writes a
+        // rollback-journal copy, compacted, from one read transaction.
+        std::string sql = "VACUUM INTO " + sqlQuote(memoryUri);
+        char* err = nullptr;
+        if (sqlite3_exec(disk, sql.c_str(), nullptr, nullptr, &err) != SQLITE_OK) {
+            error = err ? err : "VACUUM INTO failed";
+            sqlite3_free(err);
+        }
+    }
+    sqlite3_close(disk);
+    if (!error.empty()) {
+        std::cerr << "In-memory database: could not load " << databasePath << ": " << error << std::endl;
+        sqlite3_close(anchor);
+        anchor = nullptr;
+        return false;
+    }
+
+    uint64_t bytes = static_cast<uint64_t>(std::max<int64_t>(0, pragmaInt(anchor, "PRAGMA page_count") *
+                                                                pragmaInt(anchor, "PRAGMA page_size")));
+    uint64_t elapsed = micros(Clock::now() - started);
+    persistedVersion = pragmaInt(anchor, "PRAGMA data_version");
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        loadBytes = bytes;
+        loadMicros = elapsed;
+    }
+    std::cout << "Loaded " << databasePath << " into memory (" << bytes / 1024 << " KiB in "
+              << elapsed / 1000 << " ms); writing back every " << options.persistInterval.count() << " s"
+              << (options.persistOnShutdown ? " and on shutdown" : "") << std::endl;
+    worker = std::thread([this] { loop(); });
+    return true;
+}
+
+void MemoryImage::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        if (options.persistInterval.count() > 0)
+            wake.wait_for(lock, options.persistInterval, [this] { return stopping; });
+        else
+            wake.wait(lock, [this] { return stopping; });
+        if (stopping)
+            break;
+        lock.unlock();
+        persist();
+        lock.lock();
+    }
+}
+
+bool MemoryImage::persist() {
+    std::lock_guard<std::mutex> persistLock(persistMutex);
+    if (!anchor)
+        return false;
+    auto started = Clock::now();
+    // data_version moves whenever another connection commits to the image
+    int64_t version = pragmaInt(anchor, "PRAGMA data_version");
+    if (version == persistedVersion) {
+        std::lock_guard<std::mutex> lock(mutex);
+        skipped++;
+        return true;
+    }
+
+    // Snapshot into a private :memory: copy first, so the image is only read-locked
+    // for a RAM-to-RAM copy, not for the disk write and its fsync
+    sqlite3* snapshot = nullptr;
+    sqlite3* disk = nullptr;
+    std::string error;
+    uint64_t snapshotMicros = 0;
+    if (sqlite3_open_v2(":memory:", &snapshot, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        error = "could not open snapshot database";
+    } else {
+        error = copyDatabase(snapshot, anchor);
+        snapshotMicros = micros(Clock::now() - started);
+    }
+    if (error.empty()) {
+        if (sqlite3_open_v2(databasePath.c_str(), &disk, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX,
+                            nullptr) != SQLITE_OK) {
+            error = std::string("could not open ") + databasePath + ": " + (disk ? sqlite3_errmsg(disk) : "out of memory");
+        } else {
+            sqlite3_busy_timeout(disk, 5000);
+            // The backup commits as one transaction, so a crash mid-write leaves the previous image
+            error = copyDatabase(disk, snapshot);
+            if (error.empty())
+                sqlite3_exec(disk, "PRAGMA wal_checkpoint(TRUNCATE);", nullptr, nullptr, nullptr);
+        }
+    }
+    sqlite3_close(disk);
+    sqlite3_close(snapshot);
+
+    uint64_t elapsed = micros(Clock::now() - started);
+    std::lock_guard<std::mutex> lock(mutex);
+    last = json::object();
+    last["state"] = error.empty() ? "completed" : "failed";
+    last["duration_us"] = elapsed;
+    last["snapshot_us"] = snapshotMicros;
+    if (!error.empty()) {
+        failed++;
+        last["error"] = error;
+        std::cerr << "In-memory database: write-back to " << databasePath << " failed: " << error << std::endl;
+        return false;
+    }
+    persists++;
+    persistedVersion = version;
+    return true;
+}
+
+void MemoryImage::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopped)
+            return;
+        stopped = true;
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable())
+        worker.join();
+    if (anchor && options.persistOnShutdown && persist())
+        std::cout << "In-memory database written back to " << databasePath << std::endl;
+    std::lock_guard<std::mutex> persistLock(persistMutex);
+    // Last handle on the memdb: closing it frees the image
+    sqlite3_close(anchor);
+    anchor = nullptr;
+}
+
+json MemoryImage::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    json j;
+    j["enabled"] = true;
+    j["uri"] = memoryUri;
+    j["database_path"] = databasePath;
+    j["loaded_bytes"] = loadBytes;
+    j["load_us"] = loadMicros;
+    j["persist_interval_s"] = options.persistInterval.count();
+    j["persist_on_shutdown"] = options.persistOnShutdown;
+    j["persists"] = persists;
+    j["skipped_unchanged"] = skipped;
+    j["failed"] = failed;
+    j["last"] = last;
+    return j;
+}
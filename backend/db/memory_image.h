@@ -0,0 +1,75 @@
+#ifndef MEMORY_IMAGE_H
+#define MEMORY_IMAGE_H
+
+#include <sqlite3.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <nlohmann/json.hpp>
+
+// Serves the main database from RAM. At startup the disk file is copied into a
+// shared in-process memdb database, which every pooled connection then opens
+// instead of the file, so reads never fault a page in and commits never fsync.
+// The image is written back to the disk file on an interval and on shutdown.
+// A crash loses whatever committed since the last write-back. Shards and the
+// order archive stay on disk.
+class MemoryImage {
+public:
+    struct Options {
+        bool enabled = false;
+        std::chrono::seconds persistInterval{60};  // 0 writes back only on shutdown (and on demand)
+        bool persistOnShutdown = true;
+
+        // Reads db_config.json's "memory" section
+        static Options fromConfig(const nlohmann::json& section);
+    };
+
+    MemoryImage(std::string databasePath, Options options);
+    ~MemoryImage();
+    MemoryImage(const MemoryImage&) = delete;
+    MemoryImage& operator=(const MemoryImage&) = delete;
+
+    // URI connections open instead of the file ("file:/<name>?vfs=memdb")
+    const std::string& uri() const { return memoryUri; }
+
+    // Copies the disk file into memory and starts the write-back thread; false
+    // (with the reason on stderr) if the copy failed
+    bool load();
+    // Writes the image to the disk file now. Skipped when nothing committed since
+    // the last write-back; false on failure.
+    bool persist();
+    nlohmann::json stats() const;
+    // Final write-back (if configured), then releases the image
+    void stop();
+
+private:
+    void loop();
+
+    std::string databasePath;
+    Options options;
+    std::string memoryUri;
+    // Holds the memdb open for the process lifetime and is the write-back source;
+    // only used under persistMutex
+    sqlite3* anchor;
+    std::mutex persistMutex;
+    int64_t persistedVersion;  // anchor's PRAGMA data_version at the last write-back
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+    bool stopped;
+    std::thread worker;
+
+    // Guarded by mutex
+    uint64_t loadBytes;
+    uint64_t loadMicros;
+    uint64_t persists;
+    uint64_t skipped;
+    uint64_t failed;
+    nlohmann::json last;
+};
+
+#endif // MEMORY_IMAGE_H
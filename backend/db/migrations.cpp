@@ -0,0 +1,202 @@
+#include "migrations.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+    const char* kBaselineFile = "schema_sqlite.sql";
+    const char* kMigrationsDir = "migrations";
+
+    uint64_t fnv1a(const std::string& data, uint64_t hash = 1469598103934665603ull) {
+        for (unsigned char c : data) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::string hex(uint64_t v) {
+        std::ostringstream out;
+        out << std::hex << v;
+        return out.str();
+    }
+
+    bool readFile(const fs::path& path, std::string& out) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) return false;
+        std::stringstream buf;
+        buf << in.rdbuf();
+        out = buf.str();
+        return true;
+    }
+
+    bool exec(sqlite3* db, const std::string& sql, const std::string& what) {
+        char* errMsg = nullptr;
+        int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg);
+        if (rc != SQLITE_OK) {
+            std::cerr << "Migration " << what << " failed: " << (errMsg ? errMsg : sqlite3_errstr(rc)) << std::endl;
+        }
+        if (errMsg) sqlite3_free(errMsg);
+        return rc == SQLITE_OK;
+    }
+
+    std::string recordedChecksum(sqlite3* db) {
+        std::string value;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT checksum FROM schema_state WHERE id = 1", -1, &stmt, nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW) {
+            const char* p = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            if (p) value = p;
+        }
+        sqlite3_finalize(stmt);  // table is missing on a database that predates migrations
+        return value;
+    }
+}
+
+std::string MigrationRunner::findDatabaseDir() {
+    const std::vector<std::string> candidates = {
+        "database",
+        "../database",
+        "../../database",
+        "../../../database",
+        "backend/../database",
+    };
+    for (const auto& dir : candidates) {
+        std::error_code ec;
+        if (fs::exists(fs::path(dir) / kBaselineFile, ec))
+            return dir;
+    }
+    return "";
+}
+
+std::vector<Migration> MigrationRunner::load(const std::string& databaseDir) {
+    return load(databaseDir, kBaselineFile, kMigrationsDir);
+}
+
+std::vector<Migration> MigrationRunner::load(const std::string& databaseDir, const std::string& baselineFile,
+                                             const std::string& migrationsDir) {
+    std::vector<Migration> result;
+    std::string sql;
+    if (readFile(fs::path(databaseDir) / baselineFile, sql))
+        result.push_back({1, "baseline", sql, fnv1a(sql)});
+
+    std::error_code ec;
+    fs::path dir = fs::path(databaseDir) / migrationsDir;
+    std::set<int> seen = {1};
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        if (!entry.is_regular_file() || entry.path().extension() != ".sql")
+            continue;
+        // NNNN_description.sql
+        std::string stem = entry.path().stem().string();
+        size_t digits = 0;
+        while (digits < stem.size() && std::isdigit(static_cast<unsigned char>(stem[digits])))
+            digits++;
+        if (digits == 0 || digits >= stem.size() || stem[digits] != '_') {
+            std::cerr << "Skipping migration with unexpected name: " << entry.path() << std::endl;
+            continue;
+        }
+        int version = std::stoi(stem.substr(0, digits));
+        if (!seen.insert(version).second) {
+            std::cerr << "Skipping duplicate migration version " << version << ": " << entry.path() << std::endl;
+            continue;
+        }
+        if (!readFile(entry.path(), sql))
+            continue;
+        result.push_back({version, stem.substr(digits + 1), sql, fnv1a(sql)});
+    }
+    std::sort(result.begin(), result.end(), [](const Migration& a, const Migration& b) { return a.version < b.version; });
+    return result;
+}
+
+MigrationRunner::MigrationRunner(std::vector<Migration> migrations) : migrations(std::move(migrations)), setChecksum(0) {
+    std::string summary;
+    for (const auto& m : this->migrations)
+        summary += std::to_string(m.version) + ":" + hex(m.checksum) + ";";
+    setChecksum = fnv1a(summary);
+}
+
+int MigrationRunner::latestVersion() const {
+    return migrations.empty() ? 0 : migrations.back().version;
+}
+
+bool MigrationRunner::run(sqlite3* db) {
+    if (migrations.empty())
+        return true;
+    std::string expected = hex(setChecksum);
+    if (recordedChecksum(db) == expected) {
+        std::cout << "Schema up to date (version " << latestVersion() << "), skipping migrations" << std::endl;
+        return true;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (!exec(db, "BEGIN IMMEDIATE", "begin"))
+        return false;
+    bool ok = exec(db,
+        "CREATE TABLE IF NOT EXISTS schema_migrations ("
+        "version INTEGER PRIMARY KEY, name TEXT NOT NULL, checksum TEXT NOT NULL, "
+        "applied_at TEXT DEFAULT (datetime('now')));"
+        "CREATE TABLE IF NOT EXISTS schema_state ("
+        "id INTEGER PRIMARY KEY CHECK (id = 1), checksum TEXT NOT NULL, version INTEGER NOT NULL);",
+        "bookkeeping");
+
+    std::set<int> applied;
+    sqlite3_stmt* stmt = nullptr;
+    if (ok && sqlite3_prepare_v2(db, "SELECT version, checksum FROM schema_migrations", -1, &stmt, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            int version = sqlite3_column_int(stmt, 0);
+            applied.insert(version);
+            const char* sum = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+            for (const auto& m : migrations) {
+                if (m.version == version && sum && hex(m.checksum) != sum)
+                    std::cerr << "Warning: migration " << version << " (" << m.name
+                              << ") changed after it was applied; it will not run again" << std::endl;
+            }
+        }
+    }
+    sqlite3_finalize(stmt);
+
+    int count = 0;
+    for (const auto& m : migrations) {
+        if (!ok) break;
+        if (applied.count(m.version)) continue;
+        ok = exec(db, m.sql, std::to_string(m.version) + " (" + m.name + ")");
+        if (!ok) break;
+        stmt = nullptr;
+        ok = sqlite3_prepare_v2(db, "INSERT INTO schema_migrations (version, name, checksum) VALUES (?1, ?2, ?3)",
+                                -1, &stmt, nullptr) == SQLITE_OK;
+        if (ok) {
+            std::string sum = hex(m.checksum);
+            sqlite3_bind_int(stmt, 1, m.version);
+            sqlite3_bind_text(stmt, 2, m.name.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 3, sum.c_str(), -1, SQLITE_TRANSIENT);
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+        }
+        sqlite3_finalize(stmt);
+        count++;
+    }
+    if (ok) {
+        stmt = nullptr;
+        ok = sqlite3_prepare_v2(db, "INSERT OR REPLACE INTO schema_state (id, checksum, version) VALUES (1, ?1, ?2)",
+                                -1, &stmt, nullptr) == SQLITE_OK;
+        if (ok) {
+            sqlite3_bind_text(stmt, 1, expected.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(stmt, 2, latestVersion());
+            ok = sqlite3_step(stmt) == SQLITE_DONE;
+        }
+        sqlite3_finalize(stmt);
+    }
+    if (!ok || !exec(db, "COMMIT", "commit")) {
+        exec(db, "ROLLBACK", "rollback");
+        return false;
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Applied " << count << " migration(s) in " << ms << " ms, schema at version " << latestVersion() << std::endl;
+    return true;
+}
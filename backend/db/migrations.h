@@ -0,0 +1,43 @@
+#ifndef MIGRATIONS_H
+#define MIGRATIONS_H
+
+#include <sqlite3.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Migration {
+    int version;
+    std::string name;
+    std::string sql;
+    uint64_t checksum;
+};
+
+// Versioned schema migrations. Version 1 is the baseline schema_sqlite.sql;
+// later steps live in database/migrations/NNNN_description.sql. Applied
+// versions are recorded in schema_migrations, and the checksum of the whole
+// set in schema_state, so an unchanged schema costs one query at startup.
+class MigrationRunner {
+public:
+    // Finds the database/ directory relative to the working directory (same
+    // candidates as the config lookup). Empty if it cannot be found.
+    static std::string findDatabaseDir();
+    // Loads the baseline plus every migration file from databaseDir
+    static std::vector<Migration> load(const std::string& databaseDir);
+    // Same for a separate migration set, e.g. the per-user shard files
+    static std::vector<Migration> load(const std::string& databaseDir, const std::string& baselineFile,
+                                       const std::string& migrationsDir);
+
+    explicit MigrationRunner(std::vector<Migration> migrations);
+
+    // Applies all pending migrations in one transaction; false (rolled back) on error
+    bool run(sqlite3* db);
+    uint64_t checksum() const { return setChecksum; }
+    int latestVersion() const;
+
+private:
+    std::vector<Migration> migrations;
+    uint64_t setChecksum;
+};
+
+#endif // MIGRATIONS_H
@@ -0,0 +1,320 @@
+#include "order_archiver.h"
+#include <algorithm>
+#include <iostream>
+#include <utility>
+
+using json = nlohmann::json;
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    std::string quoteIdent(const std::string& name) {
+        std::string out = "\"";
+        for (char c : name) {
+            out += c;
+            if (c == '"') out += '"';
+        }
+        return out + "\"";
+    }
+
+    bool exec(sqlite3* db, const std::string& sql) {
+        char* errMsg = nullptr;
+        int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg);
+        if (rc != SQLITE_OK)
+            std::cerr << "Archiver: " << sql << " failed: " << (errMsg ? errMsg : sqlite3_errstr(rc)) << std::endl;
+        if (errMsg) sqlite3_free(errMsg);
+        return rc == SQLITE_OK;
+    }
+
+    std::vector<std::pair<std::string, std::string>> columns(sqlite3* db, const char* schema, const char* table) {
+        std::vector<std::pair<std::string, std::string>> cols;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT name, type FROM pragma_table_info(?1, ?2) ORDER BY cid", -1, &stmt, nullptr) == SQLITE_OK) {
+            sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+            sqlite3_bind_text(stmt, 2, schema, -1, SQLITE_STATIC);
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                const char* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+                const char* type = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+                cols.emplace_back(name ? name : "", type ? type : "");
+            }
+        }
+        sqlite3_finalize(stmt);
+        return cols;
+    }
+
+    // Creates archive.<table> from the live table's columns, or adds the columns
+    // a later migration introduced. Constraints are not copied: the archive only
+    // ever receives rows that already passed them.
+    bool syncTable(sqlite3* db, const char* table) {
+        auto live = columns(db, "main", table);
+        if (live.empty())
+            return false;
+        auto archived = columns(db, "archive", table);
+        if (archived.empty()) {
+            std::string sql = "CREATE TABLE archive." + quoteIdent(table) + " (";
+            for (size_t i = 0; i < live.size(); i++) {
+                if (i) sql += ", ";
+                sql += quoteIdent(live[i].first) + (live[i].first == "id" ? " INTEGER PRIMARY KEY" : " " + live[i].second);
+            }
+            return exec(db, sql + ")");
+        }
+        for (const auto& col : live) {
+            bool present = false;
+            for (const auto& a : archived)
+                present |= a.first == col.first;
+            if (!present && !exec(db, "ALTER TABLE archive." + quoteIdent(table) + " ADD COLUMN " + quoteIdent(col.first) + " " + col.second))
+                return false;
+        }
+        return true;
+    }
+
+    // Rows archived before the switch to integer cents (migration 3) only carry
+    // the old REAL amount. Derive the cents, then drop the REAL column as the
+    // live table did, so this runs once.
+    bool backfillCents(sqlite3* db, const char* table, const char* realColumn, const char* centsColumn) {
+        bool hasReal = false;
+        for (const auto& col : columns(db, "archive", table))
+            hasReal |= col.first == realColumn;
+        if (!hasReal)
+            return true;
+        return exec(db, std::string("UPDATE archive.") + quoteIdent(table) + " SET " + quoteIdent(centsColumn) +
+                        " = CAST(round(" + quoteIdent(realColumn) + " * 100) AS INTEGER) WHERE " +
+                        quoteIdent(centsColumn) + " IS NULL")
+            && exec(db, std::string("ALTER TABLE archive.") + quoteIdent(table) + " DROP COLUMN " + quoteIdent(realColumn));
+    }
+
+    std::string columnList(sqlite3* db, const char* table) {
+        std::string list;
+        for (const auto& col : columns(db, "main", table))
+            list += (list.empty() ? "" : ", ") + quoteIdent(col.first);
+        return list;
+    }
+
+    std::string idsJson(const std::vector<int64_t>& ids) {
+        return json(ids).dump();
+    }
+}
+
+OrderArchiver::Options OrderArchiver::Options::fromConfig(const json& section) {
+    Options o;
+    if (!section.is_object()) return o;
+    if (section.contains("enabled") && section["enabled"].is_boolean())
+        o.enabled = section["enabled"].get<bool>();
+    if (section.contains("hot_days") && section["hot_days"].is_number_integer())
+        o.hotDays = section["hot_days"].get<int>();
+    if (section.contains("interval_minutes") && section["interval_minutes"].is_number_integer())
+        o.interval = std::chrono::minutes(section["interval_minutes"].get<int64_t>());
+    if (section.contains("batch_size") && section["batch_size"].is_number_integer())
+        o.batchSize = std::max(1, section["batch_size"].get<int>());
+    if (section.contains("statuses") && section["statuses"].is_array()) {
+        o.statuses.clear();
+        for (const auto& s : section["statuses"])
+            if (s.is_string()) o.statuses.push_back(s.get<std::string>());
+    }
+    return o;
+}
+
+OrderArchiver::OrderArchiver(Options options, size_t shardCount, WriterLookup writers)
+    : options(std::move(options)), shardCount(shardCount), writers(std::move(writers)),
+      stopping(false), requested(false), running(false),
+      passes(0), ordersMoved(0), itemsMoved(0), lastPassMicros(0) {
+    if (this->options.enabled)
+        worker = std::thread([this] { loop(); });
+}
+
+OrderArchiver::~OrderArchiver() {
+    stop();
+}
+
+void OrderArchiver::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+bool OrderArchiver::prepare() {
+    bool ok = true;
+    for (size_t shard = 0; shard < shardCount; shard++) {
+        WriteQueue* writer = writers(shard);
+        if (!writer) {
+            ok = false;
+            continue;
+        }
+        auto result = writer->submit([](WriteContext& tx) {
+            bool synced = syncTable(tx, "orders") && syncTable(tx, "order_items")
+                && backfillCents(tx, "orders", "total_amount", "total_cents")
+                && backfillCents(tx, "order_items", "price", "price_cents")
+                && exec(tx, "DROP INDEX IF EXISTS archive.idx_archive_orders_user")
+                && exec(tx, "DROP INDEX IF EXISTS archive.idx_archive_orders_status")
+                && exec(tx, "CREATE INDEX IF NOT EXISTS archive.idx_archive_orders_user_created ON orders(user_id, created_at_ms)")
+                && exec(tx, "CREATE INDEX IF NOT EXISTS archive.idx_archive_orders_status_created ON orders(status, created_at_ms)")
+                && exec(tx, "CREATE INDEX IF NOT EXISTS archive.idx_archive_order_items_order ON order_items(order_id)");
+            if (!synced) tx.rollback();
+            return synced;
+        }, "archive.prepare").get();
+        ok &= result && *result;
+    }
+    return ok;
+}
+
+bool OrderArchiver::start() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!options.enabled || stopping || requested || running)
+            return false;
+        requested = true;
+    }
+    wake.notify_one();
+    return true;
+}
+
+void OrderArchiver::loop() {
+    auto next = Clock::now() + options.interval;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        if (!wake.wait_until(lock, next, [this] { return stopping || requested; }))
+            requested = true;  // scheduled pass
+        if (stopping)
+            break;
+        requested = false;
+        running = true;
+        lock.unlock();
+        runPass();
+        lock.lock();
+        running = false;
+        next = Clock::now() + options.interval;
+    }
+}
+
+void OrderArchiver::runPass() {
+    auto start = Clock::now();
+    std::string statuses = json(options.statuses).dump();
+    auto hot = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::hours(24) * options.hotDays);
+    int64_t cutoffMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch() - hot).count();
+    int batchSize = options.batchSize;
+    uint64_t orders = 0, items = 0;
+    std::string error;
+
+    for (size_t shard = 0; shard < shardCount && error.empty(); shard++) {
+        WriteQueue* writer = writers(shard);
+        if (!writer) {
+            error = "database unavailable";
+            break;
+        }
+        for (;;) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopping) break;
+            }
+            // Copy one batch; the live rows stay until the copy has committed
+            auto copied = writer->submit([=](WriteContext& tx) {
+                std::pair<std::vector<int64_t>, int64_t> batch;
+                auto pick = tx.prepare("SELECT id FROM main.orders WHERE status IN (SELECT value FROM json_each(?1)) "
+                                       "AND created_at_ms < ?2 ORDER BY id LIMIT ?3");
+                if (!pick) { tx.rollback(); batch.second = -1; return batch; }
+                sqlite3_bind_text(pick, 1, statuses.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_int64(pick, 2, cutoffMs);
+                sqlite3_bind_int(pick, 3, batchSize);
+                while (sqlite3_step(pick) == SQLITE_ROW)
+                    batch.first.push_back(sqlite3_column_int64(pick, 0));
+                pick.release();
+                if (batch.first.empty())
+                    return batch;
+                std::string ids = idsJson(batch.first);
+                std::string orderCols = columnList(tx, "orders");
+                std::string itemCols = columnList(tx, "order_items");
+                // A copy left by an earlier pass whose delete skipped the order
+                // (its status changed in between) is replaced, not kept stale
+                std::string copyOrders = "INSERT OR REPLACE INTO archive.orders (" + orderCols + ") SELECT " + orderCols +
+                                         " FROM main.orders WHERE id IN (SELECT value FROM json_each(?1))";
+                std::string clearItems = "DELETE FROM archive.order_items WHERE order_id IN (SELECT value FROM json_each(?1))";
+                std::string copyItems = "INSERT INTO archive.order_items (" + itemCols + ") SELECT " + itemCols +
+                                        " FROM main.order_items WHERE order_id IN (SELECT value FROM json_each(?1))";
+                const std::string* steps[] = {&copyOrders, &clearItems, &copyItems};
+                for (const std::string* sql : steps) {
+                    auto stmt = tx.prepare(sql->c_str());
+                    if (!stmt) { tx.rollback(); batch.first.clear(); batch.second = -1; return batch; }
+                    sqlite3_bind_text(stmt, 1, ids.c_str(), -1, SQLITE_TRANSIENT);
+                    if (sqlite3_step(stmt) != SQLITE_DONE) { tx.rollback(); batch.first.clear(); batch.second = -1; return batch; }
+                }
+                return batch;
+            }, "archive.copy").get();
+            if (!copied || copied->second < 0) {
+                error = copied.busy() ? "busy" : "copy failed";
+                break;
+            }
+            const std::vector<int64_t>& ids = copied->first;
+            if (ids.empty())
+                break;
+
+            // Drop the live rows whose archived copy is present and unchanged. An
+            // order whose status moved since the copy keeps its items and stays
+            // hot, and its copy is dropped so it is not listed from both tiers.
+            std::string idList = idsJson(ids);
+            auto removed = writer->submit([idList](WriteContext& tx) {
+                static const char* const steps[] = {
+                    "DELETE FROM main.order_items WHERE order_id IN (SELECT value FROM json_each(?1)) "
+                    "AND EXISTS (SELECT 1 FROM main.orders o JOIN archive.orders a ON a.id = o.id "
+                    "WHERE o.id = order_items.order_id AND a.status = o.status)",
+                    "DELETE FROM main.orders WHERE id IN (SELECT value FROM json_each(?1)) "
+                    "AND EXISTS (SELECT 1 FROM archive.orders a WHERE a.id = orders.id AND a.status = orders.status)",
+                    "DELETE FROM archive.order_items WHERE order_id IN (SELECT value FROM json_each(?1)) "
+                    "AND order_id IN (SELECT id FROM main.orders)",
+                    "DELETE FROM archive.orders WHERE id IN (SELECT value FROM json_each(?1)) "
+                    "AND id IN (SELECT id FROM main.orders)",
+                };
+                int64_t moved[2] = {0, 0};  // items, orders
+                for (size_t i = 0; i < 4; i++) {
+                    auto stmt = tx.prepare(steps[i]);
+                    if (!stmt) { tx.rollback(); return std::make_pair(int64_t(-1), int64_t(-1)); }
+                    sqlite3_bind_text(stmt, 1, idList.c_str(), -1, SQLITE_TRANSIENT);
+                    if (sqlite3_step(stmt) != SQLITE_DONE) { tx.rollback(); return std::make_pair(int64_t(-1), int64_t(-1)); }
+                    if (i < 2)
+                        moved[i] = sqlite3_changes(tx);
+                }
+                return std::make_pair(moved[1], moved[0]);
+            }, "archive.delete").get();
+            if (!removed || removed->first < 0) {
+                error = removed.busy() ? "busy" : "delete failed";
+                break;
+            }
+            orders += static_cast<uint64_t>(removed->first);
+            items += static_cast<uint64_t>(removed->second);
+            if (static_cast<int>(ids.size()) < batchSize)
+                break;
+        }
+    }
+
+    auto micros = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+    if (error.empty())
+        std::cout << "Archiver: moved " << orders << " orders (" << items << " items) older than "
+                  << options.hotDays << " days in " << micros / 1000 << " ms" << std::endl;
+    else
+        std::cerr << "Archiver: pass stopped after " << orders << " orders: " << error << std::endl;
+    std::lock_guard<std::mutex> lock(mutex);
+    passes++;
+    ordersMoved += orders;
+    itemsMoved += items;
+    lastPassMicros = micros;
+    lastError = error;
+}
+
+json OrderArchiver::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    json j;
+    j["enabled"] = options.enabled;
+    j["hot_days"] = options.hotDays;
+    j["statuses"] = options.statuses;
+    j["running"] = running;
+    j["passes"] = passes;
+    j["orders_moved"] = ordersMoved;
+    j["items_moved"] = itemsMoved;
+    j["last_pass_us"] = lastPassMicros;
+    j["last_error"] = lastError;
+    return j;
+}
@@ -0,0 +1,70 @@
+#ifndef ORDER_ARCHIVER_H
+#define ORDER_ARCHIVER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "write_queue.h"
+
+// Moves finished orders (delivered or cancelled by default) older than the hot
+// window, together with their order_items, from each orders file into the
+// "archive" database attached next to it. The archive tables mirror the live
+// columns and pick up new ones automatically. Each batch is copied in one
+// writer job and deleted in a later one, so a crash in between leaves a
+// duplicate that the next run cleans up, never a lost order.
+class OrderArchiver {
+public:
+    struct Options {
+        bool enabled = false;
+        int hotDays = 90;
+        std::chrono::minutes interval{60};
+        int batchSize = 500;
+        std::vector<std::string> statuses = {"delivered", "cancelled"};
+
+        // Reads db_config.json's "archive" section
+        static Options fromConfig(const nlohmann::json& section);
+    };
+
+    using WriterLookup = std::function<WriteQueue*(size_t shard)>;
+
+    OrderArchiver(Options options, size_t shardCount, WriterLookup writers);
+    ~OrderArchiver();
+    OrderArchiver(const OrderArchiver&) = delete;
+    OrderArchiver& operator=(const OrderArchiver&) = delete;
+
+    // Creates or extends the archive tables on every shard; blocks until done
+    bool prepare();
+    // Queues an archival pass; false if one is already queued or running
+    bool start();
+    nlohmann::json stats() const;
+    void stop();
+
+private:
+    void loop();
+    void runPass();
+
+    Options options;
+    size_t shardCount;
+    WriterLookup writers;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+    bool requested;
+    bool running;
+    std::thread worker;
+
+    uint64_t passes;
+    uint64_t ordersMoved;
+    uint64_t itemsMoved;
+    uint64_t lastPassMicros;
+    std::string lastError;
+};
+
+#endif // ORDER_ARCHIVER_H
@@ -0,0 +1,41 @@
+#include "query_registry.h"
+#include <deque>
+#include <mutex>
+
+namespace {
+    struct Registry {
+        std::mutex mutex;
+        std::deque<QueryRegistry::Query> queries;  // deque: add() hands out pointers into it
+    };
+
+    // Function-local so registrations from other translation units' static
+    // initialisers never see it unconstructed
+    Registry& registry() {
+        static Registry r;
+        return r;
+    }
+}
+
+namespace QueryRegistry {
+    const char* add(const char* name, std::string sql, Scope scope) {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.queries.push_back({name, std::move(sql), scope});
+        return r.queries.back().sql.c_str();
+    }
+
+    std::vector<Query> all() {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        return {r.queries.begin(), r.queries.end()};
+    }
+
+    const char* scopeName(Scope scope) {
+        switch (scope) {
+            case Scope::Catalog: return "catalog";
+            case Scope::User: return "user";
+            case Scope::Archive: return "archive";
+        }
+        return "unknown";
+    }
+}
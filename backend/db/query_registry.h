@@ -0,0 +1,37 @@
+#ifndef QUERY_REGISTRY_H
+#define QUERY_REGISTRY_H
+
+#include <string>
+#include <vector>
+
+// Every statement a route runs, registered once at static-initialisation time
+// so the index advisor can EXPLAIN the whole set at startup instead of waiting
+// for a bad plan to show up in the slow log. Register at namespace scope and
+// prepare through the returned pointer:
+//
+//   const char* const kByIdSql = QueryRegistry::add("users.by-id",
+//       "SELECT ... FROM users WHERE id = ?1", QueryRegistry::Scope::Catalog);
+namespace QueryRegistry {
+    // Which connection a statement runs on, and therefore where to EXPLAIN it
+    enum class Scope {
+        Catalog,  // main database: products, categories, users
+        User,     // a user shard: cart_items, orders, order_items (catalog attached)
+        Archive,  // a user shard with the order archive attached
+    };
+
+    struct Query {
+        std::string name;
+        std::string sql;
+        Scope scope;
+    };
+
+    // Returns the registered copy of sql; the pointer stays valid for the life of the process
+    const char* add(const char* name, std::string sql, Scope scope);
+
+    // Snapshot in registration order
+    std::vector<Query> all();
+
+    const char* scopeName(Scope scope);
+}
+
+#endif // QUERY_REGISTRY_H
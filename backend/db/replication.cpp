@@ -0,0 +1,776 @@
+#include "replication.h"
+#include "busy_retry.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+namespace {
+    int64_t nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    uint64_t micros(Clock::duration d) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    }
+
+    int64_t readInt(const json& section, const char* key, int64_t fallback) {
+        if (section.contains(key) && section[key].is_number_integer())
+            return section[key].get<int64_t>();
+        return fallback;
+    }
+
+    std::string quoteIdent(const std::string& name) {
+        std::string out = "\"";
+        for (char c : name) {
+            out += c;
+            if (c == '"') out += '"';
+        }
+        return out + "\"";
+    }
+
+    // Zero-padded so directory listings sort in sequence order
+    std::string fileName(const char* prefix, uint64_t seq, const char* suffix) {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "%s%020llu%s", prefix, static_cast<unsigned long long>(seq), suffix);
+        return buf;
+    }
+
+    bool parseSequence(const std::string& name, const std::string& prefix, const std::string& suffix, uint64_t& seq) {
+        if (name.size() != prefix.size() + 20 + suffix.size() || name.compare(0, prefix.size(), prefix) != 0 ||
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0)
+            return false;
+        seq = std::strtoull(name.c_str() + prefix.size(), nullptr, 10);
+        return true;
+    }
+
+    std::vector<uint64_t> listSequences(const std::string& dir, const char* prefix, const char* suffix) {
+        std::vector<uint64_t> found;
+        std::error_code ec;
+        for (const auto& entry : fs::directory_iterator(dir, ec)) {
+            uint64_t seq;
+            if (entry.is_regular_file(ec) && parseSequence(entry.path().filename().string(), prefix, suffix, seq))
+                found.push_back(seq);
+        }
+        std::sort(found.begin(), found.end());
+        return found;
+    }
+
+    // Readers only ever see complete files: write beside the target, then rename over it
+    bool writeFile(const std::string& path, const std::string& content) {
+        std::string partial = path + ".part";
+        {
+            std::ofstream out(partial, std::ios::binary | std::ios::trunc);
+            out << content;
+            if (!out.flush())
+                return false;
+        }
+        std::error_code ec;
+        fs::rename(partial, path, ec);
+        return !ec;
+    }
+
+    std::string schemaChecksum(sqlite3* db) {
+        std::string checksum;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT checksum FROM schema_state WHERE id = 1", -1, &stmt, nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0))
+            checksum = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+        sqlite3_finalize(stmt);
+        return checksum;
+    }
+
+    json columnValue(sqlite3_stmt* stmt, int i) {
+        switch (sqlite3_column_type(stmt, i)) {
+            case SQLITE_INTEGER: return sqlite3_column_int64(stmt, i);
+            case SQLITE_FLOAT: return sqlite3_column_double(stmt, i);
+            case SQLITE_TEXT: return reinterpret_cast<const char*>(sqlite3_column_text(stmt, i));
+            case SQLITE_BLOB: {
+                static const char digits[] = "0123456789abcdef";
+                const auto* p = static_cast<const unsigned char*>(sqlite3_column_blob(stmt, i));
+                std::string hex;
+                for (int n = sqlite3_column_bytes(stmt, i), k = 0; k < n; k++) {
+                    hex += digits[p[k] >> 4];
+                    hex += digits[p[k] & 15];
+                }
+                return {{"blob", hex}};
+            }
+            default: return nullptr;
+        }
+    }
+
+    void bindValue(sqlite3_stmt* stmt, int i, const json& v) {
+        if (v.is_number_integer()) {
+            sqlite3_bind_int64(stmt, i, v.get<int64_t>());
+        } else if (v.is_number_float()) {
+            sqlite3_bind_double(stmt, i, v.get<double>());
+        } else if (v.is_string()) {
+            const std::string& s = v.get_ref<const std::string&>();
+            sqlite3_bind_text(stmt, i, s.data(), static_cast<int>(s.size()), SQLITE_TRANSIENT);
+        } else if (v.is_boolean()) {
+            sqlite3_bind_int(stmt, i, v.get<bool>() ? 1 : 0);
+        } else if (v.is_object() && v.contains("blob") && v["blob"].is_string()) {
+            const std::string& hex = v["blob"].get_ref<const std::string&>();
+            std::string bytes;
+            for (size_t k = 0; k + 1 < hex.size(); k += 2)
+                bytes += static_cast<char>(std::stoi(hex.substr(k, 2), nullptr, 16));
+            sqlite3_bind_blob(stmt, i, bytes.data(), static_cast<int>(bytes.size()), SQLITE_TRANSIENT);
+        } else {
+            sqlite3_bind_null(stmt, i);
+        }
+    }
+}
+
+namespace Replication {
+
+Options Options::fromConfig(const json& section) {
+    Options o;
+    if (!section.is_object()) return o;
+    if (section.contains("publish") && section["publish"].is_boolean())
+        o.publish = section["publish"].get<bool>();
+    if (section.contains("directory") && section["directory"].is_string())
+        o.directory = section["directory"].get<std::string>();
+    if (section.contains("replica_path") && section["replica_path"].is_string())
+        o.replicaPath = section["replica_path"].get<std::string>();
+    o.publishInterval = std::chrono::milliseconds(std::max<int64_t>(readInt(section, "publish_interval_ms", o.publishInterval.count()), 10));
+    o.snapshotInterval = std::chrono::minutes(readInt(section, "snapshot_interval_minutes", o.snapshotInterval.count()));
+    o.keepSnapshots = static_cast<size_t>(std::max<int64_t>(readInt(section, "keep_snapshots", static_cast<int64_t>(o.keepSnapshots)), 1));
+    o.pollInterval = std::chrono::milliseconds(std::max<int64_t>(readInt(section, "poll_interval_ms", o.pollInterval.count()), 10));
+    return o;
+}
+
+std::string Options::directoryFor(const std::string& databasePath) const {
+    fs::path dir(directory);
+    if (dir.is_relative())
+        dir = fs::path(databasePath).parent_path() / dir;
+    return dir.string();
+}
+
+std::string Options::replicaPathFor(const std::string& databasePath) const {
+    fs::path p(databasePath);
+    if (replicaPath.empty())
+        return (p.parent_path() / (p.stem().string() + "-replica" + p.extension().string())).string();
+    fs::path replica(replicaPath);
+    return (replica.is_relative() ? p.parent_path() / replica : replica).string();
+}
+
+Publisher::Publisher(std::string directory, Options options, ChangeFeed& feed, Reader reader)
+    : directory(std::move(directory)), options(options), feed(feed), reader(std::move(reader)),
+      stopping(false), snapshotRequested(true), sequence(0), snapshotSequence(0), lastSnapshot(Clock::now()),
+      segments(0), rowsShipped(0), snapshots(0), failures(0) {
+    std::error_code ec;
+    fs::create_directories(this->directory, ec);
+    // Carry on from an earlier run's numbering, so replicas never see a sequence go backwards
+    for (uint64_t seq : listSequences(this->directory, "segment-", ".jsonl"))
+        sequence = std::max(sequence, seq);
+    for (uint64_t seq : listSequences(this->directory, "snapshot-", ".db"))
+        sequence = std::max(sequence, seq);
+    subscription = feed.subscribe("replication", [this](const ChangeBatch& batch) { collect(batch); });
+    worker = std::thread([this] { loop(); });
+    std::cout << "Publishing replication segments to " << this->directory << " every "
+              << options.publishInterval.count() << " ms" << std::endl;
+}
+
+Publisher::~Publisher() {
+    stop();
+}
+
+void Publisher::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping)
+            return;
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable())
+        worker.join();
+    feed.unsubscribe(subscription);
+}
+
+void Publisher::collect(const ChangeBatch& batch) {
+    // Shard writers commit to other files
+    if (batch.source.compare(0, 6, "shard-") == 0)
+        return;
+    std::lock_guard<std::mutex> lock(mutex);
+    if (batch.gap || !batch.overflow.empty()) {
+        // Some keys are unknown; only a full copy is sure to carry them
+        snapshotRequested = true;
+        return;
+    }
+    for (const RowChange& c : batch.changes) {
+        if (c.database != "main")
+            continue;
+        if (pending.rows[c.table].insert(c.rowid).second)
+            pending.count++;
+    }
+    if (pending.count > 0) {
+        if (pending.oldestCommitMs == 0)
+            pending.oldestCommitMs = batch.committedAtMs;
+        pending.newestCommitMs = batch.committedAtMs;
+    }
+}
+
+void Publisher::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        bool last = stopping;
+        bool snapshot = !last && (snapshotRequested ||
+            (options.snapshotInterval.count() > 0 && Clock::now() - lastSnapshot >= options.snapshotInterval));
+        Pending batch;
+        if (snapshot) {
+            // The snapshot starts after these rows committed, so it carries them
+            snapshotRequested = false;
+            pending = Pending();
+        } else {
+            std::swap(batch, pending);
+        }
+        lock.unlock();
+        bool ok = snapshot ? writeSnapshot() : (batch.count == 0 || writeSegment(batch));
+        lock.lock();
+        if (!ok)
+            snapshotRequested = true;
+        int64_t oldestPending = pending.count > 0 ? pending.oldestCommitMs : 0;
+        lock.unlock();
+        writeHead(oldestPending);
+        lock.lock();
+        if (last)
+            break;
+        wake.wait_for(lock, options.publishInterval, [this] { return stopping; });
+    }
+}
+
+bool Publisher::writeSegment(const Pending& batch) {
+    auto start = Clock::now();
+    auto conn = reader();
+    if (!conn.get()) {
+        fail("no read connection for segment");
+        return false;
+    }
+    // One read transaction, so the segment is a consistent cut
+    if (sqlite3_exec(conn, "BEGIN", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        fail(std::string("segment read: ") + sqlite3_errmsg(conn));
+        return false;
+    }
+    std::string checksum = schemaChecksum(conn);
+    uint64_t seq;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        seq = sequence + 1;
+        // Replicas on the old schema cannot apply this; give them a copy to restore
+        if (!schema.empty() && checksum != schema)
+            snapshotRequested = true;
+    }
+    json header;
+    header["sequence"] = seq;
+    header["schema"] = checksum;
+    header["rows"] = batch.count;
+    header["oldest_commit_ms"] = batch.oldestCommitMs;
+    header["newest_commit_ms"] = batch.newestCommitMs;
+    header["written_at_ms"] = nowMs();
+    std::string body = header.dump() + "\n";
+    for (const auto& entry : batch.rows) {
+        const std::string& table = entry.first;
+        std::string sql = "SELECT rowid, * FROM " + quoteIdent(table) + " WHERE rowid = ?1";
+        auto stmt = conn.prepare(sql.c_str());
+        if (!stmt.get())
+            continue;  // dropped since; the schema change brings a snapshot anyway
+        int columns = sqlite3_column_count(stmt);
+        for (int64_t rowid : entry.second) {
+            json row;
+            row["t"] = table;
+            row["r"] = rowid;
+            sqlite3_bind_int64(stmt, 1, rowid);
+            if (sqlite3_step(stmt) == SQLITE_ROW) {
+                json values = json::object();
+                for (int i = 1; i < columns; i++)
+                    values[sqlite3_column_name(stmt, i)] = columnValue(stmt, i);
+                row["v"] = std::move(values);
+            } else {
+                row["deleted"] = true;
+            }
+            sqlite3_reset(stmt);
+            body += row.dump();
+            body += '\n';
+        }
+    }
+    sqlite3_exec(conn, "COMMIT", nullptr, nullptr, nullptr);
+    conn.release();
+
+    if (!writeFile((fs::path(directory) / fileName("segment-", seq, ".jsonl")).string(), body)) {
+        fail("could not write segment " + std::to_string(seq));
+        return false;
+    }
+    segmentLatency.record(micros(Clock::now() - start));
+    std::lock_guard<std::mutex> lock(mutex);
+    sequence = seq;
+    schema = checksum;
+    segments++;
+    rowsShipped += batch.count;
+    return true;
+}
+
+bool Publisher::writeSnapshot() {
+    auto conn = reader();
+    if (!conn.get()) {
+        fail("no read connection for snapshot");
+        return false;
+    }
+    // A sequence of its own: a replica that applied every segment so far then
+    // finds no segment for it and restores the copy, which may carry rows no
+    // segment did (a dropped change batch)
+    uint64_t seq;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        seq = sequence + 1;
+    }
+    std::string target = (fs::path(directory) / fileName("snapshot-", seq, ".db")).string();
+    std::string partial = target + ".part";
+    std::error_code ec;
+    fs::remove(partial, ec);
+    sqlite3* dest = nullptr;
+    int rc = sqlite3_open(partial.c_str(), &dest);
+    std::string checksum;
+    if (rc == SQLITE_OK) {
+        sqlite3_backup* backup = sqlite3_backup_init(dest, "main", conn, "main");
+        if (backup) {
+            // Copies in one step: the read transaction only blocks checkpoints, not writers
+            do {
+                rc = sqlite3_backup_step(backup, -1);
+                if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
+            sqlite3_backup_finish(backup);
+        } else {
+            rc = sqlite3_errcode(dest);
+        }
+        if (rc == SQLITE_DONE) {
+            // The copy inherits WAL mode; without it, replicas reading the file leave no -wal / -shm behind
+            sqlite3_exec(dest, "PRAGMA journal_mode = DELETE;", nullptr, nullptr, nullptr);
+            checksum = schemaChecksum(dest);
+        }
+    }
+    std::string error = rc == SQLITE_DONE ? "" : (dest ? sqlite3_errmsg(dest) : "out of memory");
+    sqlite3_close(dest);
+    conn.release();
+    if (!error.empty()) {
+        fs::remove(partial, ec);
+        fail("snapshot " + std::to_string(seq) + ": " + error);
+        return false;
+    }
+    fs::rename(partial, target, ec);
+    if (ec) {
+        fail("snapshot " + std::to_string(seq) + ": " + ec.message());
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sequence = seq;
+        snapshotSequence = seq;
+        schema = checksum;
+        lastSnapshot = Clock::now();
+        snapshots++;
+    }
+    prune();
+    return true;
+}
+
+void Publisher::writeHead(int64_t oldestPendingMs) {
+    json head;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        head["sequence"] = sequence;
+        head["snapshot"] = snapshotSequence;
+        head["schema"] = schema;
+    }
+    head["written_at_ms"] = nowMs();
+    head["oldest_pending_ms"] = oldestPendingMs;
+    if (!writeFile((fs::path(directory) / "head.json").string(), head.dump()))
+        fail("could not write head.json");
+}
+
+void Publisher::prune() {
+    std::vector<uint64_t> kept = listSequences(directory, "snapshot-", ".db");
+    std::error_code ec;
+    while (kept.size() > options.keepSnapshots) {
+        fs::remove(fs::path(directory) / fileName("snapshot-", kept.front(), ".db"), ec);
+        kept.erase(kept.begin());
+    }
+    if (kept.empty())
+        return;
+    // A replica older than the oldest kept snapshot restores the newest one instead
+    for (uint64_t seq : listSequences(directory, "segment-", ".jsonl")) {
+        if (seq > kept.front())
+            break;
+        fs::remove(fs::path(directory) / fileName("segment-", seq, ".jsonl"), ec);
+    }
+}
+
+void Publisher::fail(const std::string& what) {
+    std::lock_guard<std::mutex> lock(mutex);
+    failures++;
+    if (what != lastError)
+        std::cerr << "Replication: " << what << std::endl;
+    lastError = what;
+}
+
+json Publisher::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    json j;
+    j["role"] = "primary";
+    j["directory"] = directory;
+    j["sequence"] = sequence;
+    j["snapshot_sequence"] = snapshotSequence;
+    j["schema"] = schema;
+    j["segments"] = segments;
+    j["rows_shipped"] = rowsShipped;
+    j["snapshots"] = snapshots;
+    j["pending_rows"] = pending.count;
+    j["pending_age_ms"] = pending.count > 0 ? std::max<int64_t>(nowMs() - pending.oldestCommitMs, 0) : 0;
+    j["failures"] = failures;
+    j["last_error"] = lastError;
+    j["publish_interval_ms"] = options.publishInterval.count();
+    j["segment_write"] = segmentLatency.toJson();
+    return j;
+}
+
+Applier::Applier(std::string directory, Options options, Opener opener)
+    : directory(std::move(directory)), options(options), opener(std::move(opener)), db(nullptr), stopping(false),
+      applied(0), restoredSnapshot(0), oldestUnappliedMs(0), lastSegmentDelayMs(0),
+      segments(0), rowsApplied(0), restores(0), failures(0) {}
+
+Applier::~Applier() {
+    stop();
+}
+
+bool Applier::bootstrap() {
+    poll();
+    return readState();
+}
+
+void Applier::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!worker.joinable() && !stopping)
+        worker = std::thread([this] { loop(); });
+}
+
+void Applier::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable())
+        worker.join();
+    statements.reset();
+    if (db) {
+        sqlite3_close_v2(db);
+        db = nullptr;
+    }
+}
+
+void Applier::loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        lock.unlock();
+        poll();
+        lock.lock();
+        wake.wait_for(lock, options.pollInterval, [this] { return stopping; });
+    }
+}
+
+bool Applier::open() {
+    if (db)
+        return true;
+    db = opener();
+    if (!db) {
+        fail("could not open the replica database");
+        return false;
+    }
+    statements = std::make_unique<StatementCache>(db, 64);
+    // Rows arrive table by table, and the primary has already checked them
+    sqlite3_exec(db, "PRAGMA foreign_keys = OFF;", nullptr, nullptr, nullptr);
+    // Segments carry every row's final state, including rows the primary's
+    // triggers wrote; firing them again here would rewrite those rows
+    sqlite3_db_config(db, SQLITE_DBCONFIG_ENABLE_TRIGGER, 0, nullptr);
+    return true;
+}
+
+bool Applier::readState() {
+    if (!db)
+        return false;
+    bool found = false;
+    uint64_t seq = 0, snapshot = 0;
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(db, "SELECT sequence, snapshot FROM replication_state WHERE id = 1", -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        found = true;
+        seq = static_cast<uint64_t>(sqlite3_column_int64(stmt, 0));
+        snapshot = static_cast<uint64_t>(sqlite3_column_int64(stmt, 1));
+    }
+    sqlite3_finalize(stmt);
+    std::string checksum = schemaChecksum(db);
+    std::lock_guard<std::mutex> lock(mutex);
+    applied = seq;
+    restoredSnapshot = snapshot;
+    schema = checksum;
+    return found;
+}
+
+bool Applier::readHead(Head& out) const {
+    std::ifstream in((fs::path(directory) / "head.json").string());
+    if (!in)
+        return false;
+    json h = json::parse(in, nullptr, false);
+    if (h.is_discarded() || !h.is_object())
+        return false;
+    out.sequence = h.value("sequence", uint64_t(0));
+    out.schema = h.value("schema", std::string());
+    out.writtenAtMs = h.value("written_at_ms", int64_t(0));
+    out.oldestPendingMs = h.value("oldest_pending_ms", int64_t(0));
+    return true;
+}
+
+bool Applier::restore() {
+    std::vector<uint64_t> available = listSequences(directory, "snapshot-", ".db");
+    if (available.empty()) {
+        fail("waiting for the primary's first snapshot in " + directory);
+        return false;
+    }
+    uint64_t seq = available.back();
+    bool haveState = readState();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        // Already on it: restoring the same copy again cannot help
+        if (haveState && seq == restoredSnapshot)
+            return false;
+    }
+    std::string path = (fs::path(directory) / fileName("snapshot-", seq, ".db")).string();
+    sqlite3* source = nullptr;
+    if (sqlite3_open_v2(path.c_str(), &source, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+        fail("cannot open " + path + ": " + (source ? sqlite3_errmsg(source) : "out of memory"));
+        sqlite3_close(source);
+        return false;
+    }
+    statements->clear();
+    int rc = SQLITE_ERROR;
+    sqlite3_backup* backup = sqlite3_backup_init(db, "main", source, "main");
+    if (backup) {
+        do {
+            rc = sqlite3_backup_step(backup, -1);
+            if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
+        sqlite3_backup_finish(backup);
+    }
+    sqlite3_close(source);
+    if (rc != SQLITE_DONE) {
+        fail("restoring " + path + ": " + sqlite3_errmsg(db));
+        return false;
+    }
+    bool recorded = sqlite3_exec(db,
+        "CREATE TABLE IF NOT EXISTS replication_state (id INTEGER PRIMARY KEY CHECK (id = 1), "
+        "sequence INTEGER NOT NULL, snapshot INTEGER NOT NULL, applied_at_ms INTEGER NOT NULL)",
+        nullptr, nullptr, nullptr) == SQLITE_OK;
+    if (recorded) {
+        auto stmt = statements->prepare("INSERT OR REPLACE INTO replication_state (id, sequence, snapshot, applied_at_ms) "
+                                        "VALUES (1, ?1, ?1, ?2)");
+        recorded = stmt.get() != nullptr;
+        if (recorded) {
+            sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(seq));
+            sqlite3_bind_int64(stmt, 2, nowMs());
+            recorded = sqlite3_step(stmt) == SQLITE_DONE;
+        }
+    }
+    if (!recorded) {
+        fail(std::string("recording the restored snapshot: ") + sqlite3_errmsg(db));
+        return false;
+    }
+    readState();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        restores++;
+    }
+    std::cout << "Replica restored from snapshot " << seq << std::endl;
+    return true;
+}
+
+int Applier::applySegment(uint64_t seq) {
+    std::ifstream in((fs::path(directory) / fileName("segment-", seq, ".jsonl")).string(), std::ios::binary);
+    if (!in)
+        return 0;
+    auto start = Clock::now();
+    std::string line;
+    json header = std::getline(in, line) ? json::parse(line, nullptr, false) : json();
+    if (!header.is_object() || header.value("sequence", uint64_t(0)) != seq) {
+        fail("segment " + std::to_string(seq) + " has a bad header");
+        return -1;
+    }
+    std::string segmentSchema = header.value("schema", std::string());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!segmentSchema.empty() && segmentSchema != schema)
+            return -2;
+    }
+    if (BusyRetry::retry("replica.begin", [this] { return sqlite3_exec(db, "BEGIN IMMEDIATE", nullptr, nullptr, nullptr); }) != SQLITE_OK) {
+        fail(std::string("segment ") + std::to_string(seq) + ": " + sqlite3_errmsg(db));
+        return -1;
+    }
+    uint64_t rows = 0;
+    std::string error;
+    while (error.empty() && std::getline(in, line)) {
+        if (line.empty())
+            continue;
+        json row = json::parse(line, nullptr, false);
+        if (!row.is_object() || !row.contains("t") || !row["t"].is_string() || !row.contains("r")) {
+            error = "malformed row";
+            break;
+        }
+        std::string table = quoteIdent(row["t"].get<std::string>());
+        std::string sql;
+        const json* values = nullptr;
+        if (row.value("deleted", false)) {
+            sql = "DELETE FROM " + table + " WHERE rowid = ?1";
+        } else if (row.contains("v") && row["v"].is_object()) {
+            values = &row["v"];
+            std::string names = "rowid", params = "?1";
+            int n = 1;
+            for (auto it = values->begin(); it != values->end(); ++it) {
+                names += ", " + quoteIdent(it.key());
+                params += ", ?" + std::to_string(++n);
+            }
+            sql = "INSERT OR REPLACE INTO " + table + " (" + names + ") VALUES (" + params + ")";
+        } else {
+            error = "malformed row";
+            break;
+        }
+        auto stmt = statements->prepare(sql.c_str());
+        if (!stmt.get()) {
+            error = sqlite3_errmsg(db);
+            break;
+        }
+        sqlite3_bind_int64(stmt, 1, row["r"].get<int64_t>());
+        if (values) {
+            int n = 1;
+            for (auto it = values->begin(); it != values->end(); ++it)
+                bindValue(stmt, ++n, *it);
+        }
+        if (sqlite3_step(stmt) != SQLITE_DONE)
+            error = sqlite3_errmsg(db);
+        rows++;
+    }
+    if (error.empty()) {
+        auto record = statements->prepare("UPDATE replication_state SET sequence = ?1, applied_at_ms = ?2 WHERE id = 1");
+        bool recorded = record.get() != nullptr;
+        if (recorded) {
+            sqlite3_bind_int64(record, 1, static_cast<sqlite3_int64>(seq));
+            sqlite3_bind_int64(record, 2, nowMs());
+            recorded = sqlite3_step(record) == SQLITE_DONE;
+            record.release();
+        }
+        if (!recorded ||
+            BusyRetry::retry("replica.commit", [this] { return sqlite3_exec(db, "COMMIT", nullptr, nullptr, nullptr); }) != SQLITE_OK)
+            error = sqlite3_errmsg(db);
+    }
+    if (!error.empty()) {
+        sqlite3_exec(db, "ROLLBACK", nullptr, nullptr, nullptr);
+        fail("segment " + std::to_string(seq) + ": " + error);
+        return -1;
+    }
+    applyLatency.record(micros(Clock::now() - start));
+    std::lock_guard<std::mutex> lock(mutex);
+    applied = seq;
+    segments++;
+    rowsApplied += rows;
+    lastSegmentDelayMs = std::max<int64_t>(nowMs() - header.value("oldest_commit_ms", nowMs()), 0);
+    return 1;
+}
+
+void Applier::poll() {
+    if (!open())
+        return;
+    Head h;
+    bool haveHead = readHead(h);
+    bool restoreNeeded = !readState();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (haveHead)
+            head = h;
+        // The primary's directory was reset, or it came back with a new schema
+        if (!restoreNeeded && haveHead)
+            restoreNeeded = h.sequence < applied || (!h.schema.empty() && h.schema != schema);
+    }
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (restoreNeeded && !restore() && attempt > 0)
+            break;
+        restoreNeeded = false;
+        int rc;
+        uint64_t next;
+        do {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                next = applied + 1;
+            }
+            rc = applySegment(next);
+        } while (rc == 1);
+        // Missing while the primary is past it: pruned, so catch up from a snapshot
+        bool pruned = rc == 0 && haveHead && h.sequence >= next;
+        if (rc == -2 || pruned)
+            restoreNeeded = true;
+        else
+            break;
+    }
+
+    int64_t oldest = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (haveHead && h.sequence > applied)
+            oldest = h.writtenAtMs;  // segments we could not apply; at least this old
+        if (haveHead && h.oldestPendingMs > 0 && (oldest == 0 || h.oldestPendingMs < oldest))
+            oldest = h.oldestPendingMs;
+        oldestUnappliedMs = oldest;
+        if (oldest == 0 && lastError.rfind("waiting", 0) != 0)
+            lastError.clear();
+    }
+}
+
+void Applier::fail(const std::string& what) {
+    std::lock_guard<std::mutex> lock(mutex);
+    failures++;
+    if (what != lastError)
+        std::cerr << "Replica: " << what << std::endl;
+    lastError = what;
+}
+
+json Applier::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    int64_t now = nowMs();
+    json j;
+    j["role"] = "replica";
+    j["directory"] = directory;
+    j["applied_sequence"] = applied;
+    j["head_sequence"] = head.sequence;
+    j["segments_behind"] = head.sequence > applied ? head.sequence - applied : 0;
+    j["lag_ms"] = oldestUnappliedMs > 0 ? std::max<int64_t>(now - oldestUnappliedMs, 0) : 0;
+    j["last_segment_delay_ms"] = lastSegmentDelayMs;
+    j["heartbeat_age_ms"] = head.writtenAtMs > 0 ? json(std::max<int64_t>(now - head.writtenAtMs, 0)) : json(nullptr);
+    j["restored_snapshot"] = restoredSnapshot;
+    j["schema"] = schema;
+    j["segments_applied"] = segments;
+    j["rows_applied"] = rowsApplied;
+    j["restores"] = restores;
+    j["failures"] = failures;
+    j["last_error"] = lastError;
+    j["poll_interval_ms"] = options.pollInterval.count();
+    j["apply"] = applyLatency.toJson();
+    return j;
+}
+
+}  // namespace Replication
@@ -0,0 +1,177 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <sqlite3.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <nlohmann/json.hpp>
+#include "../utils/latency_histogram.h"
+#include "change_feed.h"
+#include "connection_pool.h"
+#include "statement_cache.h"
+
+// Read replicas of the main database through a shared directory. The primary
+// (Publisher) follows the change feed and, every publish interval, writes the
+// current state of every row that committed since the last segment to
+// segment-<seq>.jsonl: one header line, then one line per row with its
+// columns, or a delete marker. It also writes a full copy, snapshot-<seq>.db,
+// at startup, on a schedule and whenever the feed lost changes. A snapshot
+// takes the next sequence and covers every segment before it, so a replica
+// finds no segment with its number and restores it. head.json is rewritten
+// every interval as a heartbeat.
+//
+// A replica process (Applier) restores the newest snapshot into its own copy
+// of the database, then applies segments in order, one transaction each,
+// recording the applied sequence in a replication_state table in the same
+// transaction. It restores a snapshot again when it finds it has fallen
+// behind pruning or the primary's schema changed. Segments carry row state
+// rather than statements, so replaying one twice is harmless.
+//
+// Only the main database file is replicated: shard files and the order
+// archive are not, and neither are writes made by other processes (e.g.
+// lala_import) until the next snapshot.
+namespace Replication {
+    struct Options {
+        bool publish = false;                       // primary: write segments and snapshots
+        std::string directory = "replication";      // relative to the main database file's directory
+        std::chrono::milliseconds publishInterval{200};
+        std::chrono::minutes snapshotInterval{60};  // 0: only at startup and after lost changes
+        size_t keepSnapshots = 2;                   // segments older than the oldest kept one are deleted
+        std::string replicaPath;                    // replica's copy; empty: <name>-replica.db next to the main file
+        std::chrono::milliseconds pollInterval{200};
+
+        // Reads db_config.json's "replication" section
+        static Options fromConfig(const nlohmann::json& section);
+        std::string directoryFor(const std::string& databasePath) const;
+        std::string replicaPathFor(const std::string& databasePath) const;
+    };
+
+    class Publisher {
+    public:
+        // Leases a read connection on the main database
+        using Reader = std::function<PooledConnection()>;
+
+        // Subscribes to feed and starts publishing with a snapshot
+        Publisher(std::string directory, Options options, ChangeFeed& feed, Reader reader);
+        ~Publisher();
+        Publisher(const Publisher&) = delete;
+        Publisher& operator=(const Publisher&) = delete;
+
+        // Writes a last segment for what is pending, then stops following the feed
+        void stop();
+        nlohmann::json stats() const;
+
+    private:
+        struct Pending {
+            std::map<std::string, std::set<int64_t>> rows;  // table -> rowids
+            size_t count = 0;
+            int64_t oldestCommitMs = 0;
+            int64_t newestCommitMs = 0;
+        };
+
+        void collect(const ChangeBatch& batch);
+        void loop();
+        bool writeSegment(const Pending& batch);
+        bool writeSnapshot();
+        void writeHead(int64_t oldestPendingMs);
+        void prune();
+        void fail(const std::string& what);
+
+        std::string directory;
+        Options options;
+        ChangeFeed& feed;
+        Reader reader;
+        uint64_t subscription;
+
+        mutable std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping;
+        bool snapshotRequested;
+        Pending pending;
+        std::thread worker;
+
+        // Written by the worker thread, read under mutex
+        uint64_t sequence;          // last segment or snapshot written
+        uint64_t snapshotSequence;  // segments the newest snapshot covers
+        std::string schema;         // schema_state checksum as of the last segment or snapshot
+        std::chrono::steady_clock::time_point lastSnapshot;
+        uint64_t segments;
+        uint64_t rowsShipped;
+        uint64_t snapshots;
+        uint64_t failures;
+        std::string lastError;
+        LatencyHistogram segmentLatency;
+    };
+
+    class Applier {
+    public:
+        // Opens a read-write connection on the replica's copy
+        using Opener = std::function<sqlite3*()>;
+
+        Applier(std::string directory, Options options, Opener opener);
+        ~Applier();
+        Applier(const Applier&) = delete;
+        Applier& operator=(const Applier&) = delete;
+
+        // Restores the newest snapshot unless the local copy can catch up from
+        // segments; false when there is neither a local copy nor a snapshot yet
+        bool bootstrap();
+        // Polls for new segments on a background thread
+        void start();
+        void stop();
+        nlohmann::json stats() const;
+
+    private:
+        struct Head {
+            uint64_t sequence = 0;
+            std::string schema;
+            int64_t writtenAtMs = 0;
+            int64_t oldestPendingMs = 0;
+        };
+
+        bool open();
+        bool readState();
+        bool readHead(Head& head) const;
+        bool restore();
+        // 1 applied, 0 not there, -1 failed, -2 written under another schema
+        int applySegment(uint64_t seq);
+        void poll();
+        void loop();
+        void fail(const std::string& what);
+
+        std::string directory;
+        Options options;
+        Opener opener;
+        sqlite3* db;  // used by whichever thread runs bootstrap() / the poll loop
+        std::unique_ptr<StatementCache> statements;
+
+        mutable std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping;
+        std::thread worker;
+
+        // Written by the applying thread, read under mutex
+        uint64_t applied;           // last applied segment
+        uint64_t restoredSnapshot;  // snapshot the copy was last restored from
+        std::string schema;         // local schema_state checksum
+        Head head;
+        int64_t oldestUnappliedMs;  // oldest commit the copy is known to be missing, 0 if none
+        int64_t lastSegmentDelayMs;
+        uint64_t segments;
+        uint64_t rowsApplied;
+        uint64_t restores;
+        uint64_t failures;
+        std::string lastError;
+        LatencyHistogram applyLatency;
+    };
+}
+
+#endif // REPLICATION_H
@@ -0,0 +1,66 @@
+#ifndef REPOSITORY_H
+#define REPOSITORY_H
+
+#include <sqlite3.h>
+#include <optional>
+#include <vector>
+#include "connection_pool.h"
+#include "row_mapping.h"
+#include "write_queue.h"
+
+// Base for the typed repositories in repositories/. A repository borrows either
+// a pooled read connection or the writer's WriteContext, prepares through that
+// connection's statement cache, and returns model structs mapped with RowMapping.
+// Like the statements it prepares, it must not outlive the lease.
+class Repository {
+public:
+    explicit Repository(const PooledConnection& conn) : pooled(&conn), writer(nullptr) {}
+    explicit Repository(WriteContext& tx) : pooled(nullptr), writer(&tx) {}
+
+protected:
+    CachedStatement prepare(const char* sql) const {
+        return pooled ? pooled->prepare(sql) : writer->prepare(sql);
+    }
+
+    sqlite3* db() const {
+        return pooled ? pooled->get() : static_cast<sqlite3*>(*writer);
+    }
+
+    // Appends every row of sql (with args bound to ?1, ?2, ...) to out
+    template <typename Model, typename... Args>
+    bool query(const char* sql, std::vector<Model>& out, const Args&... args) const {
+        auto stmt = prepare(sql);
+        if (!stmt || RowMapping::bind(stmt.get(), args...) != SQLITE_OK)
+            return false;
+        return RowMapping::readAll(stmt.get(), out);
+    }
+
+    // First row of sql into out; out stays empty when there is none
+    template <typename Model, typename... Args>
+    bool queryOne(const char* sql, std::optional<Model>& out, const Args&... args) const {
+        auto stmt = prepare(sql);
+        if (!stmt || RowMapping::bind(stmt.get(), args...) != SQLITE_OK)
+            return false;
+        int rc = sqlite3_step(stmt);
+        if (rc == SQLITE_ROW) {
+            out.emplace();
+            RowMapping::read(stmt.get(), *out);
+        }
+        return rc == SQLITE_ROW || rc == SQLITE_DONE;
+    }
+
+    // Runs a statement that returns no rows; the error is left on the connection (sqlite3_errmsg)
+    template <typename... Args>
+    bool execute(const char* sql, const Args&... args) const {
+        auto stmt = prepare(sql);
+        if (!stmt || RowMapping::bind(stmt.get(), args...) != SQLITE_OK)
+            return false;
+        return sqlite3_step(stmt) == SQLITE_DONE;
+    }
+
+private:
+    const PooledConnection* pooled;
+    WriteContext* writer;
+};
+
+#endif // REPOSITORY_H
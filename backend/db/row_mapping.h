@@ -0,0 +1,204 @@
+#ifndef ROW_MAPPING_H
+#define ROW_MAPPING_H
+
+#include <sqlite3.h>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "../models/Money.h"
+#include "../models/Timestamp.h"
+
+// Compile-time mapping between a model struct and a result row. A repository
+// specialises RowMapping::Columns<Model> once with the model's columns, in
+// select-list order:
+//
+//   template <> struct RowMapping::Columns<Category> {
+//       static constexpr auto list = std::make_tuple(
+//           RowMapping::column("id", "id", &Category::id),
+//           RowMapping::column("name", "name", &Category::name));
+//   };
+//
+// and gets the SELECT list, row extraction and JSON serialisation generated
+// from it; no per-field json object is built along the way.
+namespace RowMapping {
+    template <typename Model, typename T>
+    struct Column {
+        const char* key;   // JSON key
+        const char* expr;  // SQL expression in the select list
+        T Model::*member;
+    };
+
+    template <typename Model, typename T>
+    constexpr Column<Model, T> column(const char* key, const char* expr, T Model::*member) {
+        return {key, expr, member};
+    }
+
+    template <typename Model>
+    struct Columns;
+
+    namespace detail {
+        template <typename Tuple, typename Fn, size_t... I>
+        void forEach(const Tuple& t, Fn&& fn, std::index_sequence<I...>) {
+            (fn(std::get<I>(t), static_cast<int>(I)), ...);
+        }
+
+        template <typename Model, typename Fn>
+        void forEachColumn(Fn&& fn) {
+            constexpr auto& list = Columns<Model>::list;
+            forEach(list, fn, std::make_index_sequence<std::tuple_size_v<std::decay_t<decltype(list)>>>{});
+        }
+
+        inline void read(sqlite3_stmt* stmt, int col, int& out) { out = sqlite3_column_int(stmt, col); }
+        inline void read(sqlite3_stmt* stmt, int col, int64_t& out) { out = sqlite3_column_int64(stmt, col); }
+        inline void read(sqlite3_stmt* stmt, int col, double& out) { out = sqlite3_column_double(stmt, col); }
+        inline void read(sqlite3_stmt* stmt, int col, std::string& out) {
+            // NULL reads as ""; assign() reuses the string's buffer when rows are read into the same struct
+            const char* p = reinterpret_cast<const char*>(sqlite3_column_text(stmt, col));
+            out.assign(p ? p : "", p ? static_cast<size_t>(sqlite3_column_bytes(stmt, col)) : 0);
+        }
+        inline void read(sqlite3_stmt* stmt, int col, Timestamp& out) { out.ms = sqlite3_column_int64(stmt, col); }
+        inline void read(sqlite3_stmt* stmt, int col, Money& out) { out.cents = sqlite3_column_int64(stmt, col); }
+
+        inline int bind(sqlite3_stmt* stmt, int i, int v) { return sqlite3_bind_int(stmt, i, v); }
+        inline int bind(sqlite3_stmt* stmt, int i, int64_t v) { return sqlite3_bind_int64(stmt, i, v); }
+        inline int bind(sqlite3_stmt* stmt, int i, double v) { return sqlite3_bind_double(stmt, i, v); }
+        inline int bind(sqlite3_stmt* stmt, int i, const std::string& v) {
+            return sqlite3_bind_text(stmt, i, v.data(), static_cast<int>(v.size()), SQLITE_TRANSIENT);
+        }
+        inline int bind(sqlite3_stmt* stmt, int i, const char* v) {
+            return sqlite3_bind_text(stmt, i, v, -1, SQLITE_TRANSIENT);
+        }
+        inline int bind(sqlite3_stmt* stmt, int i, Timestamp v) { return sqlite3_bind_int64(stmt, i, v.ms); }
+        inline int bind(sqlite3_stmt* stmt, int i, Money v) { return sqlite3_bind_int64(stmt, i, v.cents); }
+
+        inline void appendValue(std::string& out, int v) {
+            char buf[16];
+            auto res = std::to_chars(buf, buf + sizeof(buf), v);
+            out.append(buf, res.ptr);
+        }
+        inline void appendValue(std::string& out, int64_t v) {
+            char buf[24];
+            auto res = std::to_chars(buf, buf + sizeof(buf), v);
+            out.append(buf, res.ptr);
+        }
+        inline void appendValue(std::string& out, double v) {
+            // Shortest representation that round-trips, as nlohmann::json prints it
+            char buf[32];
+            auto res = std::to_chars(buf, buf + sizeof(buf), v);
+            out.append(buf, res.ptr);
+        }
+        inline void appendValue(std::string& out, const std::string& v) {
+            out += '"';
+            for (char c : v) {
+                switch (c) {
+                    case '"': out += "\\\""; break;
+                    case '\\': out += "\\\\"; break;
+                    case '\n': out += "\\n"; break;
+                    case '\r': out += "\\r"; break;
+                    case '\t': out += "\\t"; break;
+                    default:
+                        if (static_cast<unsigned char>(c) < 0x20) {
+                            char esc[8];
+                            std::snprintf(esc, sizeof(esc), "\\u%04x", static_cast<unsigned char>(c));
+                            out += esc;
+                        } else {
+                            out += c;
+                        }
+                }
+            }
+            out += '"';
+        }
+        inline void appendValue(std::string& out, Money v) { v.appendTo(out); }
+        inline void appendValue(std::string& out, Timestamp v) {
+            out += '"';
+            out += v.iso();
+            out += '"';
+        }
+    }
+
+    // "expr, expr, ..." for the model's columns, built once
+    template <typename Model>
+    const std::string& selectList() {
+        static const std::string list = [] {
+            std::string s;
+            detail::forEachColumn<Model>([&s](const auto& c, int i) {
+                if (i > 0) s += ", ";
+                s += c.expr;
+            });
+            return s;
+        }();
+        return list;
+    }
+
+    // Reads the current row of stmt into model; the mapped columns start at firstColumn
+    template <typename Model>
+    void read(sqlite3_stmt* stmt, Model& model, int firstColumn = 0) {
+        detail::forEachColumn<Model>([&](const auto& c, int i) {
+            detail::read(stmt, firstColumn + i, model.*(c.member));
+        });
+    }
+
+    // Steps stmt to completion, appending one model per row. False on a step error.
+    template <typename Model>
+    bool readAll(sqlite3_stmt* stmt, std::vector<Model>& out) {
+        int rc;
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            out.emplace_back();
+            read(stmt, out.back());
+        }
+        return rc == SQLITE_DONE;
+    }
+
+    // Binds args to ?1, ?2, ... in order; returns the first non-OK result code
+    template <typename... Args>
+    int bind(sqlite3_stmt* stmt, const Args&... args) {
+        if constexpr (sizeof...(Args) == 0) {
+            (void)stmt;
+            return SQLITE_OK;
+        } else {
+            int rc = SQLITE_OK;
+            int i = 0;
+            ((rc = rc == SQLITE_OK ? detail::bind(stmt, ++i, args) : rc), ...);
+            return rc;
+        }
+    }
+
+    template <typename Model>
+    void appendJson(std::string& out, const Model& model) {
+        out += '{';
+        detail::forEachColumn<Model>([&](const auto& c, int i) {
+            if (i > 0) out += ',';
+            out += '"';
+            out += c.key;
+            out += "\":";
+            detail::appendValue(out, model.*(c.member));
+        });
+        out += '}';
+    }
+
+    template <typename Model>
+    void appendJson(std::string& out, const std::vector<Model>& models) {
+        out += '[';
+        for (size_t i = 0; i < models.size(); i++) {
+            if (i > 0) out += ',';
+            appendJson(out, models[i]);
+        }
+        out += ']';
+    }
+
+    // {"success":true,"data":...}, the shape every route answers with
+    template <typename Data>
+    std::string successBody(const Data& data) {
+        std::string out = "{\"success\":true,\"data\":";
+        appendJson(out, data);
+        out += '}';
+        return out;
+    }
+}
+
+#endif // ROW_MAPPING_H
@@ -0,0 +1,164 @@
+#include "shard_set.h"
+#include "busy_retry.h"
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+namespace {
+    const char* kShardedTables[] = {"cart_items", "orders", "order_items"};
+
+    // splitmix64 finalizer: sequential user ids spread evenly across shards
+    uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xbf58476d1ce4e5b9ull;
+        x ^= x >> 27;
+        x *= 0x94d049bb133111ebull;
+        x ^= x >> 31;
+        return x;
+    }
+
+    bool reserveIdRange(sqlite3* db, int64_t start) {
+        sqlite3_stmt* stmt = nullptr;
+        const char* sql = "INSERT INTO sqlite_sequence (name, seq) SELECT ?1, ?2 "
+                          "WHERE NOT EXISTS (SELECT 1 FROM sqlite_sequence WHERE name = ?1)";
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+            return false;
+        bool ok = true;
+        for (const char* table : kShardedTables) {
+            sqlite3_bind_text(stmt, 1, table, -1, SQLITE_STATIC);
+            sqlite3_bind_int64(stmt, 2, start);
+            ok &= sqlite3_step(stmt) == SQLITE_DONE;
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+        return ok;
+    }
+}
+
+ShardSet::Options ShardSet::Options::fromConfig(const json& section) {
+    Options o;
+    if (!section.is_object()) return o;
+    if (section.contains("shards") && section["shards"].is_number_unsigned())
+        o.shards = section["shards"].get<size_t>();
+    if (section.contains("directory") && section["directory"].is_string())
+        o.directory = section["directory"].get<std::string>();
+    // Ids must stay below INT32_MAX, which the routes bind them as
+    if (o.shards > 21) {
+        std::cerr << "sharding.shards: at most 21 shards are supported, using 21" << std::endl;
+        o.shards = 21;
+    }
+    return o;
+}
+
+ShardSet::ShardSet(const std::string& databasePath, Options options, size_t readPoolSize,
+                   std::chrono::milliseconds acquireTimeout, size_t statementCacheSize,
+                   WriteQueue::Options writerOptions, Opener opener) {
+    fs::path dir(options.directory);
+    if (dir.is_relative())
+        dir = fs::path(databasePath).parent_path() / dir;
+    std::error_code ec;
+    fs::create_directories(dir, ec);
+    std::string stem = fs::path(databasePath).stem().string();
+    writerOptions.statementCacheSize = statementCacheSize;
+    shards.resize(options.shards);
+    for (size_t i = 0; i < shards.size(); i++) {
+        Shard& s = shards[i];
+        s.path = (dir / (stem + "-shard-" + std::to_string(i) + ".db")).string();
+        std::string name = "shard-" + std::to_string(i);
+        std::string path = s.path;
+        writerOptions.changeSource = name;
+        s.readPool = std::make_unique<ConnectionPool>(name + "-read-only", readPoolSize, acquireTimeout, statementCacheSize,
+                                                      [opener, path] { return opener(path, true); });
+        s.writer = std::make_unique<WriteQueue>([opener, path] {
+            sqlite3* db = opener(path, false);
+            if (db) BusyRetry::install(db, "shard-writer");
+            return db;
+        }, writerOptions);
+    }
+    // Users are mapped by hash, so changing the shard count strands existing rows
+    std::string extra = (dir / (stem + "-shard-" + std::to_string(shards.size()) + ".db")).string();
+    if (fs::exists(extra, ec))
+        std::cerr << "Warning: " << extra << " exists but sharding.shards is " << shards.size()
+                  << "; users on the missing shards will not find their carts or orders" << std::endl;
+}
+
+ShardSet::~ShardSet() {
+    close();
+}
+
+size_t ShardSet::shardForUser(int64_t userId) const {
+    return static_cast<size_t>(mix(static_cast<uint64_t>(userId)) % shards.size());
+}
+
+size_t ShardSet::shardForId(int64_t id) const {
+    if (id <= 0) return shards.size();
+    int64_t shard = (id - 1) / kIdStride;
+    return shard < static_cast<int64_t>(shards.size()) ? static_cast<size_t>(shard) : shards.size();
+}
+
+PooledConnection ShardSet::read(size_t shard) {
+    return shards[shard].readPool->acquire();
+}
+
+WriteQueue* ShardSet::writer(size_t shard) {
+    return shards[shard].writer.get();
+}
+
+bool ShardSet::ensureSchema(const std::vector<Migration>& migrations) {
+    MigrationRunner runner(migrations);
+    bool ok = true;
+    for (size_t i = 0; i < shards.size(); i++) {
+        // Plain connection without the catalog attached, so unqualified names only see the shard
+        sqlite3* db = nullptr;
+        if (sqlite3_open_v2(shards[i].path.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+            std::cerr << "Shard " << i << ": open failed: " << (db ? sqlite3_errmsg(db) : "out of memory") << std::endl;
+            if (db) sqlite3_close(db);
+            ok = false;
+            continue;
+        }
+        sqlite3_busy_timeout(db, 5000);
+        bool shardOk = runner.run(db) && reserveIdRange(db, static_cast<int64_t>(i) * kIdStride);
+        if (!shardOk)
+            std::cerr << "Shard " << i << ": schema setup failed for " << shards[i].path << std::endl;
+        ok &= shardOk;
+        sqlite3_close(db);
+    }
+    return ok;
+}
+
+json ShardSet::stats() const {
+    json arr = json::array();
+    for (size_t i = 0; i < shards.size(); i++) {
+        json j;
+        j["shard"] = i;
+        j["path"] = shards[i].path;
+        j["first_id"] = static_cast<int64_t>(i) * kIdStride + 1;
+        j["read_pool"] = shards[i].readPool->stats();
+        j["writer"] = shards[i].writer->stats();
+        arr.push_back(j);
+    }
+    return arr;
+}
+
+SqliteMemory::Counters ShardSet::readMemory(bool reset) {
+    SqliteMemory::Counters total;
+    for (Shard& s : shards)
+        total += s.readPool->memory(reset);
+    return total;
+}
+
+SqliteMemory::Counters ShardSet::writerMemory(bool reset) {
+    SqliteMemory::Counters total;
+    for (Shard& s : shards)
+        total += s.writer->memory(reset);
+    return total;
+}
+
+void ShardSet::close() {
+    for (Shard& s : shards) {
+        if (s.writer) s.writer->stop();
+        if (s.readPool) s.readPool->close();
+    }
+}
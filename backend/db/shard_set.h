@@ -0,0 +1,72 @@
+#ifndef SHARD_SET_H
+#define SHARD_SET_H
+
+#include <sqlite3.h>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "connection_pool.h"
+#include "migrations.h"
+#include "write_queue.h"
+
+// Per-user shard files for cart_items, orders and order_items. A user's rows
+// all live in one shard picked by a hash of user_id, and each shard has its
+// own read pool and writer thread, so checkouts for users on different shards
+// commit in parallel. Row ids are allocated in disjoint ranges per shard
+// (shard k hands out k * kIdStride + 1 ...), so an order or cart item id alone
+// identifies its shard.
+class ShardSet {
+public:
+    static constexpr int64_t kIdStride = 100000000;
+
+    struct Options {
+        size_t shards = 0;                  // 0 or 1 keeps everything in the main file
+        std::string directory = "shards";   // relative to the main database file's directory
+
+        // Reads db_config.json's "sharding" section
+        static Options fromConfig(const nlohmann::json& section);
+    };
+
+    // Opens one connection to a shard file; readOnly selects the GET-route flavour
+    using Opener = std::function<sqlite3*(const std::string& path, bool readOnly)>;
+
+    ShardSet(const std::string& databasePath, Options options, size_t readPoolSize,
+             std::chrono::milliseconds acquireTimeout, size_t statementCacheSize,
+             WriteQueue::Options writerOptions, Opener opener);
+    ~ShardSet();
+    ShardSet(const ShardSet&) = delete;
+    ShardSet& operator=(const ShardSet&) = delete;
+
+    size_t size() const { return shards.size(); }
+    size_t shardForUser(int64_t userId) const;
+    // Shard that allocated a cart_items / orders / order_items id; size() if none did
+    size_t shardForId(int64_t id) const;
+    const std::string& path(size_t shard) const { return shards[shard].path; }
+
+    PooledConnection read(size_t shard);
+    WriteQueue* writer(size_t shard);
+
+    // Applies the shard migration set to every shard file and reserves each
+    // shard's id range
+    bool ensureSchema(const std::vector<Migration>& migrations);
+    nlohmann::json stats() const;
+    // SqliteMemory::Counters summed over every shard's read pool / writer
+    SqliteMemory::Counters readMemory(bool reset = false);
+    SqliteMemory::Counters writerMemory(bool reset = false);
+    void close();
+
+private:
+    struct Shard {
+        std::string path;
+        std::unique_ptr<ConnectionPool> readPool;
+        std::unique_ptr<WriteQueue> writer;
+    };
+
+    std::vector<Shard> shards;
+};
+
+#endif // SHARD_SET_H
@@ -0,0 +1,438 @@
+#include "sql_profiler.h"
+#include "../utils/latency_histogram.h"
+#include "../utils/utc_time.h"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+    struct Entry {
+        explicit Entry(std::string sql) : sql(std::move(sql)) {}
+        const std::string sql;
+        LatencyHistogram time;
+        std::atomic<uint64_t> rows{0};
+        // EXPLAIN QUERY PLAN, captured the first time the statement runs slow
+        std::mutex planMutex;
+        bool planCaptured = false;
+        json plan;
+    };
+
+    std::atomic<bool> profiling{true};
+    std::mutex registryMutex;
+    // Entries live for the whole process; reset() zeroes them in place
+    std::unordered_map<std::string, std::unique_ptr<Entry>> entries;
+
+    // Raw SQL text -> entry, per thread, so the hot path takes no lock. Texts
+    // with literals inlined are all distinct, so the map is emptied when full
+    // rather than left to grow with them.
+    constexpr size_t kMaxLocalEntries = 512;
+    thread_local std::unordered_map<std::string, Entry*> localEntries;
+    struct Pending {
+        std::chrono::steady_clock::time_point start;
+        uint64_t rows = 0;
+    };
+    // Statements that have started but not finished yet on this thread
+    thread_local std::unordered_map<sqlite3_stmt*, Pending> pending;
+
+    Entry* entryFor(const char* sql) {
+        auto it = localEntries.find(sql);
+        if (it != localEntries.end())
+            return it->second;
+        std::string normalized = SqlProfiler::normalize(sql);
+        Entry* entry;
+        {
+            std::lock_guard<std::mutex> lock(registryMutex);
+            auto& slot = entries[normalized];
+            if (!slot) slot = std::make_unique<Entry>(normalized);
+            entry = slot.get();
+        }
+        if (localEntries.size() >= kMaxLocalEntries)
+            localEntries.clear();
+        localEntries.emplace(sql, entry);
+        return entry;
+    }
+
+    std::mutex slowMutex;
+    SlowQueryPolicy slowPolicy;
+    std::atomic<int64_t> slowThresholdMicros{100000};
+    std::deque<json> recentSlow;
+    std::ofstream slowLog;
+    bool slowLogFailed = false;
+
+    // Call site label for slow-log entries, see SqlSite
+    thread_local const char* currentSite = nullptr;
+    // Set while this thread runs its own EXPLAIN, which must not be traced
+    thread_local bool explaining = false;
+
+    bool identChar(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+    }
+
+    // p at an opening quote: '...', "...", `...` or [...]; returns the position after the closing one
+    const char* skipQuoted(const char* p) {
+        char close = *p == '[' ? ']' : *p;
+        p++;
+        while (*p) {
+            if (*p == close) {
+                if (close != ']' && p[1] == close) {
+                    p += 2;
+                    continue;
+                }
+                return p + 1;
+            }
+            p++;
+        }
+        return p;
+    }
+
+    // p at "--" or "/*"
+    const char* skipComment(const char* p) {
+        if (p[0] == '-') {
+            while (*p && *p != '\n') p++;
+            return p;
+        }
+        const char* end = std::strstr(p + 2, "*/");
+        return end ? end + 2 : p + std::strlen(p);
+    }
+
+    // A literal as written by sqlite3_expanded_sql for a bound value
+    const char* skipLiteral(const char* p, const char** type) {
+        if (std::strncmp(p, "NULL", 4) == 0) {
+            *type = "null";
+            return p + 4;
+        }
+        if (*p == '\'') {
+            *type = "text";
+            return skipQuoted(p);
+        }
+        if ((*p == 'x' || *p == 'X') && p[1] == '\'') {
+            *type = "blob";
+            return skipQuoted(p + 1);
+        }
+        if (std::strncmp(p, "zeroblob(", 9) == 0) {
+            *type = "blob";
+            const char* end = std::strchr(p, ')');
+            return end ? end + 1 : p + std::strlen(p);
+        }
+        *type = "integer";
+        if (*p == '-') p++;
+        while (identChar(*p) || *p == '.' || ((*p == '-' || *p == '+') && (p[-1] == 'e' || p[-1] == 'E'))) {
+            if (*p == '.' || *p == 'e' || *p == 'E') *type = "real";
+            p++;
+        }
+        return p;
+    }
+
+    // Types of the values currently bound to stmt, by parameter index. The values
+    // themselves never leave this function: the original SQL and its expanded form
+    // are walked side by side and each literal substituted for a parameter is
+    // reduced to its type.
+    json boundTypes(sqlite3_stmt* stmt) {
+        json types = json::array();
+        int n = sqlite3_bind_parameter_count(stmt);
+        if (n == 0)
+            return types;
+        std::vector<const char*> byIndex(n, "unknown");
+        char* expanded = sqlite3_expanded_sql(stmt);
+        const char* a = sqlite3_sql(stmt);
+        const char* b = expanded;
+        int maxIndex = 0;
+        while (a && b && *a && *b) {
+            const char* skipped = nullptr;
+            if (*a == '\'' || *a == '"' || *a == '`' || *a == '[')
+                skipped = skipQuoted(a);
+            else if ((a[0] == '-' && a[1] == '-') || (a[0] == '/' && a[1] == '*'))
+                skipped = skipComment(a);
+            if (skipped) {
+                // Copied verbatim into the expanded text
+                size_t len = std::min(static_cast<size_t>(skipped - a), std::strlen(b));
+                a += len;
+                b += len;
+                continue;
+            }
+            if (*a == '?' || ((*a == ':' || *a == '@' || *a == '$') && identChar(a[1]))) {
+                const char* start = a++;
+                while (identChar(*a)) a++;
+                int index;
+                if (*start == '?')
+                    index = a - start > 1 ? std::atoi(start + 1) : maxIndex + 1;
+                else
+                    index = sqlite3_bind_parameter_index(stmt, std::string(start, a).c_str());
+                maxIndex = std::max(maxIndex, index);
+                const char* type = "unknown";
+                b = skipLiteral(b, &type);
+                if (index >= 1 && index <= n)
+                    byIndex[index - 1] = type;
+                continue;
+            }
+            a++;
+            b++;
+        }
+        sqlite3_free(expanded);
+        for (const char* type : byIndex)
+            types.push_back(type);
+        return types;
+    }
+
+    std::string isoNow() {
+        std::tm tm = utcTime(std::time(nullptr));
+        char buf[32];
+        std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm);
+        return buf;
+    }
+
+    void logSlow(sqlite3_stmt* stmt, Entry* entry, uint64_t micros, uint64_t rows) {
+        json record;
+        record["time"] = isoNow();
+        record["site"] = currentSite ? json(currentSite) : json(nullptr);
+        record["sql"] = entry->sql;
+        record["duration_ms"] = micros / 1000.0;
+        record["rows"] = rows;
+        record["params"] = boundTypes(stmt);
+        {
+            std::lock_guard<std::mutex> lock(entry->planMutex);
+            if (!entry->planCaptured && !sqlite3_stmt_isexplain(stmt)) {
+                entry->plan = SqlProfiler::explain(sqlite3_db_handle(stmt), sqlite3_sql(stmt));
+                entry->planCaptured = true;
+            }
+            record["plan"] = entry->plan.is_null() ? json::array() : entry->plan;
+        }
+        bool fullScan = false, tempBTree = false;
+        for (const auto& line : record["plan"]) {
+            std::string detail = line.get<std::string>();
+            size_t start = detail.find_first_not_of(' ');
+            if (start != std::string::npos && detail.compare(start, 5, "SCAN ") == 0)
+                fullScan = true;
+            if (detail.find("USE TEMP B-TREE") != std::string::npos)
+                tempBTree = true;
+        }
+        record["full_scan"] = fullScan;
+        record["temp_btree"] = tempBTree;
+
+        std::lock_guard<std::mutex> lock(slowMutex);
+        if (!slowPolicy.logPath.empty() && !slowLogFailed) {
+            if (!slowLog.is_open()) {
+                std::filesystem::path path(slowPolicy.logPath);
+                std::error_code ec;
+                if (path.has_parent_path())
+                    std::filesystem::create_directories(path.parent_path(), ec);
+                slowLog.open(path, std::ios::app);
+                if (!slowLog) {
+                    std::cerr << "Failed to open slow query log " << slowPolicy.logPath << std::endl;
+                    slowLogFailed = true;
+                }
+            }
+            if (slowLog.is_open())
+                slowLog << record.dump() << '\n' << std::flush;
+        }
+        recentSlow.push_front(std::move(record));
+        while (recentSlow.size() > slowPolicy.keep)
+            recentSlow.pop_back();
+    }
+
+    int onTrace(unsigned type, void*, void* p, void* x) {
+        if (explaining)
+            return 0;
+        auto* stmt = static_cast<sqlite3_stmt*>(p);
+        if (type == SQLITE_TRACE_STMT) {
+            // Also fires for each trigger body; keep the outer statement's start time
+            pending.try_emplace(stmt, Pending{std::chrono::steady_clock::now()});
+            return 0;
+        }
+        if (type == SQLITE_TRACE_ROW) {
+            pending[stmt].rows++;
+            return 0;
+        }
+        // SQLITE_TRACE_PROFILE. The elapsed time SQLite passes in x only has the
+        // VFS clock's millisecond resolution, so time the statement ourselves
+        uint64_t micros = static_cast<uint64_t>(*static_cast<sqlite3_int64*>(x) / 1000);
+        uint64_t rows = 0;
+        auto it = pending.find(stmt);
+        if (it != pending.end()) {
+            micros = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - it->second.start).count();
+            rows = it->second.rows;
+            pending.erase(it);
+        }
+        const char* sql = sqlite3_sql(stmt);
+        if (!sql)
+            return 0;
+        Entry* entry = entryFor(sql);
+        entry->time.record(micros);
+        entry->rows.fetch_add(rows, std::memory_order_relaxed);
+        int64_t threshold = slowThresholdMicros.load(std::memory_order_relaxed);
+        if (threshold > 0 && static_cast<int64_t>(micros) >= threshold)
+            logSlow(stmt, entry, micros, rows);
+        return 0;
+    }
+}
+
+namespace SqlProfiler {
+    json explain(sqlite3* db, const char* sql, std::string* error) {
+        json lines = json::array();
+        std::string text = std::string("EXPLAIN QUERY PLAN ") + sql;
+        sqlite3_stmt* stmt = nullptr;
+        explaining = true;
+        if (sqlite3_prepare_v2(db, text.c_str(), -1, &stmt, nullptr) == SQLITE_OK && stmt) {
+            std::unordered_map<int, int> depth;
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                int id = sqlite3_column_int(stmt, 0);
+                int parent = sqlite3_column_int(stmt, 1);
+                const char* detail = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+                auto it = depth.find(parent);
+                int d = it == depth.end() ? 0 : it->second + 1;
+                depth[id] = d;
+                lines.push_back(std::string(2 * d, ' ') + (detail ? detail : ""));
+            }
+        } else if (error) {
+            *error = sqlite3_errmsg(db);
+        }
+        sqlite3_finalize(stmt);
+        explaining = false;
+        return lines;
+    }
+
+
+void configure(bool enabled) {
+    profiling.store(enabled);
+}
+
+bool enabled() {
+    return profiling.load();
+}
+
+void configureSlowLog(const SlowQueryPolicy& policy) {
+    std::lock_guard<std::mutex> lock(slowMutex);
+    slowPolicy = policy;
+    slowThresholdMicros.store(policy.thresholdMs > 0 ? static_cast<int64_t>(policy.thresholdMs) * 1000 : 0);
+    if (slowLog.is_open())
+        slowLog.close();
+    slowLogFailed = false;
+}
+
+SlowQueryPolicy slowLogPolicy() {
+    std::lock_guard<std::mutex> lock(slowMutex);
+    return slowPolicy;
+}
+
+void install(sqlite3* db) {
+    if (profiling.load())
+        sqlite3_trace_v2(db, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW, onTrace, nullptr);
+}
+
+std::string normalize(const char* sql) {
+    std::string out;
+    const char* p = sql;
+    while (*p) {
+        char c = *p;
+        if (std::isspace(static_cast<unsigned char>(c)) || (c == '-' && p[1] == '-') || (c == '/' && p[1] == '*')) {
+            // Comments count as whitespace
+            while (std::isspace(static_cast<unsigned char>(*p)) || (p[0] == '-' && p[1] == '-') || (p[0] == '/' && p[1] == '*'))
+                p = std::isspace(static_cast<unsigned char>(*p)) ? p + 1 : skipComment(p);
+            if (!out.empty() && *p) out += ' ';
+            continue;
+        }
+        if (c == '\'') {
+            // String literal, '' is an escaped quote
+            p++;
+            while (*p && !(*p == '\'' && p[1] != '\'')) p += (*p == '\'' ? 2 : 1);
+            if (*p) p++;
+            out += '?';
+            continue;
+        }
+        if (c == '?' || ((c == ':' || c == '@' || c == '$') && identChar(p[1]))) {
+            p++;
+            while (identChar(*p)) p++;
+            out += '?';
+            continue;
+        }
+        if (std::isdigit(static_cast<unsigned char>(c)) && (out.empty() || !identChar(out.back()))) {
+            while (identChar(*p) || *p == '.') p++;
+            out += '?';
+            continue;
+        }
+        out += c;
+        p++;
+    }
+    while (!out.empty() && (out.back() == ';' || out.back() == ' '))
+        out.pop_back();
+    return out;
+}
+
+json stats(size_t limit) {
+    std::vector<const Entry*> sorted;
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (const auto& e : entries)
+            if (e.second->time.count() > 0)
+                sorted.push_back(e.second.get());
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b) { return a->time.total() > b->time.total(); });
+    if (limit > 0 && sorted.size() > limit)
+        sorted.resize(limit);
+    json arr = json::array();
+    for (const Entry* e : sorted) {
+        json j = e->time.toJson();
+        j["sql"] = e->sql;
+        j["calls"] = j["count"];
+        j.erase("count");
+        uint64_t rows = e->rows.load(std::memory_order_relaxed);
+        j["rows"] = rows;
+        j["avg_rows"] = e->time.count() ? static_cast<double>(rows) / e->time.count() : 0.0;
+        arr.push_back(j);
+    }
+    return arr;
+}
+
+void reset() {
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto& e : entries) {
+        e.second->time.reset();
+        e.second->rows = 0;
+    }
+}
+
+json slowQueries() {
+    std::lock_guard<std::mutex> lock(slowMutex);
+    json arr = json::array();
+    for (const auto& record : recentSlow)
+        arr.push_back(record);
+    return arr;
+}
+
+void resetSlowQueries() {
+    {
+        std::lock_guard<std::mutex> lock(slowMutex);
+        recentSlow.clear();
+    }
+    // Plans may have changed since (new indexes, ANALYZE), so capture them afresh
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (auto& e : entries) {
+        std::lock_guard<std::mutex> planLock(e.second->planMutex);
+        e.second->planCaptured = false;
+        e.second->plan = nullptr;
+    }
+}
+
+}
+
+SqlSite::SqlSite(const char* name) : previous(currentSite) {
+    currentSite = name;
+}
+
+SqlSite::~SqlSite() {
+    currentSite = previous;
+}
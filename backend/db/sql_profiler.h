@@ -0,0 +1,55 @@
+#ifndef SQL_PROFILER_H
+#define SQL_PROFILER_H
+
+#include <sqlite3.h>
+#include <string>
+#include <nlohmann/json.hpp>
+
+struct SlowQueryPolicy {
+    int thresholdMs = 100;                          // 0 disables the slow log
+    std::string logPath = "logs/slow-queries.log";  // JSON lines, appended
+    size_t keep = 200;                              // recent entries kept for /api/debug/slow-queries
+};
+
+// Per-statement execution stats from sqlite3_trace_v2. Statements are grouped
+// by their normalized SQL (literals and parameter numbers folded to ?, runs of
+// whitespace collapsed), so every call site sharing a query shares one entry.
+namespace SqlProfiler {
+    void configure(bool enabled);
+    bool enabled();
+    void configureSlowLog(const SlowQueryPolicy& policy);
+    SlowQueryPolicy slowLogPolicy();
+
+    // Registers the profile/row trace callbacks on a freshly opened connection
+    void install(sqlite3* db);
+
+    std::string normalize(const char* sql);
+
+    // EXPLAIN QUERY PLAN lines for sql, indented by depth like the sqlite3 shell's
+    // .eqp output. Not traced. An empty plan with error set means sql did not prepare.
+    nlohmann::json explain(sqlite3* db, const char* sql, std::string* error = nullptr);
+
+    // Entries sorted by total time, at most limit of them (0 = all)
+    nlohmann::json stats(size_t limit = 0);
+    void reset();
+
+    // Statements that ran longer than the slow threshold, newest first. Each entry
+    // carries the duration, the bound parameter types (never their values) and the
+    // EXPLAIN QUERY PLAN output, captured once per normalized statement.
+    nlohmann::json slowQueries();
+    void resetSlowQueries();
+}
+
+// Labels slow-log entries recorded on this thread with a call site (route or writer job)
+class SqlSite {
+public:
+    explicit SqlSite(const char* name);
+    ~SqlSite();
+    SqlSite(const SqlSite&) = delete;
+    SqlSite& operator=(const SqlSite&) = delete;
+
+private:
+    const char* previous;
+};
+
+#endif // SQL_PROFILER_H
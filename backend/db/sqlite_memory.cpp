@@ -0,0 +1,208 @@
+#include "sqlite_memory.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using json = nlohmann::json;
+
+namespace {
+    SqliteMemory::Budget readBudget(const json& section, SqliteMemory::Budget b) {
+        if (!section.is_object()) return b;
+        if (section.contains("cache_kib") && section["cache_kib"].is_number_integer())
+            b.cacheKib = std::max<int64_t>(section["cache_kib"].get<int64_t>(), 0);
+        if (section.contains("lookaside_slot_size") && section["lookaside_slot_size"].is_number_integer())
+            b.lookasideSlotSize = std::max(section["lookaside_slot_size"].get<int>(), 0);
+        if (section.contains("lookaside_slots") && section["lookaside_slots"].is_number_integer())
+            b.lookasideSlots = std::max(section["lookaside_slots"].get<int>(), 0);
+        return b;
+    }
+
+    // Current value, or the high-water mark for the counters SQLite only reports there
+    int64_t dbStatus(sqlite3* db, int op, bool highwater, bool reset) {
+        int current = 0;
+        int peak = 0;
+        if (sqlite3_db_status(db, op, &current, &peak, reset ? 1 : 0) != SQLITE_OK)
+            return 0;
+        return highwater ? peak : current;
+    }
+
+    json status64(int op, bool reset) {
+        sqlite3_int64 current = 0;
+        sqlite3_int64 peak = 0;
+        sqlite3_status64(op, &current, &peak, reset ? 1 : 0);
+        json j;
+        j["current"] = current;
+        j["highwater"] = peak;
+        return j;
+    }
+
+    double ratio(int64_t part, int64_t whole) {
+        return whole > 0 ? static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+    }
+}
+
+namespace SqliteMemory {
+    bool Budget::applyLookaside(sqlite3* db) const {
+        if (lookasideSlotSize <= 0 || lookasideSlots <= 0)
+            return true;
+        // SQLite allocates the buffer itself when none is passed in
+        int rc = sqlite3_db_config(db, SQLITE_DBCONFIG_LOOKASIDE, nullptr, lookasideSlotSize, lookasideSlots);
+        if (rc != SQLITE_OK) {
+            std::cerr << "SQLite lookaside " << lookasideSlots << " x " << lookasideSlotSize
+                      << " B not applied: " << sqlite3_errstr(rc) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool Budget::applyCache(sqlite3* db) const {
+        if (cacheKib <= 0)
+            return true;
+        std::vector<std::string> schemas;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "PRAGMA database_list", -1, &stmt, nullptr) == SQLITE_OK) {
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                const char* name = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+                if (name && std::string(name) != "temp")
+                    schemas.push_back(name);
+            }
+        }
+        sqlite3_finalize(stmt);
+        bool ok = true;
+        for (const std::string& schema : schemas) {
+            // Negative cache_size is KiB rather than pages
+            std::string sql = "PRAGMA \"" + schema + "\".cache_size = -" + std::to_string(cacheKib);
+            ok &= sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+        }
+        return ok;
+    }
+
+    json Budget::toJson() const {
+        json j;
+        j["cache_kib"] = cacheKib;
+        j["lookaside_slot_size"] = lookasideSlotSize;
+        j["lookaside_slots"] = lookasideSlots;
+        j["lookaside_bytes"] = static_cast<int64_t>(lookasideSlotSize) * lookasideSlots;
+        return j;
+    }
+
+    Options Options::fromConfig(const json& section) {
+        Options o;
+        if (!section.is_object()) return o;
+        if (section.contains("read_write"))
+            o.readWrite = readBudget(section["read_write"], o.readWrite);
+        if (section.contains("read_only"))
+            o.readOnly = readBudget(section["read_only"], o.readOnly);
+        if (section.contains("writer"))
+            o.writer = readBudget(section["writer"], o.writer);
+        return o;
+    }
+
+    json Options::toJson() const {
+        json j;
+        j["read_write"] = readWrite.toJson();
+        j["read_only"] = readOnly.toJson();
+        j["writer"] = writer.toJson();
+        return j;
+    }
+
+    Counters Counters::sample(sqlite3* db) {
+        Counters c;
+        if (!db)
+            return c;
+        c.connections = 1;
+        c.cacheUsed = dbStatus(db, SQLITE_DBSTATUS_CACHE_USED, false, false);
+        c.schemaUsed = dbStatus(db, SQLITE_DBSTATUS_SCHEMA_USED, false, false);
+        c.stmtUsed = dbStatus(db, SQLITE_DBSTATUS_STMT_USED, false, false);
+        int current = 0;
+        int peak = 0;
+        // Resetting moves the high-water mark down to the slots in use now
+        sqlite3_db_status(db, SQLITE_DBSTATUS_LOOKASIDE_USED, &current, &peak, 1);
+        c.lookasideUsed = current;
+        c.lookasidePeak = peak;
+        c.cacheHit = dbStatus(db, SQLITE_DBSTATUS_CACHE_HIT, false, true);
+        c.cacheMiss = dbStatus(db, SQLITE_DBSTATUS_CACHE_MISS, false, true);
+        c.cacheWrite = dbStatus(db, SQLITE_DBSTATUS_CACHE_WRITE, false, true);
+        c.cacheSpill = dbStatus(db, SQLITE_DBSTATUS_CACHE_SPILL, false, true);
+        c.lookasideHit = dbStatus(db, SQLITE_DBSTATUS_LOOKASIDE_HIT, true, true);
+        c.lookasideMissSize = dbStatus(db, SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE, true, true);
+        c.lookasideMissFull = dbStatus(db, SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL, true, true);
+        return c;
+    }
+
+    void Counters::merge(const Counters& later) {
+        connections = later.connections;
+        cacheUsed = later.cacheUsed;
+        schemaUsed = later.schemaUsed;
+        stmtUsed = later.stmtUsed;
+        lookasideUsed = later.lookasideUsed;
+        lookasidePeak = std::max(lookasidePeak, later.lookasidePeak);
+        cacheHit += later.cacheHit;
+        cacheMiss += later.cacheMiss;
+        cacheWrite += later.cacheWrite;
+        cacheSpill += later.cacheSpill;
+        lookasideHit += later.lookasideHit;
+        lookasideMissSize += later.lookasideMissSize;
+        lookasideMissFull += later.lookasideMissFull;
+    }
+
+    Counters& Counters::operator+=(const Counters& other) {
+        connections += other.connections;
+        cacheUsed += other.cacheUsed;
+        schemaUsed += other.schemaUsed;
+        stmtUsed += other.stmtUsed;
+        lookasideUsed += other.lookasideUsed;
+        lookasidePeak = std::max(lookasidePeak, other.lookasidePeak);
+        cacheHit += other.cacheHit;
+        cacheMiss += other.cacheMiss;
+        cacheWrite += other.cacheWrite;
+        cacheSpill += other.cacheSpill;
+        lookasideHit += other.lookasideHit;
+        lookasideMissSize += other.lookasideMissSize;
+        lookasideMissFull += other.lookasideMissFull;
+        return *this;
+    }
+
+    void Counters::clearEvents() {
+        lookasidePeak = lookasideUsed;
+        cacheHit = cacheMiss = cacheWrite = cacheSpill = 0;
+        lookasideHit = lookasideMissSize = lookasideMissFull = 0;
+    }
+
+    json Counters::toJson() const {
+        json j;
+        j["connections"] = connections;
+        j["cache_used_bytes"] = cacheUsed;
+        j["schema_used_bytes"] = schemaUsed;
+        j["stmt_used_bytes"] = stmtUsed;
+        j["cache_hit"] = cacheHit;
+        j["cache_miss"] = cacheMiss;
+        j["cache_hit_rate"] = ratio(cacheHit, cacheHit + cacheMiss);
+        j["cache_write"] = cacheWrite;
+        j["cache_spill"] = cacheSpill;
+        j["lookaside_used_slots"] = lookasideUsed;
+        j["lookaside_peak_slots"] = lookasidePeak;
+        j["lookaside_hit"] = lookasideHit;
+        j["lookaside_miss_size"] = lookasideMissSize;
+        j["lookaside_miss_full"] = lookasideMissFull;
+        j["lookaside_hit_rate"] = ratio(lookasideHit, lookasideHit + lookasideMissSize + lookasideMissFull);
+        return j;
+    }
+
+    json processStats(bool reset) {
+        json j;
+        j["memory_used"] = status64(SQLITE_STATUS_MEMORY_USED, reset);
+        j["malloc_count"] = status64(SQLITE_STATUS_MALLOC_COUNT, reset);
+        j["largest_malloc"] = status64(SQLITE_STATUS_MALLOC_SIZE, reset);
+        // Page cache lives in malloc'd overflow unless SQLITE_CONFIG_PAGECACHE is set
+        j["pagecache_used"] = status64(SQLITE_STATUS_PAGECACHE_USED, reset);
+        j["pagecache_overflow"] = status64(SQLITE_STATUS_PAGECACHE_OVERFLOW, reset);
+        j["largest_pagecache_alloc"] = status64(SQLITE_STATUS_PAGECACHE_SIZE, reset);
+        // Distro builds sometimes drop lookaside, which leaves its counters at zero
+        j["lookaside_compiled_in"] = sqlite3_compileoption_used("OMIT_LOOKASIDE") == 0;
+        j["soft_heap_limit"] = sqlite3_soft_heap_limit64(-1);
+        j["hard_heap_limit"] = sqlite3_hard_heap_limit64(-1);
+        return j;
+    }
+}
@@ -0,0 +1,74 @@
+#ifndef SQLITE_MEMORY_H
+#define SQLITE_MEMORY_H
+
+#include <sqlite3.h>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+// Per-connection memory settings and SQLite's own memory accounting. Each kind
+// of connection gets its own page cache and lookaside budget: the read-only
+// pool serves the catalog and is worth a large cache, while the writer mostly
+// touches a few hot pages. The counters come from sqlite3_db_status (per
+// connection) and sqlite3_status64 (process-wide), so cache hit rate and
+// lookaside exhaustion can be checked before changing a budget.
+namespace SqliteMemory {
+    struct Budget {
+        int64_t cacheKib = 0;       // page cache per attached database file; 0 keeps the storage profile's cache_size
+        int lookasideSlotSize = 0;  // bytes per lookaside slot; 0 keeps SQLite's default allocator
+        int lookasideSlots = 0;
+
+        // Lookaside can only be resized while none of it is in use, so call this
+        // straight after sqlite3_open_v2, before anything is prepared
+        bool applyLookaside(sqlite3* db) const;
+        // Call last in the opener: it overrides the storage profile's cache_size
+        // and covers every database attached by then
+        bool applyCache(sqlite3* db) const;
+        nlohmann::json toJson() const;
+    };
+
+    struct Options {
+        Budget readWrite;  // pooled read-write and maintenance connections
+        Budget readOnly;   // GET-route pools, main file and shards
+        Budget writer;     // writer threads, main file and shards
+
+        // Reads db_config.json's "connection_memory" section
+        static Options fromConfig(const nlohmann::json& section);
+        nlohmann::json toJson() const;
+    };
+
+    // sqlite3_db_status figures for one connection, or summed over several.
+    // The *Used fields are current sizes in bytes (lookasideUsed in slots); the
+    // rest count events since the last reset.
+    struct Counters {
+        int64_t connections = 0;
+        int64_t cacheUsed = 0;
+        int64_t schemaUsed = 0;
+        int64_t stmtUsed = 0;
+        int64_t lookasideUsed = 0;
+        int64_t lookasidePeak = 0;
+        int64_t cacheHit = 0;
+        int64_t cacheMiss = 0;
+        int64_t cacheWrite = 0;
+        int64_t cacheSpill = 0;
+        int64_t lookasideHit = 0;
+        int64_t lookasideMissSize = 0;
+        int64_t lookasideMissFull = 0;
+
+        // Reads db's counters and zeroes the event counts, so successive samples
+        // of the same connection can be merged. Only the thread using db may call it.
+        static Counters sample(sqlite3* db);
+        // Folds a later sample of the same connection in: sizes are replaced,
+        // event counts accumulate
+        void merge(const Counters& later);
+        // Adds another connection's figures
+        Counters& operator+=(const Counters& other);
+        void clearEvents();
+        nlohmann::json toJson() const;
+    };
+
+    // Process-wide sqlite3_status64 figures (heap in use, page cache overflow,
+    // largest allocation); reset clears the high-water marks after reading
+    nlohmann::json processStats(bool reset = false);
+}
+
+#endif // SQLITE_MEMORY_H
@@ -0,0 +1,112 @@
+#include "statement_cache.h"
+#include <iterator>
+
+using json = nlohmann::json;
+
+CachedStatement::CachedStatement(StatementCache* cache, StatementCache::Entry* entry, sqlite3_stmt* stmt)
+    : cache(cache), entry(entry), stmt(stmt) {}
+
+CachedStatement::CachedStatement(CachedStatement&& other) noexcept
+    : cache(other.cache), entry(other.entry), stmt(other.stmt) {
+    other.cache = nullptr;
+    other.entry = nullptr;
+    other.stmt = nullptr;
+}
+
+CachedStatement& CachedStatement::operator=(CachedStatement&& other) noexcept {
+    if (this != &other) {
+        release();
+        cache = other.cache;
+        entry = other.entry;
+        stmt = other.stmt;
+        other.cache = nullptr;
+        other.entry = nullptr;
+        other.stmt = nullptr;
+    }
+    return *this;
+}
+
+CachedStatement::~CachedStatement() {
+    release();
+}
+
+void CachedStatement::release() {
+    if (stmt) {
+        cache->giveBack(entry, stmt);
+        stmt = nullptr;
+        entry = nullptr;
+        cache = nullptr;
+    }
+}
+
+StatementCache::StatementCache(sqlite3* db, size_t capacity)
+    : db(db), capacity(capacity), hits(0), misses(0), evictions(0) {}
+
+StatementCache::~StatementCache() {
+    clear();
+}
+
+CachedStatement StatementCache::prepare(const char* sql) {
+    auto it = slots.try_emplace(sql).first;
+    Slot& slot = it->second;
+    if (!slot.idle.empty()) {
+        auto parked = slot.idle.back();
+        slot.idle.pop_back();
+        sqlite3_stmt* stmt = parked->stmt;
+        lru.erase(parked);
+        slot.leased++;
+        hits.fetch_add(1, std::memory_order_relaxed);
+        return CachedStatement(this, &*it, stmt);
+    }
+    misses.fetch_add(1, std::memory_order_relaxed);
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK || !stmt) {
+        sqlite3_finalize(stmt);
+        if (slot.leased == 0) slots.erase(it);
+        return {};
+    }
+    slot.leased++;
+    return CachedStatement(this, &*it, stmt);
+}
+
+void StatementCache::giveBack(Entry* entry, sqlite3_stmt* stmt) {
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    Slot& slot = entry->second;
+    slot.leased--;
+    lru.push_front({entry, stmt});
+    slot.idle.push_back(lru.begin());
+    if (lru.size() > capacity)
+        evictOldest();
+}
+
+void StatementCache::evictOldest() {
+    Parked oldest = lru.back();
+    lru.pop_back();
+    Slot& slot = oldest.entry->second;
+    // Statements of one SQL text are parked in return order, so its oldest is first
+    slot.idle.erase(slot.idle.begin());
+    if (slot.idle.empty() && slot.leased == 0)
+        slots.erase(slots.find(oldest.entry->first));
+    sqlite3_finalize(oldest.stmt);
+    evictions.fetch_add(1, std::memory_order_relaxed);
+}
+
+void StatementCache::clear() {
+    // Entries with outstanding handles stay: those handles point at them
+    for (auto it = slots.begin(); it != slots.end();) {
+        it->second.idle.clear();
+        it = it->second.leased == 0 ? slots.erase(it) : std::next(it);
+    }
+    for (const Parked& parked : lru)
+        sqlite3_finalize(parked.stmt);
+    lru.clear();
+}
+
+json StatementCache::stats() const {
+    json j;
+    j["hits"] = hits.load(std::memory_order_relaxed);
+    j["misses"] = misses.load(std::memory_order_relaxed);
+    j["evictions"] = evictions.load(std::memory_order_relaxed);
+    return j;
+}
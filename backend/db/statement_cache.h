@@ -0,0 +1,84 @@
+#ifndef STATEMENT_CACHE_H
+#define STATEMENT_CACHE_H
+
+#include <sqlite3.h>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+class CachedStatement;
+
+// Prepared statements for one connection, keyed by SQL text. Not thread-safe:
+// it is only used by whoever holds the connection. Idle statements beyond
+// capacity are finalized least recently used first.
+class StatementCache {
+public:
+    StatementCache(sqlite3* db, size_t capacity);
+    ~StatementCache();
+    StatementCache(const StatementCache&) = delete;
+    StatementCache& operator=(const StatementCache&) = delete;
+
+    // Empty handle if the SQL fails to prepare (see sqlite3_errmsg on the connection)
+    CachedStatement prepare(const char* sql);
+    void clear();
+    nlohmann::json stats() const;
+
+private:
+    friend class CachedStatement;
+    struct Slot;
+    using Entry = std::pair<const std::string, Slot>;
+    struct Parked {
+        Entry* entry;
+        sqlite3_stmt* stmt;
+    };
+    struct Slot {
+        std::vector<std::list<Parked>::iterator> idle;  // oldest first
+        size_t leased = 0;
+    };
+
+    void giveBack(Entry* entry, sqlite3_stmt* stmt);
+    void evictOldest();
+
+    sqlite3* db;
+    size_t capacity;
+    // One entry per SQL text while it has idle or leased statements; map nodes
+    // are stable, so handles and parked statements point at their entry
+    std::unordered_map<std::string, Slot> slots;
+    std::list<Parked> lru;  // idle statements, most recently returned first
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<uint64_t> evictions;
+};
+
+// RAII handle on a cached prepared statement. Releasing it resets the statement
+// and clears its bindings, then parks it in the owning connection's cache.
+// Must not outlive the connection lease it was prepared on.
+class CachedStatement {
+public:
+    CachedStatement() = default;
+    CachedStatement(CachedStatement&& other) noexcept;
+    CachedStatement& operator=(CachedStatement&& other) noexcept;
+    CachedStatement(const CachedStatement&) = delete;
+    CachedStatement& operator=(const CachedStatement&) = delete;
+    ~CachedStatement();
+
+    sqlite3_stmt* get() const { return stmt; }
+    operator sqlite3_stmt*() const& { return stmt; }
+    operator sqlite3_stmt*() const&& = delete;
+    void release();
+
+private:
+    friend class StatementCache;
+    CachedStatement(StatementCache* cache, StatementCache::Entry* entry, sqlite3_stmt* stmt);
+
+    StatementCache* cache = nullptr;
+    StatementCache::Entry* entry = nullptr;
+    sqlite3_stmt* stmt = nullptr;
+};
+
+#endif // STATEMENT_CACHE_H
@@ -0,0 +1,111 @@
+#include "storage_profile.h"
+#include <algorithm>
+#include <cctype>
+#include <initializer_list>
+#include <iostream>
+
+using json = nlohmann::json;
+
+namespace {
+    std::string upper(std::string s) {
+        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+        return s;
+    }
+
+    bool oneOf(const std::string& value, std::initializer_list<const char*> allowed) {
+        for (const char* a : allowed)
+            if (value == a) return true;
+        return false;
+    }
+
+    // Overrides a keyword setting if the config value is one SQLite accepts
+    void readKeyword(const json& section, const char* key, std::string& out, std::initializer_list<const char*> allowed) {
+        if (!section.contains(key)) return;
+        if (section[key].is_string()) {
+            std::string v = upper(section[key].get<std::string>());
+            if (oneOf(v, allowed)) {
+                out = v;
+                return;
+            }
+        }
+        std::cerr << "storage." << key << ": unsupported value " << section[key].dump() << ", keeping " << out << std::endl;
+    }
+
+    bool exec(sqlite3* db, const std::string& sql) {
+        char* errMsg = nullptr;
+        int rc = sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &errMsg);
+        if (rc != SQLITE_OK) {
+            std::cerr << "Storage profile: " << sql << " failed: " << (errMsg ? errMsg : sqlite3_errstr(rc)) << std::endl;
+        }
+        if (errMsg) sqlite3_free(errMsg);
+        return rc == SQLITE_OK;
+    }
+}
+
+StorageProfile StorageProfile::preset(const std::string& name) {
+    if (name == "throughput") {
+        return {"throughput", "WAL", "NORMAL", 256ll * 1024 * 1024, -64 * 1024, "MEMORY", 4096, "INCREMENTAL"};
+    }
+    if (name != "durable") {
+        std::cerr << "Unknown storage profile '" << name << "', using durable" << std::endl;
+    }
+    return {"durable", "WAL", "FULL", 0, -8 * 1024, "DEFAULT", 4096, "INCREMENTAL"};
+}
+
+StorageProfile StorageProfile::fromConfig(const json& section) {
+    std::string name = "durable";
+    if (section.is_object() && section.contains("profile") && section["profile"].is_string())
+        name = section["profile"].get<std::string>();
+    StorageProfile p = preset(name);
+    if (!section.is_object()) return p;
+    readKeyword(section, "journal_mode", p.journalMode, {"DELETE", "TRUNCATE", "PERSIST", "MEMORY", "WAL", "OFF"});
+    readKeyword(section, "synchronous", p.synchronous, {"OFF", "NORMAL", "FULL", "EXTRA"});
+    readKeyword(section, "temp_store", p.tempStore, {"DEFAULT", "FILE", "MEMORY"});
+    readKeyword(section, "auto_vacuum", p.autoVacuum, {"NONE", "FULL", "INCREMENTAL"});
+    if (section.contains("mmap_size") && section["mmap_size"].is_number_integer())
+        p.mmapSize = section["mmap_size"].get<int64_t>();
+    if (section.contains("cache_size") && section["cache_size"].is_number_integer())
+        p.cacheSize = section["cache_size"].get<int64_t>();
+    if (section.contains("page_size") && section["page_size"].is_number_integer())
+        p.pageSize = section["page_size"].get<int>();
+    return p;
+}
+
+bool StorageProfile::apply(sqlite3* db, bool readOnly) const {
+    bool ok = true;
+    if (readOnly) {
+        ok &= exec(db, "PRAGMA cache_size = " + std::to_string(cacheSize));
+        ok &= exec(db, "PRAGMA mmap_size = " + std::to_string(mmapSize));
+        ok &= exec(db, "PRAGMA temp_store = " + tempStore);
+        return ok;
+    }
+    // page_size and auto_vacuum only stick before the first table is created (page_size never in WAL mode)
+    sqlite3_stmt* stmt = nullptr;
+    bool empty = false;
+    if (sqlite3_prepare_v2(db, "PRAGMA page_count", -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+        empty = sqlite3_column_int64(stmt, 0) == 0;
+    sqlite3_finalize(stmt);
+    if (empty && pageSize > 0)
+        ok &= exec(db, "PRAGMA page_size = " + std::to_string(pageSize));
+    if (empty)
+        ok &= exec(db, "PRAGMA auto_vacuum = " + autoVacuum);
+    ok &= exec(db, "PRAGMA journal_mode = " + journalMode);
+    ok &= exec(db, "PRAGMA synchronous = " + synchronous);
+    ok &= exec(db, "PRAGMA cache_size = " + std::to_string(cacheSize));
+    ok &= exec(db, "PRAGMA mmap_size = " + std::to_string(mmapSize));
+    ok &= exec(db, "PRAGMA temp_store = " + tempStore);
+    return ok;
+}
+
+json StorageProfile::toJson() const {
+    json j;
+    j["profile"] = name;
+    j["journal_mode"] = journalMode;
+    j["synchronous"] = synchronous;
+    j["mmap_size"] = mmapSize;
+    j["cache_size"] = cacheSize;
+    j["temp_store"] = tempStore;
+    j["page_size"] = pageSize;
+    j["auto_vacuum"] = autoVacuum;
+    return j;
+}
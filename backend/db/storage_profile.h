@@ -0,0 +1,31 @@
+#ifndef STORAGE_PROFILE_H
+#define STORAGE_PROFILE_H
+
+#include <sqlite3.h>
+#include <cstdint>
+#include <string>
+#include <nlohmann/json.hpp>
+
+// PRAGMA settings applied to every connection when it is opened.
+// "durable" keeps fsync-on-commit; "throughput" trades the last commits on
+// power loss for WAL with NORMAL sync, a larger cache and mmap reads.
+struct StorageProfile {
+    std::string name;
+    std::string journalMode;  // DELETE, TRUNCATE, PERSIST, MEMORY, WAL, OFF
+    std::string synchronous;  // OFF, NORMAL, FULL, EXTRA
+    int64_t mmapSize;         // bytes, 0 disables mmap
+    int64_t cacheSize;        // pages if positive, KiB if negative (SQLite semantics)
+    std::string tempStore;    // DEFAULT, FILE, MEMORY
+    int pageSize;             // only takes effect on a new, empty database
+    std::string autoVacuum;   // NONE, FULL, INCREMENTAL; also only on a new database
+
+    static StorageProfile preset(const std::string& name);
+    // Reads {"profile": "...", <overrides>} from db_config.json's "storage" section
+    static StorageProfile fromConfig(const nlohmann::json& section);
+
+    // Read-only connections skip the settings that would write the database header
+    bool apply(sqlite3* db, bool readOnly = false) const;
+    nlohmann::json toJson() const;
+};
+
+#endif // STORAGE_PROFILE_H
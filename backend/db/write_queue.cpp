@@ -0,0 +1,195 @@
+#include "write_queue.h"
+#include <algorithm>
+#include <iostream>
+
+using json = nlohmann::json;
+
+namespace {
+    bool exec(sqlite3* db, const char* sql) {
+        return sqlite3_exec(db, sql, nullptr, nullptr, nullptr) == SQLITE_OK;
+    }
+
+    int execRetrying(sqlite3* db, const char* site, const char* sql) {
+        return BusyRetry::retry(site, [db, sql] { return sqlite3_exec(db, sql, nullptr, nullptr, nullptr); });
+    }
+}
+
+WriteQueue::WriteQueue(Opener opener, Options options)
+    : opener(std::move(opener)), options(options), db(nullptr), stopping(false),
+      batches(0), jobs(0), rolledBackJobs(0), failedBatches(0), busyBatches(0), maxBatchSize(0), totalCommitMicros(0) {
+    worker = std::thread([this] { loop(); });
+}
+
+WriteQueue::~WriteQueue() {
+    stop();
+}
+
+void WriteQueue::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+void WriteQueue::enqueue(Job job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!stopping) {
+            queue.push_back(std::move(job));
+            wake.notify_one();
+            return;
+        }
+    }
+    // Queue already shut down
+    job.complete(Outcome::Failed);
+}
+
+void WriteQueue::loop() {
+    std::vector<Job> batch;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty())
+                break;  // stopping and drained
+            // Give concurrent writers a short window to join this batch
+            auto deadline = std::chrono::steady_clock::now() + options.batchWindow;
+            wake.wait_until(lock, deadline, [this] { return stopping || queue.size() >= options.maxBatch; });
+            size_t n = std::min(queue.size(), std::max<size_t>(options.maxBatch, 1));
+            for (size_t i = 0; i < n; i++) {
+                batch.push_back(std::move(queue.front()));
+                queue.pop_front();
+            }
+        }
+        runBatch(batch);
+        batch.clear();
+    }
+    statements.reset();
+    if (db) {
+        sqlite3_close_v2(db);
+        db = nullptr;
+    }
+    capture.reset();
+}
+
+void WriteQueue::runBatch(std::vector<Job>& batch) {
+    auto start = std::chrono::steady_clock::now();
+    if (!db) {
+        db = opener();
+        if (db) {
+            statements = std::make_unique<StatementCache>(db, options.statementCacheSize);
+            if (options.changes) {
+                capture = std::make_unique<ChangeCapture>(*options.changes, options.changeSource);
+                capture->install(db);
+            }
+        }
+    }
+    bool committed = false;
+    bool busy = false;
+    uint64_t rolledBack = 0;
+    int rc = db ? execRetrying(db, "writer.begin", "BEGIN IMMEDIATE") : SQLITE_CANTOPEN;
+    if (rc == SQLITE_OK) {
+        // Set once SQLite has rolled back the whole transaction (SQLITE_FULL,
+        // IOERR, NOMEM, ...) or a savepoint step fails: the jobs left would run
+        // in autocommit mode, so they are failed without running
+        bool aborted = false;
+        for (Job& job : batch) {
+            if (aborted || !exec(db, "SAVEPOINT write_job")) {
+                aborted = true;
+                job.run = nullptr;
+                continue;
+            }
+            size_t changeMark = capture ? capture->mark() : 0;
+            WriteContext ctx(db, *statements);
+            bool ok = true;
+            try {
+                job.run(ctx);
+            } catch (const std::exception& e) {
+                std::cerr << "Writer: mutation threw: " << e.what() << std::endl;
+                ok = false;
+            }
+            if (sqlite3_get_autocommit(db)) {
+                std::cerr << "Writer: the batch transaction was rolled back: " << sqlite3_errmsg(db) << std::endl;
+                aborted = true;
+                job.run = nullptr;
+                continue;
+            }
+            if (!ok || ctx.isRolledBack()) {
+                aborted = !exec(db, "ROLLBACK TO write_job");
+                if (capture)
+                    capture->rollbackTo(changeMark);
+                rolledBack++;
+                if (!ok)
+                    job.run = nullptr;  // no result to hand back
+            }
+            aborted = aborted || !exec(db, "RELEASE write_job");
+        }
+        // A busy COMMIT leaves the transaction open, so it is safe to retry as is
+        rc = aborted ? SQLITE_ABORT : execRetrying(db, "writer.commit", "COMMIT");
+        committed = rc == SQLITE_OK;
+        if (!committed) {
+            busy = BusyRetry::isBusy(rc);
+            std::cerr << "Writer: batch commit failed: " << (aborted ? "transaction aborted" : sqlite3_errmsg(db)) << std::endl;
+            if (!sqlite3_get_autocommit(db))
+                exec(db, "ROLLBACK");
+            if (capture)
+                capture->discard();
+        } else if (capture) {
+            capture->flush();
+        }
+    } else {
+        busy = BusyRetry::isBusy(rc);
+        std::cerr << "Writer: could not begin batch: " << (db ? sqlite3_errmsg(db) : "no connection") << std::endl;
+    }
+    auto micros = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    // Sampled here because only the writer thread may touch db
+    SqliteMemory::Counters sample = SqliteMemory::Counters::sample(db);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        memoryCounters.merge(sample);
+        batches++;
+        jobs += batch.size();
+        rolledBackJobs += rolledBack;
+        if (!committed) failedBatches++;
+        if (busy) busyBatches++;
+        maxBatchSize = std::max<uint64_t>(maxBatchSize, batch.size());
+        totalCommitMicros += micros;
+    }
+    for (Job& job : batch) {
+        if (committed)
+            job.complete(job.run ? Outcome::Committed : Outcome::Failed);
+        else
+            job.complete(busy ? Outcome::Busy : Outcome::Failed);
+    }
+}
+
+json WriteQueue::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    json j;
+    j["queue_depth"] = queue.size();
+    j["batches"] = batches;
+    j["jobs"] = jobs;
+    j["rolled_back_jobs"] = rolledBackJobs;
+    j["failed_batches"] = failedBatches;
+    j["busy_batches"] = busyBatches;
+    j["max_batch_size"] = maxBatchSize;
+    j["avg_batch_size"] = batches ? static_cast<double>(jobs) / batches : 0.0;
+    j["avg_batch_us"] = batches ? totalCommitMicros / batches : 0;
+    j["batch_window_us"] = options.batchWindow.count();
+    j["max_batch"] = options.maxBatch;
+    if (memoryCounters.connections)
+        j["memory"] = memoryCounters.toJson();
+    return j;
+}
+
+SqliteMemory::Counters WriteQueue::memory(bool reset) {
+    std::lock_guard<std::mutex> lock(mutex);
+    SqliteMemory::Counters c = memoryCounters;
+    if (reset)
+        memoryCounters.clearEvents();
+    return c;
+}
@@ -0,0 +1,152 @@
+#ifndef WRITE_QUEUE_H
+#define WRITE_QUEUE_H
+
+#include <sqlite3.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "busy_retry.h"
+#include "change_feed.h"
+#include "sql_profiler.h"
+#include "sqlite_memory.h"
+#include "statement_cache.h"
+
+// What a queued mutation sees while it runs on the writer thread. Each
+// mutation runs inside its own savepoint within the shared batch transaction.
+class WriteContext {
+public:
+    WriteContext(sqlite3* db, StatementCache& statements) : db(db), statements(statements), rolledBack(false) {}
+
+    operator sqlite3*() const { return db; }
+    CachedStatement prepare(const char* sql) { return statements.prepare(sql); }
+    // Discards this mutation's changes; the rest of the batch still commits
+    void rollback() { rolledBack = true; }
+    bool isRolledBack() const { return rolledBack; }
+
+private:
+    sqlite3* db;
+    StatementCache& statements;
+    bool rolledBack;
+};
+
+// Outcome of a queued mutation: the mutation's return value once its batch has
+// committed, or empty. busy() tells callers the batch failed on lock contention
+// (worth retrying later) rather than on an error.
+template <typename T>
+class WriteResult {
+public:
+    WriteResult() : contended(false) {}
+    explicit WriteResult(T value) : value(std::move(value)), contended(false) {}
+    static WriteResult busyFailure() { WriteResult r; r.contended = true; return r; }
+
+    explicit operator bool() const { return value.has_value(); }
+    T& operator*() { return *value; }
+    T* operator->() { return &*value; }
+    bool busy() const { return contended; }
+
+private:
+    std::optional<T> value;
+    bool contended;
+};
+
+// Single writer thread with group commit. Mutations that arrive within the
+// batch window share one BEGIN IMMEDIATE ... COMMIT (one fsync); each caller's
+// future completes with its own result once the batch has committed, or with
+// an empty WriteResult if the batch could not be committed. BEGIN and COMMIT
+// are retried with jittered backoff when another connection holds the lock.
+class WriteQueue {
+public:
+    using Opener = std::function<sqlite3*()>;
+
+    struct Options {
+        std::chrono::microseconds batchWindow{1000};
+        size_t maxBatch = 64;
+        size_t statementCacheSize = 64;
+        // Committed batches' row changes go here when set, labelled changeSource
+        ChangeFeed* changes = nullptr;
+        std::string changeSource = "writer";
+    };
+
+    WriteQueue(Opener opener, Options options);
+    ~WriteQueue();
+    WriteQueue(const WriteQueue&) = delete;
+    WriteQueue& operator=(const WriteQueue&) = delete;
+
+    // site names the call site in BusyRetry contention stats
+    template <typename Fn>
+    auto submit(Fn fn, const char* site = "writer.job") -> std::future<WriteResult<std::invoke_result_t<Fn&, WriteContext&>>> {
+        using Result = std::invoke_result_t<Fn&, WriteContext&>;
+        auto promise = std::make_shared<std::promise<WriteResult<Result>>>();
+        auto value = std::make_shared<std::optional<Result>>();
+        auto future = promise->get_future();
+        Job job;
+        job.run = [fn = std::move(fn), value, site](WriteContext& ctx) mutable {
+            BusySite scope(site);
+            SqlSite sqlScope(site);
+            value->emplace(fn(ctx));
+        };
+        job.complete = [promise, value](Outcome outcome) {
+            if (outcome == Outcome::Committed && value->has_value())
+                promise->set_value(WriteResult<Result>(std::move(**value)));
+            else if (outcome == Outcome::Busy)
+                promise->set_value(WriteResult<Result>::busyFailure());
+            else
+                promise->set_value(WriteResult<Result>());
+        };
+        enqueue(std::move(job));
+        return future;
+    }
+
+    void stop();
+    nlohmann::json stats() const;
+    // The writer connection's sqlite3_db_status figures as of its last batch;
+    // reset zeroes the event counts after reading
+    SqliteMemory::Counters memory(bool reset = false);
+
+private:
+    enum class Outcome { Committed, Failed, Busy };
+
+    struct Job {
+        std::function<void(WriteContext&)> run;
+        std::function<void(Outcome)> complete;
+    };
+
+    void enqueue(Job job);
+    void loop();
+    void runBatch(std::vector<Job>& batch);
+
+    Opener opener;
+    Options options;
+    sqlite3* db;
+    std::unique_ptr<StatementCache> statements;
+    std::unique_ptr<ChangeCapture> capture;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Job> queue;
+    bool stopping;
+    std::thread worker;
+
+    // Counters are only written by the writer thread, read under the mutex
+    uint64_t batches;
+    uint64_t jobs;
+    uint64_t rolledBackJobs;
+    uint64_t failedBatches;
+    uint64_t busyBatches;
+    uint64_t maxBatchSize;
+    uint64_t totalCommitMicros;
+    SqliteMemory::Counters memoryCounters;
+};
+
+#endif // WRITE_QUEUE_H
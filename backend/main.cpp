@@ -1,11 +1,14 @@
 #include <crow.h>
 #include <curl/curl.h>
 #include "db/connection.h"
+#include "models/Money.h"
 #include "routes/home_routes.h"
 #include "routes/product_routes.h"
 #include "routes/cart_routes.h"
 #include "routes/order_routes.h"
 #include "routes/stripe_routes.h"
+#include "routes/debug_routes.h"
+#include "routes/admin_routes.h"
 #include "utils/cors_helper.h"
 #include "utils/vulnerable_helper.h"
 #include <iostream>
@@ -13,8 +16,26 @@
 #include <nlohmann/json.hpp>
 #include <cstring>
 #include <cstdio>
+#include <cstdlib>
+
+int main(int argc, char** argv) {
+    // --replica: serve GET routes from a copy the primary keeps up to date
+    // (see "replication" in db_config.json); --port N: listen elsewhere than 8005
+    bool replica = false;
+    int port = 8005;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--replica") == 0) {
+            replica = true;
+        } else if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+            port = std::atoi(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--replica] [--port N]" << std::endl;
+            return 2;
+        }
+    }
+    if (replica)
+        DatabaseConnection::runAsReplica();
 
-int main() {
     curl_global_init(CURL_GLOBAL_DEFAULT);
     crow::SimpleApp app;
     
@@ -152,13 +173,11 @@ int main() {
             return CORSHelper::jsonResponse(200, j.dump());
         }
         j["database"] = true;
-        sqlite3* conn = db.getConnection();
-        sqlite3_stmt* stmt = nullptr;
-        if (sqlite3_prepare_v2(conn, "SELECT COUNT(*) FROM products", -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        auto conn = db.getReadConnection();
+        auto stmt = conn.prepare("SELECT COUNT(*) FROM products");
+        if (stmt && sqlite3_step(stmt) == SQLITE_ROW) {
             j["products_count"] = sqlite3_column_int(stmt, 0);
-            sqlite3_finalize(stmt);
         } else {
-            if (stmt) sqlite3_finalize(stmt);
             j["message"] = "Products table missing or error. Schema runs automatically on first start.";
         }
         return CORSHelper::jsonResponse(200, j.dump());
@@ -169,47 +188,45 @@ int main() {
     .methods("GET"_method)
     ([]() {
         auto& db = DatabaseConnection::getInstance();
-        sqlite3* conn = db.getConnection();
-        if (!db.isConnected()) {
+        auto conn = db.getConnection();
+        if (!conn) {
             nlohmann::json e;
             e["success"] = false;
             e["message"] = "Database connection failed";
             return CORSHelper::jsonResponse(500, e.dump());
         }
         int categoryId = 1;
-        sqlite3_stmt* catStmt = nullptr;
-        if (sqlite3_prepare_v2(conn, "SELECT id FROM categories WHERE name = 'T-Shirts' LIMIT 1", -1, &catStmt, nullptr) == SQLITE_OK && sqlite3_step(catStmt) == SQLITE_ROW) {
+        auto catStmt = conn.prepare("SELECT id FROM categories WHERE name = 'T-Shirts' LIMIT 1");
+        if (catStmt && sqlite3_step(catStmt) == SQLITE_ROW) {
             categoryId = sqlite3_column_int(catStmt, 0);
-            sqlite3_finalize(catStmt);
-        } else if (catStmt) sqlite3_finalize(catStmt);
-        struct MenProduct { const char* name; const char* desc; double price; const char* img; int stock; const char* sizes; const char* chart; };
+        }
+        catStmt.release();
+        struct MenProduct { const char* name; const char* desc; Money price; const char* img; int stock; const char* sizes; const char* chart; };
         MenProduct list[] = {
             { "Mercedes-AMG Petronas Formula One Team White T-Shirt",
               "A classic white short-sleeve crew-neck t-shirt featuring the Mercedes-Benz star emblem alongside the AMG PETRONAS FORMULA ONE TEAM logo on the chest. Perfect for fans of motorsport.",
-              34.99, "/images/mercedes-amg-f1-tee.png", 50,
+              Money::fromCents(3499), "/images/mercedes-amg-f1-tee.png", 50,
               "S,M,L,XL,XXL", "Chest:36,38,40,42,44 in;Length:27,28,29,30,31 in;Shoulder:17,18,19,20,21 in;Sleeve:7,7.5,8,8.5,9 in" },
             { "Remember Who You Wanted To Be Black T-Shirt",
               "Black crew-neck t-shirt with inspirational quote REMEMBER WHO YOU WANTED TO BE in dark grey and white. Simple, modern design with soft cotton fabric.",
-              28.99, "/images/remember-who-you-wanted-tee.png", 55,
+              Money::fromCents(2899), "/images/remember-who-you-wanted-tee.png", 55,
               "S,M,L,XL,XXL", "Chest:36,38,40,42,44 in;Length:27,28,29,30,31 in;Shoulder:17,18,19,20,21 in;Sleeve:7,7.5,8,8.5,9 in" },
             { "Abstract Wave Print Short Sleeve Button-Down Shirt",
               "Stylish short-sleeved men's shirt featuring a unique black, grey, and white abstract wave pattern. Perfect for casual wear and modern statement look.",
-              49.99, "/images/abstract-black-grey-shirt.png", 30,
+              Money::fromCents(4999), "/images/abstract-black-grey-shirt.png", 30,
               "S,M,L,XL,XXL", "Chest:38,40,42,44,46 in;Length:29,30,31,32,33 in;Shoulder:18,19,20,21,22 in;Sleeve:6.5,7,7.5,8,8.5 in" },
             { "Tropical Palm Tree Print Button-Up Shirt",
               "Dark grey short-sleeve shirt with white vertical stripe and black palm tree silhouettes. Casual resort wear, lightweight fabric.",
-              44.99, "/images/tropical-palm-shirt.png", 28,
+              Money::fromCents(4499), "/images/tropical-palm-shirt.png", 28,
               "S,M,L,XL,XXL", "Chest:38,40,42,44,46 in;Length:29,30,31,32,33 in;Shoulder:18,19,20,21,22 in;Sleeve:6.5,7,7.5,8,8.5 in" },
             { "Diadora Abstract Graphic White T-Shirt",
               "White crew-neck t-shirt with bold abstract graphic in teal, orange, and black. Diadora branding. Modern, eye-catching design for casual streetwear.",
-              36.99, "/images/diadora-abstract-tee.png", 42,
+              Money::fromCents(3699), "/images/diadora-abstract-tee.png", 42,
               "S,M,L,XL,XXL", "Chest:36,38,40,42,44 in;Length:27,28,29,30,31 in;Shoulder:17,18,19,20,21 in;Sleeve:7,7.5,8,8.5,9 in" },
         };
         int inserted = 0;
-        sqlite3_stmt* checkStmt = nullptr;
-        sqlite3_prepare_v2(conn, "SELECT 1 FROM products WHERE name = ?1", -1, &checkStmt, nullptr);
-        sqlite3_stmt* insStmt = nullptr;
-        sqlite3_prepare_v2(conn, "INSERT INTO products (name, description, price, image_url, category_id, gender, stock_quantity, sizes, size_chart) VALUES (?1, ?2, ?3, ?4, ?5, 'men', ?6, ?7, ?8)", -1, &insStmt, nullptr);
+        auto checkStmt = conn.prepare("SELECT 1 FROM products WHERE name = ?1");
+        auto insStmt = conn.prepare("INSERT INTO products (name, description, price_cents, image_url, category_id, gender, stock_quantity, sizes, size_chart) VALUES (?1, ?2, ?3, ?4, ?5, 'men', ?6, ?7, ?8)");
         for (const auto& p : list) {
             if (checkStmt) {
                 sqlite3_bind_text(checkStmt, 1, p.name, -1, SQLITE_STATIC);
@@ -220,7 +237,7 @@ int main() {
             if (insStmt) {
                 sqlite3_bind_text(insStmt, 1, p.name, -1, SQLITE_STATIC);
                 sqlite3_bind_text(insStmt, 2, p.desc, -1, SQLITE_STATIC);
-                sqlite3_bind_double(insStmt, 3, p.price);
+                sqlite3_bind_int64(insStmt, 3, p.price.cents);
                 sqlite3_bind_text(insStmt, 4, p.img, -1, SQLITE_STATIC);
                 sqlite3_bind_int(insStmt, 5, categoryId);
                 sqlite3_bind_int(insStmt, 6, p.stock);
@@ -230,8 +247,8 @@ int main() {
                 sqlite3_reset(insStmt);
             }
         }
-        if (checkStmt) sqlite3_finalize(checkStmt);
-        if (insStmt) sqlite3_finalize(insStmt);
+        checkStmt.release();
+        insStmt.release();
         nlohmann::json resp;
         resp["success"] = true;
         resp["message"] = "Men's products seed completed.";
@@ -242,21 +259,26 @@ int main() {
     // Setup routes
     setupHomeRoutes(app);
     setupProductRoutes(app);
-    setupCartRoutes(app);
-    setupOrderRoutes(app);
-    setupStripeRoutes(app);
+    // Carts, orders and payments write, and need the user's own latest rows
+    if (!replica) {
+        setupCartRoutes(app);
+        setupOrderRoutes(app);
+        setupStripeRoutes(app);
+        setupAdminRoutes(app);
+    }
+    setupDebugRoutes(app);
     
-    // Initialize database connection (creates lala-store.db from schema if missing)
+    // Initialize database connection and apply pending schema migrations
     auto& db = DatabaseConnection::getInstance();
     if (!db.isConnected()) {
         std::cerr << "Warning: Database connection failed. Some features may not work." << std::endl;
-    } else {
-        db.ensureSchema();
+    } else if (db.ensureSchema()) {
+        db.startReplication();
     }
     
-    std::cout << "Starting LALA STORE server on http://localhost:8005" << std::endl;
-    std::cout << "API endpoints available at http://localhost:8005/api/" << std::endl;
-    app.port(8005).multithreaded().run();
+    std::cout << "Starting LALA STORE " << (replica ? "read replica" : "server") << " on http://localhost:" << port << std::endl;
+    std::cout << "API endpoints available at http://localhost:" << port << "/api/" << std::endl;
+    app.port(port).multithreaded().run();
     
     return 0;
 }
@@ -2,14 +2,16 @@
 #define CART_H
 
 #include <string>
+#include "Money.h"
+#include "Timestamp.h"
 
 struct CartItem {
     int id;
     int user_id;
     int product_id;
     int quantity;
-    double price;
-    std::string created_at;
+    Money price;
+    Timestamp created_at;
     
     // Joined product data
     std::string product_name;
@@ -0,0 +1,45 @@
+#ifndef MONEY_H
+#define MONEY_H
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+// An amount in cents, stored in the *_cents INTEGER columns. Sums and line
+// totals stay in integers, so they are exact; responses print it as a plain
+// decimal number with two places (19.99), without going through double.
+struct Money {
+    int64_t cents = 0;
+
+    static Money fromCents(int64_t cents) { return {cents}; }
+    // For amounts that arrive as decimal numbers (JSON, CSV): rounds to the nearest cent
+    static Money fromDecimal(double amount) { return {std::llround(amount * 100.0)}; }
+
+    Money& operator+=(Money other) { cents += other.cents; return *this; }
+    Money operator+(Money other) const { return {cents + other.cents}; }
+    Money operator*(int64_t quantity) const { return {cents * quantity}; }
+    bool operator==(Money other) const { return cents == other.cents; }
+    bool operator!=(Money other) const { return cents != other.cents; }
+    bool operator<(Money other) const { return cents < other.cents; }
+
+    void appendTo(std::string& out) const {
+        uint64_t magnitude = cents < 0 ? 0 - static_cast<uint64_t>(cents) : static_cast<uint64_t>(cents);
+        if (cents < 0) out += '-';
+        char buf[24];
+        auto res = std::to_chars(buf, buf + sizeof(buf), magnitude / 100);
+        out.append(buf, res.ptr);
+        unsigned fraction = static_cast<unsigned>(magnitude % 100);
+        out += '.';
+        out += static_cast<char>('0' + fraction / 10);
+        out += static_cast<char>('0' + fraction % 10);
+    }
+
+    std::string str() const {
+        std::string out;
+        appendTo(out);
+        return out;
+    }
+};
+
+#endif // MONEY_H
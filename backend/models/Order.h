@@ -2,14 +2,16 @@
 #define ORDER_H
 
 #include <string>
+#include "Money.h"
+#include "Timestamp.h"
 
 struct Order {
     int id;
     int user_id;
-    double total_amount;
+    Money total_amount;
     std::string status; // "pending", "processing", "shipped", "delivered"
     std::string shipping_address;
-    std::string created_at;
+    Timestamp created_at;
 };
 
 struct OrderItem {
@@ -17,7 +19,7 @@ struct OrderItem {
     int order_id;
     int product_id;
     int quantity;
-    double price;
+    Money price;
     std::string product_name;
 };
 
@@ -2,18 +2,28 @@
 #define PRODUCT_H
 
 #include <string>
+#include "Money.h"
+#include "Timestamp.h"
 
 struct Product {
     int id;
     std::string name;
     std::string description;
-    double price;
+    Money price;
     std::string image_url;
     int category_id;
     std::string category_name;
     std::string gender; // "men" or "women"
     int stock_quantity;
-    std::string created_at;
+    Timestamp created_at;
+    std::string sizes;      // comma separated, e.g. "S,M,L"
+    std::string size_chart;
+};
+
+// One size of a product (product_variants); stock_quantity is the sum over them
+struct ProductVariant {
+    std::string size;
+    int stock;
 };
 
 #endif // PRODUCT_H
@@ -0,0 +1,31 @@
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include "../utils/utc_time.h"
+
+// Milliseconds since the Unix epoch, as stored in the created_at_ms columns.
+// Responses carry it as an ISO 8601 UTC string, e.g. "2024-05-01T12:30:00.250Z".
+struct Timestamp {
+    int64_t ms = 0;
+
+    static Timestamp now() {
+        auto since = std::chrono::system_clock::now().time_since_epoch();
+        return {std::chrono::duration_cast<std::chrono::milliseconds>(since).count()};
+    }
+
+    std::string iso() const {
+        std::time_t seconds = static_cast<std::time_t>(ms / 1000);
+        std::tm tm = utcTime(seconds);
+        char buf[32];
+        size_t n = std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+        std::snprintf(buf + n, sizeof(buf) - n, ".%03dZ", static_cast<int>(ms % 1000));
+        return buf;
+    }
+};
+
+#endif // TIMESTAMP_H
@@ -0,0 +1,43 @@
+#include "cart_repository.h"
+#include "../db/query_registry.h"
+
+namespace {
+    using QueryRegistry::Scope;
+
+    std::string selectItems(const char* rest) {
+        return "SELECT " + RowMapping::selectList<CartItem>() +
+               " FROM cart_items ci JOIN products p ON ci.product_id = p.id " + rest;
+    }
+
+    const char* const kForUserSql = QueryRegistry::add("cart.for-user",
+        selectItems("WHERE ci.user_id = ?1 ORDER BY ci.created_at_ms DESC"), Scope::User);
+    const char* const kFindSql = QueryRegistry::add("cart.find",
+        selectItems("WHERE ci.user_id = ?1 AND ci.product_id = ?2"), Scope::User);
+    const char* const kAddSql = QueryRegistry::add("cart.add",
+        "INSERT INTO cart_items (user_id, product_id, quantity, price_cents, created_at_ms) VALUES (?1, ?2, ?3, ?4, ?5)",
+        Scope::User);
+    const char* const kSetQuantitySql = QueryRegistry::add("cart.set-quantity",
+        "UPDATE cart_items SET quantity = ?1 WHERE id = ?2", Scope::User);
+    const char* const kRemoveSql = QueryRegistry::add("cart.remove",
+        "DELETE FROM cart_items WHERE id = ?1", Scope::User);
+}
+
+bool CartRepository::forUser(int userId, std::vector<CartItem>& out) const {
+    return query(kForUserSql, out, userId);
+}
+
+bool CartRepository::find(int userId, int productId, std::optional<CartItem>& out) const {
+    return queryOne(kFindSql, out, userId, productId);
+}
+
+bool CartRepository::add(int userId, int productId, int quantity, Money price) const {
+    return execute(kAddSql, userId, productId, quantity, price, Timestamp::now());
+}
+
+bool CartRepository::setQuantity(int cartItemId, int quantity) const {
+    return execute(kSetQuantitySql, quantity, cartItemId);
+}
+
+bool CartRepository::remove(int cartItemId) const {
+    return execute(kRemoveSql, cartItemId);
+}
@@ -0,0 +1,37 @@
+#ifndef CART_REPOSITORY_H
+#define CART_REPOSITORY_H
+
+#include <optional>
+#include <vector>
+#include "../db/repository.h"
+#include "../models/Cart.h"
+
+template <>
+struct RowMapping::Columns<CartItem> {
+    static constexpr auto list = std::make_tuple(
+        RowMapping::column("id", "ci.id", &CartItem::id),
+        RowMapping::column("user_id", "ci.user_id", &CartItem::user_id),
+        RowMapping::column("product_id", "ci.product_id", &CartItem::product_id),
+        RowMapping::column("quantity", "ci.quantity", &CartItem::quantity),
+        RowMapping::column("price", "ci.price_cents", &CartItem::price),
+        RowMapping::column("created_at", "ci.created_at_ms", &CartItem::created_at),
+        RowMapping::column("product_name", "p.name", &CartItem::product_name),
+        RowMapping::column("product_image", "p.image_url", &CartItem::product_image));
+};
+
+// Cart rows live on the user's shard; product data comes from the catalog join.
+class CartRepository : public Repository {
+public:
+    using Repository::Repository;
+
+    // Newest first
+    bool forUser(int userId, std::vector<CartItem>& out) const;
+    // The user's line for a product, if any
+    bool find(int userId, int productId, std::optional<CartItem>& out) const;
+
+    bool add(int userId, int productId, int quantity, Money price) const;
+    bool setQuantity(int cartItemId, int quantity) const;
+    bool remove(int cartItemId) const;
+};
+
+#endif // CART_REPOSITORY_H
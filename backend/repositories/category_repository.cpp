@@ -0,0 +1,12 @@
+#include "category_repository.h"
+#include "../db/query_registry.h"
+
+namespace {
+    const char* const kAllSql = QueryRegistry::add("categories.all",
+        "SELECT " + RowMapping::selectList<Category>() + " FROM categories ORDER BY name",
+        QueryRegistry::Scope::Catalog);
+}
+
+bool CategoryRepository::all(std::vector<Category>& out) const {
+    return query(kAllSql, out);
+}
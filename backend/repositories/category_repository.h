@@ -0,0 +1,24 @@
+#ifndef CATEGORY_REPOSITORY_H
+#define CATEGORY_REPOSITORY_H
+
+#include <vector>
+#include "../db/repository.h"
+#include "../models/Category.h"
+
+template <>
+struct RowMapping::Columns<Category> {
+    static constexpr auto list = std::make_tuple(
+        RowMapping::column("id", "id", &Category::id),
+        RowMapping::column("name", "name", &Category::name),
+        RowMapping::column("description", "description", &Category::description));
+};
+
+class CategoryRepository : public Repository {
+public:
+    using Repository::Repository;
+
+    // By name
+    bool all(std::vector<Category>& out) const;
+};
+
+#endif // CATEGORY_REPOSITORY_H
@@ -0,0 +1,30 @@
+#include "order_repository.h"
+#include "../db/query_registry.h"
+
+namespace {
+    using QueryRegistry::Scope;
+
+    std::string selectNewest(const char* from, const char* filter) {
+        return "SELECT " + RowMapping::selectList<Order>() + " FROM " + from + " WHERE " + filter +
+               " ORDER BY created_at_ms DESC, id DESC LIMIT ?2";
+    }
+
+    const char* const kHotByUserSql = QueryRegistry::add("orders.hot-by-user",
+        selectNewest("main.orders", "user_id = ?1"), Scope::User);
+    const char* const kHotByStatusSql = QueryRegistry::add("orders.hot-by-status",
+        selectNewest("main.orders", "status = ?1"), Scope::User);
+    const char* const kArchiveByUserSql = QueryRegistry::add("orders.archive-by-user",
+        selectNewest("archive.orders a",
+                     "user_id = ?1 AND NOT EXISTS (SELECT 1 FROM main.orders m WHERE m.id = a.id)"),
+        Scope::Archive);
+    const char* const kArchiveByStatusSql = QueryRegistry::add("orders.archive-by-status",
+        selectNewest("archive.orders a",
+                     "status = ?1 AND NOT EXISTS (SELECT 1 FROM main.orders m WHERE m.id = a.id)"),
+        Scope::Archive);
+}
+
+const char* OrderRepository::newestSql(Tier tier, Filter filter) {
+    if (tier == Tier::Hot)
+        return filter == Filter::ByUser ? kHotByUserSql : kHotByStatusSql;
+    return filter == Filter::ByUser ? kArchiveByUserSql : kArchiveByStatusSql;
+}
@@ -0,0 +1,40 @@
+#ifndef ORDER_REPOSITORY_H
+#define ORDER_REPOSITORY_H
+
+#include <cstdint>
+#include <vector>
+#include "../db/repository.h"
+#include "../models/Order.h"
+
+template <>
+struct RowMapping::Columns<Order> {
+    static constexpr auto list = std::make_tuple(
+        RowMapping::column("id", "id", &Order::id),
+        RowMapping::column("user_id", "user_id", &Order::user_id),
+        RowMapping::column("total_amount", "total_cents", &Order::total_amount),
+        RowMapping::column("status", "status", &Order::status),
+        RowMapping::column("shipping_address", "shipping_address", &Order::shipping_address),
+        RowMapping::column("created_at", "created_at_ms", &Order::created_at));
+};
+
+// Order listings on one user shard, newest first. The hot tier reads main.orders;
+// the archive tier reads archive.orders and skips rows the archiver has copied
+// but not yet deleted from the hot table.
+class OrderRepository : public Repository {
+public:
+    enum class Tier { Hot, Archive };
+    enum class Filter { ByUser, ByStatus };  // user_id = value / status = value
+
+    using Repository::Repository;
+
+    // At most limit rows (-1 = all)
+    template <typename Value>
+    bool newest(Tier tier, Filter filter, const Value& value, int64_t limit, std::vector<Order>& out) const {
+        return query(newestSql(tier, filter), out, value, limit);
+    }
+
+private:
+    static const char* newestSql(Tier tier, Filter filter);
+};
+
+#endif // ORDER_REPOSITORY_H
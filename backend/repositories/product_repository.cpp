@@ -0,0 +1,89 @@
+#include "product_repository.h"
+#include "../db/query_registry.h"
+
+namespace {
+    using QueryRegistry::Scope;
+
+    std::string selectProducts(const std::string& rest) {
+        return "SELECT " + RowMapping::selectList<Product>() +
+               " FROM products p LEFT JOIN categories c ON p.category_id = c.id " + rest;
+    }
+
+    const char* const kByIdSql = QueryRegistry::add("products.by-id",
+        selectProducts("WHERE p.id = ?1"), Scope::Catalog);
+    const char* const kNewestSql = QueryRegistry::add("products.newest",
+        selectProducts("WHERE COALESCE(p.stock_quantity,0) > 0 ORDER BY p.created_at_ms DESC LIMIT ?1"), Scope::Catalog);
+    const char* const kByGenderSql = QueryRegistry::add("products.by-gender",
+        selectProducts("WHERE p.gender = ?1 AND COALESCE(p.stock_quantity,0) > 0 ORDER BY p.created_at_ms DESC"),
+        Scope::Catalog);
+    const char* const kByCategorySql = QueryRegistry::add("products.by-category",
+        selectProducts("WHERE c.name = ?1 AND COALESCE(p.stock_quantity,0) > 0 ORDER BY p.name"), Scope::Catalog);
+    const char* const kSearchSql = QueryRegistry::add("products.search",
+        selectProducts("WHERE p.name LIKE ?1 AND COALESCE(p.stock_quantity,0) > 0 ORDER BY p.name"), Scope::Catalog);
+
+    // Size filters: the in-stock products of one size, from the partial index on product_variants
+    std::string inSize(const char* param) {
+        return std::string("p.id IN (SELECT product_id FROM product_variants WHERE size = ") + param + " AND stock > 0)";
+    }
+
+    const char* const kNewestInSizeSql = QueryRegistry::add("products.newest.size",
+        selectProducts("WHERE " + inSize("?2") + " AND COALESCE(p.stock_quantity,0) > 0 "
+                       "ORDER BY p.created_at_ms DESC LIMIT ?1"), Scope::Catalog);
+    const char* const kByGenderInSizeSql = QueryRegistry::add("products.by-gender.size",
+        selectProducts("WHERE p.gender = ?1 AND " + inSize("?2") + " AND COALESCE(p.stock_quantity,0) > 0 "
+                       "ORDER BY p.created_at_ms DESC"), Scope::Catalog);
+    const char* const kByCategoryInSizeSql = QueryRegistry::add("products.by-category.size",
+        selectProducts("WHERE c.name = ?1 AND " + inSize("?2") + " AND COALESCE(p.stock_quantity,0) > 0 "
+                       "ORDER BY p.name"), Scope::Catalog);
+    const char* const kSearchInSizeSql = QueryRegistry::add("products.search.size",
+        selectProducts("WHERE p.name LIKE ?1 AND " + inSize("?2") + " AND COALESCE(p.stock_quantity,0) > 0 "
+                       "ORDER BY p.name"), Scope::Catalog);
+    const char* const kVariantsSql = QueryRegistry::add("products.variants",
+        "SELECT " + RowMapping::selectList<ProductVariant>() + " FROM product_variants WHERE product_id = ?1 ORDER BY position",
+        Scope::Catalog);
+    const char* const kPriceSql = QueryRegistry::add("products.price",
+        "SELECT price_cents FROM products WHERE id = ?1", Scope::Catalog);
+}
+
+bool ProductRepository::byId(int id, std::optional<Product>& out) const {
+    return queryOne(kByIdSql, out, id);
+}
+
+bool ProductRepository::newest(int limit, std::vector<Product>& out, const std::string& size) const {
+    if (!size.empty())
+        return query(kNewestInSizeSql, out, limit, size);
+    return query(kNewestSql, out, limit);
+}
+
+bool ProductRepository::byGender(const std::string& gender, std::vector<Product>& out, const std::string& size) const {
+    if (!size.empty())
+        return query(kByGenderInSizeSql, out, gender, size);
+    return query(kByGenderSql, out, gender);
+}
+
+bool ProductRepository::byCategory(const std::string& categoryName, std::vector<Product>& out, const std::string& size) const {
+    if (!size.empty())
+        return query(kByCategoryInSizeSql, out, categoryName, size);
+    return query(kByCategorySql, out, categoryName);
+}
+
+bool ProductRepository::search(const std::string& text, std::vector<Product>& out, const std::string& size) const {
+    if (!size.empty())
+        return query(kSearchInSizeSql, out, "%" + text + "%", size);
+    return query(kSearchSql, out, "%" + text + "%");
+}
+
+bool ProductRepository::variants(int id, std::vector<ProductVariant>& out) const {
+    return query(kVariantsSql, out, id);
+}
+
+bool ProductRepository::price(int id, std::optional<Money>& out) const {
+    auto stmt = prepare(kPriceSql);
+    if (!stmt)
+        return false;
+    sqlite3_bind_int(stmt, 1, id);
+    int rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW)
+        out = Money::fromCents(sqlite3_column_int64(stmt, 0));
+    return rc == SQLITE_ROW || rc == SQLITE_DONE;
+}
@@ -0,0 +1,56 @@
+#ifndef PRODUCT_REPOSITORY_H
+#define PRODUCT_REPOSITORY_H
+
+#include <optional>
+#include <string>
+#include <vector>
+#include "../db/repository.h"
+#include "../models/Product.h"
+
+template <>
+struct RowMapping::Columns<Product> {
+    static constexpr auto list = std::make_tuple(
+        RowMapping::column("id", "p.id", &Product::id),
+        RowMapping::column("name", "p.name", &Product::name),
+        RowMapping::column("description", "p.description", &Product::description),
+        RowMapping::column("price", "p.price_cents", &Product::price),
+        RowMapping::column("image_url", "p.image_url", &Product::image_url),
+        RowMapping::column("category_id", "p.category_id", &Product::category_id),
+        RowMapping::column("category_name", "c.name", &Product::category_name),
+        RowMapping::column("gender", "p.gender", &Product::gender),
+        RowMapping::column("stock_quantity", "COALESCE(p.stock_quantity,0)", &Product::stock_quantity),
+        RowMapping::column("created_at", "p.created_at_ms", &Product::created_at),
+        RowMapping::column("sizes", "p.sizes", &Product::sizes),
+        RowMapping::column("size_chart", "p.size_chart", &Product::size_chart));
+};
+
+template <>
+struct RowMapping::Columns<ProductVariant> {
+    static constexpr auto list = std::make_tuple(
+        RowMapping::column("size", "size", &ProductVariant::size),
+        RowMapping::column("stock", "stock", &ProductVariant::stock));
+};
+
+// Catalog reads, with the category name joined in. Listings only include
+// products that are in stock; given a size, only those with that size in stock
+// (product_variants, compared case-insensitively). An empty size means any.
+class ProductRepository : public Repository {
+public:
+    using Repository::Repository;
+
+    bool byId(int id, std::optional<Product>& out) const;
+    // Newest first; limit < 0 returns all of them
+    bool newest(int limit, std::vector<Product>& out, const std::string& size = "") const;
+    bool byGender(const std::string& gender, std::vector<Product>& out, const std::string& size = "") const;
+    // By name
+    bool byCategory(const std::string& categoryName, std::vector<Product>& out, const std::string& size = "") const;
+    // Name contains text, by name
+    bool search(const std::string& text, std::vector<Product>& out, const std::string& size = "") const;
+    // The product's sizes in list order with their stock, sold-out ones included
+    bool variants(int id, std::vector<ProductVariant>& out) const;
+
+    // Current list price; out stays empty for an unknown product
+    bool price(int id, std::optional<Money>& out) const;
+};
+
+#endif // PRODUCT_REPOSITORY_H
@@ -0,0 +1,25 @@
+#include "user_repository.h"
+#include "../db/query_registry.h"
+
+namespace {
+    using QueryRegistry::Scope;
+
+    const char* const kByIdSql = QueryRegistry::add("users.by-id",
+        "SELECT " + RowMapping::selectList<User>() + " FROM users WHERE id = ?1", Scope::Catalog);
+    const char* const kExistsSql = QueryRegistry::add("users.exists",
+        "SELECT 1 FROM users WHERE id = ?1", Scope::Catalog);
+}
+
+bool UserRepository::byId(int id, std::optional<User>& out) const {
+    return queryOne(kByIdSql, out, id);
+}
+
+bool UserRepository::exists(int id, bool& out) const {
+    auto stmt = prepare(kExistsSql);
+    if (!stmt)
+        return false;
+    sqlite3_bind_int(stmt, 1, id);
+    int rc = sqlite3_step(stmt);
+    out = rc == SQLITE_ROW;
+    return rc == SQLITE_ROW || rc == SQLITE_DONE;
+}
@@ -0,0 +1,26 @@
+#ifndef USER_REPOSITORY_H
+#define USER_REPOSITORY_H
+
+#include "../db/repository.h"
+#include "../models/User.h"
+
+// password_hash is deliberately not mapped: nothing that reads users through
+// a repository should ever see it.
+template <>
+struct RowMapping::Columns<User> {
+    static constexpr auto list = std::make_tuple(
+        RowMapping::column("id", "id", &User::id),
+        RowMapping::column("username", "username", &User::username),
+        RowMapping::column("email", "email", &User::email),
+        RowMapping::column("created_at", "created_at", &User::created_at));
+};
+
+class UserRepository : public Repository {
+public:
+    using Repository::Repository;
+
+    bool byId(int id, std::optional<User>& out) const;
+    bool exists(int id, bool& out) const;
+};
+
+#endif // USER_REPOSITORY_H
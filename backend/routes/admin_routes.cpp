@@ -0,0 +1,200 @@
+#include <crow.h>
+#include "../db/connection.h"
+#include "../utils/cors_helper.h"
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+void setupAdminRoutes(crow::SimpleApp& app) {
+    // Start an online backup; progress is polled with GET on the same path
+    CROW_ROUTE(app, "/api/admin/backup")
+    .methods("POST"_method)
+    ([]() {
+        BackupManager* backups = DatabaseConnection::getInstance().backups();
+        if (!backups) {
+            json e; e["success"]=false; e["message"]="Database not connected";
+            return CORSHelper::jsonResponse(500, e.dump());
+        }
+        if (!backups->start()) {
+            json e; e["success"]=false; e["message"]="A backup is already running";
+            e["data"] = backups->status();
+            return CORSHelper::jsonResponse(409, e.dump());
+        }
+        json resp;
+        resp["success"] = true;
+        resp["message"] = "Backup started";
+        resp["data"] = backups->status();
+        return CORSHelper::jsonResponse(202, resp.dump());
+    });
+
+    CROW_ROUTE(app, "/api/admin/backup")
+    .methods("GET"_method)
+    ([]() {
+        BackupManager* backups = DatabaseConnection::getInstance().backups();
+        if (!backups) {
+            json e; e["success"]=false; e["message"]="Database not connected";
+            return CORSHelper::jsonResponse(500, e.dump());
+        }
+        json resp;
+        resp["success"] = true;
+        resp["data"] = backups->status();
+        return CORSHelper::jsonResponse(200, resp.dump());
+    });
+
+    // Run an order archival pass now instead of waiting for the schedule
+    CROW_ROUTE(app, "/api/admin/archive")
+    .methods("POST"_method)
+    ([]() {
+        auto& db = DatabaseConnection::getInstance();
+        OrderArchiver* archiver = db.archiver();
+        if (!archiver) {
+            json e; e["success"]=false; e["message"]="Database not connected";
+            return CORSHelper::jsonResponse(500, e.dump());
+        }
+        if (!db.archiveEnabled()) {
+            json e; e["success"]=false; e["message"]="Order archiving is disabled in db_config.json";
+            return CORSHelper::jsonResponse(409, e.dump());
+        }
+        if (!archiver->start()) {
+            json e; e["success"]=false; e["message"]="An archival pass is already running";
+            e["data"] = archiver->stats();
+            return CORSHelper::jsonResponse(409, e.dump());
+        }
+        json resp;
+        resp["success"] = true;
+        resp["message"] = "Archival pass started";
+        resp["data"] = archiver->stats();
+        return CORSHelper::jsonResponse(202, resp.dump());
+    });
+
+    CROW_ROUTE(app, "/api/admin/archive")
+    .methods("GET"_method)
+    ([]() {
+        OrderArchiver* archiver = DatabaseConnection::getInstance().archiver();
+        if (!archiver) {
+            json e; e["success"]=false; e["message"]="Database not connected";
+            return CORSHelper::jsonResponse(500, e.dump());
+        }
+        json resp;
+        resp["success"] = true;
+        resp["data"] = archiver->stats();
+        return CORSHelper::jsonResponse(200, resp.dump());
+    });
+
+    // Write the in-memory database back to disk now instead of waiting for the interval
+    CROW_ROUTE(app, "/api/admin/memory")
+    .methods("POST"_method)
+    ([]() {
+        MemoryImage* memory = DatabaseConnection::getInstance().memoryImage();
+        if (!memory) {
+            json e; e["success"]=false; e["message"]="In-memory mode is disabled in db_config.json";
+            return CORSHelper::jsonResponse(409, e.dump());
+        }
+        bool ok = memory->persist();
+        json resp;
+        resp["success"] = ok;
+        resp["message"] = ok ? "In-memory database written back" : "Write-back failed";
+        resp["data"] = memory->stats();
+        return CORSHelper::jsonResponse(ok ? 200 : 500, resp.dump());
+    });
+
+    CROW_ROUTE(app, "/api/admin/memory")
+    .methods("GET"_method)
+    ([]() {
+        MemoryImage* memory = DatabaseConnection::getInstance().memoryImage();
+        json resp;
+        resp["success"] = true;
+        resp["data"] = memory ? memory->stats() : json{{"enabled", false}};
+        return CORSHelper::jsonResponse(200, resp.dump());
+    });
+
+    // EXPLAIN every registered query against the live schema: full scans, temp
+    // B-tree sorts, suggested indexes and redundant or unused ones
+    CROW_ROUTE(app, "/api/admin/index-advisor")
+    .methods("GET"_method)
+    ([]() {
+        auto& db = DatabaseConnection::getInstance();
+        if (!db.isConnected()) {
+            json e; e["success"]=false; e["message"]="Database not connected";
+            return CORSHelper::jsonResponse(500, e.dump());
+        }
+        json resp;
+        resp["success"] = true;
+        resp["data"] = db.adviseIndexes();
+        return CORSHelper::jsonResponse(200, resp.dump());
+    });
+
+    // Bulk product import from a CSV or JSONL file in the configured
+    // import.directory (disabled when unset): {"path": "<file in that
+    // directory>", "format": "csv"|"jsonl"} (format defaults to the extension).
+    // Progress and rows/sec are polled with GET on the same path; DELETE cancels.
+    CROW_ROUTE(app, "/api/admin/import")
+    .methods("POST"_method)
+    ([](const crow::request& req) {
+        json body = json::parse(req.body, nullptr, false);
+        if (body.is_discarded() || !body.contains("path") || !body["path"].is_string()) {
+            json e; e["success"]=false; e["message"]="Expected {\"path\": \"...\"}";
+            return CORSHelper::jsonResponse(400, e.dump());
+        }
+        CatalogImporter* importer = DatabaseConnection::getInstance().importer();
+        if (!importer) {
+            json e; e["success"]=false; e["message"]="Database not connected";
+            return CORSHelper::jsonResponse(500, e.dump());
+        }
+        std::string path, error;
+        if (!importer->resolveRequestPath(body["path"].get<std::string>(), path, error)) {
+            json e; e["success"]=false; e["message"]=error;
+            return CORSHelper::jsonResponse(importer->acceptsRequestPaths() ? 400 : 403, e.dump());
+        }
+        CatalogImporter::Format format;
+        std::string formatName = body.contains("format") && body["format"].is_string() ? body["format"].get<std::string>() : "";
+        if (formatName == "csv") {
+            format = CatalogImporter::Format::Csv;
+        } else if (formatName == "jsonl" || formatName == "ndjson") {
+            format = CatalogImporter::Format::Jsonl;
+        } else if (!formatName.empty() || !CatalogImporter::formatFor(path, format)) {
+            json e; e["success"]=false; e["message"]="Format must be csv or jsonl";
+            return CORSHelper::jsonResponse(400, e.dump());
+        }
+        if (!importer->start(path, format)) {
+            json e; e["success"]=false; e["message"]="An import is already running";
+            e["data"] = importer->status();
+            return CORSHelper::jsonResponse(409, e.dump());
+        }
+        json resp;
+        resp["success"] = true;
+        resp["message"] = "Import started";
+        resp["data"] = importer->status();
+        return CORSHelper::jsonResponse(202, resp.dump());
+    });
+
+    CROW_ROUTE(app, "/api/admin/import")
+    .methods("GET"_method)
+    ([]() {
+        CatalogImporter* importer = DatabaseConnection::getInstance().importer();
+        if (!importer) {
+            json e; e["success"]=false; e["message"]="Database not connected";
+            return CORSHelper::jsonResponse(500, e.dump());
+        }
+        json resp;
+        resp["success"] = true;
+        resp["data"] = importer->status();
+        return CORSHelper::jsonResponse(200, resp.dump());
+    });
+
+    CROW_ROUTE(app, "/api/admin/import")
+    .methods("DELETE"_method)
+    ([]() {
+        CatalogImporter* importer = DatabaseConnection::getInstance().importer();
+        if (!importer) {
+            json e; e["success"]=false; e["message"]="Database not connected";
+            return CORSHelper::jsonResponse(500, e.dump());
+        }
+        importer->stop();
+        json resp;
+        resp["success"] = true;
+        resp["message"] = "Import cancelled";
+        resp["data"] = importer->status();
+        return CORSHelper::jsonResponse(200, resp.dump());
+    });
+}
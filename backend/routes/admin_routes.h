@@ -0,0 +1,8 @@
+#ifndef ADMIN_ROUTES_H
+#define ADMIN_ROUTES_H
+
+#include <crow.h>
+
+void setupAdminRoutes(crow::SimpleApp& app);
+
+#endif // ADMIN_ROUTES_H
@@ -0,0 +1,112 @@
+#include <crow.h>
+#include "../db/busy_retry.h"
+#include "../db/connection.h"
+#include "../db/sql_profiler.h"
+#include "../utils/cors_helper.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cstdlib>
+
+using json = nlohmann::json;
+
+void setupDebugRoutes(crow::SimpleApp& app) {
+    // Connection pool occupancy and per-connection checkout wait times
+    CROW_ROUTE(app, "/api/debug/db-pool")
+    ([]() {
+        json resp;
+        resp["success"] = true;
+        resp["data"] = DatabaseConnection::getInstance().poolStats();
+        return CORSHelper::jsonResponse(200, resp.dump());
+    });
+
+    // SQLITE_BUSY waits and write retries per call site; ?reset=1 clears them after reading
+    CROW_ROUTE(app, "/api/debug/contention")
+    ([](const crow::request& req) {
+        json resp;
+        resp["success"] = true;
+        resp["data"] = BusyRetry::stats();
+        resp["policy"] = {
+            {"timeout_ms", BusyRetry::policy().timeoutMs},
+            {"retry_attempts", BusyRetry::policy().retryAttempts},
+            {"retry_base_ms", BusyRetry::policy().retryBaseMs},
+            {"retry_max_ms", BusyRetry::policy().retryMaxMs},
+        };
+        const char* reset = req.url_params.get("reset");
+        if (reset && std::string(reset) == "1")
+            BusyRetry::resetStats();
+        return CORSHelper::jsonResponse(200, resp.dump());
+    });
+
+    // Per-statement time and row counts, most expensive first; ?limit=N, ?reset=1 clears after reading
+    CROW_ROUTE(app, "/api/debug/sql-stats")
+    ([](const crow::request& req) {
+        size_t limit = 0;
+        if (const char* l = req.url_params.get("limit"))
+            limit = static_cast<size_t>(std::max(0L, std::atol(l)));
+        json resp;
+        resp["success"] = true;
+        resp["enabled"] = SqlProfiler::enabled();
+        resp["data"] = SqlProfiler::stats(limit);
+        const char* reset = req.url_params.get("reset");
+        if (reset && std::string(reset) == "1")
+            SqlProfiler::reset();
+        return CORSHelper::jsonResponse(200, resp.dump());
+    });
+
+    // Recent statements over the slow threshold with their query plans; ?reset=1 clears
+    // them and the cached plans after reading
+    CROW_ROUTE(app, "/api/debug/slow-queries")
+    ([](const crow::request& req) {
+        SlowQueryPolicy policy = SqlProfiler::slowLogPolicy();
+        json resp;
+        resp["success"] = true;
+        resp["data"] = SqlProfiler::slowQueries();
+        resp["threshold_ms"] = policy.thresholdMs;
+        resp["log"] = policy.logPath;
+        const char* reset = req.url_params.get("reset");
+        if (reset && std::string(reset) == "1")
+            SqlProfiler::resetSlowQueries();
+        return CORSHelper::jsonResponse(200, resp.dump());
+    });
+
+    // SQLite heap use, and page cache / lookaside hit rates per kind of connection,
+    // as of each connection's last release; ?reset=1 clears counts and high-water marks after reading
+    CROW_ROUTE(app, "/api/debug/sqlite-memory")
+    ([](const crow::request& req) {
+        const char* reset = req.url_params.get("reset");
+        json resp;
+        resp["success"] = true;
+        resp["data"] = DatabaseConnection::getInstance().memoryStats(reset && std::string(reset) == "1");
+        return CORSHelper::jsonResponse(200, resp.dump());
+    });
+
+    // Change feed throughput: batches queued, delivered and dropped, rows per
+    // table, and each subscriber's delivery latency
+    CROW_ROUTE(app, "/api/debug/change-feed")
+    ([]() {
+        ChangeFeed* feed = DatabaseConnection::getInstance().changeFeed();
+        if (!feed) {
+            json e; e["success"]=false; e["message"]="Change feed is disabled or the database is unavailable";
+            return CORSHelper::jsonResponse(404, e.dump());
+        }
+        json resp;
+        resp["success"] = true;
+        resp["data"] = feed->stats();
+        return CORSHelper::jsonResponse(200, resp.dump());
+    });
+
+    // Read replication: on the primary, segments and snapshots written; on a
+    // replica, the sequence applied, segments behind and lag_ms
+    CROW_ROUTE(app, "/api/debug/replication")
+    ([]() {
+        json stats = DatabaseConnection::getInstance().replicationStats();
+        if (stats.is_null()) {
+            json e; e["success"]=false; e["message"]="Replication is not running in this process";
+            return CORSHelper::jsonResponse(404, e.dump());
+        }
+        json resp;
+        resp["success"] = true;
+        resp["data"] = stats;
+        return CORSHelper::jsonResponse(200, resp.dump());
+    });
+}
@@ -0,0 +1,8 @@
+#ifndef DEBUG_ROUTES_H
+#define DEBUG_ROUTES_H
+
+#include <crow.h>
+
+void setupDebugRoutes(crow::SimpleApp& app);
+
+#endif // DEBUG_ROUTES_H
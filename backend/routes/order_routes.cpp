@@ -1,243 +1,308 @@
 #include <crow.h>
 #include "../db/connection.h"
-#include "../models/Order.h"
+#include "../db/query_registry.h"
+#include "../repositories/order_repository.h"
 #include "../utils/cors_helper.h"
+#include "../utils/db_async.h"
 #include "../utils/stripe_client.h"
 #include <sqlite3.h>
 #include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
 #include <sstream>
+#include <vector>
 
 using json = nlohmann::json;
 
 namespace {
-    const char* col_text(sqlite3_stmt* stmt, int col) {
-        const char* p = reinterpret_cast<const char*>(sqlite3_column_text(stmt, col));
-        return p ? p : "";
-    }
+    using QueryRegistry::Scope;
+
+    const char* const kCartForCheckoutSql = QueryRegistry::add("orders.create.cart",
+        "SELECT ci.id, ci.product_id, ci.quantity, ci.price_cents FROM cart_items ci WHERE ci.user_id = ?1", Scope::User);
+    const char* const kInsertPaidOrderSql = QueryRegistry::add("orders.create.paid",
+        "INSERT INTO orders (user_id, total_cents, status, shipping_address, customer_name, phone, payment_method, "
+        "stripe_payment_intent_id, currency, card_brand, card_last4, created_at_ms) "
+        "VALUES (?1, ?2, 'paid', ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10, ?11)", Scope::User);
+    const char* const kInsertPendingOrderSql = QueryRegistry::add("orders.create.pending",
+        "INSERT INTO orders (user_id, total_cents, status, shipping_address, customer_name, phone, payment_method, "
+        "created_at_ms) VALUES (?1, ?2, 'pending', ?3, ?4, ?5, ?6, ?11)", Scope::User);
+    const char* const kInsertItemSql = QueryRegistry::add("orders.create.item",
+        "INSERT INTO order_items (order_id, product_id, quantity, price_cents, created_at_ms) VALUES (?1, ?2, ?3, ?4, ?5)",
+        Scope::User);
+    const char* const kClearCartSql = QueryRegistry::add("orders.create.clear-cart",
+        "DELETE FROM cart_items WHERE user_id = ?1", Scope::User);
+
     int col_int(sqlite3_stmt* stmt, int col) { return sqlite3_column_int(stmt, col); }
-    double col_double(sqlite3_stmt* stmt, int col) { return sqlite3_column_double(stmt, col); }
+
+    int64_t param_int(const crow::request& req, const char* name, int64_t fallback, int64_t lo, int64_t hi) {
+        const char* v = req.url_params.get(name);
+        if (!v || !*v) return fallback;
+        return std::min(std::max<int64_t>(std::atoll(v), lo), hi);
+    }
+
+    // Runs one order-list query on each shard and merges the rows newest first.
+    // A missing archive table (archiving never ran) just contributes no rows.
+    template <typename Value>
+    bool collectOrders(DatabaseConnection& db, const std::vector<size_t>& shards, OrderRepository::Tier tier,
+                       OrderRepository::Filter filter, const Value& value, int64_t perShardLimit, bool optional,
+                       std::vector<Order>& out) {
+        for (size_t shard : shards) {
+            auto conn = db.getUserReadConnection(shard);
+            if (!conn) return false;
+            size_t before = out.size();
+            if (!OrderRepository(conn).newest(tier, filter, value, perShardLimit, out)) {
+                out.resize(before);
+                if (optional) continue;
+                return false;
+            }
+        }
+        if (shards.size() > 1) {
+            std::stable_sort(out.begin(), out.end(), [](const Order& a, const Order& b) {
+                return a.created_at.ms != b.created_at.ms ? a.created_at.ms > b.created_at.ms : a.id > b.id;
+            });
+        }
+        return true;
+    }
+
+    // Orders matching filter (bound to value), newest first.
+    // limit 0 returns every hot order; otherwise the archive is only read when
+    // the requested page runs past the hot rows. source reports which tiers were read.
+    template <typename Value>
+    bool pageOrders(DatabaseConnection& db, const std::vector<size_t>& shards, OrderRepository::Filter filter,
+                    const Value& value, int64_t limit, int64_t offset,
+                    std::vector<Order>& page, std::string& source) {
+        std::vector<Order> hot;
+        if (!collectOrders(db, shards, OrderRepository::Tier::Hot, filter, value, limit > 0 ? offset + limit : -1, false, hot))
+            return false;
+        source = "hot";
+        if (limit == 0) {
+            page = std::move(hot);
+            return true;
+        }
+        for (int64_t i = offset; i < static_cast<int64_t>(hot.size()) && i < offset + limit; i++)
+            page.push_back(std::move(hot[static_cast<size_t>(i)]));
+        int64_t missing = limit - static_cast<int64_t>(page.size());
+        if (missing == 0 || !db.archiveEnabled())
+            return true;
+        // Every hot row was fetched, so the archive page starts where they ran out
+        int64_t archiveOffset = std::max<int64_t>(0, offset - static_cast<int64_t>(hot.size()));
+        std::vector<Order> archived;
+        if (!collectOrders(db, shards, OrderRepository::Tier::Archive, filter, value,
+                           archiveOffset + missing, true, archived))
+            return false;
+        for (int64_t i = archiveOffset; i < static_cast<int64_t>(archived.size()) && i < archiveOffset + missing; i++)
+            page.push_back(std::move(archived[static_cast<size_t>(i)]));
+        source = page.empty() || missing == limit ? "archive" : "hot+archive";
+        return true;
+    }
+
+    // {"success":true,"data":[...],"paging":{...}}
+    std::string orderPageBody(const std::vector<Order>& orders, int64_t limit, int64_t offset, const std::string& source) {
+        std::string body = RowMapping::successBody(orders);
+        json paging = {{"limit", limit}, {"offset", offset}, {"source", source}};
+        body.pop_back();
+        body += ",\"paging\":" + paging.dump() + "}";
+        return body;
+    }
 }
 
 void setupOrderRoutes(crow::SimpleApp& app) {
     CROW_ROUTE(app, "/api/orders/create")
     .methods("POST"_method)
-    ([](const crow::request& req) {
-        try {
-            auto body = json::parse(req.body);
-            int user_id = body["user_id"].get<int>();
-            std::string shipping_address = body.value("shipping_address", "");
-            std::string customer_name = body.value("customer_name", "");
-            std::string phone = body.value("phone", "");
-            std::string payment_method = body.value("payment_method", "");
-            std::string payment_intent_id = body.value("payment_intent_id", "");
-
-            bool isCardPayment = (payment_method == "card" || payment_method == "visa");
-            if (isCardPayment && payment_intent_id.empty()) {
-                json e; e["success"]=false; e["message"]="Card payment requires payment verification. Please complete card entry.";
-                return CORSHelper::jsonResponse(400, e.dump());
-            }
-            std::string card_brand, card_last4, currency = "usd";
-            if (isCardPayment && !payment_intent_id.empty()) {
-                json verify = StripeClient::verifyPaymentIntent(payment_intent_id);
-                if (!verify.value("ok", false)) {
-                    json e; e["success"]=false; e["message"]="Payment verification failed. Please try again.";
+    ([](const crow::request& req, crow::response& res) {
+        DbAsync::respond(res, "orders.create", [&req]() {
+            try {
+                auto body = json::parse(req.body);
+                int user_id = body["user_id"].get<int>();
+                std::string shipping_address = body.value("shipping_address", "");
+                std::string customer_name = body.value("customer_name", "");
+                std::string phone = body.value("phone", "");
+                std::string payment_method = body.value("payment_method", "");
+                std::string payment_intent_id = body.value("payment_intent_id", "");
+
+                bool isCardPayment = (payment_method == "card" || payment_method == "visa");
+                if (isCardPayment && payment_intent_id.empty()) {
+                    json e; e["success"]=false; e["message"]="Card payment requires payment verification. Please complete card entry.";
                     return CORSHelper::jsonResponse(400, e.dump());
                 }
-                json details = StripeClient::getPaymentIntentDetails(payment_intent_id);
-                if (details.value("ok", false)) {
-                    if (details.contains("card_brand")) card_brand = details["card_brand"].get<std::string>();
-                    if (details.contains("card_last4")) card_last4 = details["card_last4"].get<std::string>();
+                std::string card_brand, card_last4, currency = "usd";
+                if (isCardPayment && !payment_intent_id.empty()) {
+                    json verify = StripeClient::verifyPaymentIntent(payment_intent_id);
+                    if (!verify.value("ok", false)) {
+                        json e; e["success"]=false; e["message"]="Payment verification failed. Please try again.";
+                        return CORSHelper::jsonResponse(400, e.dump());
+                    }
+                    json details = StripeClient::getPaymentIntentDetails(payment_intent_id);
+                    if (details.value("ok", false)) {
+                        if (details.contains("card_brand")) card_brand = details["card_brand"].get<std::string>();
+                        if (details.contains("card_last4")) card_last4 = details["card_last4"].get<std::string>();
+                    }
                 }
-            }
 
-            auto& db = DatabaseConnection::getInstance();
-            sqlite3* conn = db.getConnection();
-            if (!db.isConnected()) {
-                json e; e["success"]=false; e["message"]="Database connection failed";
-                return CORSHelper::jsonResponse(500, e.dump());
-            }
+                auto& db = DatabaseConnection::getInstance();
+                auto* writer = db.userWriter(db.userShardFor(user_id));
+                if (!writer) {
+                    json e; e["success"]=false; e["message"]="Database connection failed";
+                    return CORSHelper::jsonResponse(500, e.dump());
+                }
+                auto result = writer->submit([=](WriteContext& tx) -> crow::response {
+                    auto cartStmt = tx.prepare(kCartForCheckoutSql);
+                    if (!cartStmt) {
+                        tx.rollback();
+                        json e; e["success"]=false; e["message"]="Failed to get cart items";
+                        return CORSHelper::jsonResponse(500, e.dump());
+                    }
+                    sqlite3_bind_int(cartStmt, 1, user_id);
+                    std::vector<int> cartItemIds, productIds, quantities;
+                    std::vector<Money> prices;
+                    Money total_amount;
+                    while (sqlite3_step(cartStmt) == SQLITE_ROW) {
+                        cartItemIds.push_back(col_int(cartStmt, 0));
+                        productIds.push_back(col_int(cartStmt, 1));
+                        quantities.push_back(col_int(cartStmt, 2));
+                        Money price = Money::fromCents(sqlite3_column_int64(cartStmt, 3));
+                        prices.push_back(price);
+                        total_amount += price * quantities.back();
+                    }
+                    cartStmt.release();
 
-            if (sqlite3_exec(conn, "BEGIN TRANSACTION", nullptr, nullptr, nullptr) != SQLITE_OK) {
-                json e; e["success"]=false; e["message"]="Failed to start transaction";
-                return CORSHelper::jsonResponse(500, e.dump());
-            }
+                    if (productIds.empty()) {
+                        tx.rollback();
+                        json e; e["success"]=false; e["message"]="Cart is empty";
+                        return CORSHelper::jsonResponse(400, e.dump());
+                    }
 
-            sqlite3_stmt* cartStmt = nullptr;
-            if (sqlite3_prepare_v2(conn, "SELECT ci.id, ci.product_id, ci.quantity, ci.price FROM cart_items ci WHERE ci.user_id = ?1", -1, &cartStmt, nullptr) != SQLITE_OK) {
-                sqlite3_exec(conn, "ROLLBACK", nullptr, nullptr, nullptr);
-                json e; e["success"]=false; e["message"]="Failed to get cart items";
-                return CORSHelper::jsonResponse(500, e.dump());
-            }
-            sqlite3_bind_int(cartStmt, 1, user_id);
-            std::vector<int> cartItemIds, productIds, quantities;
-            std::vector<double> prices;
-            double total_amount = 0.0;
-            while (sqlite3_step(cartStmt) == SQLITE_ROW) {
-                cartItemIds.push_back(col_int(cartStmt, 0));
-                productIds.push_back(col_int(cartStmt, 1));
-                quantities.push_back(col_int(cartStmt, 2));
-                double price = col_double(cartStmt, 3);
-                prices.push_back(price);
-                total_amount += price * quantities.back();
-            }
-            sqlite3_finalize(cartStmt);
+                    const char* orderSql = isCardPayment && !payment_intent_id.empty() ? kInsertPaidOrderSql
+                                                                                       : kInsertPendingOrderSql;
+                    auto orderStmt = tx.prepare(orderSql);
+                    if (!orderStmt) {
+                        tx.rollback();
+                        json e; e["success"]=false; e["message"]="Failed to create order";
+                        return CORSHelper::jsonResponse(500, e.dump());
+                    }
+                    sqlite3_bind_int(orderStmt, 1, user_id);
+                    sqlite3_bind_int64(orderStmt, 2, total_amount.cents);
+                    sqlite3_bind_text(orderStmt, 3, shipping_address.c_str(), -1, SQLITE_TRANSIENT);
+                    sqlite3_bind_text(orderStmt, 4, customer_name.c_str(), -1, SQLITE_TRANSIENT);
+                    sqlite3_bind_text(orderStmt, 5, phone.c_str(), -1, SQLITE_TRANSIENT);
+                    sqlite3_bind_text(orderStmt, 6, payment_method.c_str(), -1, SQLITE_TRANSIENT);
+                    Timestamp createdAt = Timestamp::now();
+                    sqlite3_bind_int64(orderStmt, 11, createdAt.ms);
+                    if (isCardPayment && !payment_intent_id.empty()) {
+                        sqlite3_bind_text(orderStmt, 7, payment_intent_id.c_str(), -1, SQLITE_TRANSIENT);
+                        sqlite3_bind_text(orderStmt, 8, currency.c_str(), -1, SQLITE_TRANSIENT);
+                        sqlite3_bind_text(orderStmt, 9, card_brand.c_str(), -1, SQLITE_TRANSIENT);
+                        sqlite3_bind_text(orderStmt, 10, card_last4.c_str(), -1, SQLITE_TRANSIENT);
+                    }
+                    if (sqlite3_step(orderStmt) != SQLITE_DONE) {
+                        orderStmt.release();
+                        tx.rollback();
+                        json e; e["success"]=false; e["message"]="Failed to create order";
+                        return CORSHelper::jsonResponse(500, e.dump());
+                    }
+                    orderStmt.release();
+                    sqlite3_int64 order_id = sqlite3_last_insert_rowid(tx);
 
-            if (productIds.empty()) {
-                sqlite3_exec(conn, "ROLLBACK", nullptr, nullptr, nullptr);
-                json e; e["success"]=false; e["message"]="Cart is empty";
-                return CORSHelper::jsonResponse(400, e.dump());
-            }
+                    auto itemStmt = tx.prepare(kInsertItemSql);
+                    if (!itemStmt) {
+                        tx.rollback();
+                        json response;
+                        response["success"] = false;
+                        response["message"] = "Failed to create order items";
+                        return crow::response(500, response.dump());
+                    }
+                    for (size_t i = 0; i < productIds.size(); i++) {
+                        sqlite3_bind_int64(itemStmt, 1, order_id);
+                        sqlite3_bind_int(itemStmt, 2, productIds[i]);
+                        sqlite3_bind_int(itemStmt, 3, quantities[i]);
+                        sqlite3_bind_int64(itemStmt, 4, prices[i].cents);
+                        sqlite3_bind_int64(itemStmt, 5, createdAt.ms);
+                        if (sqlite3_step(itemStmt) != SQLITE_DONE) {
+                            itemStmt.release();
+                            tx.rollback();
+                            json response;
+                            response["success"] = false;
+                            response["message"] = "Failed to create order items";
+                            return crow::response(500, response.dump());
+                        }
+                        sqlite3_reset(itemStmt);
+                    }
+                    itemStmt.release();
 
-            sqlite3_stmt* orderStmt = nullptr;
-            const char* orderSql;
-            if (isCardPayment && !payment_intent_id.empty()) {
-                orderSql = "INSERT INTO orders (user_id, total_amount, status, shipping_address, customer_name, phone, payment_method, stripe_payment_intent_id, currency, card_brand, card_last4) VALUES (?1, ?2, 'paid', ?3, ?4, ?5, ?6, ?7, ?8, ?9, ?10)";
-            } else {
-                orderSql = "INSERT INTO orders (user_id, total_amount, status, shipping_address, customer_name, phone, payment_method) VALUES (?1, ?2, 'pending', ?3, ?4, ?5, ?6)";
-            }
-            if (sqlite3_prepare_v2(conn, orderSql, -1, &orderStmt, nullptr) != SQLITE_OK) {
-                sqlite3_exec(conn, "ROLLBACK", nullptr, nullptr, nullptr);
-                json e; e["success"]=false; e["message"]="Failed to create order";
-                return CORSHelper::jsonResponse(500, e.dump());
-            }
-            sqlite3_bind_int(orderStmt, 1, user_id);
-            sqlite3_bind_double(orderStmt, 2, total_amount);
-            sqlite3_bind_text(orderStmt, 3, shipping_address.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_text(orderStmt, 4, customer_name.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_text(orderStmt, 5, phone.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_bind_text(orderStmt, 6, payment_method.c_str(), -1, SQLITE_TRANSIENT);
-            if (isCardPayment && !payment_intent_id.empty()) {
-                sqlite3_bind_text(orderStmt, 7, payment_intent_id.c_str(), -1, SQLITE_TRANSIENT);
-                sqlite3_bind_text(orderStmt, 8, currency.c_str(), -1, SQLITE_TRANSIENT);
-                sqlite3_bind_text(orderStmt, 9, card_brand.c_str(), -1, SQLITE_TRANSIENT);
-                sqlite3_bind_text(orderStmt, 10, card_last4.c_str(), -1, SQLITE_TRANSIENT);
-            }
-            if (sqlite3_step(orderStmt) != SQLITE_DONE) {
-                sqlite3_finalize(orderStmt);
-                sqlite3_exec(conn, "ROLLBACK", nullptr, nullptr, nullptr);
-                json e; e["success"]=false; e["message"]="Failed to create order";
-                return CORSHelper::jsonResponse(500, e.dump());
-            }
-            sqlite3_finalize(orderStmt);
-            sqlite3_int64 order_id = sqlite3_last_insert_rowid(conn);
-
-            sqlite3_stmt* itemStmt = nullptr;
-            if (sqlite3_prepare_v2(conn, "INSERT INTO order_items (order_id, product_id, quantity, price) VALUES (?1, ?2, ?3, ?4)", -1, &itemStmt, nullptr) != SQLITE_OK) {
-                sqlite3_exec(conn, "ROLLBACK", nullptr, nullptr, nullptr);
-                json response;
-                response["success"] = false;
-                response["message"] = "Failed to create order items";
-                return crow::response(500, response.dump());
-            }
-            for (size_t i = 0; i < productIds.size(); i++) {
-                sqlite3_bind_int64(itemStmt, 1, order_id);
-                sqlite3_bind_int(itemStmt, 2, productIds[i]);
-                sqlite3_bind_int(itemStmt, 3, quantities[i]);
-                sqlite3_bind_double(itemStmt, 4, prices[i]);
-                if (sqlite3_step(itemStmt) != SQLITE_DONE) {
-                    sqlite3_finalize(itemStmt);
-                    sqlite3_exec(conn, "ROLLBACK", nullptr, nullptr, nullptr);
+                    auto clearStmt = tx.prepare(kClearCartSql);
+                    if (!clearStmt) {
+                        tx.rollback();
+                        json response;
+                        response["success"] = false;
+                        response["message"] = "Failed to clear cart";
+                        return crow::response(500, response.dump());
+                    }
+                    sqlite3_bind_int(clearStmt, 1, user_id);
+                    sqlite3_step(clearStmt);
+                    clearStmt.release();
+
+                    json response;
+                    response["success"] = true;
+                    response["message"] = "Order created successfully";
+                    response["order_id"] = static_cast<int>(order_id);
+                    return CORSHelper::jsonResponse(200, response.dump());
+                }, "orders.create").get();
+                if (result.busy()) {
+                    json r; r["success"]=false; r["message"]="Database busy, please retry";
+                    auto res = CORSHelper::jsonResponse(503, r.dump());
+                    res.set_header("Retry-After", "1");
+                    return res;
+                }
+                if (!result) {
                     json response;
                     response["success"] = false;
-                    response["message"] = "Failed to create order items";
+                    response["message"] = "Failed to commit transaction";
                     return crow::response(500, response.dump());
                 }
-                sqlite3_reset(itemStmt);
+                return std::move(*result);
+            } catch (const std::exception& e) {
+                json resp; resp["success"]=false; resp["message"]="Invalid request: "+std::string(e.what());
+                return CORSHelper::jsonResponse(400, resp.dump());
             }
-            sqlite3_finalize(itemStmt);
-
-            sqlite3_stmt* clearStmt = nullptr;
-            if (sqlite3_prepare_v2(conn, "DELETE FROM cart_items WHERE user_id = ?1", -1, &clearStmt, nullptr) != SQLITE_OK) {
-                sqlite3_exec(conn, "ROLLBACK", nullptr, nullptr, nullptr);
-                json response;
-                response["success"] = false;
-                response["message"] = "Failed to clear cart";
-                return crow::response(500, response.dump());
-            }
-            sqlite3_bind_int(clearStmt, 1, user_id);
-            sqlite3_step(clearStmt);
-            sqlite3_finalize(clearStmt);
-
-            if (sqlite3_exec(conn, "COMMIT", nullptr, nullptr, nullptr) != SQLITE_OK) {
-                json response;
-                response["success"] = false;
-                response["message"] = "Failed to commit transaction";
-                return crow::response(500, response.dump());
-            }
-
-            json response;
-            response["success"] = true;
-            response["message"] = "Order created successfully";
-            response["order_id"] = static_cast<int>(order_id);
-            return CORSHelper::jsonResponse(200, response.dump());
-        } catch (const std::exception& e) {
-            json resp; resp["success"]=false; resp["message"]="Invalid request: "+std::string(e.what());
-            return CORSHelper::jsonResponse(400, resp.dump());
-        }
+        });
     });
 
+    // Optional ?limit=&offset= paging; without a limit only the hot orders are returned
     CROW_ROUTE(app, "/api/orders/user/<int>")
     .methods("GET"_method)
-    ([](int user_id) {
-        auto& db = DatabaseConnection::getInstance();
-        sqlite3* conn = db.getConnection();
-        if (!db.isConnected()) {
-            return crow::response(500, "Database connection failed");
-        }
-        const char* sql = "SELECT id, user_id, total_amount, status, shipping_address, created_at FROM orders WHERE user_id = ?1 ORDER BY created_at DESC";
-        sqlite3_stmt* stmt = nullptr;
-        if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-            return crow::response(500, "Query failed");
-        }
-        sqlite3_bind_int(stmt, 1, user_id);
-        json orders = json::array();
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            json order;
-            order["id"] = col_int(stmt, 0);
-            order["user_id"] = col_int(stmt, 1);
-            order["total_amount"] = col_double(stmt, 2);
-            order["status"] = col_text(stmt, 3);
-            order["shipping_address"] = col_text(stmt, 4);
-            order["created_at"] = col_text(stmt, 5);
-            orders.push_back(order);
-        }
-        sqlite3_finalize(stmt);
-        json response;
-        response["success"] = true;
-        response["data"] = orders;
-        return CORSHelper::jsonResponse(200, response.dump());
+    ([](const crow::request& req, crow::response& res, int user_id) {
+        DbAsync::respond(res, "orders.by-user", [&req, user_id]() {
+            auto& db = DatabaseConnection::getInstance();
+            int64_t limit = param_int(req, "limit", 0, 0, 500);
+            int64_t offset = param_int(req, "offset", 0, 0, INT32_MAX);
+            std::vector<Order> orders;
+            std::string source;
+            if (!pageOrders(db, {db.userShardFor(user_id)}, OrderRepository::Filter::ByUser, user_id, limit, offset, orders, source)) {
+                return crow::response(500, "Query failed");
+            }
+            return CORSHelper::jsonResponse(200, orderPageBody(orders, limit, offset, source));
+        });
     });
 
     CROW_ROUTE(app, "/api/orders/by-status")
     .methods("GET"_method)
-    ([](const crow::request& req) {
-        std::string status = req.url_params.get("status") ? req.url_params.get("status") : "pending";
-        auto& db = DatabaseConnection::getInstance();
-        sqlite3* conn = db.getConnection();
-        if (!db.isConnected()) {
-            return crow::response(500, "Database connection failed");
-        }
-        const char* sql = "SELECT id, user_id, total_amount, status, shipping_address, created_at FROM orders WHERE status = ?1 ORDER BY created_at DESC";
-        sqlite3_stmt* stmt = nullptr;
-        if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-            return crow::response(500, "Query failed");
-        }
-        sqlite3_bind_text(stmt, 1, status.c_str(), -1, SQLITE_TRANSIENT);
-        json orders = json::array();
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            json order;
-            order["id"] = col_int(stmt, 0);
-            order["user_id"] = col_int(stmt, 1);
-            order["total_amount"] = col_double(stmt, 2);
-            order["status"] = col_text(stmt, 3);
-            order["shipping_address"] = col_text(stmt, 4);
-            order["created_at"] = col_text(stmt, 5);
-            orders.push_back(order);
-        }
-        sqlite3_finalize(stmt);
-        json response;
-        response["success"] = true;
-        response["data"] = orders;
-        return CORSHelper::jsonResponse(200, response.dump());
+    ([](const crow::request& req, crow::response& res) {
+        DbAsync::respond(res, "orders.by-status", [&req]() {
+            std::string status = req.url_params.get("status") ? req.url_params.get("status") : "pending";
+            auto& db = DatabaseConnection::getInstance();
+            int64_t limit = param_int(req, "limit", 0, 0, 500);
+            int64_t offset = param_int(req, "offset", 0, 0, INT32_MAX);
+            // Orders are spread over the user shards; gather from each and merge by creation time
+            std::vector<size_t> shards;
+            for (size_t shard = 0; shard < db.userShardCount(); shard++)
+                shards.push_back(shard);
+            std::vector<Order> orders;
+            std::string source;
+            if (!pageOrders(db, shards, OrderRepository::Filter::ByStatus, status, limit, offset, orders, source)) {
+                return crow::response(500, "Query failed");
+            }
+            return CORSHelper::jsonResponse(200, orderPageBody(orders, limit, offset, source));
+        });
     });
 }
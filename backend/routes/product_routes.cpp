@@ -1,190 +1,111 @@
 #include <crow.h>
 #include "../db/connection.h"
-#include "../models/Product.h"
+#include "../repositories/product_repository.h"
 #include "../utils/cors_helper.h"
-#include <sqlite3.h>
+#include "../utils/db_async.h"
 #include <nlohmann/json.hpp>
-#include <sstream>
+#include <optional>
+#include <vector>
 
 using json = nlohmann::json;
 
 namespace {
-    const char* col_text(sqlite3_stmt* stmt, int col) {
-        const char* p = reinterpret_cast<const char*>(sqlite3_column_text(stmt, col));
-        return p ? p : "";
+    // ?size=XL narrows a listing to products with that size in stock
+    std::string sizeParam(const crow::request& req) {
+        const char* size = req.url_params.get("size");
+        return size ? size : "";
     }
-    int col_int(sqlite3_stmt* stmt, int col) { return sqlite3_column_int(stmt, col); }
-    double col_double(sqlite3_stmt* stmt, int col) { return sqlite3_column_double(stmt, col); }
 }
 
 void setupProductRoutes(crow::SimpleApp& app) {
     CROW_ROUTE(app, "/api/products/details/<int>")
-    ([](int product_id) {
-        auto& db = DatabaseConnection::getInstance();
-        sqlite3* conn = db.getConnection();
-        if (!db.isConnected()) {
-            json e; e["success"]=false; e["message"]="Database connection failed";
-            return CORSHelper::jsonResponse(500, e.dump());
-        }
-        const char* sql = "SELECT p.id, p.name, p.description, p.price, p.image_url, "
-                   "p.category_id, c.name, p.gender, COALESCE(p.stock_quantity,0), p.created_at, p.sizes, p.size_chart "
-                   "FROM products p LEFT JOIN categories c ON p.category_id = c.id WHERE p.id = ?1";
-        sqlite3_stmt* stmt = nullptr;
-        if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-            json e; e["success"]=false; e["message"]="Query failed";
-            return CORSHelper::jsonResponse(500, e.dump());
-        }
-        sqlite3_bind_int(stmt, 1, product_id);
-        int step = sqlite3_step(stmt);
-        if (step != SQLITE_ROW) {
-            sqlite3_finalize(stmt);
-            json resp;
-            resp["success"] = false;
-            resp["message"] = "Product not found";
-            return crow::response(404, resp.dump());
-        }
-        json product;
-        product["id"] = col_int(stmt, 0);
-        product["name"] = col_text(stmt, 1);
-        product["description"] = col_text(stmt, 2);
-        product["price"] = col_double(stmt, 3);
-        product["image_url"] = col_text(stmt, 4);
-        product["category_id"] = col_int(stmt, 5);
-        product["category_name"] = col_text(stmt, 6);
-        product["gender"] = col_text(stmt, 7);
-        product["stock_quantity"] = col_int(stmt, 8);
-        product["created_at"] = col_text(stmt, 9);
-        product["sizes"] = col_text(stmt, 10);
-        product["size_chart"] = col_text(stmt, 11);
-        sqlite3_finalize(stmt);
-        json resp;
-        resp["success"] = true;
-        resp["data"] = product;
-        return CORSHelper::jsonResponse(200, resp.dump());
+    ([](crow::response& res, int product_id) {
+        DbAsync::respond(res, "products.details", [product_id]() {
+            auto& db = DatabaseConnection::getInstance();
+            auto conn = db.getReadConnection();
+            if (!conn) {
+                json e; e["success"]=false; e["message"]="Database connection failed";
+                return CORSHelper::jsonResponse(500, e.dump());
+            }
+            ProductRepository products(conn);
+            std::optional<Product> product;
+            if (!products.byId(product_id, product)) {
+                json e; e["success"]=false; e["message"]="Query failed";
+                return CORSHelper::jsonResponse(500, e.dump());
+            }
+            if (!product) {
+                json resp;
+                resp["success"] = false;
+                resp["message"] = "Product not found";
+                return crow::response(404, resp.dump());
+            }
+            std::vector<ProductVariant> variants;
+            if (!products.variants(product_id, variants)) {
+                json e; e["success"]=false; e["message"]="Query failed";
+                return CORSHelper::jsonResponse(500, e.dump());
+            }
+            // The product object, with its per-size stock added as "variants"
+            std::string body = "{\"success\":true,\"data\":";
+            RowMapping::appendJson(body, *product);
+            body.pop_back();
+            body += ",\"variants\":";
+            RowMapping::appendJson(body, variants);
+            body += "}}";
+            return CORSHelper::jsonResponse(200, body);
+        });
     });
 
     CROW_ROUTE(app, "/api/products")
-    ([]() {
-        auto& db = DatabaseConnection::getInstance();
-        sqlite3* conn = db.getConnection();
-        if (!db.isConnected()) {
-            json e; e["success"]=false; e["message"]="Database connection failed";
-            return CORSHelper::jsonResponse(500, e.dump());
-        }
-        const char* sql = "SELECT p.id, p.name, p.description, p.price, p.image_url, "
-                   "p.category_id, c.name, p.gender, COALESCE(p.stock_quantity,0), p.created_at, p.sizes, p.size_chart "
-                   "FROM products p LEFT JOIN categories c ON p.category_id = c.id "
-                   "WHERE COALESCE(p.stock_quantity,0) > 0 ORDER BY p.created_at DESC";
-        sqlite3_stmt* stmt = nullptr;
-        if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-            json e; e["success"]=false; e["message"]="Query failed";
-            return CORSHelper::jsonResponse(500, e.dump());
-        }
-        json products = json::array();
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            json product;
-            product["id"] = col_int(stmt, 0);
-            product["name"] = col_text(stmt, 1);
-            product["description"] = col_text(stmt, 2);
-            product["price"] = col_double(stmt, 3);
-            product["image_url"] = col_text(stmt, 4);
-            product["category_id"] = col_int(stmt, 5);
-            product["category_name"] = col_text(stmt, 6);
-            product["gender"] = col_text(stmt, 7);
-            product["stock_quantity"] = col_int(stmt, 8);
-            product["created_at"] = col_text(stmt, 9);
-            product["sizes"] = col_text(stmt, 10);
-            product["size_chart"] = col_text(stmt, 11);
-            products.push_back(product);
-        }
-        sqlite3_finalize(stmt);
-        json response;
-        response["success"] = true;
-        response["data"] = products;
-        return CORSHelper::jsonResponse(200, response.dump());
+    ([](const crow::request& req, crow::response& res) {
+        DbAsync::respond(res, "products.list", [size = sizeParam(req)]() {
+            auto& db = DatabaseConnection::getInstance();
+            auto conn = db.getReadConnection();
+            if (!conn) {
+                json e; e["success"]=false; e["message"]="Database connection failed";
+                return CORSHelper::jsonResponse(500, e.dump());
+            }
+            std::vector<Product> products;
+            if (!ProductRepository(conn).newest(-1, products, size)) {
+                json e; e["success"]=false; e["message"]="Query failed";
+                return CORSHelper::jsonResponse(500, e.dump());
+            }
+            return CORSHelper::jsonResponse(200, RowMapping::successBody(products));
+        });
     });
 
     CROW_ROUTE(app, "/api/products/<string>")
-    ([](const std::string& gender) {
-        auto& db = DatabaseConnection::getInstance();
-        sqlite3* conn = db.getConnection();
-        if (!db.isConnected()) {
-            json e; e["success"]=false; e["message"]="Database connection failed";
-            return CORSHelper::jsonResponse(500, e.dump());
-        }
-        const char* sql = "SELECT p.id, p.name, p.description, p.price, p.image_url, "
-                   "p.category_id, c.name, p.gender, COALESCE(p.stock_quantity,0), p.created_at, p.sizes, p.size_chart "
-                   "FROM products p LEFT JOIN categories c ON p.category_id = c.id "
-                   "WHERE p.gender = ?1 AND COALESCE(p.stock_quantity,0) > 0 ORDER BY p.created_at DESC";
-        sqlite3_stmt* stmt = nullptr;
-        if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-            json e; e["success"]=false; e["message"]="Query failed";
-            return CORSHelper::jsonResponse(500, e.dump());
-        }
-        sqlite3_bind_text(stmt, 1, gender.c_str(), -1, SQLITE_TRANSIENT);
-        json products = json::array();
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            json product;
-            product["id"] = col_int(stmt, 0);
-            product["name"] = col_text(stmt, 1);
-            product["description"] = col_text(stmt, 2);
-            product["price"] = col_double(stmt, 3);
-            product["image_url"] = col_text(stmt, 4);
-            product["category_id"] = col_int(stmt, 5);
-            product["category_name"] = col_text(stmt, 6);
-            product["gender"] = col_text(stmt, 7);
-            product["stock_quantity"] = col_int(stmt, 8);
-            product["created_at"] = col_text(stmt, 9);
-            product["sizes"] = col_text(stmt, 10);
-            product["size_chart"] = col_text(stmt, 11);
-            products.push_back(product);
-        }
-        sqlite3_finalize(stmt);
-        json response;
-        response["success"] = true;
-        response["data"] = products;
-        return CORSHelper::jsonResponse(200, response.dump());
+    ([](const crow::request& req, crow::response& res, const std::string& gender) {
+        DbAsync::respond(res, "products.by-gender", [gender, size = sizeParam(req)]() {
+            auto& db = DatabaseConnection::getInstance();
+            auto conn = db.getReadConnection();
+            if (!conn) {
+                json e; e["success"]=false; e["message"]="Database connection failed";
+                return CORSHelper::jsonResponse(500, e.dump());
+            }
+            std::vector<Product> products;
+            if (!ProductRepository(conn).byGender(gender, products, size)) {
+                json e; e["success"]=false; e["message"]="Query failed";
+                return CORSHelper::jsonResponse(500, e.dump());
+            }
+            return CORSHelper::jsonResponse(200, RowMapping::successBody(products));
+        });
     });
 
     CROW_ROUTE(app, "/api/products/category/<string>")
-    ([](const std::string& categoryName) {
-        auto& db = DatabaseConnection::getInstance();
-        sqlite3* conn = db.getConnection();
-        if (!db.isConnected()) {
-            json e; e["success"]=false; e["message"]="Database connection failed";
-            return CORSHelper::jsonResponse(500, e.dump());
-        }
-        const char* sql = "SELECT p.id, p.name, p.description, p.price, p.image_url, "
-                   "p.category_id, c.name, p.gender, COALESCE(p.stock_quantity,0), p.created_at, p.sizes, p.size_chart "
-                   "FROM products p LEFT JOIN categories c ON p.category_id = c.id "
-                   "WHERE c.name = ?1 AND COALESCE(p.stock_quantity,0) > 0 ORDER BY p.name";
-        sqlite3_stmt* stmt = nullptr;
-        if (sqlite3_prepare_v2(conn, sql, -1, &stmt, nullptr) != SQLITE_OK) {
-            json e; e["success"]=false; e["message"]="Query failed";
-            return CORSHelper::jsonResponse(500, e.dump());
-        }
-        sqlite3_bind_text(stmt, 1, categoryName.c_str(), -1, SQLITE_TRANSIENT);
-        json products = json::array();
-        while (sqlite3_step(stmt) == SQLITE_ROW) {
-            json product;
-            product["id"] = col_int(stmt, 0);
-            product["name"] = col_text(stmt, 1);
-            product["description"] = col_text(stmt, 2);
-            product["price"] = col_double(stmt, 3);
-            product["image_url"] = col_text(stmt, 4);
-            product["category_id"] = col_int(stmt, 5);
-            product["category_name"] = col_text(stmt, 6);
-            product["gender"] = col_text(stmt, 7);
-            product["stock_quantity"] = col_int(stmt, 8);
-            product["created_at"] = col_text(stmt, 9);
-            product["sizes"] = col_text(stmt, 10);
-            product["size_chart"] = col_text(stmt, 11);
-            products.push_back(product);
-        }
-        sqlite3_finalize(stmt);
-        json response;
-        response["success"] = true;
-        response["data"] = products;
-        return CORSHelper::jsonResponse(200, response.dump());
+    ([](const crow::request& req, crow::response& res, const std::string& categoryName) {
+        DbAsync::respond(res, "products.by-category", [categoryName, size = sizeParam(req)]() {
+            auto& db = DatabaseConnection::getInstance();
+            auto conn = db.getReadConnection();
+            if (!conn) {
+                json e; e["success"]=false; e["message"]="Database connection failed";
+                return CORSHelper::jsonResponse(500, e.dump());
+            }
+            std::vector<Product> products;
+            if (!ProductRepository(conn).byCategory(categoryName, products, size)) {
+                json e; e["success"]=false; e["message"]="Query failed";
+                return CORSHelper::jsonResponse(500, e.dump());
+            }
+            return CORSHelper::jsonResponse(200, RowMapping::successBody(products));
+        });
     });
 }
@@ -1,12 +1,20 @@
 #include <crow.h>
 #include "../db/connection.h"
+#include "../db/query_registry.h"
 #include "../utils/cors_helper.h"
 #include "../utils/stripe_client.h"
 #include <sqlite3.h>
 #include <nlohmann/json.hpp>
+#include <future>
+#include <vector>
 
 using json = nlohmann::json;
 
+namespace {
+    const char* const kSetStatusByIntentSql = QueryRegistry::add("stripe.set-status",
+        "UPDATE orders SET status = ?1 WHERE stripe_payment_intent_id = ?2", QueryRegistry::Scope::User);
+}
+
 void setupStripeRoutes(crow::SimpleApp& app) {
     StripeClient::init();
     
@@ -90,10 +98,9 @@ void setupStripeRoutes(crow::SimpleApp& app) {
                 return crow::response(200);
             }
             auto& db = DatabaseConnection::getInstance();
-            if (!db.isConnected()) {
+            if (!db.userWriter(0)) {
                 return crow::response(200);
             }
-            sqlite3* conn = db.getConnection();
             const char* newStatus = nullptr;
             if (event_type == "payment_intent.succeeded") {
                 newStatus = "paid";
@@ -101,13 +108,26 @@ void setupStripeRoutes(crow::SimpleApp& app) {
                 newStatus = "payment_failed";
             }
             if (newStatus) {
-                sqlite3_stmt* stmt = nullptr;
-                if (sqlite3_prepare_v2(conn, "UPDATE orders SET status = ?1 WHERE stripe_payment_intent_id = ?2", -1, &stmt, nullptr) == SQLITE_OK) {
-                    sqlite3_bind_text(stmt, 1, newStatus, -1, SQLITE_STATIC);
-                    sqlite3_bind_text(stmt, 2, intent_id.c_str(), -1, SQLITE_TRANSIENT);
-                    sqlite3_step(stmt);
-                    sqlite3_finalize(stmt);
+                // The event does not name the user, so update whichever shard holds the intent
+                size_t shardCount = db.userShardCount();
+                std::vector<std::future<WriteResult<bool>>> updates;
+                for (size_t shard = 0; shard < shardCount; shard++) {
+                    auto* writer = db.userWriter(shard);
+                    if (!writer) continue;
+                    updates.push_back(writer->submit([=](WriteContext& tx) {
+                        auto stmt = tx.prepare(kSetStatusByIntentSql);
+                        if (!stmt) return false;
+                        sqlite3_bind_text(stmt, 1, newStatus, -1, SQLITE_STATIC);
+                        sqlite3_bind_text(stmt, 2, intent_id.c_str(), -1, SQLITE_TRANSIENT);
+                        return sqlite3_step(stmt) == SQLITE_DONE;
+                    }, "stripe.webhook"));
                 }
+                bool busy = false;
+                for (auto& update : updates)
+                    busy |= update.get().busy();
+                // Stripe redelivers on non-2xx, so let it retry when the write lost to lock contention
+                if (busy)
+                    return crow::response(503, "Database busy");
             }
             return crow::response(200);
         } catch (...) {
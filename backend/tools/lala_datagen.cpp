@@ -0,0 +1,547 @@
+// Synthetic dataset for load tests and query-plan work:
+//   lala_datagen <out.db> [--seed N] [--categories N] [--products N] [--users N]
+//                [--orders N] [--carts N] [--product-skew S] [--user-skew S]
+//                [--now-ms T] [--force]
+// Creates a fresh database with the server's migrations applied, then fills it
+// with catalog, users, order history and open carts. Product popularity is
+// Zipfian (a few best sellers take most order lines and cart adds) and so is
+// the number of orders per user, which gives the long tail of one-off buyers
+// next to a few heavy customers. Rows are derived from the seed and the anchor
+// time only (--now-ms, default midnight UTC today), so two runs with the same
+// arguments produce the same rows. Point "database_path" in db_config.json at
+// the output to serve it; with "sharding" enabled the orders would have to be
+// split into shard files first, so leave it off.
+#include "../db/migrations.h"
+#include <sqlite3.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+    struct Options {
+        std::string out;
+        uint64_t seed = 42;
+        int64_t categories = 40;
+        int64_t products = 100000;
+        int64_t users = 100000;
+        int64_t orders = 1000000;
+        int64_t carts = 20000;
+        double productSkew = 1.1;
+        double userSkew = 0.9;
+        int64_t nowMs = 0;
+        bool force = false;
+    };
+
+    const int64_t kDayMs = 86400000;
+    const int64_t kOrderHistoryDays = 730;
+    const int64_t kCatalogHistoryDays = 1095;
+    const int64_t kCartHistoryDays = 14;
+    const int64_t kRowsPerTransaction = 50000;
+
+    // xoshiro256** seeded through splitmix64. The std:: distributions are
+    // implementation-defined, so sampling is done here to keep output identical
+    // across standard libraries.
+    class Rng {
+    public:
+        explicit Rng(uint64_t seed) {
+            for (auto& word : state) {
+                seed += 0x9e3779b97f4a7c15ULL;
+                uint64_t z = seed;
+                z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+                z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+                word = z ^ (z >> 31);
+            }
+        }
+
+        uint64_t next() {
+            uint64_t result = rotl(state[1] * 5, 7) * 9;
+            uint64_t t = state[1] << 17;
+            state[2] ^= state[0];
+            state[3] ^= state[1];
+            state[1] ^= state[2];
+            state[0] ^= state[3];
+            state[2] ^= t;
+            state[3] = rotl(state[3], 45);
+            return result;
+        }
+        // [0, 1)
+        double unit() { return static_cast<double>(next() >> 11) * 0x1.0p-53; }
+        // [0, n)
+        int64_t below(int64_t n) { return static_cast<int64_t>(unit() * static_cast<double>(n)); }
+        // [lo, hi]
+        int64_t between(int64_t lo, int64_t hi) { return lo + below(hi - lo + 1); }
+        bool chance(double p) { return unit() < p; }
+
+    private:
+        static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+        uint64_t state[4];
+    };
+
+    // Draws ids firstId..firstId+n-1 with P(rank k) proportional to 1/k^s.
+    // Ranks map to ids through a seeded shuffle, so the popular rows are spread
+    // over the table rather than being the oldest ones.
+    class Zipf {
+    public:
+        Zipf(int64_t n, double s, int64_t firstId, Rng& rng) : cdf(static_cast<size_t>(n)), ids(static_cast<size_t>(n)) {
+            double sum = 0;
+            for (int64_t k = 0; k < n; k++) {
+                sum += 1.0 / std::pow(static_cast<double>(k + 1), s);
+                cdf[k] = sum;
+            }
+            for (auto& c : cdf)
+                c /= sum;
+            for (int64_t k = 0; k < n; k++)
+                ids[k] = firstId + k;
+            for (int64_t k = n - 1; k > 0; k--)
+                std::swap(ids[k], ids[rng.below(k + 1)]);
+        }
+
+        int64_t sample(Rng& rng) const {
+            auto it = std::upper_bound(cdf.begin(), cdf.end(), rng.unit());
+            size_t rank = std::min(static_cast<size_t>(it - cdf.begin()), cdf.size() - 1);
+            return ids[rank];
+        }
+        // Share of draws that land on the top fraction of ranks
+        double headShare(double fraction) const {
+            size_t k = std::max<size_t>(1, static_cast<size_t>(fraction * cdf.size()));
+            return cdf[k - 1];
+        }
+
+    private:
+        std::vector<double> cdf;
+        std::vector<int64_t> ids;
+    };
+
+    const char* const kAdjectives[] = {
+        "Classic", "Slim", "Relaxed", "Vintage", "Essential", "Organic", "Urban", "Coastal",
+        "Heritage", "Everyday", "Premium", "Cropped", "Oversized", "Tailored", "Washed", "Lightweight"};
+    const char* const kNouns[] = {
+        "Tee", "Jeans", "Dress", "Jacket", "Sneakers", "Hoodie", "Shirt", "Chinos",
+        "Skirt", "Coat", "Boots", "Sweater", "Shorts", "Blazer", "Cardigan", "Parka"};
+    const char* const kCategoryNames[] = {
+        "Tops", "Bottoms", "Outerwear", "Footwear", "Knitwear", "Activewear", "Accessories", "Denim",
+        "Loungewear", "Swimwear", "Formal", "Basics"};
+    const char* const kCities[] = {
+        "Springfield", "Riverton", "Lakeside", "Fairview", "Greenville", "Madison", "Ashland", "Clayton"};
+    const char* const kStreets[] = {"Main St", "Oak Ave", "Maple Rd", "Cedar Ln", "Park Blvd", "Hill St"};
+    const char* const kSizeSets[] = {"XS,S,M,L,XL", "S,M,L,XL", "S,M,L", "28,30,32,34,36", "6,7,8,9,10,11", "One Size"};
+    const char* const kCardBrands[] = {"visa", "mastercard", "amex"};
+
+    template <size_t N>
+    const char* pick(const char* const (&items)[N], Rng& rng) {
+        return items[rng.below(static_cast<int64_t>(N))];
+    }
+
+    int usage() {
+        std::cerr << "usage: lala_datagen <out.db> [--seed N] [--categories N] [--products N] [--users N]\n"
+                     "                    [--orders N] [--carts N] [--product-skew S] [--user-skew S]\n"
+                     "                    [--now-ms T] [--force]" << std::endl;
+        return 2;
+    }
+
+    bool parseArgs(int argc, char** argv, Options& o) {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--force") {
+                o.force = true;
+                continue;
+            }
+            if (arg[0] != '-') {
+                if (!o.out.empty())
+                    return false;
+                o.out = arg;
+                continue;
+            }
+            if (i + 1 >= argc)
+                return false;
+            char* end = nullptr;
+            const char* value = argv[++i];
+            if (arg == "--product-skew" || arg == "--user-skew") {
+                double s = std::strtod(value, &end);
+                if (*end || s < 0)
+                    return false;
+                (arg == "--product-skew" ? o.productSkew : o.userSkew) = s;
+                continue;
+            }
+            long long n = std::strtoll(value, &end, 10);
+            if (*end || n < 0)
+                return false;
+            if (arg == "--seed") o.seed = static_cast<uint64_t>(n);
+            else if (arg == "--categories") o.categories = n;
+            else if (arg == "--products") o.products = n;
+            else if (arg == "--users") o.users = n;
+            else if (arg == "--orders") o.orders = n;
+            else if (arg == "--carts") o.carts = n;
+            else if (arg == "--now-ms") o.nowMs = n;
+            else return false;
+        }
+        return !o.out.empty() && o.categories > 0 && o.products > 0 && (o.users > 0 || (o.orders == 0 && o.carts == 0));
+    }
+
+    bool exec(sqlite3* db, const std::string& sql) {
+        char* err = nullptr;
+        if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &err) != SQLITE_OK) {
+            std::cerr << "SQL error: " << (err ? err : "unknown") << "\n  in: " << sql.substr(0, 200) << std::endl;
+            sqlite3_free(err);
+            return false;
+        }
+        return true;
+    }
+
+    int64_t scalar(sqlite3* db, const char* sql) {
+        sqlite3_stmt* stmt = nullptr;
+        int64_t value = 0;
+        if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+            value = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+        return value;
+    }
+
+    // Open write transaction, committed every kRowsPerTransaction rows. Shared
+    // by loaders that interleave, like an order and its lines.
+    class Batch {
+    public:
+        explicit Batch(sqlite3* db) : db(db) {}
+
+        bool begin() { return pending > 0 || exec(db, "BEGIN"); }
+        bool added() { return ++pending < kRowsPerTransaction || commit(); }
+        void abort() {
+            if (pending > 0)
+                exec(db, "ROLLBACK");
+            pending = 0;
+        }
+        bool commit() {
+            if (pending == 0)
+                return true;
+            pending = 0;
+            return exec(db, "COMMIT");
+        }
+
+    private:
+        sqlite3* db;
+        int64_t pending = 0;
+    };
+
+    // One cached INSERT per table
+    class Loader {
+    public:
+        Loader(sqlite3* db, Batch& batch, const char* table, const char* sql) : db(db), batch(batch), table(table) {
+            if (sqlite3_prepare_v3(db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK)
+                std::cerr << "Prepare failed for " << table << ": " << sqlite3_errmsg(db) << std::endl;
+            start = std::chrono::steady_clock::now();
+        }
+        ~Loader() { sqlite3_finalize(stmt); }
+
+        sqlite3_stmt* row() { return stmt; }
+
+        bool insert() {
+            if (!stmt || !batch.begin())
+                return false;
+            int rc = sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+            if (rc != SQLITE_DONE) {
+                std::cerr << "Insert into " << table << " failed: " << sqlite3_errmsg(db) << std::endl;
+                batch.abort();
+                return false;
+            }
+            rows++;
+            return batch.added();
+        }
+
+        // Commits and prints the table's row count and rate
+        bool finish() {
+            if (!batch.commit())
+                return false;
+            double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::fprintf(stderr, "%-12s %12lld rows %8.2f s %10.0f rows/s\n", table,
+                         static_cast<long long>(rows), secs, secs > 0 ? rows / secs : 0.0);
+            return true;
+        }
+
+    private:
+        sqlite3* db;
+        Batch& batch;
+        const char* table;
+        sqlite3_stmt* stmt = nullptr;
+        int64_t rows = 0;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    void bindText(sqlite3_stmt* stmt, int i, const std::string& s) {
+        sqlite3_bind_text(stmt, i, s.c_str(), static_cast<int>(s.size()), SQLITE_TRANSIENT);
+    }
+
+    // Order status by age: recent orders are still moving through fulfilment,
+    // older ones have settled as delivered, cancelled or failed.
+    const char* orderStatus(int64_t ageMs, Rng& rng) {
+        double u = rng.unit();
+        if (ageMs < kDayMs) {
+            if (u < 0.35) return "pending";
+            if (u < 0.65) return "paid";
+            if (u < 0.85) return "processing";
+            if (u < 0.95) return "payment_failed";
+            return "cancelled";
+        }
+        if (ageMs < 7 * kDayMs) {
+            if (u < 0.15) return "processing";
+            if (u < 0.70) return "shipped";
+            if (u < 0.90) return "delivered";
+            if (u < 0.96) return "cancelled";
+            return "payment_failed";
+        }
+        if (u < 0.91) return "delivered";
+        if (u < 0.97) return "cancelled";
+        return "payment_failed";
+    }
+}
+
+int main(int argc, char** argv) {
+    Options o;
+    if (!parseArgs(argc, argv, o))
+        return usage();
+    if (o.nowMs == 0) {
+        auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        o.nowMs = now - now % kDayMs;
+    }
+
+    std::error_code ec;
+    if (std::filesystem::exists(o.out, ec)) {
+        if (!o.force) {
+            std::cerr << o.out << " exists; pass --force to replace it" << std::endl;
+            return 1;
+        }
+        for (const char* suffix : {"", "-journal", "-wal", "-shm"})
+            std::filesystem::remove(o.out + suffix, ec);
+    }
+    std::string databaseDir = MigrationRunner::findDatabaseDir();
+    if (databaseDir.empty()) {
+        std::cerr << "Cannot find the database/ directory with the migrations; run from the repo or backend/" << std::endl;
+        return 1;
+    }
+
+    sqlite3* db = nullptr;
+    if (sqlite3_open(o.out.c_str(), &db) != SQLITE_OK) {
+        std::cerr << "Cannot create " << o.out << ": " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return 1;
+    }
+    MigrationRunner migrations(MigrationRunner::load(databaseDir));
+    if (!migrations.run(db)) {
+        sqlite3_close(db);
+        return 1;
+    }
+
+    // A throwaway file: no journal, no syncs, and secondary indexes built once
+    // at the end instead of maintained row by row.
+    exec(db, "PRAGMA journal_mode=OFF; PRAGMA synchronous=OFF; PRAGMA locking_mode=EXCLUSIVE;"
+             "PRAGMA temp_store=MEMORY; PRAGMA cache_size=-262144; PRAGMA foreign_keys=OFF");
+    std::vector<std::pair<std::string, std::string>> indexes;
+    {
+        sqlite3_stmt* stmt = nullptr;
+        sqlite3_prepare_v2(db, "SELECT name, sql FROM sqlite_master WHERE type = 'index' AND sql IS NOT NULL "
+                               "AND tbl_name IN ('products', 'users', 'cart_items', 'orders', 'order_items')",
+                           -1, &stmt, nullptr);
+        while (stmt && sqlite3_step(stmt) == SQLITE_ROW)
+            indexes.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)),
+                                 reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)));
+        sqlite3_finalize(stmt);
+    }
+    for (const auto& index : indexes)
+        exec(db, "DROP INDEX \"" + index.first + "\"");
+
+    auto start = std::chrono::steady_clock::now();
+    std::fprintf(stderr, "seed %llu, anchor %lld ms\n", static_cast<unsigned long long>(o.seed),
+                 static_cast<long long>(o.nowMs));
+    Rng rng(o.seed);
+    Batch batch(db);
+    bool ok = true;
+
+    // Categories: the seeded ones plus generated names
+    int64_t firstCategory = scalar(db, "SELECT COALESCE(MAX(id), 0) FROM categories") + 1;
+    {
+        Loader load(db, batch, "categories", "INSERT INTO categories (id, name, description) VALUES (?, ?, ?)");
+        for (int64_t i = 0; ok && i < o.categories; i++) {
+            sqlite3_stmt* s = load.row();
+            std::string name = std::string(kCategoryNames[i % 12]) + " " + std::to_string(i / 12 + 1);
+            sqlite3_bind_int64(s, 1, firstCategory + i);
+            bindText(s, 2, name);
+            bindText(s, 3, "Generated category " + std::to_string(i + 1));
+            ok = load.insert();
+        }
+        ok = ok && load.finish();
+    }
+
+    // Products, added over the catalog history in id order. Category sizes are
+    // skewed too; about one in eight is out of stock.
+    int64_t firstProduct = scalar(db, "SELECT COALESCE(MAX(id), 0) FROM products") + 1;
+    std::vector<int64_t> productPrice(static_cast<size_t>(o.products));
+    {
+        Zipf categoryOf(o.categories, 0.8, firstCategory, rng);
+        Loader load(db, batch, "products",
+            "INSERT INTO products (id, name, description, price_cents, image_url, category_id, gender, "
+            "stock_quantity, sizes, sku, created_at_ms) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+        int64_t catalogStart = o.nowMs - kCatalogHistoryDays * kDayMs;
+        for (int64_t i = 0; ok && i < o.products; i++) {
+            sqlite3_stmt* s = load.row();
+            int64_t id = firstProduct + i;
+            // Log-uniform between $5 and $250, rounded to .99
+            int64_t dollars = static_cast<int64_t>(std::exp(std::log(5.0) + rng.unit() * std::log(50.0)));
+            productPrice[i] = dollars * 100 + 99;
+            double g = rng.unit();
+            char sku[32];
+            std::snprintf(sku, sizeof(sku), "GEN-%08lld", static_cast<long long>(i + 1));
+            sqlite3_bind_int64(s, 1, id);
+            bindText(s, 2, std::string(pick(kAdjectives, rng)) + " " + pick(kNouns, rng) + " " + std::to_string(i + 1));
+            bindText(s, 3, "Generated product " + std::to_string(i + 1));
+            sqlite3_bind_int64(s, 4, productPrice[i]);
+            bindText(s, 5, "/images/products/gen-" + std::to_string((i % 500) + 1) + ".jpg");
+            sqlite3_bind_int64(s, 6, categoryOf.sample(rng));
+            sqlite3_bind_text(s, 7, g < 0.45 ? "men" : g < 0.9 ? "women" : "unisex", -1, SQLITE_STATIC);
+            sqlite3_bind_int64(s, 8, rng.chance(0.125) ? 0 : rng.between(1, 200));
+            sqlite3_bind_text(s, 9, pick(kSizeSets, rng), -1, SQLITE_STATIC);
+            sqlite3_bind_text(s, 10, sku, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(s, 11, catalogStart + (kCatalogHistoryDays * kDayMs) * i / o.products);
+            ok = load.insert();
+        }
+        ok = ok && load.finish();
+    }
+
+    int64_t firstUser = scalar(db, "SELECT COALESCE(MAX(id), 0) FROM users") + 1;
+    {
+        // Same placeholder hash as the seeded test user
+        std::string hash = "$2b$10$example_hash_replace_in_production";
+        Loader load(db, batch, "users", "INSERT INTO users (id, username, email, password_hash) VALUES (?, ?, ?, ?)");
+        for (int64_t i = 0; ok && i < o.users; i++) {
+            sqlite3_stmt* s = load.row();
+            std::string name = "user" + std::to_string(i + 1);
+            sqlite3_bind_int64(s, 1, firstUser + i);
+            bindText(s, 2, name);
+            bindText(s, 3, name + "@example.com");
+            bindText(s, 4, hash);
+            ok = load.insert();
+        }
+        ok = ok && load.finish();
+    }
+
+    // Orders in time order over the history window, placed by Zipf-chosen
+    // users; each has one to eight lines of Zipf-chosen products.
+    if (ok && o.orders > 0) {
+        Zipf productOf(o.products, o.productSkew, firstProduct, rng);
+        Zipf buyerOf(o.users, o.userSkew, firstUser, rng);
+        std::fprintf(stderr, "top 1%% of products take %.0f%% of order lines, top 1%% of users %.0f%% of orders\n",
+                     productOf.headShare(0.01) * 100, buyerOf.headShare(0.01) * 100);
+        int64_t firstOrder = scalar(db, "SELECT COALESCE(MAX(id), 0) FROM orders") + 1;
+        Loader orders(db, batch, "orders",
+            "INSERT INTO orders (id, user_id, total_cents, status, shipping_address, customer_name, phone, "
+            "payment_method, stripe_payment_intent_id, currency, card_brand, card_last4, created_at_ms) "
+            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, 'usd', ?, ?, ?)");
+        Loader items(db, batch, "order_items",
+            "INSERT INTO order_items (order_id, product_id, quantity, price_cents, created_at_ms) VALUES (?, ?, ?, ?, ?)");
+        int64_t historyStart = o.nowMs - kOrderHistoryDays * kDayMs;
+        // Order volume grows over the window: the time of order i follows a
+        // quadratic curve, so recent days are busier than old ones.
+        for (int64_t i = 0; ok && i < o.orders; i++) {
+            double t = std::sqrt((i + rng.unit()) / static_cast<double>(o.orders));
+            int64_t createdMs = historyStart + static_cast<int64_t>(t * kOrderHistoryDays * kDayMs);
+            int64_t orderId = firstOrder + i;
+            int64_t total = 0;
+            int64_t lines = 1;
+            while (lines < 8 && rng.chance(0.45))
+                lines++;
+            for (int64_t l = 0; ok && l < lines; l++) {
+                int64_t product = productOf.sample(rng);
+                int64_t quantity = rng.chance(0.8) ? 1 : rng.between(2, 3);
+                int64_t price = productPrice[product - firstProduct];
+                total += price * quantity;
+                sqlite3_stmt* s = items.row();
+                sqlite3_bind_int64(s, 1, orderId);
+                sqlite3_bind_int64(s, 2, product);
+                sqlite3_bind_int64(s, 3, quantity);
+                sqlite3_bind_int64(s, 4, price);
+                sqlite3_bind_int64(s, 5, createdMs);
+                ok = items.insert();
+            }
+            if (!ok)
+                break;
+            int64_t user = buyerOf.sample(rng);
+            bool card = rng.chance(0.7);
+            sqlite3_stmt* s = orders.row();
+            sqlite3_bind_int64(s, 1, orderId);
+            sqlite3_bind_int64(s, 2, user);
+            sqlite3_bind_int64(s, 3, total);
+            sqlite3_bind_text(s, 4, orderStatus(o.nowMs - createdMs, rng), -1, SQLITE_STATIC);
+            bindText(s, 5, std::to_string(rng.between(1, 9999)) + " " + pick(kStreets, rng) + ", " + pick(kCities, rng));
+            bindText(s, 6, "User " + std::to_string(user - firstUser + 1));
+            bindText(s, 7, "555-" + std::to_string(rng.between(1000000, 9999999)));
+            sqlite3_bind_text(s, 8, card ? "card" : "cod", -1, SQLITE_STATIC);
+            if (card) {
+                bindText(s, 9, "pi_gen_" + std::to_string(orderId));
+                sqlite3_bind_text(s, 10, pick(kCardBrands, rng), -1, SQLITE_STATIC);
+                bindText(s, 11, std::to_string(rng.between(1000, 9999)));
+            }
+            sqlite3_bind_int64(s, 12, createdMs);
+            ok = orders.insert();
+        }
+        ok = ok && orders.finish() && items.finish();
+    }
+
+    // Open carts: distinct users, each with a few distinct popular products
+    if (ok && o.carts > 0) {
+        Zipf productOf(o.products, o.productSkew, firstProduct, rng);
+        std::vector<int64_t> shoppers(static_cast<size_t>(o.users));
+        for (int64_t i = 0; i < o.users; i++)
+            shoppers[i] = firstUser + i;
+        int64_t carts = std::min(o.carts, o.users);
+        for (int64_t i = 0; i < carts; i++)
+            std::swap(shoppers[i], shoppers[i + rng.below(o.users - i)]);
+        Loader load(db, batch, "cart_items",
+            "INSERT INTO cart_items (user_id, product_id, quantity, price_cents, created_at_ms) VALUES (?, ?, ?, ?, ?)");
+        for (int64_t i = 0; ok && i < carts; i++) {
+            int64_t lines = std::min<int64_t>(rng.between(1, 6), o.products);
+            std::vector<int64_t> chosen;
+            int64_t cartStart = o.nowMs - rng.below(kCartHistoryDays * kDayMs);
+            for (int attempts = 0; ok && static_cast<int64_t>(chosen.size()) < lines && attempts < 50; attempts++) {
+                int64_t product = productOf.sample(rng);
+                if (std::find(chosen.begin(), chosen.end(), product) != chosen.end())
+                    continue;
+                chosen.push_back(product);
+                sqlite3_stmt* s = load.row();
+                sqlite3_bind_int64(s, 1, shoppers[i]);
+                sqlite3_bind_int64(s, 2, product);
+                sqlite3_bind_int64(s, 3, rng.chance(0.85) ? 1 : 2);
+                sqlite3_bind_int64(s, 4, productPrice[product - firstProduct]);
+                sqlite3_bind_int64(s, 5, std::min(o.nowMs, cartStart + static_cast<int64_t>(chosen.size()) * 60000));
+                ok = load.insert();
+            }
+        }
+        ok = ok && load.finish();
+    }
+
+    if (ok) {
+        auto indexStart = std::chrono::steady_clock::now();
+        for (const auto& index : indexes)
+            ok = ok && exec(db, index.second);
+        std::fprintf(stderr, "%-12s %12zu built %8.2f s\n", "indexes", indexes.size(),
+                     std::chrono::duration<double>(std::chrono::steady_clock::now() - indexStart).count());
+        ok = ok && exec(db, "ANALYZE");
+    }
+    sqlite3_close(db);
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!ok) {
+        std::cerr << "Generation failed; " << o.out << " is incomplete" << std::endl;
+        return 1;
+    }
+    std::fprintf(stderr, "wrote %s in %.1f s\n", o.out.c_str(), secs);
+    return 0;
+}
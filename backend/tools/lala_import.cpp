@@ -0,0 +1,71 @@
+// Bulk catalog import from the command line:
+//   lala_import <products.csv|products.jsonl> [--format csv|jsonl]
+// Reads db_config.json and applies pending migrations like the server does, so
+// run it from the same directory. With "memory" enabled in the config, import
+// through POST /api/admin/import instead: the running server's write-back
+// would overwrite rows another process added to the file. The same goes for
+// "replication" publishing: replicas only see rows imported by this tool after
+// the server's next snapshot.
+#include "../db/connection.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <nlohmann/json.hpp>
+
+namespace {
+    int usage() {
+        std::cerr << "usage: lala_import <products.csv|products.jsonl> [--format csv|jsonl]" << std::endl;
+        return 2;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string path;
+    std::string formatName;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+            formatName = argv[++i];
+        else if (argv[i][0] == '-' || !path.empty())
+            return usage();
+        else
+            path = argv[i];
+    }
+    if (path.empty())
+        return usage();
+    CatalogImporter::Format format;
+    if (formatName == "csv") {
+        format = CatalogImporter::Format::Csv;
+    } else if (formatName == "jsonl" || formatName == "ndjson") {
+        format = CatalogImporter::Format::Jsonl;
+    } else if (!formatName.empty() || !CatalogImporter::formatFor(path, format)) {
+        std::cerr << "Cannot tell the format of " << path << "; pass --format csv or --format jsonl" << std::endl;
+        return 2;
+    }
+
+    auto& db = DatabaseConnection::getInstance();
+    if (!db.isConnected() || !db.ensureSchema()) {
+        std::cerr << "Database unavailable" << std::endl;
+        return 1;
+    }
+    CatalogImporter* importer = db.importer();
+    if (!importer)
+        return 1;
+
+    auto lastPrint = std::chrono::steady_clock::now();
+    nlohmann::json report = importer->run(path, format, [&lastPrint](const nlohmann::json& r) {
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastPrint < std::chrono::seconds(1))
+            return;
+        lastPrint = now;
+        std::fprintf(stderr, "\r%llu rows, %.0f rows/s   ", r["rows_read"].get<unsigned long long>(),
+                     r["rows_per_sec"].get<double>());
+    });
+    std::fprintf(stderr, "\n");
+    for (const auto& e : report["errors"])
+        std::cerr << "  " << e.get<std::string>() << std::endl;
+    std::cout << report.dump(2) << std::endl;
+    db.closeConnection();
+    return report["state"] == "completed" ? 0 : 1;
+}
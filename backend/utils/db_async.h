@@ -0,0 +1,46 @@
+#ifndef DB_ASYNC_H
+#define DB_ASYNC_H
+
+#include <crow.h>
+#include <exception>
+#include <string>
+#include <utility>
+#include <nlohmann/json.hpp>
+#include "../db/connection.h"
+#include "../db/sql_profiler.h"
+#include "cors_helper.h"
+
+namespace DbAsync {
+    // Runs handler (which returns a crow::response) on the DB executor and ends
+    // res with its result, freeing the Crow thread while SQLite works. Crow keeps
+    // the request and res alive until res.end(), so handler may capture the
+    // request by reference; capture route parameters by value. Answers 503 with
+    // Retry-After when the executor's queue is full.
+    template <typename Handler>
+    void respond(crow::response& res, const char* site, Handler handler) {
+        auto job = [&res, site, handler = std::move(handler)]() mutable {
+            try {
+                res = handler();
+            } catch (const std::exception& ex) {
+                nlohmann::json e; e["success"]=false; e["message"]=std::string("Error: ")+ex.what();
+                res = CORSHelper::jsonResponse(500, e.dump());
+            }
+            res.end();
+        };
+        DbExecutor* executor = DatabaseConnection::getInstance().executor();
+        if (!executor) {
+            // Database unavailable: the handler reports that itself
+            SqlSite scope(site);
+            job();
+            return;
+        }
+        if (!executor->submit(job, site)) {
+            nlohmann::json e; e["success"]=false; e["message"]="Server busy, please retry";
+            res = CORSHelper::jsonResponse(503, e.dump());
+            res.set_header("Retry-After", "1");
+            res.end();
+        }
+    }
+}
+
+#endif // DB_ASYNC_H
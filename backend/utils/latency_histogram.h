@@ -0,0 +1,71 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+
+// Lock-free log2 histogram of durations in microseconds. Bucket 0 holds 0 us,
+// bucket i holds [2^(i-1), 2^i) us; percentiles report the bucket's upper bound.
+class LatencyHistogram {
+public:
+    static constexpr int kBuckets = 40;
+
+    void record(uint64_t micros) {
+        int bucket = 0;
+        while (bucket < kBuckets - 1 && (micros >> bucket) != 0)
+            bucket++;
+        buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        n.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(micros, std::memory_order_relaxed);
+        uint64_t seen = maxSeen.load(std::memory_order_relaxed);
+        while (micros > seen && !maxSeen.compare_exchange_weak(seen, micros, std::memory_order_relaxed)) {
+        }
+    }
+
+    uint64_t count() const { return n.load(std::memory_order_relaxed); }
+    uint64_t total() const { return sum.load(std::memory_order_relaxed); }
+    uint64_t max() const { return maxSeen.load(std::memory_order_relaxed); }
+
+    uint64_t percentile(double q) const {
+        uint64_t total = count();
+        if (total == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(total - 1)) + 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; i++) {
+            seen += buckets[i].load(std::memory_order_relaxed);
+            if (seen >= rank)
+                return i == 0 ? 0 : std::min<uint64_t>(uint64_t(1) << i, max());
+        }
+        return max();
+    }
+
+    void reset() {
+        for (auto& b : buckets) b.store(0, std::memory_order_relaxed);
+        n.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        maxSeen.store(0, std::memory_order_relaxed);
+    }
+
+    nlohmann::json toJson() const {
+        nlohmann::json j;
+        uint64_t c = count();
+        j["count"] = c;
+        j["total_us"] = total();
+        j["avg_us"] = c ? total() / c : 0;
+        j["p50_us"] = percentile(0.50);
+        j["p99_us"] = percentile(0.99);
+        j["max_us"] = max();
+        return j;
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, kBuckets> buckets{};
+    std::atomic<uint64_t> n{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> maxSeen{0};
+};
+
+#endif // LATENCY_HISTOGRAM_H
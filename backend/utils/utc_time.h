@@ -0,0 +1,19 @@
+#ifndef UTC_TIME_H
+#define UTC_TIME_H
+
+#include <ctime>
+
+// Broken-down UTC time for seconds since the epoch. gmtime_r is POSIX-only:
+// MSVC has gmtime_s (arguments swapped) instead, and MinGW only declares
+// gmtime_r with _POSIX_C_SOURCE.
+inline std::tm utcTime(std::time_t seconds) {
+    std::tm tm{};
+#ifdef _WIN32
+    gmtime_s(&tm, &seconds);
+#else
+    gmtime_r(&seconds, &tm);
+#endif
+    return tm;
+}
+
+#endif // UTC_TIME_H
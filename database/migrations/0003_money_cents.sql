@@ -0,0 +1,21 @@
+-- Money as INTEGER cents. The REAL columns are replaced rather than kept
+-- alongside, so nothing can go on summing floating-point prices:
+--   products.price, cart_items.price, order_items.price -> price_cents
+--   orders.total_amount                                  -> total_cents
+-- The API still returns price and total_amount as decimal numbers (19.99).
+
+ALTER TABLE products ADD COLUMN price_cents INTEGER NOT NULL DEFAULT 0 CHECK (price_cents >= 0);
+UPDATE products SET price_cents = CAST(round(price * 100) AS INTEGER);
+ALTER TABLE products DROP COLUMN price;
+
+ALTER TABLE cart_items ADD COLUMN price_cents INTEGER NOT NULL DEFAULT 0 CHECK (price_cents >= 0);
+UPDATE cart_items SET price_cents = CAST(round(price * 100) AS INTEGER);
+ALTER TABLE cart_items DROP COLUMN price;
+
+ALTER TABLE orders ADD COLUMN total_cents INTEGER NOT NULL DEFAULT 0 CHECK (total_cents >= 0);
+UPDATE orders SET total_cents = CAST(round(total_amount * 100) AS INTEGER);
+ALTER TABLE orders DROP COLUMN total_amount;
+
+ALTER TABLE order_items ADD COLUMN price_cents INTEGER NOT NULL DEFAULT 0 CHECK (price_cents >= 0);
+UPDATE order_items SET price_cents = CAST(round(price * 100) AS INTEGER);
+ALTER TABLE order_items DROP COLUMN price;
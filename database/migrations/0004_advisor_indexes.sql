@@ -0,0 +1,13 @@
+-- Index changes reported by the startup index advisor (backend/db/index_advisor.h).
+
+-- The UNIQUE constraint on orders.stripe_payment_intent_id already has an
+-- index; this one only doubled the cost of every order insert.
+DROP INDEX IF EXISTS idx_orders_stripe_pi;
+
+-- Storefront listings only show products in stock, so index just those rows.
+-- SQLite picks a partial index only when the query repeats its WHERE term,
+-- which every listing in ProductRepository does: COALESCE(stock_quantity,0) > 0.
+DROP INDEX IF EXISTS idx_products_created;
+CREATE INDEX idx_products_instock_created ON products(created_at_ms) WHERE COALESCE(stock_quantity,0) > 0;
+CREATE INDEX idx_products_instock_category_name ON products(category_id, name) WHERE COALESCE(stock_quantity,0) > 0;
+CREATE INDEX idx_products_instock_name ON products(name) WHERE COALESCE(stock_quantity,0) > 0;
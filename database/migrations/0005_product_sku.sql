@@ -0,0 +1,5 @@
+-- Supplier SKU, the key bulk catalog imports upsert on (backend/db/catalog_importer.h).
+-- Products created through the API or the seed scripts have none, so the
+-- unique index only covers rows that have one.
+ALTER TABLE products ADD COLUMN sku TEXT;
+CREATE UNIQUE INDEX idx_products_sku ON products(sku) WHERE sku IS NOT NULL;
@@ -0,0 +1,72 @@
+-- Per-size stock. products.sizes ('S,M,L,XL') stays as the display list and
+-- products.stock_quantity as the product's total; product_variants holds one
+-- row per size with its own stock, so "in stock in XL" is an index lookup
+-- instead of parsing the sizes string of every row.
+--
+-- The existing strings carry no per-size stock, so each product's total is
+-- spread evenly over its sizes (the first sizes get the remainder).
+--
+-- A rowid table rather than WITHOUT ROWID: the change feed and replication
+-- only see tables that have a rowid.
+
+CREATE TABLE product_variants (
+    id INTEGER PRIMARY KEY,
+    product_id INTEGER NOT NULL REFERENCES products(id) ON DELETE CASCADE,
+    size TEXT NOT NULL COLLATE NOCASE,
+    stock INTEGER NOT NULL DEFAULT 0 CHECK (stock >= 0),
+    position INTEGER NOT NULL,  -- place in the product's sizes list
+    UNIQUE (product_id, size),
+    UNIQUE (product_id, position)  -- a product's sizes in list order, without a sort
+);
+
+-- Size filters: in-stock products per size. Like the products listing indexes,
+-- only in-stock rows, so queries must repeat "stock > 0".
+CREATE INDEX idx_product_variants_instock_size ON product_variants(size, product_id) WHERE stock > 0;
+
+-- One row per non-empty entry of products.sizes, split through a JSON array
+CREATE VIEW product_size_list AS
+SELECT p.id AS product_id, trim(s.value) AS size, s.key AS position
+FROM products p,
+     json_each('["' || replace(replace(replace(p.sizes, '\', '\\'), '"', '\"'), ',', '","') || '"]') s
+WHERE p.sizes IS NOT NULL AND trim(s.value) <> '';
+
+INSERT INTO product_variants (product_id, size, stock, position)
+SELECT product_id, size, stock_quantity / n + (rank < stock_quantity % n), position
+FROM (SELECT v.product_id, v.size, v.position, p.stock_quantity,
+             count(*) OVER (PARTITION BY v.product_id) AS n,
+             row_number() OVER (PARTITION BY v.product_id ORDER BY v.position) - 1 AS rank
+      FROM (SELECT product_id, size, min(position) AS position
+            FROM product_size_list GROUP BY product_id, size COLLATE NOCASE) v
+      JOIN products p ON p.id = v.product_id);
+
+-- Writes to products.sizes or products.stock_quantity (API inserts, seeds,
+-- bulk imports) rebuild the product's variants, spreading the new total evenly
+-- again. Per-size stock is set on product_variants.stock instead, which keeps
+-- the product total in step; the WHEN below then sees matching totals and
+-- leaves the variants alone.
+CREATE TRIGGER product_variants_from_sizes AFTER INSERT ON products WHEN NEW.sizes IS NOT NULL
+BEGIN
+    INSERT INTO product_variants (product_id, size, stock, position)
+    SELECT NEW.id, size, NEW.stock_quantity / n + (rank < NEW.stock_quantity % n), position
+    FROM (SELECT size, position, count(*) OVER () AS n, row_number() OVER (ORDER BY position) - 1 AS rank
+          FROM (SELECT size, min(position) AS position
+                FROM product_size_list WHERE product_id = NEW.id GROUP BY size COLLATE NOCASE));
+END;
+
+CREATE TRIGGER product_variants_resize AFTER UPDATE OF sizes, stock_quantity ON products
+WHEN (NEW.sizes IS NOT NULL OR OLD.sizes IS NOT NULL)
+ AND (NEW.sizes IS NOT OLD.sizes
+      OR NEW.stock_quantity IS NOT (SELECT COALESCE(sum(stock), 0) FROM product_variants WHERE product_id = NEW.id))
+BEGIN
+    DELETE FROM product_variants WHERE product_id = NEW.id;
+    INSERT INTO product_variants (product_id, size, stock, position)
+    SELECT NEW.id, size, NEW.stock_quantity / n + (rank < NEW.stock_quantity % n), position
+    FROM (SELECT size, position, count(*) OVER () AS n, row_number() OVER (ORDER BY position) - 1 AS rank
+          FROM (SELECT size, min(position) AS position
+                FROM product_size_list WHERE product_id = NEW.id GROUP BY size COLLATE NOCASE));
+END;
+
+CREATE TRIGGER product_variants_stock AFTER UPDATE OF stock ON product_variants WHEN NEW.stock IS NOT OLD.stock
+BEGIN
+    UPDATE products SET stock_quantity = stock_quantity + NEW.stock - OLD.stock WHERE id = NEW.product_id;
+END;
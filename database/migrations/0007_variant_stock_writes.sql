@@ -0,0 +1,80 @@
+-- Version 6 rebuilt a product's variants, with its total spread evenly again,
+-- on any write that left products.stock_quantity different from their sum, so
+-- setting a new total (every catalog re-import does) wiped the per-size stock.
+-- Writes to products now leave the variants' stock alone where they can:
+-- - A new sizes list keeps the stock of the sizes still in it. New sizes start
+--   at 0 and dropped ones take their stock with them; a product that had no
+--   variants yet gets its total spread evenly, as on insert.
+-- - A new stock_quantity moves only the difference: an increase goes to the
+--   first size, a decrease is taken from the sizes in list order.
+-- - A new sizes list with the same stock_quantity makes the total follow the
+--   variants that remain, if any do.
+-- Writing product_variants.stock sets the product total to the variants' sum.
+
+DROP TRIGGER product_variants_resize;
+DROP TRIGGER product_variants_stock;
+
+CREATE TRIGGER product_variants_resize AFTER UPDATE OF sizes ON products WHEN NEW.sizes IS NOT OLD.sizes
+BEGIN
+    INSERT INTO product_variants (product_id, size, stock, position)
+    SELECT NEW.id, size, NEW.stock_quantity / n + (rank < NEW.stock_quantity % n), position
+    FROM (SELECT size, position, count(*) OVER () AS n, row_number() OVER (ORDER BY position) - 1 AS rank
+          FROM (SELECT size, min(position) AS position
+                FROM product_size_list WHERE product_id = NEW.id GROUP BY size COLLATE NOCASE))
+    WHERE NOT EXISTS (SELECT 1 FROM product_variants WHERE product_id = NEW.id);
+
+    DELETE FROM product_variants
+    WHERE product_id = NEW.id AND size NOT IN (SELECT size FROM product_size_list WHERE product_id = NEW.id);
+
+    -- Kept sizes take their new place and spelling, new ones start at 0.
+    -- Positions are parked below zero first so the moves cannot collide.
+    UPDATE product_variants SET position = -1 - position WHERE product_id = NEW.id;
+    INSERT INTO product_variants (product_id, size, stock, position)
+    SELECT NEW.id, size, 0, min(position) FROM product_size_list
+    WHERE product_id = NEW.id
+    GROUP BY size COLLATE NOCASE
+    ON CONFLICT (product_id, size) DO UPDATE SET size = excluded.size, position = excluded.position;
+
+    UPDATE products SET stock_quantity = (SELECT sum(stock) FROM product_variants WHERE product_id = NEW.id)
+    WHERE id = NEW.id AND NEW.stock_quantity IS OLD.stock_quantity
+      AND stock_quantity <> (SELECT sum(stock) FROM product_variants WHERE product_id = NEW.id);
+
+    -- A new total in the same write: as in product_variants_total
+    UPDATE product_variants
+    SET stock = stock + NEW.stock_quantity - (SELECT sum(stock) FROM product_variants WHERE product_id = NEW.id)
+    WHERE product_id = NEW.id
+      AND NEW.stock_quantity IS NOT OLD.stock_quantity
+      AND position = (SELECT min(position) FROM product_variants WHERE product_id = NEW.id)
+      AND NEW.stock_quantity > (SELECT sum(stock) FROM product_variants WHERE product_id = NEW.id);
+    UPDATE product_variants SET stock = stock - t.take
+    FROM (SELECT id, min(stock, max(0, need - (sum(stock) OVER (ORDER BY position) - stock))) AS take
+          FROM product_variants,
+               (SELECT sum(stock) - NEW.stock_quantity AS need FROM product_variants WHERE product_id = NEW.id HAVING need > 0)
+          WHERE product_id = NEW.id) t
+    WHERE product_variants.id = t.id AND t.take > 0 AND NEW.stock_quantity IS NOT OLD.stock_quantity;
+END;
+
+-- Only for writes that leave sizes alone; product_variants_resize handles the rest
+CREATE TRIGGER product_variants_total AFTER UPDATE OF stock_quantity ON products
+WHEN NEW.sizes IS OLD.sizes
+ AND NEW.stock_quantity <> (SELECT sum(stock) FROM product_variants WHERE product_id = NEW.id)
+BEGIN
+    UPDATE product_variants
+    SET stock = stock + NEW.stock_quantity - (SELECT sum(stock) FROM product_variants WHERE product_id = NEW.id)
+    WHERE product_id = NEW.id
+      AND position = (SELECT min(position) FROM product_variants WHERE product_id = NEW.id)
+      AND NEW.stock_quantity > (SELECT sum(stock) FROM product_variants WHERE product_id = NEW.id);
+    UPDATE product_variants SET stock = stock - t.take
+    FROM (SELECT id, min(stock, max(0, need - (sum(stock) OVER (ORDER BY position) - stock))) AS take
+          FROM product_variants,
+               (SELECT sum(stock) - NEW.stock_quantity AS need FROM product_variants WHERE product_id = NEW.id HAVING need > 0)
+          WHERE product_id = NEW.id) t
+    WHERE product_variants.id = t.id AND t.take > 0;
+END;
+
+CREATE TRIGGER product_variants_stock AFTER UPDATE OF stock ON product_variants WHEN NEW.stock IS NOT OLD.stock
+BEGIN
+    UPDATE products SET stock_quantity = (SELECT sum(stock) FROM product_variants WHERE product_id = NEW.product_id)
+    WHERE id = NEW.product_id
+      AND stock_quantity IS NOT (SELECT sum(stock) FROM product_variants WHERE product_id = NEW.product_id);
+END;
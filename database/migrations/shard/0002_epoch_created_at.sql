@@ -0,0 +1,36 @@
+-- Shard counterpart of migrations/0002_epoch_created_at.sql: integer creation
+-- times (milliseconds since the Unix epoch) for the cart and order listings,
+-- plus indexes matching their ORDER BYs.
+--
+-- created_at (TEXT) is kept for older readers. The backend writes created_at_ms
+-- itself; the triggers fill it in for rows inserted by anything else.
+
+ALTER TABLE cart_items ADD COLUMN created_at_ms INTEGER;
+ALTER TABLE orders ADD COLUMN created_at_ms INTEGER;
+ALTER TABLE order_items ADD COLUMN created_at_ms INTEGER;
+
+UPDATE cart_items SET created_at_ms = CAST(round((julianday(COALESCE(created_at, 'now')) - 2440587.5) * 86400000) AS INTEGER);
+UPDATE orders SET created_at_ms = CAST(round((julianday(COALESCE(created_at, 'now')) - 2440587.5) * 86400000) AS INTEGER);
+UPDATE order_items SET created_at_ms = CAST(round((julianday(COALESCE(created_at, 'now')) - 2440587.5) * 86400000) AS INTEGER);
+
+CREATE TRIGGER cart_items_created_at_ms AFTER INSERT ON cart_items WHEN NEW.created_at_ms IS NULL
+BEGIN
+    UPDATE cart_items SET created_at_ms = CAST(round((julianday('now') - 2440587.5) * 86400000) AS INTEGER) WHERE id = NEW.id;
+END;
+CREATE TRIGGER orders_created_at_ms AFTER INSERT ON orders WHEN NEW.created_at_ms IS NULL
+BEGIN
+    UPDATE orders SET created_at_ms = CAST(round((julianday('now') - 2440587.5) * 86400000) AS INTEGER) WHERE id = NEW.id;
+END;
+CREATE TRIGGER order_items_created_at_ms AFTER INSERT ON order_items WHEN NEW.created_at_ms IS NULL
+BEGIN
+    UPDATE order_items SET created_at_ms = CAST(round((julianday('now') - 2440587.5) * 86400000) AS INTEGER) WHERE id = NEW.id;
+END;
+
+-- A user's cart, newest first
+DROP INDEX IF EXISTS idx_cart_items_user;
+CREATE INDEX idx_cart_items_user_created ON cart_items(user_id, created_at_ms);
+
+-- Order listings by user and by status; the rowid tiebreak (id DESC) is part of every index entry
+DROP INDEX IF EXISTS idx_orders_user;
+CREATE INDEX idx_orders_user_created ON orders(user_id, created_at_ms);
+CREATE INDEX idx_orders_status_created ON orders(status, created_at_ms);
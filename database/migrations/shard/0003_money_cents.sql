@@ -0,0 +1,14 @@
+-- Shard counterpart of migrations/0003_money_cents.sql: cart and order
+-- amounts as INTEGER cents in place of the REAL columns.
+
+ALTER TABLE cart_items ADD COLUMN price_cents INTEGER NOT NULL DEFAULT 0 CHECK (price_cents >= 0);
+UPDATE cart_items SET price_cents = CAST(round(price * 100) AS INTEGER);
+ALTER TABLE cart_items DROP COLUMN price;
+
+ALTER TABLE orders ADD COLUMN total_cents INTEGER NOT NULL DEFAULT 0 CHECK (total_cents >= 0);
+UPDATE orders SET total_cents = CAST(round(total_amount * 100) AS INTEGER);
+ALTER TABLE orders DROP COLUMN total_amount;
+
+ALTER TABLE order_items ADD COLUMN price_cents INTEGER NOT NULL DEFAULT 0 CHECK (price_cents >= 0);
+UPDATE order_items SET price_cents = CAST(round(price * 100) AS INTEGER);
+ALTER TABLE order_items DROP COLUMN price;
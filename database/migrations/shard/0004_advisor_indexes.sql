@@ -0,0 +1,4 @@
+-- Shard counterpart of migrations/0004_advisor_indexes.sql: the UNIQUE
+-- constraint on orders.stripe_payment_intent_id already has an index.
+
+DROP INDEX IF EXISTS idx_orders_stripe_pi;
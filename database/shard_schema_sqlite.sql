@@ -0,0 +1,52 @@
+-- Lala Store - per-user shard schema (SQLite)
+-- Used when sharding is enabled in db_config.json: cart_items, orders and
+-- order_items for a user live in shards/lala-store-shard-N.db, picked by a hash
+-- of user_id. Catalog tables (users, products, categories) stay in lala-store.db,
+-- which every shard connection attaches read-only as "catalog". Foreign keys
+-- into the catalog cannot cross database files, so they are checked in code.
+
+PRAGMA foreign_keys = ON;
+
+-- Cart items
+CREATE TABLE IF NOT EXISTS cart_items (
+    id INTEGER PRIMARY KEY AUTOINCREMENT,
+    user_id INTEGER NOT NULL,
+    product_id INTEGER NOT NULL,
+    quantity INTEGER NOT NULL DEFAULT 1 CHECK (quantity > 0),
+    price REAL NOT NULL CHECK (price >= 0),
+    created_at TEXT DEFAULT (datetime('now')),
+    UNIQUE(user_id, product_id)
+);
+
+-- Orders (with Stripe/PCI columns)
+CREATE TABLE IF NOT EXISTS orders (
+    id INTEGER PRIMARY KEY AUTOINCREMENT,
+    user_id INTEGER NOT NULL,
+    total_amount REAL NOT NULL CHECK (total_amount >= 0),
+    status TEXT NOT NULL DEFAULT 'pending' CHECK (status IN ('pending', 'paid', 'processing', 'shipped', 'delivered', 'cancelled', 'payment_failed')),
+    shipping_address TEXT NOT NULL,
+    customer_name TEXT,
+    phone TEXT,
+    payment_method TEXT,
+    stripe_payment_intent_id TEXT UNIQUE,
+    currency TEXT NOT NULL DEFAULT 'usd',
+    card_brand TEXT,
+    card_last4 TEXT,
+    created_at TEXT DEFAULT (datetime('now'))
+);
+
+-- Order items
+CREATE TABLE IF NOT EXISTS order_items (
+    id INTEGER PRIMARY KEY AUTOINCREMENT,
+    order_id INTEGER NOT NULL REFERENCES orders(id) ON DELETE CASCADE,
+    product_id INTEGER NOT NULL,
+    quantity INTEGER NOT NULL CHECK (quantity > 0),
+    price REAL NOT NULL CHECK (price >= 0),
+    created_at TEXT DEFAULT (datetime('now'))
+);
+
+CREATE INDEX IF NOT EXISTS idx_cart_items_user ON cart_items(user_id);
+CREATE INDEX IF NOT EXISTS idx_cart_items_product ON cart_items(product_id);
+CREATE INDEX IF NOT EXISTS idx_orders_user ON orders(user_id);
+CREATE INDEX IF NOT EXISTS idx_order_items_order ON order_items(order_id);
+CREATE INDEX IF NOT EXISTS idx_orders_stripe_pi ON orders(stripe_payment_intent_id);
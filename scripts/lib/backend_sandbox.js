@@ -0,0 +1,183 @@
+/**
+ * Runs the built backend against a throwaway database, for the integration
+ * scripts that need their own db_config.json (sharding, replication, imports).
+ *
+ * A sandbox is a temp directory laid out like a checkout: config/db_config.json
+ * (the repo's config with overrides merged in) and database/ (schema and
+ * migrations), so the server finds both from its working directory.
+ *
+ * The binary is LALA_STORE_BIN, or the first of backend/build/lala_store,
+ * backend/build/Release/lala_store(.exe), backend/build_mingw/lala_store.exe.
+ */
+
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const http = require('http');
+const { spawn } = require('child_process');
+
+const projectRoot = path.resolve(__dirname, '..', '..');
+
+function findBinary() {
+  if (process.env.LALA_STORE_BIN) return process.env.LALA_STORE_BIN;
+  const candidates = [
+    'backend/build/lala_store',
+    'backend/build/Release/lala_store',
+    'backend/build/Release/lala_store.exe',
+    'backend/build/lala_store.exe',
+    'backend/build_mingw/lala_store.exe',
+  ];
+  for (const c of candidates) {
+    const p = path.join(projectRoot, c);
+    if (fs.existsSync(p)) return p;
+  }
+  return null;
+}
+
+function merge(base, overrides) {
+  const out = { ...base };
+  for (const [key, value] of Object.entries(overrides || {})) {
+    out[key] = value && typeof value === 'object' && !Array.isArray(value) && base[key] && typeof base[key] === 'object'
+      ? merge(base[key], value)
+      : value;
+  }
+  return out;
+}
+
+function createSandbox(name, configOverrides) {
+  const dir = fs.mkdtempSync(path.join(os.tmpdir(), `lala-${name}-`));
+  const dbDir = path.join(dir, 'database');
+  fs.mkdirSync(dbDir);
+  for (const f of ['schema_sqlite.sql', 'shard_schema_sqlite.sql']) {
+    fs.copyFileSync(path.join(projectRoot, 'database', f), path.join(dbDir, f));
+  }
+  fs.cpSync(path.join(projectRoot, 'database', 'migrations'), path.join(dbDir, 'migrations'), { recursive: true });
+
+  const base = JSON.parse(fs.readFileSync(path.join(projectRoot, 'backend', 'config', 'db_config.json'), 'utf8'));
+  const config = merge(merge(base, {
+    database_path: 'database/lala-store.db',
+    profiling: { slow_log: 'logs/slow-queries.log' },
+    advisor: { on_startup: false },
+  }), configOverrides);
+  fs.mkdirSync(path.join(dir, 'config'));
+  const sandbox = { dir, dbDir, config };
+  writeConfig(sandbox);
+  return sandbox;
+}
+
+function writeConfig(sandbox) {
+  fs.writeFileSync(path.join(sandbox.dir, 'config', 'db_config.json'), JSON.stringify(sandbox.config, null, 2));
+}
+
+// Merges more overrides into the sandbox's config; servers started afterwards read them
+function reconfigure(sandbox, configOverrides) {
+  sandbox.config = merge(sandbox.config, configOverrides);
+  writeConfig(sandbox);
+}
+
+function request(port, method, urlPath, body) {
+  return new Promise((resolve, reject) => {
+    const payload = body === undefined ? null : JSON.stringify(body);
+    const req = http.request({
+      host: '127.0.0.1',
+      port,
+      path: `/api${urlPath}`,
+      method,
+      headers: payload ? { 'Content-Type': 'application/json', 'Content-Length': Buffer.byteLength(payload) } : {},
+    }, (res) => {
+      let data = '';
+      res.on('data', (c) => { data += c; });
+      res.on('end', () => {
+        try {
+          resolve({ status: res.statusCode, data: JSON.parse(data) });
+        } catch {
+          resolve({ status: res.statusCode, data: null, raw: data });
+        }
+      });
+    });
+    req.on('error', reject);
+    req.setTimeout(10000, () => { req.destroy(); reject(new Error(`${method} ${urlPath}: timeout`)); });
+    if (payload) req.write(payload);
+    req.end();
+  });
+}
+
+const sleep = (ms) => new Promise((r) => setTimeout(r, ms));
+
+// Polls fn until it returns a truthy value; throws with the last value after timeoutMs
+async function waitFor(what, fn, timeoutMs = 15000, intervalMs = 200) {
+  const deadline = Date.now() + timeoutMs;
+  let last;
+  while (Date.now() < deadline) {
+    try {
+      last = await fn();
+      if (last) return last;
+    } catch (e) {
+      last = e.message;
+    }
+    await sleep(intervalMs);
+  }
+  throw new Error(`timed out waiting for ${what}${last !== undefined ? ` (last: ${JSON.stringify(last)})` : ''}`);
+}
+
+async function startServer(sandbox, port, args = []) {
+  const binary = findBinary();
+  if (!binary) {
+    throw new Error('No backend executable found. Build first: cd backend && cmake -B build && cmake --build build');
+  }
+  const child = spawn(binary, [...args, '--port', String(port)], { cwd: sandbox.dir, stdio: ['ignore', 'pipe', 'pipe'] });
+  let output = '';
+  child.stdout.on('data', (c) => { output += c; });
+  child.stderr.on('data', (c) => { output += c; });
+  const exited = new Promise((resolve) => child.on('exit', resolve));
+  const server = {
+    port,
+    get: (p) => request(port, 'GET', p),
+    post: (p, body) => request(port, 'POST', p, body),
+    put: (p, body) => request(port, 'PUT', p, body),
+    del: (p) => request(port, 'DELETE', p),
+    output: () => output,
+    async stop() {
+      if (child.exitCode !== null) return;
+      child.kill('SIGINT');
+      const timer = setTimeout(() => child.kill('SIGKILL'), 10000);
+      await exited;
+      clearTimeout(timer);
+    },
+  };
+  try {
+    await waitFor(`the server on port ${port}`, async () => {
+      if (child.exitCode !== null) throw new Error(`server exited with ${child.exitCode}`);
+      const h = await server.get('/health');
+      return h.status === 200 && h.data?.database;
+    });
+  } catch (e) {
+    await server.stop();
+    throw new Error(`${e.message}\n${output}`);
+  }
+  return server;
+}
+
+// Writes a JSONL catalog file into the sandbox's import directory and imports
+// it through POST /api/admin/import; resolves with the finished report
+async function importProducts(server, sandbox, fileName, rows) {
+  const dir = path.join(sandbox.dbDir, sandbox.config.import.directory);
+  fs.mkdirSync(dir, { recursive: true });
+  fs.writeFileSync(path.join(dir, fileName), rows.map((r) => JSON.stringify(r)).join('\n') + '\n');
+  const started = await server.post('/admin/import', { path: fileName });
+  if (started.status !== 202) throw new Error(`import ${fileName}: HTTP ${started.status} ${JSON.stringify(started.data)}`);
+  const report = await waitFor(`import of ${fileName}`, async () => {
+    const s = await server.get('/admin/import');
+    return ['completed', 'failed', 'cancelled'].includes(s.data?.data?.state) ? s.data.data : null;
+  });
+  if (report.state !== 'completed' || report.rejected > 0) {
+    throw new Error(`import ${fileName}: ${JSON.stringify(report)}`);
+  }
+  return report;
+}
+
+function removeSandbox(sandbox) {
+  if (!process.env.KEEP_SANDBOX) fs.rmSync(sandbox.dir, { recursive: true, force: true });
+}
+
+module.exports = { createSandbox, reconfigure, startServer, importProducts, removeSandbox, waitFor, sleep };
@@ -6,6 +6,12 @@
  * 2. Backend server is running and responding
  * 3. All key API endpoints return correct data
  * 4. Frontend can connect to backend via proxy
+ * 6. Writer savepoint rollback and busy (503) handling
+ * 7. Order archiver copy and delete
+ * 8. Statement cache LRU eviction
+ * 9. Migration checksum drift
+ * Tests 6 and up each start their own server on a throwaway database
+ * (see scripts/lib/backend_sandbox.js).
  * 
  * Run: node scripts/test_backend_integration.js
  */
@@ -13,6 +19,8 @@
 const fs = require('fs');
 const path = require('path');
 const http = require('http');
+const { spawn } = require('child_process');
+const { createSandbox, startServer, removeSandbox, waitFor } = require('./lib/backend_sandbox');
 
 const BACKEND_URL = 'http://127.0.0.1:8005';
 const API_BASE = `${BACKEND_URL}/api`;
@@ -245,6 +253,213 @@ function testFrontendConfig() {
   }
 }
 
+// Runs fn against a server started on a fresh sandbox database; false if it throws
+async function withSandbox(name, configOverrides, port, fn) {
+  const sandbox = createSandbox(name, configOverrides);
+  let server;
+  try {
+    server = await startServer(sandbox, port);
+    return await fn(server, sandbox);
+  } catch (error) {
+    logError(error.message);
+    return false;
+  } finally {
+    if (server) await server.stop();
+    removeSandbox(sandbox);
+  }
+}
+
+function expect(condition, message) {
+  if (!condition) throw new Error(message);
+}
+
+async function seededProducts(server, count) {
+  const list = await server.get('/products');
+  const products = (list.data?.data || []).slice(0, count);
+  expect(products.length === count, `need ${count} seeded products`);
+  return products;
+}
+
+// Holds SQLite's write lock on a database file from the sqlite3 shell until
+// release() is called; null if the shell is not installed
+function holdWriteLock(dbPath) {
+  return new Promise((resolve, reject) => {
+    const shell = spawn('sqlite3', [dbPath], { stdio: ['pipe', 'pipe', 'pipe'] });
+    let output = '';
+    shell.on('error', (e) => (e.code === 'ENOENT' ? resolve(null) : reject(e)));
+    shell.stderr.on('data', (c) => { output += c; });
+    shell.stdout.on('data', (c) => {
+      output += c;
+      if (output.includes('locked')) {
+        resolve({
+          release: () => new Promise((done) => {
+            shell.on('exit', done);
+            shell.stdin.end('ROLLBACK;\n.quit\n');
+          }),
+        });
+      }
+    });
+    shell.stdin.write("PRAGMA busy_timeout = 5000;\nBEGIN IMMEDIATE;\nSELECT 'locked';\n");
+  });
+}
+
+// Test 6: A mutation that rolls back its savepoint must leave the rest of its
+// batch committed, and a writer that cannot get the lock answers 503
+async function testWriterSavepoints() {
+  logSection('Test 6: Writer Savepoint Rollback and Busy Handling');
+  const USER_ID = 1;
+  return withSandbox('writer', {
+    writer: { batch_window_us: 20000 },
+    busy: { timeout_ms: 100, retry_attempts: 1, retry_base_ms: 2, retry_max_ms: 10 },
+  }, 18110, async (server, sandbox) => {
+    const products = await seededProducts(server, 2);
+    const before = (await server.get('/debug/db-pool')).data?.data?.writer || {};
+
+    // Checking out an empty cart rolls back its savepoint; the adds queued
+    // alongside it share the batch window and must still commit
+    const [checkout, ...adds] = await Promise.all([
+      server.post('/orders/create', { user_id: USER_ID, shipping_address: '1 Test Street', customer_name: 'Writer Test', phone: '000', payment_method: 'cod' }),
+      ...products.map((p) => server.post('/cart/add', { user_id: USER_ID, product_id: p.id, quantity: 1 })),
+    ]);
+    adds.forEach((r, i) => expect(r.status === 200, `cart/add ${products[i].id}: HTTP ${r.status} ${r.data?.message}`));
+    const after = (await server.get('/debug/db-pool')).data?.data?.writer || {};
+    const cart = (await server.get(`/cart/${USER_ID}`)).data?.data || [];
+    if (checkout.status === 400) {
+      expect(after.rolled_back_jobs > (before.rolled_back_jobs || 0), 'empty-cart checkout was not counted as rolled back');
+      expect(cart.length === products.length, `cart has ${cart.length} lines, expected ${products.length}`);
+      logSuccess(`Rolled-back checkout left ${cart.length} cart lines committed (${after.jobs} jobs in ${after.batches} batches)`);
+    } else {
+      // The adds won the race, so the checkout saw (some of) them: nothing may be lost or duplicated
+      expect(checkout.status === 200, `orders/create: HTTP ${checkout.status} ${checkout.data?.message}`);
+      logWarning('Checkout ran after the adds; checked that the batch stayed consistent instead');
+    }
+    expect(after.failed_batches === (before.failed_batches || 0), `failed_batches ${after.failed_batches}`);
+
+    const lock = await holdWriteLock(path.join(sandbox.dbDir, 'lala-store.db'));
+    if (!lock) {
+      logWarning('sqlite3 shell not installed; skipped the busy check');
+      return true;
+    }
+    let busy;
+    try {
+      busy = await server.post('/cart/add', { user_id: USER_ID, product_id: products[0].id, quantity: 1 });
+    } finally {
+      await lock.release();
+    }
+    expect(busy.status === 503, `write under a held lock: HTTP ${busy.status}, expected 503`);
+    expect(busy.data?.success === false, '503 body is not the JSON error');
+    const retry = await server.post('/cart/add', { user_id: USER_ID, product_id: products[0].id, quantity: 1 });
+    expect(retry.status === 200, `retry after the lock was released: HTTP ${retry.status}`);
+    const stats = (await server.get('/debug/db-pool')).data?.data?.writer || {};
+    expect(stats.busy_batches > 0, 'busy batch not counted');
+    logSuccess(`Held lock answered 503, retry succeeded (${stats.busy_batches} busy batch(es))`);
+    return true;
+  });
+}
+
+// Test 7: One archival pass copies an old order and its items into the
+// archive file and deletes them from the hot tables; a second pass moves nothing
+async function testArchiver() {
+  logSection('Test 7: Order Archiver Copy and Delete');
+  const USER_ID = 1;
+  return withSandbox('archiver', {
+    archive: { enabled: true, hot_days: 0, interval_minutes: 1440, statuses: ['pending'] },
+  }, 18111, async (server) => {
+    const products = await seededProducts(server, 2);
+    for (const p of products) {
+      const r = await server.post('/cart/add', { user_id: USER_ID, product_id: p.id, quantity: 1 });
+      expect(r.status === 200, `cart/add ${p.id}: HTTP ${r.status}`);
+    }
+    const created = await server.post('/orders/create', {
+      user_id: USER_ID, shipping_address: '1 Test Street', customer_name: 'Archive Test', phone: '000', payment_method: 'cod',
+    });
+    expect(created.status === 200 && created.data?.order_id, `orders/create: HTTP ${created.status} ${created.data?.message}`);
+    const orderId = created.data.order_id;
+
+    const pass = async () => {
+      const passes = (await server.get('/admin/archive')).data?.data?.passes || 0;
+      const r = await server.post('/admin/archive');
+      expect(r.status === 202, `admin/archive: HTTP ${r.status} ${r.data?.message}`);
+      return waitFor('the archival pass', async () => {
+        const s = (await server.get('/admin/archive')).data?.data;
+        return s && !s.running && s.passes > passes ? s : null;
+      });
+    };
+    const first = await pass();
+    expect(!first.last_error, `archiver error: ${first.last_error}`);
+    expect(first.orders_moved === 1 && first.items_moved === products.length,
+      `moved ${first.orders_moved} order(s) and ${first.items_moved} item(s), expected 1 and ${products.length}`);
+    const hot = await server.get(`/orders/user/${USER_ID}`);
+    expect(!(hot.data?.data || []).some((o) => o.id === orderId), 'archived order still in the hot listing');
+    const paged = await server.get(`/orders/user/${USER_ID}?limit=10`);
+    const archived = (paged.data?.data || []).find((o) => o.id === orderId);
+    expect(archived, `order ${orderId} missing from the archive page`);
+    const expected = products.reduce((n, p) => n + Math.round(Number(p.price) * 100), 0) / 100;
+    expect(Math.abs(Number(archived.total_amount) - expected) < 1e-9, `archived total ${archived.total_amount}, expected ${expected}`);
+
+    const second = await pass();
+    expect(second.orders_moved === first.orders_moved && second.items_moved === first.items_moved,
+      `second pass moved more rows: ${second.orders_moved} order(s), ${second.items_moved} item(s)`);
+    logSuccess(`Order ${orderId} and ${first.items_moved} item(s) archived; second pass moved nothing`);
+    return true;
+  });
+}
+
+// Test 8: With a statement cache smaller than the set of queries in use, the
+// least recently used statements are finalized and re-prepared on demand
+async function testStatementCacheEviction() {
+  logSection('Test 8: Statement Cache LRU Eviction');
+  return withSandbox('statements', { statement_cache_size: 2, read_pool_size: 1 }, 18112, async (server) => {
+    const paths = ['/products', '/products/men', '/products/women', '/home/featured', '/home/categories'];
+    for (let round = 0; round < 2; round++) {
+      for (const p of paths) {
+        const r = await server.get(p);
+        expect(r.status === 200, `${p} (round ${round + 1}): HTTP ${r.status}`);
+      }
+    }
+    const pools = (await server.get('/debug/db-pool')).data?.data?.pools || [];
+    const caches = pools.flatMap((pool) => (pool.connections || []).map((c) => c.statement_cache).filter(Boolean));
+    const sum = (key) => caches.reduce((n, c) => n + (c[key] || 0), 0);
+    expect(caches.length > 0, 'no statement cache stats in /debug/db-pool');
+    expect(sum('evictions') > 0, 'no statements evicted with a 2-entry cache');
+    logSuccess(`${sum('evictions')} evictions, ${sum('hits')} hits, ${sum('misses')} misses; every route answered twice`);
+    return true;
+  });
+}
+
+// Test 9: Editing a migration after it was applied is reported on the next
+// start, and the edited migration is not run again
+async function testMigrationDrift() {
+  logSection('Test 9: Migration Checksum Drift');
+  const sandbox = createSandbox('drift', {});
+  let server;
+  try {
+    server = await startServer(sandbox, 18113);
+    await server.stop();
+    server = null;
+
+    const dir = path.join(sandbox.dbDir, 'migrations');
+    const latest = fs.readdirSync(dir).filter((f) => /^\d+_.*\.sql$/.test(f)).sort().pop();
+    const version = parseInt(latest, 10);
+    fs.appendFileSync(path.join(dir, latest), '\n-- edited after it was applied\n');
+
+    server = await startServer(sandbox, 18113);
+    const warning = new RegExp(`migration ${version} \\(.*\\) changed after it was applied`);
+    expect(warning.test(server.output()), `no drift warning for ${latest}:\n${server.output()}`);
+    expect(!/Migration .* failed/.test(server.output()), 'the edited migration ran again');
+    const health = await server.get('/health');
+    expect(health.status === 200 && health.data?.database, `server unhealthy after the drift: HTTP ${health.status}`);
+    logSuccess(`Edit to ${latest} reported; server kept serving`);
+    return true;
+  } catch (error) {
+    logError(error.message);
+    return false;
+  } finally {
+    if (server) await server.stop();
+    removeSandbox(sandbox);
+  }
+}
+
 // Main test runner
 async function main() {
   console.log('\n');
@@ -258,6 +473,10 @@ async function main() {
     apiEndpoints: await testAPIEndpoints(),
     productDetails: await testProductDetails(),
     frontendConfig: testFrontendConfig(),
+    writerSavepoints: await testWriterSavepoints(),
+    archiver: await testArchiver(),
+    statementCache: await testStatementCacheEviction(),
+    migrationDrift: await testMigrationDrift(),
   };
   
   logSection('Test Summary');
@@ -0,0 +1,147 @@
+#!/usr/bin/env node
+/**
+ * Read replica convergence: a primary publishing change segments and a replica
+ * (--replica) applying them. Products and their per-size stock are written on
+ * the primary through the catalog importer; the replica must serve the same
+ * product, variants and total once it has caught up.
+ * Starts both servers on a throwaway database (see scripts/lib/backend_sandbox.js).
+ * Run: node scripts/test_replica_convergence.js
+ */
+
+const { createSandbox, startServer, importProducts, removeSandbox, waitFor } = require('./lib/backend_sandbox');
+
+const PRIMARY_PORT = 18106;
+const REPLICA_PORT = 18107;
+const SKU = 'REPL-TEE-001';
+const NAME = 'Replication Test Tee';
+const BULK_ROWS = 20;
+
+function check(condition, message) {
+  if (!condition) throw new Error(message);
+}
+
+// The fields both servers must agree on, from /products/details/<id>
+function snapshot(details) {
+  const d = details.data?.data;
+  if (!d) return null;
+  return JSON.stringify({
+    name: d.name,
+    price: d.price,
+    sizes: d.sizes,
+    stock_quantity: d.stock_quantity,
+    variants: (d.variants || []).map((v) => [v.size, v.stock]),
+  });
+}
+
+async function main() {
+  console.log('\n--- Read replica convergence ---\n');
+  const sandbox = createSandbox('replica', {
+    import: { directory: 'imports' },
+    replication: { publish: true, publish_interval_ms: 100, poll_interval_ms: 100 },
+    // Small enough that the bulk import below overflows a change batch, so it
+    // only reaches the replica through a snapshot
+    change_feed: { max_rows_per_batch: BULK_ROWS },
+  });
+  let primary;
+  let replica;
+  let failed = 0;
+  const step = async (name, fn) => {
+    try {
+      const detail = await fn();
+      console.log(`[PASS] ${name}${detail ? `: ${detail}` : ''}`);
+    } catch (e) {
+      console.log(`[FAIL] ${name}: ${e.message}`);
+      failed++;
+    }
+  };
+
+  try {
+    primary = await startServer(sandbox, PRIMARY_PORT);
+    replica = await startServer(sandbox, REPLICA_PORT, ['--replica']);
+    let productId;
+
+    // Polls until the replica serves the same product as the primary
+    const converged = async (what) => {
+      const expected = snapshot(await primary.get(`/products/details/${productId}`));
+      check(expected, `product ${productId} missing on the primary`);
+      await waitFor(`the replica to apply ${what}`, async () => snapshot(await replica.get(`/products/details/${productId}`)) === expected);
+      return expected;
+    };
+
+    await step('Replica role', async () => {
+      const p = await primary.get('/debug/replication');
+      const r = await replica.get('/debug/replication');
+      check(p.status === 200, `primary /debug/replication: HTTP ${p.status}`);
+      check(r.status === 200 && r.data?.data?.role === 'replica', `replica /debug/replication: ${JSON.stringify(r.data)}`);
+      const write = await replica.post('/cart/add', { user_id: 1, product_id: 1, quantity: 1 });
+      check(write.status === 404 || write.status === 405, `replica accepted a write route: HTTP ${write.status}`);
+    });
+
+    await step('New product', async () => {
+      await importProducts(primary, sandbox, 'products-1.jsonl', [
+        { sku: SKU, name: NAME, gender: 'unisex', price: 19.99, stock: 6, sizes: 'S,M,L' },
+      ]);
+      const list = await primary.get('/products');
+      const product = (list.data?.data || []).find((p) => p.name === NAME);
+      check(product, `imported product ${NAME} not listed on the primary`);
+      productId = product.id;
+      return await converged('the insert');
+    });
+
+    await step('Total and price update', async () => {
+      await importProducts(primary, sandbox, 'products-2.jsonl', [
+        { sku: SKU, name: NAME, gender: 'unisex', price: 24.5, stock: 4, sizes: 'S,M,L' },
+      ]);
+      const state = JSON.parse(await converged('the update'));
+      check(state.stock_quantity === 4, `stock_quantity ${state.stock_quantity}, expected 4`);
+      check(JSON.stringify(state.variants) === JSON.stringify([['S', 0], ['M', 2], ['L', 2]]),
+        `variants ${JSON.stringify(state.variants)}, expected S0/M2/L2`);
+      return JSON.stringify(state.variants);
+    });
+
+    await step('Sizes update', async () => {
+      await importProducts(primary, sandbox, 'products-3.jsonl', [
+        { sku: SKU, name: NAME, gender: 'unisex', price: 24.5, stock: 4, sizes: 'M,L,XL' },
+      ]);
+      const state = JSON.parse(await converged('the new sizes'));
+      check(JSON.stringify(state.variants) === JSON.stringify([['M', 2], ['L', 2], ['XL', 0]]),
+        `variants ${JSON.stringify(state.variants)}, expected M2/L2/XL0`);
+      return JSON.stringify(state.variants);
+    });
+
+    await step('Import larger than a change batch', async () => {
+      const before = (await replica.get('/debug/replication')).data?.data?.restores ?? 0;
+      const rows = [];
+      for (let i = 0; i < BULK_ROWS; i++)
+        rows.push({ sku: `REPL-BULK-${i}`, name: `Replication Bulk ${i}`, gender: 'unisex', price: 5, stock: 3, sizes: 'S,M,L' });
+      await importProducts(primary, sandbox, 'products-bulk.jsonl', rows);
+      const names = (list) => (list.data?.data || []).filter((p) => p.name.startsWith('Replication Bulk ')).length;
+      check(names(await primary.get('/products')) === BULK_ROWS, 'bulk import missing on the primary');
+      await waitFor('the replica to restore the snapshot', async () => names(await replica.get('/products')) === BULK_ROWS);
+      const after = (await replica.get('/debug/replication')).data?.data;
+      check(after.restores > before, `restores ${before} -> ${after.restores}`);
+      return `${BULK_ROWS} products via snapshot ${after.restored_snapshot}`;
+    });
+
+    await step('Replica caught up', async () => {
+      const stats = await waitFor('segments_behind to reach 0', async () => {
+        const r = await replica.get('/debug/replication');
+        return r.data?.data?.segments_behind === 0 ? r.data.data : null;
+      });
+      check(stats.failures === 0, `replica failures ${stats.failures}: ${stats.last_error}`);
+      return `applied_sequence ${stats.applied_sequence}, ${stats.rows_applied} rows`;
+    });
+  } catch (e) {
+    console.log('[FAIL]', e.message);
+    failed++;
+  } finally {
+    if (replica) await replica.stop();
+    if (primary) await primary.stop();
+    removeSandbox(sandbox);
+  }
+
+  console.log(failed === 0 ? '\nAll checks passed.\n' : `\n${failed} check(s) failed.\n`);
+  process.exit(failed === 0 ? 0 : 1);
+}
+
+main();
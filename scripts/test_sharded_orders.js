@@ -0,0 +1,207 @@
+#!/usr/bin/env node
+/**
+ * Cart and order round trip with carts and orders sharded over per-user files,
+ * then an archival pass that moves the order into the archive database and a
+ * backup that must cover every shard and archive file. A second database that
+ * already holds a cart when sharding is switched on must stay unsharded.
+ * Starts its own server on a throwaway database (see scripts/lib/backend_sandbox.js).
+ * Run: node scripts/test_sharded_orders.js
+ */
+
+const fs = require('fs');
+const path = require('path');
+const { createSandbox, reconfigure, startServer, removeSandbox, waitFor } = require('./lib/backend_sandbox');
+
+const PORT = 18105;
+const SHARDS = 4;
+const USER_ID = 1;  // the seeded test user
+
+function check(condition, message) {
+  if (!condition) throw new Error(message);
+}
+
+// Shard whose id range holds id, from the first_id of each shard in db-pool stats
+function shardOf(id, shards) {
+  let owner = -1;
+  for (const s of shards) {
+    if (id >= s.first_id) owner = s.shard;
+  }
+  return owner;
+}
+
+async function main() {
+  console.log('\n--- Sharded cart / order round trip ---\n');
+  const sandbox = createSandbox('shards', {
+    sharding: { shards: SHARDS, directory: 'shards' },
+    // Every pending order is "old" at once, so one pass archives it
+    archive: { enabled: true, hot_days: 0, interval_minutes: 1440, statuses: ['pending'] },
+  });
+  let server;
+  let failed = 0;
+  const step = async (name, fn) => {
+    try {
+      const detail = await fn();
+      console.log(`[PASS] ${name}${detail ? `: ${detail}` : ''}`);
+    } catch (e) {
+      console.log(`[FAIL] ${name}: ${e.message}`);
+      failed++;
+    }
+  };
+
+  try {
+    server = await startServer(sandbox, PORT);
+    let shards = [];
+    let products = [];
+    let cart = [];
+    let orderId;
+
+    await step('Shard files', async () => {
+      const pool = await server.get('/debug/db-pool');
+      shards = pool.data?.data?.shards || pool.data?.shards || [];
+      check(shards.length === SHARDS, `expected ${SHARDS} shards in db-pool stats, got ${shards.length}`);
+      for (const s of shards) check(fs.existsSync(path.resolve(sandbox.dir, s.path)), `missing shard file ${s.path}`);
+      return shards.map((s) => path.basename(s.path)).join(', ');
+    });
+
+    await step('Add to cart', async () => {
+      const list = await server.get('/products');
+      products = (list.data?.data || []).slice(0, 2);
+      check(products.length === 2, 'need two seeded products');
+      for (const p of products) {
+        const r = await server.post('/cart/add', { user_id: USER_ID, product_id: p.id, quantity: 1 });
+        check(r.status === 200 && r.data?.success, `cart/add ${p.id}: HTTP ${r.status} ${r.data?.message}`);
+      }
+      const again = await server.post('/cart/add', { user_id: USER_ID, product_id: products[0].id, quantity: 2 });
+      check(again.status === 200, `second cart/add: HTTP ${again.status}`);
+      const c = await server.get(`/cart/${USER_ID}`);
+      cart = c.data?.data || [];
+      check(cart.length === 2, `expected 2 cart lines, got ${cart.length}`);
+      const first = cart.find((i) => i.product_id === products[0].id);
+      check(first && first.quantity === 3, `expected quantity 3 for product ${products[0].id}`);
+      const owners = new Set(cart.map((i) => shardOf(i.id, shards)));
+      check(owners.size === 1, `cart lines of one user landed in shards ${[...owners]}`);
+      return `${cart.length} lines in shard ${[...owners][0]}`;
+    });
+
+    await step('Update and remove by cart item id', async () => {
+      const first = cart.find((i) => i.product_id === products[0].id);
+      const second = cart.find((i) => i.product_id === products[1].id);
+      const u = await server.put('/cart/update', { cart_item_id: first.id, quantity: 2 });
+      check(u.status === 200, `cart/update: HTTP ${u.status} ${u.data?.message}`);
+      const d = await server.del(`/cart/remove/${second.id}`);
+      check(d.status === 200, `cart/remove: HTTP ${d.status} ${d.data?.message}`);
+      const missing = await server.del('/cart/remove/2147483000');
+      check(missing.status === 404, `removing an id outside every shard: HTTP ${missing.status}`);
+      const c = await server.get(`/cart/${USER_ID}`);
+      cart = c.data?.data || [];
+      check(cart.length === 1 && cart[0].quantity === 2, `cart after update/remove: ${JSON.stringify(cart)}`);
+    });
+
+    await step('Checkout', async () => {
+      const r = await server.post('/orders/create', {
+        user_id: USER_ID, shipping_address: '1 Test Street', customer_name: 'Shard Test', phone: '000', payment_method: 'cod',
+      });
+      check(r.status === 200 && r.data?.order_id, `orders/create: HTTP ${r.status} ${r.data?.message}`);
+      orderId = r.data.order_id;
+      check(shardOf(orderId, shards) === shardOf(cart[0].id, shards), `order ${orderId} is not in the user's shard`);
+      const expected = (Math.round(Number(products[0].price) * 100) * 2) / 100;
+      const orders = await server.get(`/orders/user/${USER_ID}`);
+      const order = (orders.data?.data || []).find((o) => o.id === orderId);
+      check(order, `order ${orderId} missing from /orders/user/${USER_ID}`);
+      check(Math.abs(Number(order.total_amount) - expected) < 1e-9, `total ${order.total_amount}, expected ${expected}`);
+      const c = await server.get(`/cart/${USER_ID}`);
+      check((c.data?.data || []).length === 0, 'cart not cleared after checkout');
+      const byStatus = await server.get('/orders/by-status?status=pending');
+      check((byStatus.data?.data || []).some((o) => o.id === orderId), 'order missing from the cross-shard status listing');
+      return `order ${orderId}, total ${order.total_amount}`;
+    });
+
+    await step('Archive pass', async () => {
+      const r = await server.post('/admin/archive');
+      check(r.status === 202, `admin/archive: HTTP ${r.status} ${r.data?.message}`);
+      const stats = await waitFor('the archival pass', async () => {
+        const s = await server.get('/admin/archive');
+        return s.data?.data && !s.data.data.running && s.data.data.passes > 0 ? s.data.data : null;
+      });
+      check(!stats.last_error, `archiver error: ${stats.last_error}`);
+      check(stats.orders_moved >= 1, `orders_moved ${stats.orders_moved}`);
+      const hot = await server.get(`/orders/user/${USER_ID}`);
+      check(!(hot.data?.data || []).some((o) => o.id === orderId), 'archived order still listed as hot');
+      const paged = await server.get(`/orders/user/${USER_ID}?limit=10`);
+      const archived = (paged.data?.data || []).find((o) => o.id === orderId);
+      check(archived, `order ${orderId} missing from the archive page`);
+      check(paged.data.paging?.source !== 'hot', `paging source ${paged.data.paging?.source}`);
+      return `${stats.orders_moved} order(s), ${stats.items_moved} item(s) moved; page source ${paged.data.paging.source}`;
+    });
+
+    await step('Shard maintenance', async () => {
+      const pool = await server.get('/debug/db-pool');
+      const stats = pool.data?.data?.shards || pool.data?.shards || [];
+      for (const s of stats) {
+        check(s.maintenance && path.resolve(sandbox.dir, s.maintenance.file) === path.resolve(sandbox.dir, s.path),
+          `shard ${s.shard} has no maintenance thread of its own`);
+      }
+      return `${stats.length} schedulers`;
+    });
+
+    await step('Backup covers every file', async () => {
+      const r = await server.post('/admin/backup');
+      check(r.status === 202, `admin/backup: HTTP ${r.status} ${r.data?.message}`);
+      const last = await waitFor('the backup', async () => {
+        const s = await server.get('/admin/backup');
+        const l = s.data?.data?.last;
+        return l && ['completed', 'failed'].includes(l.state) ? l : null;
+      });
+      check(last.state === 'completed', `backup ${last.state}: ${last.error}`);
+      const names = (last.files || []).map((f) => path.basename(f));
+      // main, every shard, and an archive next to each of them
+      check(names.length === 2 * (SHARDS + 1), `backup wrote ${names.length} files: ${names.join(', ')}`);
+      for (const s of shards) {
+        const stem = path.basename(s.path, '.db');
+        check(names.some((n) => n.startsWith(`${stem}-2`)), `no backup of ${stem}`);
+        check(names.some((n) => n.startsWith(`${stem}-archive-`)), `no backup of ${stem}-archive`);
+      }
+      for (const f of last.files) check(fs.existsSync(path.resolve(sandbox.dir, f)), `missing backup file ${f}`);
+      return `${names.length} files`;
+    });
+  } catch (e) {
+    console.log('[FAIL]', e.message);
+    failed++;
+  } finally {
+    if (server) await server.stop();
+    removeSandbox(sandbox);
+  }
+
+  // Sharding switched on over a database that already has a cart: the shards
+  // would start empty and hide it, so the server must keep it in the main file
+  const existing = createSandbox('shards-existing', {});
+  server = null;
+  try {
+    await step('Sharding refused over existing carts', async () => {
+      server = await startServer(existing, PORT);
+      const list = await server.get('/products');
+      const product = (list.data?.data || [])[0];
+      check(product, 'need a seeded product');
+      const r = await server.post('/cart/add', { user_id: USER_ID, product_id: product.id, quantity: 1 });
+      check(r.status === 200, `cart/add: HTTP ${r.status} ${r.data?.message}`);
+      await server.stop();
+
+      reconfigure(existing, { sharding: { shards: SHARDS, directory: 'shards' } });
+      server = await startServer(existing, PORT);
+      const pool = await server.get('/debug/db-pool');
+      check(!(pool.data?.data?.shards || pool.data?.shards), 'sharding enabled over a non-empty main file');
+      check(/already holds carts or orders/.test(server.output()), 'no error logged for the refused sharding');
+      const c = await server.get(`/cart/${USER_ID}`);
+      check((c.data?.data || []).length === 1, `cart after restart: ${JSON.stringify(c.data?.data)}`);
+      return 'cart kept in the main file';
+    });
+  } finally {
+    if (server) await server.stop();
+    removeSandbox(existing);
+  }
+
+  console.log(failed === 0 ? '\nAll checks passed.\n' : `\n${failed} check(s) failed.\n`);
+  process.exit(failed === 0 ? 0 : 1);
+}
+
+main();
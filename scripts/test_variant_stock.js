@@ -0,0 +1,113 @@
+#!/usr/bin/env node
+/**
+ * Per-size stock (product_variants) across product updates: catalog re-imports
+ * that change the total, the price or the sizes list must keep the stock of the
+ * sizes that remain, and the ?size= listings must follow it.
+ * Starts its own server on a throwaway database (see scripts/lib/backend_sandbox.js).
+ * Run: node scripts/test_variant_stock.js
+ */
+
+const { createSandbox, startServer, importProducts, removeSandbox } = require('./lib/backend_sandbox');
+
+const PORT = 18108;
+const SKU = 'VAR-TEE-001';
+const NAME = 'Variant Stock Test Tee';
+
+function check(condition, message) {
+  if (!condition) throw new Error(message);
+}
+
+async function main() {
+  console.log('\n--- Per-size stock across product updates ---\n');
+  const sandbox = createSandbox('variants', { import: { directory: 'imports' } });
+  let server;
+  let failed = 0;
+  let imports = 0;
+  let productId;
+
+  // Re-imports the test product with the given fields and returns its details
+  const write = async (fields) => {
+    imports++;
+    await importProducts(server, sandbox, `variants-${imports}.jsonl`, [
+      { sku: SKU, name: NAME, gender: 'unisex', price: 19.99, ...fields },
+    ]);
+    if (productId === undefined) {
+      const list = await server.get('/products');
+      const product = (list.data?.data || []).find((p) => p.name === NAME);
+      check(product, `imported product ${NAME} not listed`);
+      productId = product.id;
+    }
+    const details = await server.get(`/products/details/${productId}`);
+    check(details.status === 200 && details.data?.data, `products/details/${productId}: HTTP ${details.status}`);
+    return details.data.data;
+  };
+  // "S2 M2 L2" from the variants, checked against the product total
+  const stockOf = (product) => {
+    const variants = product.variants || [];
+    const sum = variants.reduce((n, v) => n + v.stock, 0);
+    check(sum === product.stock_quantity, `variants sum to ${sum}, stock_quantity is ${product.stock_quantity}`);
+    return variants.map((v) => `${v.size}${v.stock}`).join(' ');
+  };
+  const expectStock = (product, expected) => {
+    const actual = stockOf(product);
+    check(actual === expected, `variants ${actual}, expected ${expected}`);
+    return actual;
+  };
+  const listed = async (size) => {
+    const list = await server.get(`/products?size=${encodeURIComponent(size)}`);
+    return (list.data?.data || []).some((p) => p.id === productId);
+  };
+  const step = async (name, fn) => {
+    try {
+      const detail = await fn();
+      console.log(`[PASS] ${name}${detail ? `: ${detail}` : ''}`);
+    } catch (e) {
+      console.log(`[FAIL] ${name}: ${e.message}`);
+      failed++;
+    }
+  };
+
+  try {
+    server = await startServer(sandbox, PORT);
+
+    await step('New product spreads its total', async () =>
+      expectStock(await write({ stock: 6, sizes: 'S,M,L' }), 'S2 M2 L2'));
+
+    await step('Lower total is taken in size order', async () =>
+      expectStock(await write({ stock: 4, sizes: 'S,M,L' }), 'S0 M2 L2'));
+
+    await step('Price-only update keeps per-size stock', async () => {
+      const product = await write({ price: 24.5, stock: 4, sizes: 'S,M,L' });
+      check(Number(product.price) === 24.5, `price ${product.price}, expected 24.5`);
+      return expectStock(product, 'S0 M2 L2');
+    });
+
+    await step('Size filter follows per-size stock', async () => {
+      check(!(await listed('S')), 'listed under ?size=S with no S in stock');
+      check(await listed('m'), 'not listed under ?size=m (sizes compare case-insensitively)');
+    });
+
+    await step('New sizes list keeps remaining sizes', async () =>
+      expectStock(await write({ price: 24.5, stock: 4, sizes: 'M,L,XL' }), 'M2 L2 XL0'));
+
+    await step('Higher total goes to the first size', async () =>
+      expectStock(await write({ price: 24.5, stock: 10, sizes: 'M,L,XL' }), 'M8 L2 XL0'));
+
+    await step('Size filter after resizing', async () => {
+      check(!(await listed('S')), 'listed under the dropped size S');
+      check(!(await listed('XL')), 'listed under ?size=XL with no XL in stock');
+      check(await listed('L'), 'not listed under ?size=L');
+    });
+  } catch (e) {
+    console.log('[FAIL]', e.message);
+    failed++;
+  } finally {
+    if (server) await server.stop();
+    removeSandbox(sandbox);
+  }
+
+  console.log(failed === 0 ? '\nAll checks passed.\n' : `\n${failed} check(s) failed.\n`);
+  process.exit(failed === 0 ? 0 : 1);
+}
+
+main();